@@ -0,0 +1,11 @@
+package main;
+
+func main() {
+    var arr = [1, 2, 3, 4, 5, 6, 7, 8];
+    var i int;
+    var s int = 0;
+    for (i = 0; i < 10000000; i = i + 1) {
+        s = s + arr[i - i / 8 * 8];
+    }
+    echo(s);
+}
@@ -0,0 +1,18 @@
+package main;
+
+func main() {
+    // 内建函数直接在连续存储上执行向量化的批量运算
+    var arr []float = [];
+    var i int;
+    var f float = 0.0;
+    for (i = 0; i < 1000000; i = i + 1) {
+        arr[i] = f;
+        f = f + 0.5;
+    }
+    var s float = 0.0;
+    var r int;
+    for (r = 0; r < 100; r = r + 1) {
+        s = s + sum_float(arr) + dot_float(arr, arr) + max_float(arr);
+    }
+    echo(s);
+}
@@ -0,0 +1,12 @@
+package main;
+
+func main() {
+    // 在循环中不断向字符串末尾追加内容
+    var s string = "<ul>";
+    var i int;
+    for (i = 0; i < 200000; i = i + 1) {
+        s = s + "<li>item</li>";
+    }
+    s = s + "</ul>";
+    echo(i);
+}
@@ -0,0 +1,13 @@
+package main;
+
+func main() {
+    var a = 0;
+    var b = 0;
+
+    do {
+        b = b + a * 2;
+        a = a + 1;
+    } while (a < 10000000);
+
+    echo(b);
+}
@@ -0,0 +1,12 @@
+package main;
+
+func main() {
+    var i int;
+    var sum = 0;
+
+    for (i = 0; i < 10000000; i = i + 1) {
+        sum = sum + i;
+    }
+
+    echo(sum);
+}
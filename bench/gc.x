@@ -0,0 +1,31 @@
+package main;
+
+func make(n int) []string {
+    var a []string = [];
+    var i int;
+    for (i = 0; i < n; i = i + 1) {
+        a[] = "item" + "-" + "x";
+    }
+    return a;
+}
+
+func main() {
+    // 在循环中不断创建马上变为垃圾的字符串、数组与 map，内存占用应当保持平稳
+    var i int;
+    var total = 0;
+    var s string = "";
+    for (i = 0; i < 300000; i = i + 1) {
+        var a []int = [];
+        var j int;
+        for (j = 0; j < 20; j = j + 1) {
+            a[] = j;
+        }
+        total = total + a[19];
+        s = make(4)[2];
+        var m [int]string = [];
+        m[i] = s;
+        total = total + map_len(m);
+    }
+    echo(total);
+    echo(s);
+}
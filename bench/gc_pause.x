@@ -0,0 +1,36 @@
+package main;
+
+func leaf(n int) int {
+    var i int;
+    var t = 0;
+    for (i = 0; i < n; i = i + 1) {
+        var a []string = [];
+        a[] = "x" + "y";
+        a[] = "z" + "w";
+        t = t + 1;
+    }
+    return t;
+}
+
+func rec(d int, n int) int {
+    var s = "a" + "b";
+    var a []int = [];
+    a[] = d;
+    var m [string]int = [];
+    m[s] = d;
+    if (d > 0) {
+        return rec(d - 1, n) + a[0] - m["ab"];
+    }
+    return leaf(n);
+}
+
+func main() {
+    // 递归中的每一层都持有对象，使老年代不断增长并触发 Full GC
+    // 使用 -s 查看 GC 次数与最长暂停时间，-p 设置暂停时间目标
+    var i int;
+    var t = 0;
+    for (i = 0; i < 10; i = i + 1) {
+        t = t + rec(6000, 100000);
+    }
+    echo(t);
+}
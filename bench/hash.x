@@ -0,0 +1,18 @@
+package main;
+
+func main() {
+    // 下标不连续，数组使用哈希表保存
+    var arr []int = [];
+    var i int;
+    for (i = 0; i < 1000000; i = i + 1) {
+        arr[i * 7] = i;
+    }
+    var s int = 0;
+    var r int;
+    for (r = 0; r < 5; r = r + 1) {
+        for (i = 0; i < 1000000; i = i + 1) {
+            s = s + arr[i * 7];
+        }
+    }
+    echo(s);
+}
@@ -0,0 +1,173 @@
+#include "../../src/common/common.h"
+#include "chained.h"
+
+int ht_chained_init(ht_chained_t* ht, unsigned size) {
+    memset(ht, 0, sizeof(ht_chained_t));
+    
+    // 规范化 size 取值
+    size = ALIGN(size);
+    if (size < HT_CHAINED_MIN_SIZE) {
+        size = HT_CHAINED_MIN_SIZE;
+    }
+
+    ht->table = (ht_chained_node_t **)xcalloc(size, sizeof(ht_chained_node_t*));
+    if (UNEXPECTED(!ht->table)) {
+        return 1;
+    }
+
+    ht->length = 0;
+    ht->size = size;
+
+    return 0;
+}
+
+static unsigned ht_bkdr(ht_chained_t* ht, lgx_str_t* k) {
+    unsigned ret = 0;
+    int i;
+    
+    for (i = 0; i < k->length; ++i) {
+        ret = (ret << 5) - ret + k->buffer[i];
+    }
+    
+    return ret;
+}
+
+static int ht_set(ht_chained_t* ht, ht_chained_node_t* node) {
+    unsigned pos = node->hash % ht->size;
+
+    // 插入位置是空的
+    if (!ht->table[pos]) {
+        node->next = NULL;
+        ht->table[pos] = node;
+    } else {
+        ht_chained_node_t* next = ht->table[pos];
+        while (next) {
+            if (lgx_str_cmp(&node->k, &next->k) == 0) {
+                // 键已存在
+                return 1;
+            }
+            next = next->next;
+        }
+
+        // 插入到链表头部
+        node->next = ht->table[pos];
+        ht->table[pos] = node;
+    }
+
+    ++ ht->length;
+
+    if (!ht->tail) {
+        ht->head = node;
+        ht->tail = node;
+    } else {
+        ht->tail->order = node;
+        ht->tail = node;
+    }
+
+    return 0;
+}
+
+static ht_chained_node_t* ht_node_new(lgx_str_t* k, void* v) {
+    ht_chained_node_t* node = (ht_chained_node_t*)xcalloc(1, sizeof(ht_chained_node_t));
+    if (!node) {
+        return NULL;
+    }
+
+    if (lgx_str_init(&node->k, k->length)) {
+        xfree(node);
+        return NULL;
+    }
+    
+    lgx_str_dup(k, &node->k);
+    node->v = v;
+
+    return node;
+}
+
+static void ht_node_del(ht_chained_node_t* node) {
+    lgx_str_cleanup(&node->k);
+    xfree(node);
+}
+
+void ht_chained_cleanup(ht_chained_t* ht) {
+    int i;
+    ht_chained_node_t *node, *next;
+    for (i = 0; i < ht->size; i++) {
+        node = ht->table[i];
+        while (node) {
+            next = node->next;
+            ht_node_del(node);
+            node = next;
+        }
+    }
+
+    xfree(ht->table);
+
+    memset(ht, 0, sizeof(ht_chained_t));
+}
+
+// 将 hash table 扩容一倍
+static int ht_resize(ht_chained_t* ht) {
+    ht_chained_t resize;
+    if (UNEXPECTED(ht_chained_init(&resize, ht->size * 2))) {
+        return 1;
+    }
+
+    ht_chained_node_t *n = ht->head, *next;
+    while (n) {
+        next = n->order;
+        ht_set(&resize, n);
+        n = next;
+    }
+
+    xfree(ht->table);
+
+    ht->size = resize.size;
+    ht->table = resize.table;
+    ht->head = resize.head;
+    ht->tail = resize.tail;
+
+    return 0;
+}
+
+int ht_chained_set(ht_chained_t *ht, lgx_str_t* k, void* v) {
+    ht_chained_node_t* node = ht_node_new(k, v);
+    if (!node) {
+        return 1;
+    }
+    node->hash = ht_bkdr(ht, &node->k);
+
+    if (ht_set(ht, node)) {
+        // 键已存在
+        ht_node_del(node);
+        return 1;
+    }
+
+    if (UNEXPECTED(ht->size < ht->length * 2)) {
+        ht_resize(ht);
+    }
+
+    return 0;
+}
+
+ht_chained_node_t* ht_chained_get(ht_chained_t *ht, lgx_str_t* k) {
+    unsigned pos = ht_bkdr(ht, k) % ht->size;
+
+    ht_chained_node_t *next = ht->table[pos];
+    while (next) {
+        if (lgx_str_cmp(&next->k, k) == 0) {
+            return next;
+        }
+        next = next->next;
+    }
+
+    return NULL;
+}
+
+ht_chained_node_t* ht_chained_first(const ht_chained_t* ht) {
+    return ht->head;
+}
+
+ht_chained_node_t* ht_chained_next(const ht_chained_node_t* node) {
+    return node->order;
+}
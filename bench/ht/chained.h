@@ -0,0 +1,50 @@
+#ifndef LGX_HT_CHAINED_H
+#define	LGX_HT_CHAINED_H
+
+#include "../../src/common/str.h"
+
+// 替换为开放寻址之前的拉链法哈希表（commit 0273992 中的 lgx_ht_t），只用于性能对比
+// 除了改名之外保持原有实现，包括 BKDR 哈希函数
+
+#define HT_CHAINED_MIN_SIZE 8
+
+typedef struct ht_chained_node_s {
+    // 下一个相同哈希值的元素
+    struct ht_chained_node_s* next;
+
+    // 下一个插入的元素
+    struct ht_chained_node_s* order;
+
+	// 当前哈希节点的内容
+    lgx_str_t k;
+    void* v;
+
+    // 当前节点的哈希值
+    unsigned hash;
+} ht_chained_node_t;
+
+typedef struct ht_chained_s {
+    // 总容量
+    unsigned size;
+
+    // 已使用的容量
+    unsigned length;
+
+    // 存储数据的结构
+    ht_chained_node_t** table;
+
+    // 依据插入顺序保存的链表，以便遍历
+    ht_chained_node_t* head;
+    ht_chained_node_t* tail;
+} ht_chained_t;
+
+int ht_chained_init(ht_chained_t* ht, unsigned size);
+void ht_chained_cleanup(ht_chained_t* ht);
+
+int ht_chained_set(ht_chained_t *ht, lgx_str_t* k, void* v);
+ht_chained_node_t* ht_chained_get(ht_chained_t *ht, lgx_str_t* k);
+
+ht_chained_node_t* ht_chained_first(const ht_chained_t* ht);
+ht_chained_node_t* ht_chained_next(const ht_chained_node_t* node);
+
+#endif	/* LGX_HT_CHAINED_H */
@@ -0,0 +1,176 @@
+#include <time.h>
+#include "../../src/common/common.h"
+#include "../../src/common/ht.h"
+#include "chained.h"
+
+// 对比开放寻址的 lgx_ht_t 与之前的拉链法哈希表
+//
+// 在构建目录中执行：
+//     cmake --build . --target ht_bench && ./ht_bench [键的数量]
+//
+// 分别使用 8 字节的整数键（数组使用的键）与短字符串键，
+// 测量插入全部键、按随机顺序对全部键查找 5 遍以及遍历 5 遍的耗时。
+// 连续的键在 BKDR 哈希下落在相邻的桶中，按插入顺序查找会高估拉链法的缓存命中率，所以打乱查找顺序
+
+#define LOOKUP_PASSES 5
+#define ITERATE_PASSES 5
+
+typedef struct {
+    double insert;
+    double lookup;
+    double iterate;
+} bench_result_t;
+
+static double bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// 生成 n 个键。整数键与数组的稀疏下标一致（i * 7），字符串键形如 "key12345"
+static lgx_str_t* bench_keys(unsigned n, int string, long long* nums, char* buf) {
+    lgx_str_t* keys = (lgx_str_t*)malloc(n * sizeof(lgx_str_t));
+    unsigned i;
+    for (i = 0; i < n; i ++) {
+        if (string) {
+            keys[i].buffer = buf + i * 16;
+            keys[i].length = sprintf(keys[i].buffer, "key%u", i);
+        } else {
+            nums[i] = (long long)i * 7;
+            keys[i].buffer = (char*)&nums[i];
+            keys[i].length = sizeof(long long);
+        }
+        keys[i].size = 0;
+    }
+    return keys;
+}
+
+// 固定种子的随机排列，两个哈希表使用相同的查找顺序
+static unsigned* bench_order(unsigned n) {
+    unsigned* order = (unsigned*)malloc(n * sizeof(unsigned));
+    unsigned long long x = 88172645463325252ULL;
+    unsigned i;
+    for (i = 0; i < n; i ++) {
+        order[i] = i;
+    }
+    for (i = n - 1; i > 0; i --) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        unsigned j = (unsigned)(x % (i + 1));
+        unsigned t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    return order;
+}
+
+static bench_result_t bench_ht(lgx_str_t* keys, unsigned* order, unsigned n, unsigned long long* check) {
+    bench_result_t r;
+    lgx_ht_t ht;
+    unsigned i, p;
+
+    double t = bench_now();
+    lgx_ht_init(&ht, 0);
+    for (i = 0; i < n; i ++) {
+        lgx_ht_set(&ht, &keys[i], &keys[i]);
+    }
+    r.insert = bench_now() - t;
+
+    t = bench_now();
+    for (p = 0; p < LOOKUP_PASSES; p ++) {
+        for (i = 0; i < n; i ++) {
+            *check += (uintptr_t)lgx_ht_get(&ht, &keys[order[i]])->v;
+        }
+    }
+    r.lookup = bench_now() - t;
+
+    t = bench_now();
+    for (p = 0; p < ITERATE_PASSES; p ++) {
+        lgx_ht_node_t* node;
+        for (node = lgx_ht_first(&ht); node; node = lgx_ht_next(node)) {
+            *check += node->k.length;
+        }
+    }
+    r.iterate = bench_now() - t;
+
+    lgx_ht_cleanup(&ht);
+    return r;
+}
+
+static bench_result_t bench_chained(lgx_str_t* keys, unsigned* order, unsigned n, unsigned long long* check) {
+    bench_result_t r;
+    ht_chained_t ht;
+    unsigned i, p;
+
+    double t = bench_now();
+    ht_chained_init(&ht, 0);
+    for (i = 0; i < n; i ++) {
+        ht_chained_set(&ht, &keys[i], &keys[i]);
+    }
+    r.insert = bench_now() - t;
+
+    t = bench_now();
+    for (p = 0; p < LOOKUP_PASSES; p ++) {
+        for (i = 0; i < n; i ++) {
+            *check += (uintptr_t)ht_chained_get(&ht, &keys[order[i]])->v;
+        }
+    }
+    r.lookup = bench_now() - t;
+
+    t = bench_now();
+    for (p = 0; p < ITERATE_PASSES; p ++) {
+        ht_chained_node_t* node;
+        for (node = ht_chained_first(&ht); node; node = ht_chained_next(node)) {
+            *check += node->k.length;
+        }
+    }
+    r.iterate = bench_now() - t;
+
+    ht_chained_cleanup(&ht);
+    return r;
+}
+
+static void bench_print(const char* name, bench_result_t* chained, bench_result_t* ht) {
+    printf("%-8s %-8s %10.1f ms %10.1f ms %+7.1f%%\n", name, "insert",
+        chained->insert, ht->insert, (ht->insert / chained->insert - 1) * 100);
+    printf("%-8s %-8s %10.1f ms %10.1f ms %+7.1f%%\n", name, "lookup",
+        chained->lookup, ht->lookup, (ht->lookup / chained->lookup - 1) * 100);
+    printf("%-8s %-8s %10.1f ms %10.1f ms %+7.1f%%\n", name, "iterate",
+        chained->iterate, ht->iterate, (ht->iterate / chained->iterate - 1) * 100);
+}
+
+int main(int argc, char* argv[]) {
+    unsigned n = argc > 1 ? (unsigned)atoi(argv[1]) : 1000000;
+    if (!n) {
+        fprintf(stderr, "usage: %s [count]\n", argv[0]);
+        return 1;
+    }
+
+    lgx_hash_init();
+
+    long long* nums = (long long*)malloc(n * sizeof(long long));
+    char* buf = (char*)malloc((size_t)n * 16);
+    unsigned* order = bench_order(n);
+    unsigned long long check = 0;
+
+    printf("%u keys, %d lookup passes, %d iterate passes\n", n, LOOKUP_PASSES, ITERATE_PASSES);
+    printf("%-8s %-8s %13s %13s %8s\n", "key", "op", "chained", "open", "change");
+
+    int string;
+    for (string = 0; string <= 1; string ++) {
+        lgx_str_t* keys = bench_keys(n, string, nums, buf);
+        bench_result_t chained = bench_chained(keys, order, n, &check);
+        bench_result_t ht = bench_ht(keys, order, n, &check);
+        bench_print(string ? "string" : "integer", &chained, &ht);
+        free(keys);
+    }
+
+    // 防止查找被优化掉
+    fprintf(stderr, "checksum %llu\n", check);
+
+    free(order);
+    free(buf);
+    free(nums);
+    return 0;
+}
@@ -0,0 +1,22 @@
+package main;
+
+func main() {
+    // 整数键以二进制保存，不需要转换为字符串
+    var m [int]int = [];
+    var i int;
+    for (i = 0; i < 1000000; i = i + 1) {
+        m[i * 7919] = i;
+    }
+    var s = 0;
+    for (i = 0; i < 1000000; i = i + 1) {
+        s = s + m[i * 7919];
+    }
+    echo(s);
+
+    // 第一次范围查询时转为有序保存
+    var n = 0;
+    for (i = 0; i < 100000; i = i + 1) {
+        n = n + map_floor(m, i * 65537);
+    }
+    echo(n);
+}
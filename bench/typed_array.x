@@ -0,0 +1,18 @@
+package main;
+
+func main() {
+    // 元素全部为 int 的数组使用不带类型标记的连续存储
+    var arr []int = [];
+    var i int;
+    for (i = 0; i < 4000000; i = i + 1) {
+        arr[i] = i;
+    }
+    var s int = 0;
+    var r int;
+    for (r = 0; r < 5; r = r + 1) {
+        for (i = 0; i < 4000000; i = i + 1) {
+            s = s + arr[i];
+        }
+    }
+    echo(s);
+}
@@ -0,0 +1,13 @@
+package main;
+
+func main() {
+    var a = 10000000;
+    var b = 0;
+
+    while (a > 0) {
+        b = b + a;
+        a = a - 1;
+    }
+
+    echo(b);
+}
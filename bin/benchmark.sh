@@ -0,0 +1,35 @@
+#!/bin/sh
+
+# 解释器性能测试
+#
+# 在构建目录中执行（需要 Release 构建）：
+#     ../bin/benchmark.sh [source_file ...]
+#
+# 对比 computed goto 与 switch 分发：
+#     cmake .. -DCMAKE_BUILD_TYPE=Release -DXSCRIPT_SWITCH_DISPATCH=ON
+#
+# 指定字节码优化级别（默认为 2）：
+#     OPTIMIZE=0 ../bin/benchmark.sh
+#
+# 指定 JIT 编译阈值（默认为 1000，0 表示关闭 JIT）：
+#     JIT=0 ../bin/benchmark.sh
+#
+# 指定循环 trace 阈值（默认为 50，0 表示关闭 trace）：
+#     TRACE=0 ../bin/benchmark.sh
+
+ROOT=$(cd $(dirname $0)/.. && pwd)
+OPTIMIZE=${OPTIMIZE:-2}
+JIT=${JIT:-1000}
+TRACE=${TRACE:-50}
+
+if [ $# -eq 0 ] ; then
+    set -- $ROOT/test/basic/fib.x $ROOT/test/statement/for.x $ROOT/test/statement/do-while.x $ROOT/bench/*.x
+fi
+
+for file in "$@"
+do
+    ./xscript --run --stat -O $OPTIMIZE -j $JIT -t $TRACE $file > /dev/null
+    if [ $? -ne 0 ] ;then
+        echo "ERROR" $file
+    fi
+done
@@ -1,23 +1,109 @@
 #!/bin/sh
 
-function mk_test() {
+# 功能测试
+#
+# 在构建目录中执行：
+#     ../bin/test.sh ../test
+#
+# 每个用例先用语法分析器解析一次，再使用 --run 在 -O0/-O2 下分别以三种方式执行：
+#     -j 0  只使用解释器
+#     -j 1  函数在第一次调用时编译为机器码
+#     -t 1  函数保持解释执行，循环在第一次回跳时记录 trace 并编译
+# 同一优化级别下，JIT 的输出必须与解释器完全一致。
+#
+# 用例中所有 /* EXPECT ... */ 注释块的内容（去掉行首缩进后依次拼接）即为期望的输出，
+# 没有 EXPECT 注释块的用例只检查退出状态与各执行方式之间的一致性。
+#
+# 包含 NORUN 标记的用例使用了字节码编译器尚未支持的语法，只做语法分析；
+# 包含 NOPARSE 标记的用例使用了语法分析器尚未支持的语法（例如 []int），只使用 --run 执行；
+# 包含 PENDING 标记的用例使用了尚未实现的语法，跳过执行；
+# 包含 INT64 标记的用例依赖完整的 64 位整数，在 NaN-boxing 构建（整数只有 47 位）中跳过执行。
+
+XSCRIPT=${XSCRIPT:-./xscript}
+FAILED=0
+
+if $XSCRIPT -v 2>&1 | grep -q nan-boxing ;then
+    NAN_BOXING=1
+fi
+
+expect() {
+    awk '/\/\* EXPECT/ { e = 1; next } e && /\*\// { e = 0; next } e { sub(/^[ \t]+/, ""); print }' $1
+}
+
+run_test() {
+    if grep -q PENDING $1 ;then
+        echo "SKIP" $1
+        return 0
+    fi
+
+    if [ -n "$NAN_BOXING" ] && grep -q INT64 $1 ;then
+        echo "SKIP" $1
+        return 0
+    fi
+
+    if ! grep -q NOPARSE $1 ;then
+        $XSCRIPT $1 > /dev/null
+        if [ $? -ne 0 ] ;then
+            echo "ERROR" $1
+            return 1
+        fi
+    fi
+
+    if grep -q NORUN $1 ;then
+        echo "OK" $1
+        return 0
+    fi
+
+    for optimize in 0 2
+    do
+        for mode in "-j 0" "-j 1" "-t 1"
+        do
+            output=$($XSCRIPT --run -O $optimize $mode $1 2>&1)
+            if [ $? -ne 0 ] ;then
+                echo "ERROR" $1 "(-O$optimize $mode)"
+                echo "$output" | tail -n 5
+                return 1
+            fi
+
+            if grep -q EXPECT $1 && [ "$output" != "$(expect $1)" ] ;then
+                echo "ERROR" $1 "(-O$optimize $mode): unexpected output"
+                echo "$output" > /tmp/xscript_test.$$
+                expect $1 | diff - /tmp/xscript_test.$$ | head -n 10
+                rm -f /tmp/xscript_test.$$
+                return 1
+            fi
+
+            if [ "$mode" = "-j 0" ] ;then
+                interpreted=$output
+            elif [ "$output" != "$interpreted" ] ;then
+                echo "ERROR" $1 "(-O$optimize $mode): output differs from -j 0"
+                echo "$output" > /tmp/xscript_test.$$
+                echo "$interpreted" | diff - /tmp/xscript_test.$$ | head -n 10
+                rm -f /tmp/xscript_test.$$
+                return 1
+            fi
+        done
+    done
+
+    echo "OK" $1
+    return 0
+}
+
+mk_test() {
     for file in $1/*
     do
         if test -f $file
         then
-            ./xscript $file > /dev/null
-            if [ $? -ne 0 ] ;then
-                echo "ERROR" $file
-            else
-                echo "OK" $file
-            fi
+            run_test $file || FAILED=1
         elif test -d $file
         then
-            mk_test $file 
+            mk_test $file
         fi
     done
 }
 
 if [ $# -eq 1 ] ; then
     mk_test $1
-fi
\ No newline at end of file
+fi
+
+exit $FAILED
@@ -0,0 +1,83 @@
+#include "arena.h"
+
+// 内存块头部占用的空间
+#define ARENA_CHUNK_HEADER LGX_ARENA_ALIGN(sizeof(lgx_arena_chunk_t))
+
+void lgx_arena_init(lgx_arena_t* arena) {
+    memset(arena, 0, sizeof(lgx_arena_t));
+}
+
+void lgx_arena_cleanup(lgx_arena_t* arena) {
+    while (arena->chunks) {
+        lgx_arena_chunk_t* next = arena->chunks->next;
+        xfree(arena->chunks);
+        arena->chunks = next;
+    }
+
+    memset(arena, 0, sizeof(lgx_arena_t));
+}
+
+// 当前内存块空间不足时申请新的内存块
+// 内存块申请时即清零，且在释放前不会被复用，所以分配时不需要再清零
+void* lgx_arena_grow(lgx_arena_t* arena, size_t size) {
+    if (size > LGX_ARENA_CHUNK_SIZE / 4) {
+        // 大块内存单独申请，不影响当前内存块的剩余空间
+        lgx_arena_chunk_t* chunk = (lgx_arena_chunk_t*)xcalloc(1, ARENA_CHUNK_HEADER + size);
+        if (UNEXPECTED(!chunk)) {
+            return NULL;
+        }
+        arena->size += ARENA_CHUNK_HEADER + size;
+
+        if (arena->chunks) {
+            chunk->next = arena->chunks->next;
+            arena->chunks->next = chunk;
+        } else {
+            chunk->next = NULL;
+            arena->chunks = chunk;
+        }
+
+        return (char*)chunk + ARENA_CHUNK_HEADER;
+    }
+
+    lgx_arena_chunk_t* chunk = (lgx_arena_chunk_t*)xcalloc(1, LGX_ARENA_CHUNK_SIZE);
+    if (UNEXPECTED(!chunk)) {
+        return NULL;
+    }
+    arena->size += LGX_ARENA_CHUNK_SIZE;
+
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+
+    arena->pos = (char*)chunk + ARENA_CHUNK_HEADER;
+    arena->end = (char*)chunk + LGX_ARENA_CHUNK_SIZE;
+
+    void* p = arena->pos;
+    arena->pos += size;
+
+    return p;
+}
+
+void* lgx_arena_realloc(lgx_arena_t* arena, void* p, size_t old_size, size_t size) {
+    if (!p) {
+        return lgx_arena_alloc(arena, size);
+    }
+
+    old_size = LGX_ARENA_ALIGN(old_size);
+    if (size <= old_size) {
+        return p;
+    }
+
+    size = LGX_ARENA_ALIGN(size);
+    if ((char*)p + old_size == arena->pos && (size_t)(arena->end - (char*)p) >= size) {
+        arena->pos = (char*)p + size;
+        return p;
+    }
+
+    void* q = lgx_arena_alloc(arena, size);
+    if (UNEXPECTED(!q)) {
+        return NULL;
+    }
+    memcpy(q, p, old_size);
+
+    return q;
+}
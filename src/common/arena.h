@@ -0,0 +1,48 @@
+#ifndef LGX_ARENA_H
+#define LGX_ARENA_H
+
+#include "common.h"
+
+// 每次向系统申请的内存大小，超过其四分之一的请求单独申请
+#define LGX_ARENA_CHUNK_SIZE (64 * 1024)
+
+typedef struct lgx_arena_chunk_s {
+    struct lgx_arena_chunk_s* next;
+} lgx_arena_chunk_t;
+
+// 顺序分配的内存池，分配出的内存不能单独释放，在 lgx_arena_cleanup 时一次性释放
+typedef struct {
+    lgx_arena_chunk_t* chunks;
+
+    // 当前内存块中未使用的空间
+    char* pos;
+    char* end;
+
+    // 已向系统申请的内存总量
+    size_t size;
+} lgx_arena_t;
+
+void lgx_arena_init(lgx_arena_t* arena);
+void lgx_arena_cleanup(lgx_arena_t* arena);
+
+void* lgx_arena_grow(lgx_arena_t* arena, size_t size);
+
+// 分配出的内存按 8 字节对齐，语法树中没有需要更大对齐的数据
+#define LGX_ARENA_ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+// 分配 size 字节的内存，返回的内存已经清零
+static lgx_inline void* lgx_arena_alloc(lgx_arena_t* arena, size_t size) {
+    size = LGX_ARENA_ALIGN(size);
+    if (EXPECTED((size_t)(arena->end - arena->pos) >= size)) {
+        void* p = arena->pos;
+        arena->pos += size;
+        return p;
+    }
+
+    return lgx_arena_grow(arena, size);
+}
+
+// 把 p 指向的内存扩展为 size 字节，p 是最后一次分配的内存时原地扩展
+void* lgx_arena_realloc(lgx_arena_t* arena, void* p, size_t old_size, size_t size);
+
+#endif // LGX_ARENA_H
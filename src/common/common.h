@@ -9,14 +9,22 @@
 #include <memory.h>
 #include <assert.h>
 
-//#include <jemalloc/jemalloc.h>
-
 #define lgx_inline inline
 
+// 定义 LGX_SYSTEM_MALLOC 时直接使用系统的 malloc，便于配合 ASAN 等工具检查内存错误
+#ifdef LGX_SYSTEM_MALLOC
 #define xmalloc malloc
 #define xcalloc calloc
 #define xrealloc realloc
 #define xfree free
+#else
+#include "mem.h"
+
+#define xmalloc lgx_mem_alloc
+#define xcalloc lgx_mem_calloc
+#define xrealloc lgx_mem_realloc
+#define xfree lgx_mem_free
+#endif
 
 #if defined(__GNUC__)
 #define EXPECTED(x)	(__builtin_expect(((x) != 0), 1))
@@ -26,6 +34,16 @@
 #define UNEXPECTED(x)	(x)
 #endif
 
+// 64 位整数除法与取余，调用者需要保证除数不为 0
+// 除数为 -1 时按补码回绕（INT64_MIN / -1 == INT64_MIN），避免 CPU 触发溢出异常，与 JIT 的结果一致
+static lgx_inline long long lgx_long_div(long long a, long long b) {
+    return UNEXPECTED(b == -1) ? (long long)(0ULL - (unsigned long long)a) : a / b;
+}
+
+static lgx_inline long long lgx_long_mod(long long a, long long b) {
+    return UNEXPECTED(b == -1) ? 0 : a % b;
+}
+
 #if defined(__GNUC__)
 #define ALIGN(x) ((1ULL << 32) >> __builtin_clz(x - 1))
 #elif defined(WIN32)
@@ -0,0 +1,121 @@
+#include "common.h"
+#include "hash.h"
+
+#include <time.h>
+
+/* 哈希算法基于 wyhash（https://github.com/wangyi-fudan/wyhash），每次处理 8 字节
+ * 种子在进程启动时随机生成，相同的键在不同的进程中会得到不同的哈希值
+ */
+
+static const uint64_t hash_secret[4] = {
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+};
+
+// 已经与 hash_secret 混合过的种子
+static uint64_t hash_seed = 0x2d358dccaa6c78a5ull;
+
+// 计算 a * b 的 128 位结果，并把高 64 位与低 64 位分别保存到 a 和 b 中
+static lgx_inline void hash_mum(uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = *a;
+    r *= *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static lgx_inline uint64_t hash_mix(uint64_t a, uint64_t b) {
+    hash_mum(&a, &b);
+    return a ^ b;
+}
+
+static lgx_inline uint64_t hash_r8(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static lgx_inline uint64_t hash_r4(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static lgx_inline uint64_t hash_r3(const uint8_t *p, unsigned k) {
+    return (((uint64_t)p[0]) << 16) | (((uint64_t)p[k >> 1]) << 8) | p[k - 1];
+}
+
+void lgx_hash_init() {
+    uint64_t seed = 0;
+
+    FILE *fp = fopen("/dev/urandom", "rb");
+    if (fp) {
+        if (fread(&seed, sizeof(seed), 1, fp) != 1) {
+            seed = 0;
+        }
+        fclose(fp);
+    }
+
+    // 无法读取随机数时，使用时间与地址作为种子
+    if (!seed) {
+        seed = (uint64_t)time(NULL) ^ ((uint64_t)clock() << 32) ^ (uint64_t)(size_t)&seed;
+    }
+
+    hash_seed = seed ^ hash_mix(seed ^ hash_secret[0], hash_secret[1]);
+}
+
+uint32_t lgx_hash(const void* buf, unsigned len) {
+    const uint8_t *p = (const uint8_t *)buf;
+    uint64_t seed = hash_seed;
+    uint64_t a, b;
+
+    if (EXPECTED(len <= 16)) {
+        if (EXPECTED(len >= 4)) {
+            a = (hash_r4(p) << 32) | hash_r4(p + ((len >> 3) << 2));
+            b = (hash_r4(p + len - 4) << 32) | hash_r4(p + len - 4 - ((len >> 3) << 2));
+        } else if (EXPECTED(len > 0)) {
+            a = hash_r3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        unsigned i = len;
+        if (UNEXPECTED(i > 48)) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = hash_mix(hash_r8(p) ^ hash_secret[1], hash_r8(p + 8) ^ seed);
+                see1 = hash_mix(hash_r8(p + 16) ^ hash_secret[2], hash_r8(p + 24) ^ see1);
+                see2 = hash_mix(hash_r8(p + 32) ^ hash_secret[3], hash_r8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (EXPECTED(i > 48));
+            seed ^= see1 ^ see2;
+        }
+        while (UNEXPECTED(i > 16)) {
+            seed = hash_mix(hash_r8(p) ^ hash_secret[1], hash_r8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = hash_r8(p + i - 16);
+        b = hash_r8(p + i - 8);
+    }
+
+    a ^= hash_secret[1];
+    b ^= seed;
+    hash_mum(&a, &b);
+
+    uint64_t h = hash_mix(a ^ hash_secret[0] ^ len, b ^ hash_secret[1]);
+
+    // 0 被用于表示尚未计算哈希值
+    uint32_t ret = (uint32_t)(h ^ (h >> 32));
+    return ret ? ret : 1;
+}
\ No newline at end of file
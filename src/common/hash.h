@@ -0,0 +1,13 @@
+#ifndef LGX_HASH_H
+#define LGX_HASH_H
+
+#include <stdint.h>
+
+// 使用随机种子初始化哈希函数，防止哈希碰撞攻击
+// 必须在计算任何哈希值之前调用，并且在进程的生命周期内只能调用一次
+void lgx_hash_init();
+
+// 计算长度为 len 的内存块的哈希值，返回值总是不为 0
+uint32_t lgx_hash(const void* buf, unsigned len);
+
+#endif // LGX_HASH_H
\ No newline at end of file
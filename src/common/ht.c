@@ -1,133 +1,235 @@
 #include "common.h"
 #include "ht.h"
 
-int lgx_ht_init(lgx_ht_t* ht, unsigned size) {
-    memset(ht, 0, sizeof(lgx_ht_t));
-    
-    // 规范化 size 取值
-    size = ALIGN(size);
-    if (size < LGX_HT_MIN_SIZE) {
-        size = LGX_HT_MIN_SIZE;
+// 节点状态
+#define HT_NODE_EMPTY   0
+#define HT_NODE_USED    1
+#define HT_NODE_DELETED 2
+
+// 节点的键引用外部的内存，没有复制
+#define HT_NODE_SHARED  4
+
+// 短键保存在节点内部，节点被移动后需要重新设置指针
+#define HT_NODE_INLINE_KEY(n) (!(n)->k.size && !((n)->state & HT_NODE_SHARED))
+
+// 槽位数为 size 时最多可以保存的节点数，负载因子不超过 0.5
+#define HT_CAPACITY(size) ((size) / 2)
+
+static int ht_alloc(lgx_ht_t* ht, unsigned size) {
+    ht->slots = (lgx_ht_slot_t *)xcalloc(size, sizeof(lgx_ht_slot_t));
+    if (UNEXPECTED(!ht->slots)) {
+        return 1;
     }
 
-    ht->table = (lgx_ht_node_t **)xcalloc(size, sizeof(lgx_ht_node_t*));
-    if (UNEXPECTED(!ht->table)) {
+    ht->nodes = (lgx_ht_node_t *)xcalloc(HT_CAPACITY(size) + 1, sizeof(lgx_ht_node_t));
+    if (UNEXPECTED(!ht->nodes)) {
+        xfree(ht->slots);
+        ht->slots = NULL;
         return 1;
     }
 
-    ht->length = 0;
     ht->size = size;
 
     return 0;
 }
 
-static unsigned ht_bkdr(lgx_ht_t* ht, lgx_str_t* k) {
-    unsigned ret = 0;
-    int i;
-    
-    for (i = 0; i < k->length; ++i) {
-        ret = (ret << 5) - ret + k->buffer[i];
+int lgx_ht_init(lgx_ht_t* ht, unsigned size) {
+    memset(ht, 0, sizeof(lgx_ht_t));
+
+    // 规范化 size 取值
+    size = size > LGX_HT_MIN_SIZE / 2 ? ALIGN(size * 2) : LGX_HT_MIN_SIZE;
+
+    return ht_alloc(ht, size);
+}
+
+// 插入索引，调用前必须保证该节点不在索引中，并且还有空闲的槽位
+static void ht_slot_insert(lgx_ht_t* ht, unsigned hash, unsigned node) {
+    unsigned mask = ht->size - 1;
+    unsigned pos = hash & mask;
+    unsigned dist = 0;
+
+    for (;;) {
+        lgx_ht_slot_t* slot = &ht->slots[pos];
+        if (!slot->node) {
+            slot->hash = hash;
+            slot->node = node;
+            return;
+        }
+
+        // 已有元素的探测距离更短时，由当前元素占据该位置，并继续为被替换的元素寻找位置
+        unsigned d = (pos - (slot->hash & mask)) & mask;
+        if (d < dist) {
+            lgx_ht_slot_t tmp = *slot;
+            slot->hash = hash;
+            slot->node = node;
+            hash = tmp.hash;
+            node = tmp.node;
+            dist = d;
+        }
+
+        pos = (pos + 1) & mask;
+        ++ dist;
     }
-    
-    return ret;
 }
 
-static int ht_set(lgx_ht_t* ht, lgx_ht_node_t* node) {
-    unsigned pos = node->hash % ht->size;
+// 查找键所在的槽位，不存在时返回 NULL
+static lgx_ht_slot_t* ht_slot_find(lgx_ht_t* ht, lgx_str_t* k, unsigned hash) {
+    unsigned mask = ht->size - 1;
+    unsigned pos = hash & mask;
+    unsigned dist = 0;
 
-    // 插入位置是空的
-    if (!ht->table[pos]) {
-        node->next = NULL;
-        ht->table[pos] = node;
-    } else {
-        lgx_ht_node_t* next = ht->table[pos];
-        while (next) {
-            if (lgx_str_cmp(&node->k, &next->k) == 0) {
-                // 键已存在
-                return 1;
+    for (;;) {
+        lgx_ht_slot_t* slot = &ht->slots[pos];
+        if (!slot->node) {
+            return NULL;
+        }
+
+        // 探测距离已经超过了当前位置元素的探测距离，说明键不存在
+        if (((pos - (slot->hash & mask)) & mask) < dist) {
+            return NULL;
+        }
+
+        if (slot->hash == hash) {
+            lgx_ht_node_t* node = &ht->nodes[slot->node - 1];
+            if (node->k.length == k->length &&
+                (node->k.buffer == k->buffer || memcmp(node->k.buffer, k->buffer, k->length) == 0)) {
+                return slot;
             }
-            next = next->next;
         }
 
-        // 插入到链表头部
-        node->next = ht->table[pos];
-        ht->table[pos] = node;
+        pos = (pos + 1) & mask;
+        ++ dist;
     }
+}
 
-    ++ ht->length;
+// 没有已删除的节点时，直接扩大节点数组，再重建索引
+static int ht_grow(lgx_ht_t* ht, unsigned size) {
+    lgx_ht_slot_t* slots = (lgx_ht_slot_t *)xcalloc(size, sizeof(lgx_ht_slot_t));
+    if (UNEXPECTED(!slots)) {
+        return 1;
+    }
 
-    if (!ht->tail) {
-        ht->head = node;
-        ht->tail = node;
-    } else {
-        ht->tail->order = node;
-        ht->tail = node;
+    lgx_ht_node_t* nodes = (lgx_ht_node_t *)xrealloc(ht->nodes, (HT_CAPACITY(size) + 1) * sizeof(lgx_ht_node_t));
+    if (UNEXPECTED(!nodes)) {
+        xfree(slots);
+        return 1;
+    }
+    memset(nodes + ht->used, 0, (HT_CAPACITY(size) + 1 - ht->used) * sizeof(lgx_ht_node_t));
+
+    xfree(ht->slots);
+    ht->slots = slots;
+    ht->size = size;
+
+    unsigned i;
+    for (i = 0; i < ht->used; ++i) {
+        // 节点被移动后，短键的指针需要重新指向节点内部
+        if (nodes != ht->nodes && HT_NODE_INLINE_KEY(&nodes[i])) {
+            nodes[i].k.buffer = nodes[i].key;
+        }
+        ht_slot_insert(ht, nodes[i].hash, i + 1);
     }
+    ht->nodes = nodes;
 
     return 0;
 }
 
-static lgx_ht_node_t* ht_node_new(lgx_str_t* k, void* v) {
-    lgx_ht_node_t* node = (lgx_ht_node_t*)xcalloc(1, sizeof(lgx_ht_node_t));
-    if (!node) {
-        return NULL;
+// 调整槽位数为 size，同时移除已删除的节点
+static int ht_resize(lgx_ht_t* ht, unsigned size) {
+    if (ht->length == ht->used && size > ht->size) {
+        return ht_grow(ht, size);
     }
 
-    if (lgx_str_init(&node->k, k->length)) {
-        xfree(node);
-        return NULL;
+    lgx_ht_t resize;
+    memset(&resize, 0, sizeof(lgx_ht_t));
+    if (UNEXPECTED(ht_alloc(&resize, size))) {
+        return 1;
     }
-    
-    lgx_str_dup(k, &node->k);
-    node->v = v;
 
-    return node;
-}
+    unsigned i;
+    for (i = 0; i < ht->used; ++i) {
+        lgx_ht_node_t* n = &ht->nodes[i];
+        if (!(n->state & HT_NODE_USED)) {
+            continue;
+        }
 
-static void ht_node_del(lgx_ht_node_t* node) {
-    assert(node->v == NULL);
+        lgx_ht_node_t* node = &resize.nodes[resize.used ++];
+        *node = *n;
+        // 节点被移动后，短键的指针需要重新指向节点内部
+        if (HT_NODE_INLINE_KEY(node)) {
+            node->k.buffer = node->key;
+        }
+        ht_slot_insert(&resize, node->hash, resize.used);
+    }
 
-    lgx_str_cleanup(&node->k);
-    xfree(node);
+    xfree(ht->nodes);
+    xfree(ht->slots);
+
+    ht->size = resize.size;
+    ht->used = resize.used;
+    ht->nodes = resize.nodes;
+    ht->slots = resize.slots;
+
+    return 0;
 }
 
 void lgx_ht_cleanup(lgx_ht_t* ht) {
-    int i;
-    lgx_ht_node_t *node, *next;
-    for (i = 0; i < ht->size; i++) {
-        node = ht->table[i];
-        while (node) {
-            next = node->next;
-            ht_node_del(node);
-            node = next;
+    unsigned i;
+    for (i = 0; i < ht->used; ++i) {
+        lgx_ht_node_t* n = &ht->nodes[i];
+        if (n->state & HT_NODE_USED) {
+            assert(n->v == NULL);
+            lgx_str_cleanup(&n->k);
         }
     }
 
-    xfree(ht->table);
+    xfree(ht->nodes);
+    xfree(ht->slots);
 
     memset(ht, 0, sizeof(lgx_ht_t));
 }
 
-// 将 hash table 扩容一倍
-static int ht_resize(lgx_ht_t* ht) {
-    lgx_ht_t resize;
-    if (UNEXPECTED(lgx_ht_init(&resize, ht->size * 2))) {
+static int ht_insert(lgx_ht_t *ht, lgx_str_t* k, unsigned hash, void* v, int shared) {
+    if (UNEXPECTED(!ht->size)) {
+        if (ht_alloc(ht, LGX_HT_MIN_SIZE)) {
+            return 1;
+        }
+    } else if (ht_slot_find(ht, k, hash)) {
+        // 键已存在
         return 1;
     }
 
-    lgx_ht_node_t *n = ht->head, *next;
-    while (n) {
-        next = n->order;
-        ht_set(&resize, n);
-        n = next;
+    if (UNEXPECTED(ht->used == HT_CAPACITY(ht->size))) {
+        // 已删除的节点较多时只需要整理节点，否则扩容一倍
+        unsigned size = ht->length >= ht->used / 4 * 3 ? ht->size * 2 : ht->size;
+        if (ht_resize(ht, size)) {
+            return 1;
+        }
     }
 
-    xfree(ht->table);
+    lgx_ht_node_t* node = &ht->nodes[ht->used];
+    if (shared) {
+        node->k.buffer = k->buffer;
+        node->k.length = k->length;
+        node->k.size = 0;
+    } else if (k->length <= LGX_HT_INLINE_KEY) {
+        memcpy(node->key, k->buffer, k->length);
+        node->k.buffer = node->key;
+        node->k.length = k->length;
+        node->k.size = 0;
+    } else {
+        if (lgx_str_init(&node->k, k->length)) {
+            return 1;
+        }
+        lgx_str_dup(k, &node->k);
+    }
+    node->v = v;
+    node->hash = hash;
+    node->state = shared ? HT_NODE_USED | HT_NODE_SHARED : HT_NODE_USED;
 
-    ht->size = resize.size;
-    ht->table = resize.table;
-    ht->head = resize.head;
-    ht->tail = resize.tail;
+    ++ ht->used;
+    ++ ht->length;
+
+    ht_slot_insert(ht, hash, ht->used);
 
     return 0;
 }
@@ -140,86 +242,101 @@ int lgx_ht_set(lgx_ht_t *ht, lgx_str_t* k, void* v) {
     // 键不能为空
     assert(k->length && k->buffer);
 
-    lgx_ht_node_t* node = ht_node_new(k, v);
-    if (!node) {
-        return 1;
-    }
-    node->hash = ht_bkdr(ht, &node->k);
-
-    if (ht_set(ht, node)) {
-        // 键已存在
-        node->v = NULL;
-        ht_node_del(node);
-        return 1;
-    }
+    return lgx_ht_set_with_hash(ht, k, lgx_ht_hash(k), v);
+}
 
-    if (UNEXPECTED(ht->size < ht->length * 2)) {
-        ht_resize(ht);
-    }
+int lgx_ht_set_with_hash(lgx_ht_t *ht, lgx_str_t* k, unsigned hash, void* v) {
+    return ht_insert(ht, k, hash, v, 0);
+}
 
-    return 0;
+// 键 k 不会被复制，调用者必须保证在哈希表的生命周期内，键的内容不会被修改或释放
+int lgx_ht_set_shared(lgx_ht_t *ht, lgx_str_t* k, unsigned hash, void* v) {
+    return ht_insert(ht, k, hash, v, 1);
 }
 
 lgx_ht_node_t* lgx_ht_get(lgx_ht_t *ht, lgx_str_t* k) {
     // 键不能为空
     assert(k->length && k->buffer);
 
-    unsigned pos = ht_bkdr(ht, k) % ht->size;
+    if (!ht->length) {
+        return NULL;
+    }
+
+    return lgx_ht_get_with_hash(ht, k, lgx_ht_hash(k));
+}
 
-    if (!ht->table[pos]) {
+lgx_ht_node_t* lgx_ht_get_with_hash(lgx_ht_t *ht, lgx_str_t* k, unsigned hash) {
+    if (!ht->length) {
         return NULL;
     }
 
-    lgx_ht_node_t *next = ht->table[pos];
-    while (next) {
-        if (lgx_str_cmp(&next->k, k) == 0) {
-            return next;
-        }
-        next = next->next;
+    lgx_ht_slot_t* slot = ht_slot_find(ht, k, hash);
+    if (!slot) {
+        return NULL;
     }
 
-    return NULL;
+    return &ht->nodes[slot->node - 1];
 }
 
 // 注意：lgx_ht_del 不会自动释放 v 所指向的内存，需要调用者自行处理。
 int lgx_ht_del(lgx_ht_t *ht, lgx_str_t* k) {
-    // 键不能为空
-    assert(k->length && k->buffer);
+    // 通过 lgx_ht_set_with_hash 插入的空字符串键也可以删除
+    assert(k->buffer || !k->length);
 
-    unsigned pos = ht_bkdr(ht, k) % ht->size;
-
-    if (!ht->table[pos]) {
+    if (!ht->length) {
         return 0;
     }
 
-    lgx_ht_node_t *next;
-
-    if (lgx_str_cmp(&ht->table[pos]->k, k) == 0) {
-        next = ht->table[pos]->next;
-        ht_node_del(ht->table[pos]);
-        ht->table[pos] = next;
+    lgx_ht_slot_t* slot = ht_slot_find(ht, k, lgx_ht_hash(k));
+    if (!slot) {
         return 0;
     }
 
-    lgx_ht_node_t* prev = next = ht->table[pos];
-    next = next->next;
-    while (next) {
-        if (lgx_str_cmp(&next->k, k) == 0) {
-            prev->next = next->next;
-            ht_node_del(next);
-            return 0;
+    // 节点保留在原位置并标记为已删除，遍历时跳过，扩容时移除
+    lgx_ht_node_t* node = &ht->nodes[slot->node - 1];
+    lgx_str_cleanup(&node->k);
+    node->v = NULL;
+    node->state = HT_NODE_DELETED;
+    -- ht->length;
+
+    // 把后续探测距离不为 0 的元素依次前移一位，不需要在槽位中留下删除标记
+    unsigned mask = ht->size - 1;
+    unsigned pos = slot - ht->slots;
+    for (;;) {
+        unsigned next = (pos + 1) & mask;
+        lgx_ht_slot_t* s = &ht->slots[next];
+        if (!s->node || (s->hash & mask) == next) {
+            break;
         }
-        prev = next;
-        next = next->next;
+        ht->slots[pos] = *s;
+        pos = next;
     }
+    ht->slots[pos].hash = 0;
+    ht->slots[pos].node = 0;
 
     return 0;
 }
 
+static lgx_ht_node_t* ht_skip(const lgx_ht_node_t* node) {
+    while (node->state == HT_NODE_DELETED) {
+        ++ node;
+    }
+
+    if (node->state == HT_NODE_EMPTY) {
+        return NULL;
+    }
+
+    return (lgx_ht_node_t*)node;
+}
+
 lgx_ht_node_t* lgx_ht_first(const lgx_ht_t* ht) {
-    return ht->head;
+    if (!ht->nodes) {
+        return NULL;
+    }
+
+    return ht_skip(ht->nodes);
 }
 
 lgx_ht_node_t* lgx_ht_next(const lgx_ht_node_t* node) {
-    return node->order;
-}
+    return ht_skip(node + 1);
+}
\ No newline at end of file
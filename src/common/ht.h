@@ -2,44 +2,73 @@
 #define	LGX_HT_H
 
 #include "str.h"
+#include "hash.h"
 
 #define LGX_HT_MIN_SIZE 8
 
-typedef struct lgx_ht_node_s {
-    // 下一个相同哈希值的元素
-    struct lgx_ht_node_s* next;
-
-    // 下一个插入的元素
-    struct lgx_ht_node_s* order;
+// 长度不超过该值的键（包括 8 字节的整数键）直接保存在节点中，不需要额外分配内存
+#define LGX_HT_INLINE_KEY 16
 
+typedef struct lgx_ht_node_s {
 	// 当前哈希节点的内容
     lgx_str_t k;
     void* v;
 
     // 当前节点的哈希值
     unsigned hash;
+
+    // 节点状态：空闲、使用中、已删除
+    unsigned state;
+
+    // 短键的存储空间
+    char key[LGX_HT_INLINE_KEY];
 } lgx_ht_node_t;
 
+typedef struct lgx_ht_slot_s {
+    // 节点的哈希值，用于在不访问节点的情况下计算探测距离和快速比较
+    unsigned hash;
+
+    // 节点在 nodes 中的下标加一，为 0 表示空槽位
+    unsigned node;
+} lgx_ht_slot_t;
+
+// 使用 Robin Hood 线性探测的开放寻址哈希表
+// 节点依据插入顺序紧密地保存在 nodes 中，以便遍历；slots 只保存索引
+// 注意：插入元素时节点可能会被移动，lgx_ht_get 返回的指针只在下一次插入前有效
 typedef struct lgx_ht_s {
-    // 总容量
+    // 槽位总数，总是 2 的幂
     unsigned size;
 
     // 已使用的容量
     unsigned length;
 
-    // 存储数据的结构
-    lgx_ht_node_t** table;
+    // nodes 中已经使用的节点数（包括已删除的节点）
+    unsigned used;
+
+    // 依据插入顺序保存的节点。可以保存 size / 2 个节点，
+    // 并且额外保留一个空闲节点作为遍历的终点
+    lgx_ht_node_t* nodes;
 
-    // 依据插入顺序保存的链表，以便遍历
-    lgx_ht_node_t* head;
-    lgx_ht_node_t* tail;
+    // 存储索引的结构
+    lgx_ht_slot_t* slots;
 } lgx_ht_t;
 
+// size 为预计保存的元素个数
 int lgx_ht_init(lgx_ht_t* ht, unsigned size);
 void lgx_ht_cleanup(lgx_ht_t* ht);
 
+#define lgx_ht_hash(k) lgx_hash((k)->buffer, (k)->length)
+
 int lgx_ht_set(lgx_ht_t *ht, lgx_str_t* k, void* v);
 lgx_ht_node_t* lgx_ht_get(lgx_ht_t *ht, lgx_str_t* k);
+
+// 使用预先计算好的哈希值，hash 必须等于 lgx_ht_hash(k)
+int lgx_ht_set_with_hash(lgx_ht_t *ht, lgx_str_t* k, unsigned hash, void* v);
+lgx_ht_node_t* lgx_ht_get_with_hash(lgx_ht_t *ht, lgx_str_t* k, unsigned hash);
+
+// 直接引用键的内存而不复制，用于驻留字符串等生命周期比哈希表更长的键
+int lgx_ht_set_shared(lgx_ht_t *ht, lgx_str_t* k, unsigned hash, void* v);
+
 int lgx_ht_del(lgx_ht_t *ht, lgx_str_t* k);
 
 lgx_ht_node_t* lgx_ht_first(const lgx_ht_t* ht);
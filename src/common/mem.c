@@ -0,0 +1,502 @@
+#include "common.h"
+
+#ifndef LGX_SYSTEM_MALLOC
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#ifdef WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+typedef struct mem_block_s {
+    struct mem_block_s* next;
+} mem_block_t;
+
+typedef struct mem_heap_s mem_heap_t;
+
+// 页头位于页的起始位置，通过地址对齐即可由内存块找到所在的页
+typedef struct mem_page_s {
+    // 页所属的堆，只有所属的线程可以修改页中的其它字段
+    mem_heap_t* heap;
+
+    // 同一分级中有空闲块的页组成的链表
+    struct mem_page_s *prev, *next;
+
+    // 已释放的内存块
+    mem_block_t* free;
+
+    // 尚未切分的空间，end 之后的空间不足一个内存块
+    char *bump, *end;
+
+    // 所属的分级
+    unsigned cls;
+
+    // 已分配的内存块数量
+    unsigned used;
+
+    // 没有空闲块，不在链表中
+    unsigned full;
+} mem_page_t;
+
+// 页头占用的空间，保证内存块 16 字节对齐
+#define MEM_PAGE_HEADER ((sizeof(mem_page_t) + 15) & ~(size_t)15)
+
+typedef struct {
+    // 有空闲块的页，总是从第一个页中分配
+    mem_page_t* avail;
+
+    size_t pages;
+    size_t blocks;
+} mem_class_t;
+
+// 每个线程使用独立的堆，分配与本线程的释放都不需要加锁
+struct mem_heap_s {
+    mem_class_t classes[LGX_MEM_CLASSES];
+
+    // 缓存的空闲页
+    mem_page_t* empty;
+    size_t empty_count;
+
+    size_t pages;
+    size_t peak_pages;
+
+    // 其它线程释放的内存块，由所属线程在分配时回收
+    _Atomic(mem_block_t*) remote;
+
+    struct mem_heap_s* next;
+};
+
+static const unsigned mem_class_size[LGX_MEM_CLASSES] = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256, 320, 384, 448, 512,
+    640, 768, 896, 1024
+};
+
+// 以 (size + 15) / 16 为下标查找分级
+static const unsigned char mem_size_class[LGX_MEM_SMALL_LIMIT / 16 + 1] = {
+    0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+    12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15, 15,
+    16, 16, 16, 16, 16, 16, 16, 16, 17, 17, 17, 17, 17, 17, 17, 17,
+    18, 18, 18, 18, 18, 18, 18, 18, 19, 19, 19, 19, 19, 19, 19, 19
+};
+
+static _Thread_local mem_heap_t* mem_heap;
+
+// 所有线程的堆，线程退出后它的堆不会被释放
+static mem_heap_t* mem_heaps;
+static pthread_mutex_t mem_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static atomic_size_t mem_large;
+
+// 记录哪些页属于分配器的两级位图，页号最多 32 位，即只管理低 48 位的地址空间
+#define MEM_RADIX_BITS 16
+#define MEM_RADIX_SIZE (1 << MEM_RADIX_BITS)
+
+typedef atomic_uint_least64_t mem_bits_t;
+
+static _Atomic(mem_bits_t*) mem_radix[MEM_RADIX_SIZE];
+
+static int mem_radix_set(void* p, int on) {
+    uintptr_t pn = (uintptr_t)p >> LGX_MEM_PAGE_SHIFT;
+    if (pn >> (2 * MEM_RADIX_BITS)) {
+        return 1;
+    }
+
+    mem_bits_t* leaf = atomic_load_explicit(&mem_radix[pn >> MEM_RADIX_BITS], memory_order_acquire);
+    if (!leaf) {
+        pthread_mutex_lock(&mem_lock);
+        leaf = atomic_load_explicit(&mem_radix[pn >> MEM_RADIX_BITS], memory_order_acquire);
+        if (!leaf) {
+            leaf = (mem_bits_t*)calloc(MEM_RADIX_SIZE / 64, sizeof(mem_bits_t));
+            if (leaf) {
+                atomic_store_explicit(&mem_radix[pn >> MEM_RADIX_BITS], leaf, memory_order_release);
+            }
+        }
+        pthread_mutex_unlock(&mem_lock);
+        if (!leaf) {
+            return 1;
+        }
+    }
+
+    uint64_t bit = 1ULL << (pn & 63);
+    if (on) {
+        atomic_fetch_or_explicit(&leaf[(pn & (MEM_RADIX_SIZE - 1)) >> 6], bit, memory_order_relaxed);
+    } else {
+        atomic_fetch_and_explicit(&leaf[(pn & (MEM_RADIX_SIZE - 1)) >> 6], ~bit, memory_order_relaxed);
+    }
+
+    return 0;
+}
+
+// 返回 p 所在的页，p 不是由分配器管理的页中分配时返回 NULL
+static lgx_inline mem_page_t* mem_page_of(void* p) {
+    uintptr_t pn = (uintptr_t)p >> LGX_MEM_PAGE_SHIFT;
+    if (UNEXPECTED(pn >> (2 * MEM_RADIX_BITS))) {
+        return NULL;
+    }
+
+    mem_bits_t* leaf = atomic_load_explicit(&mem_radix[pn >> MEM_RADIX_BITS], memory_order_acquire);
+    if (!leaf) {
+        return NULL;
+    }
+
+    uint64_t bits = atomic_load_explicit(&leaf[(pn & (MEM_RADIX_SIZE - 1)) >> 6], memory_order_relaxed);
+    if (!(bits & (1ULL << (pn & 63)))) {
+        return NULL;
+    }
+
+    return (mem_page_t*)(pn << LGX_MEM_PAGE_SHIFT);
+}
+
+static mem_heap_t* mem_heap_new() {
+    mem_heap_t* heap = (mem_heap_t*)calloc(1, sizeof(mem_heap_t));
+    if (!heap) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&mem_lock);
+    heap->next = mem_heaps;
+    mem_heaps = heap;
+    pthread_mutex_unlock(&mem_lock);
+
+    mem_heap = heap;
+
+    return heap;
+}
+
+// 每次向系统申请的页数，页从独立的映射中分配，不影响系统 malloc 的堆
+#define MEM_SEGMENT_PAGES 16
+
+#ifdef WIN32
+static void* mem_os_alloc(size_t size) {
+    return _aligned_malloc(size, LGX_MEM_PAGE_SIZE);
+}
+
+static void mem_os_free(void* page) {
+    _aligned_free(page);
+}
+#else
+static void* mem_os_alloc(size_t size) {
+    // 多映射一页的空间，裁剪掉首尾多余的部分以满足对齐要求
+    char* p = (char*)mmap(NULL, size + LGX_MEM_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+
+    size_t head = (LGX_MEM_PAGE_SIZE - ((uintptr_t)p & (LGX_MEM_PAGE_SIZE - 1))) & (LGX_MEM_PAGE_SIZE - 1);
+    if (head) {
+        munmap(p, head);
+    }
+    munmap(p + head + size, LGX_MEM_PAGE_SIZE - head);
+
+    return p + head;
+}
+
+static void mem_os_free(void* page) {
+    munmap(page, LGX_MEM_PAGE_SIZE);
+}
+#endif
+
+static mem_page_t* mem_page_new(mem_heap_t* heap, unsigned cls) {
+    mem_page_t* page = heap->empty;
+    if (page) {
+        heap->empty = page->next;
+        heap->empty_count --;
+    } else {
+#ifdef WIN32
+        // Windows 下的页无法单独归还，每次只申请一页
+        unsigned count = 1;
+#else
+        unsigned count = MEM_SEGMENT_PAGES;
+#endif
+        char* p = (char*)mem_os_alloc((size_t)count * LGX_MEM_PAGE_SIZE);
+        if (!p) {
+            return NULL;
+        }
+
+        // 除第一页外，其余的页加入空闲页缓存
+        unsigned i;
+        for (i = count; i > 0; i --) {
+            page = (mem_page_t*)(p + (size_t)(i - 1) * LGX_MEM_PAGE_SIZE);
+            if (mem_radix_set(page, 1)) {
+                mem_os_free(page);
+                continue;
+            }
+            page->heap = heap;
+            heap->pages ++;
+            if (i > 1) {
+                page->next = heap->empty;
+                heap->empty = page;
+                heap->empty_count ++;
+            }
+        }
+        if (heap->pages > heap->peak_pages) {
+            heap->peak_pages = heap->pages;
+        }
+
+        page = (mem_page_t*)p;
+        if (!mem_page_of(page)) {
+            return NULL;
+        }
+    }
+
+    unsigned size = mem_class_size[cls];
+
+    page->prev = NULL;
+    page->next = NULL;
+    page->free = NULL;
+    page->bump = (char*)page + MEM_PAGE_HEADER;
+    page->end = page->bump + (LGX_MEM_PAGE_SIZE - MEM_PAGE_HEADER) / size * size;
+    page->cls = cls;
+    page->used = 0;
+    page->full = 0;
+
+    heap->classes[cls].pages ++;
+
+    return page;
+}
+
+// 归还空闲页，优先缓存起来供其它分级复用
+static void mem_page_release(mem_heap_t* heap, mem_page_t* page) {
+    heap->classes[page->cls].pages --;
+
+    if (heap->empty_count < LGX_MEM_PAGE_CACHE) {
+        page->next = heap->empty;
+        heap->empty = page;
+        heap->empty_count ++;
+        return;
+    }
+
+    mem_radix_set(page, 0);
+    heap->pages --;
+    mem_os_free(page);
+}
+
+static lgx_inline void mem_avail_add(mem_class_t* cls, mem_page_t* page) {
+    page->prev = NULL;
+    page->next = cls->avail;
+    if (cls->avail) {
+        cls->avail->prev = page;
+    }
+    cls->avail = page;
+}
+
+static lgx_inline void mem_avail_del(mem_class_t* cls, mem_page_t* page) {
+    if (page->prev) {
+        page->prev->next = page->next;
+    } else {
+        cls->avail = page->next;
+    }
+    if (page->next) {
+        page->next->prev = page->prev;
+    }
+    page->prev = NULL;
+    page->next = NULL;
+}
+
+static lgx_inline void mem_page_free(mem_heap_t* heap, mem_page_t* page, void* p) {
+    mem_class_t* cls = &heap->classes[page->cls];
+
+    mem_block_t* b = (mem_block_t*)p;
+    b->next = page->free;
+    page->free = b;
+    page->used --;
+    cls->blocks --;
+
+    if (page->full) {
+        // 优先填满已有的页
+        page->full = 0;
+        mem_avail_add(cls, page);
+    } else if (page->used == 0 && (page->prev || page->next)) {
+        // 每个分级至少保留一个页，避免在页的边界反复申请与归还
+        mem_avail_del(cls, page);
+        mem_page_release(heap, page);
+    }
+}
+
+// 回收其它线程释放的内存块
+static void mem_heap_collect(mem_heap_t* heap) {
+    if (!atomic_load_explicit(&heap->remote, memory_order_relaxed)) {
+        return;
+    }
+
+    mem_block_t* b = atomic_exchange_explicit(&heap->remote, NULL, memory_order_acquire);
+    while (b) {
+        mem_block_t* next = b->next;
+        mem_page_free(heap, (mem_page_t*)((uintptr_t)b & ~(uintptr_t)(LGX_MEM_PAGE_SIZE - 1)), b);
+        b = next;
+    }
+}
+
+static void* mem_large_alloc(size_t size) {
+    void* p = malloc(size);
+    if (p) {
+        atomic_fetch_add_explicit(&mem_large, 1, memory_order_relaxed);
+    }
+    return p;
+}
+
+void* lgx_mem_alloc(size_t size) {
+    if (UNEXPECTED(size > LGX_MEM_SMALL_LIMIT)) {
+        return mem_large_alloc(size);
+    }
+
+    mem_heap_t* heap = mem_heap;
+    if (UNEXPECTED(!heap)) {
+        heap = mem_heap_new();
+        if (!heap) {
+            return mem_large_alloc(size);
+        }
+    }
+
+    unsigned c = mem_size_class[(size + 15) >> 4];
+    mem_class_t* cls = &heap->classes[c];
+
+    mem_page_t* page = cls->avail;
+    if (UNEXPECTED(!page)) {
+        mem_heap_collect(heap);
+        page = cls->avail;
+        if (!page) {
+            page = mem_page_new(heap, c);
+            if (!page) {
+                return mem_large_alloc(size);
+            }
+            mem_avail_add(cls, page);
+        }
+    }
+
+    mem_block_t* b = page->free;
+    if (b) {
+        page->free = b->next;
+    } else {
+        b = (mem_block_t*)page->bump;
+        page->bump += mem_class_size[c];
+    }
+    page->used ++;
+    cls->blocks ++;
+
+    if (UNEXPECTED(!page->free && page->bump == page->end)) {
+        mem_avail_del(cls, page);
+        page->full = 1;
+    }
+
+    return b;
+}
+
+void* lgx_mem_calloc(size_t n, size_t size) {
+    if (size && n > SIZE_MAX / size) {
+        return NULL;
+    }
+
+    size *= n;
+    if (size > LGX_MEM_SMALL_LIMIT) {
+        void* p = calloc(1, size);
+        if (p) {
+            atomic_fetch_add_explicit(&mem_large, 1, memory_order_relaxed);
+        }
+        return p;
+    }
+
+    void* p = lgx_mem_alloc(size);
+    if (p) {
+        // 内存块 16 字节对齐且大小是 16 的倍数，小块内存逐个清零比调用 memset 更快
+        uint64_t* w = (uint64_t*)p;
+        size_t n = (size + 15) >> 4;
+        while (n --) {
+            w[0] = 0;
+            w[1] = 0;
+            w += 2;
+        }
+    }
+    return p;
+}
+
+void* lgx_mem_realloc(void* p, size_t size) {
+    if (!p) {
+        return lgx_mem_alloc(size);
+    }
+
+    mem_page_t* page = mem_page_of(p);
+    if (!page) {
+        return realloc(p, size);
+    }
+
+    unsigned old = mem_class_size[page->cls];
+    if (size <= old) {
+        return p;
+    }
+
+    void* q = lgx_mem_alloc(size);
+    if (!q) {
+        return NULL;
+    }
+    memcpy(q, p, old);
+    lgx_mem_free(p);
+
+    return q;
+}
+
+void lgx_mem_free(void* p) {
+    if (!p) {
+        return;
+    }
+
+    mem_page_t* page = mem_page_of(p);
+    if (!page) {
+        atomic_fetch_sub_explicit(&mem_large, 1, memory_order_relaxed);
+        free(p);
+        return;
+    }
+
+    mem_heap_t* heap = mem_heap;
+    if (EXPECTED(page->heap == heap)) {
+        mem_page_free(heap, page, p);
+        return;
+    }
+
+    // 由其它线程分配的内存块交给所属的线程回收
+    heap = page->heap;
+    mem_block_t* b = (mem_block_t*)p;
+    b->next = atomic_load_explicit(&heap->remote, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&heap->remote, &b->next, b, memory_order_release, memory_order_relaxed));
+}
+
+void lgx_mem_collect() {
+    if (mem_heap) {
+        mem_heap_collect(mem_heap);
+    }
+}
+
+void lgx_mem_stat(lgx_mem_stat_t* stat) {
+    memset(stat, 0, sizeof(lgx_mem_stat_t));
+
+    lgx_mem_collect();
+
+    unsigned i;
+    for (i = 0; i < LGX_MEM_CLASSES; i ++) {
+        stat->classes[i].size = mem_class_size[i];
+    }
+
+    pthread_mutex_lock(&mem_lock);
+    mem_heap_t* heap;
+    for (heap = mem_heaps; heap; heap = heap->next) {
+        stat->pages += heap->pages;
+        stat->peak_pages += heap->peak_pages;
+        stat->empty_pages += heap->empty_count;
+        for (i = 0; i < LGX_MEM_CLASSES; i ++) {
+            stat->classes[i].pages += heap->classes[i].pages;
+            stat->classes[i].blocks += heap->classes[i].blocks;
+            stat->blocks += heap->classes[i].blocks;
+            stat->used += heap->classes[i].blocks * mem_class_size[i];
+        }
+    }
+    pthread_mutex_unlock(&mem_lock);
+
+    stat->large = atomic_load_explicit(&mem_large, memory_order_relaxed);
+}
+
+#endif // LGX_SYSTEM_MALLOC
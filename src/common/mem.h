@@ -0,0 +1,54 @@
+#ifndef LGX_MEM_H
+#define LGX_MEM_H
+
+#include <stddef.h>
+
+// 小块内存按大小分级，从 64KB 对齐的页中分配，同一页中的内存块大小相同
+#define LGX_MEM_PAGE_SHIFT 16
+#define LGX_MEM_PAGE_SIZE (1 << LGX_MEM_PAGE_SHIFT)
+
+// 超过该大小的内存块直接使用系统的 malloc
+#define LGX_MEM_SMALL_LIMIT 1024
+
+// 小块内存的分级数量
+#define LGX_MEM_CLASSES 20
+
+// 每个线程最多缓存的空闲页数量，超过的部分归还给系统
+#define LGX_MEM_PAGE_CACHE 16
+
+typedef struct {
+    // 持有的页数（包括缓存的空闲页）及其峰值
+    size_t pages;
+    size_t peak_pages;
+
+    // 缓存的空闲页数
+    size_t empty_pages;
+
+    // 已分配的小块内存数量及其占用的字节数
+    size_t blocks;
+    size_t used;
+
+    // 直接通过系统 malloc 分配、尚未释放的内存块数量
+    size_t large;
+
+    // 每个分级的块大小、页数与已分配的块数
+    struct {
+        unsigned size;
+        size_t pages;
+        size_t blocks;
+    } classes[LGX_MEM_CLASSES];
+} lgx_mem_stat_t;
+
+void* lgx_mem_alloc(size_t size);
+void* lgx_mem_calloc(size_t n, size_t size);
+void* lgx_mem_realloc(void* p, size_t size);
+void lgx_mem_free(void* p);
+
+// 回收其它线程释放的、由当前线程分配的内存块。分配时只在分级没有空闲页时才会回收，
+// 持续由其它线程释放内存（例如 GC 的后台释放线程）时需要定期调用，否则页数统计会偏高
+void lgx_mem_collect();
+
+// 汇总所有线程的内存统计，调用期间其他线程不能分配或释放内存
+void lgx_mem_stat(lgx_mem_stat_t* stat);
+
+#endif // LGX_MEM_H
@@ -30,10 +30,12 @@ static lgx_inline void rb_set_color(lgx_rb_node_t *node, lgx_rb_color_t color) {
 static long long rb_compare(lgx_rb_t *rbt, lgx_str_t *key1, lgx_str_t *key2) {
     switch (rbt->key_type) {
         case LGX_RB_KEY_INTEGER: {
-            long long k1 = *(long long *)key1->buffer;
-            long long k2 = *(long long *)key2->buffer;
+            long long k1, k2;
+            memcpy(&k1, key1->buffer, sizeof(k1));
+            memcpy(&k2, key2->buffer, sizeof(k2));
 
-            return k1 - k2;
+            // 直接相减可能溢出
+            return (k1 > k2) - (k1 < k2);
         }
         case LGX_RB_KEY_STRING:
         default:
@@ -164,11 +166,15 @@ lgx_rb_node_t * lgx_rb_set(lgx_rb_t *rbt, lgx_str_t *key) {
         return NULL;
     }
 
-    if (lgx_str_init(&tmp_node->key, key->length)) {
+    if (key->length <= LGX_RB_INLINE_KEY) {
+        tmp_node->key.buffer = tmp_node->buf;
+        tmp_node->key.size = 0;
+    } else if (lgx_str_init(&tmp_node->key, key->length)) {
         xfree(tmp_node);
         return NULL;
     }
-    lgx_str_dup(key, &tmp_node->key);
+    memcpy(tmp_node->key.buffer, key->buffer, key->length);
+    tmp_node->key.length = key->length;
 
     tmp_node->left = tmp_node->right = NULL;
     rb_set_parent(tmp_node, NULL);
@@ -542,6 +548,7 @@ static void rb_print(lgx_rb_t* rbt, lgx_rb_node_t *node) {
         switch (rbt->key_type) {
             case LGX_RB_KEY_INTEGER:
                 printf("%lld\n", *(long long*)node->key.buffer);
+                break;
             case LGX_RB_KEY_STRING:
             default:
                 printf("%.*s\n", node->key.length, node->key.buffer);
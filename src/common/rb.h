@@ -15,12 +15,17 @@ typedef enum {
     LGX_RB_KEY_INTEGER = 1
 } lgx_rb_key_type_t;
 
+#define LGX_RB_INLINE_KEY 8
+
 typedef struct lgx_rb_node_s {
     struct lgx_rb_node_s * left;
     struct lgx_rb_node_s * right;
     uintptr_t parent_color;
     lgx_str_t key;
     void* value;
+
+    // 长度不超过该值的键（包括 8 字节的整数键）直接保存在节点中，不需要额外分配内存
+    char buf[LGX_RB_INLINE_KEY];
 } lgx_rb_node_t;
 
 typedef struct lgx_rb_s {
@@ -35,6 +35,11 @@ void lgx_str_cleanup(lgx_str_t* str) {
  * 如果 str1 < str2，返回负数。
  */
 int lgx_str_cmp(lgx_str_t *str1, lgx_str_t *str2) {
+    // 驻留字符串共享同一块内存
+    if (str1->buffer == str2->buffer && str1->length == str2->length) {
+        return 0;
+    }
+
     int len = str1->length;
     if (str1->length > str2->length) {
         len = str2->length;
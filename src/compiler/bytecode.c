@@ -32,6 +32,47 @@ const char* op_name[] = {
     "GEI",
     "GTI",
     "LNOT",
+    "IADD",
+    "IADDI",
+    "ISUB",
+    "ISUBI",
+    "IMUL",
+    "IMULI",
+    "IDIV",
+    "IDIVI",
+    "INEG",
+    "IEQ",
+    "IEQI",
+    "ILE",
+    "ILEI",
+    "ILT",
+    "ILTI",
+    "IGEI",
+    "IGTI",
+    "FADD",
+    "FSUB",
+    "FMUL",
+    "FDIV",
+    "FNEG",
+    "FEQ",
+    "FLE",
+    "FLT",
+    "ADD_LONG",
+    "ADD_DOUBLE",
+    "LT_LONG",
+    "LT_DOUBLE",
+    "ARRAY_GET_LONG",
+    "JLT",
+    "JLE",
+    "JEQ",
+    "JNE",
+    "JLTI",
+    "JLEI",
+    "JGTI",
+    "JGEI",
+    "JEQI",
+    "JNEI",
+    "INCJMP",
     "TYPEOF",
     "TEST",
     "JMP",
@@ -45,6 +86,9 @@ const char* op_name[] = {
     "ARRAY_NEW",
     "ARRAY_GET",
     "ARRAY_SET",
+    "MAP_NEW",
+    "MAP_GET",
+    "MAP_SET",
     "GLOBAL_GET",
     "GLOBAL_SET",
     "THROW",
@@ -67,8 +111,29 @@ void lgx_bc_echo(unsigned n, unsigned i) {
         case OP_AND:
         case OP_OR:
         case OP_XOR:
+        case OP_IADD:
+        case OP_ISUB:
+        case OP_IMUL:
+        case OP_IDIV:
+        case OP_IEQ:
+        case OP_ILE:
+        case OP_ILT:
+        case OP_FADD:
+        case OP_FSUB:
+        case OP_FMUL:
+        case OP_FDIV:
+        case OP_FEQ:
+        case OP_FLE:
+        case OP_FLT:
+        case OP_ADD_LONG:
+        case OP_ADD_DOUBLE:
+        case OP_LT_LONG:
+        case OP_LT_DOUBLE:
+        case OP_ARRAY_GET_LONG:
         case OP_ARRAY_GET:
         case OP_ARRAY_SET:
+        case OP_MAP_GET:
+        case OP_MAP_SET:
         case OP_CONCAT:
             printf("%4d %11s R[%d] R[%d] R[%d]\n", n, op_name[OP(i)], PA(i), PB(i), PC(i));
             break;
@@ -83,10 +148,21 @@ void lgx_bc_echo(unsigned n, unsigned i) {
         case OP_LTI:
         case OP_SHLI:
         case OP_SHRI:
+        case OP_IADDI:
+        case OP_ISUBI:
+        case OP_IMULI:
+        case OP_IDIVI:
+        case OP_IEQI:
+        case OP_ILEI:
+        case OP_ILTI:
+        case OP_IGEI:
+        case OP_IGTI:
             printf("%4d %11s R[%d] R[%d] %d\n", n, op_name[OP(i)], PA(i), PB(i), PC(i));
             break;
         case OP_MOV:
         case OP_NEG:
+        case OP_INEG:
+        case OP_FNEG:
         case OP_NOT:
         case OP_LNOT:
         case OP_CALL_SET:
@@ -94,6 +170,21 @@ void lgx_bc_echo(unsigned n, unsigned i) {
         case OP_CALL:
             printf("%4d %11s R[%d] R[%d]\n", n, op_name[OP(i)], PA(i), PB(i));
             break;
+        case OP_JLT:
+        case OP_JLE:
+        case OP_JEQ:
+        case OP_JNE:
+            printf("%4d %11s R[%d] R[%d]\n", n, op_name[OP(i)], PA(i), PB(i));
+            break;
+        case OP_JLTI:
+        case OP_JLEI:
+        case OP_JGTI:
+        case OP_JGEI:
+        case OP_JEQI:
+        case OP_JNEI:
+        case OP_INCJMP:
+            printf("%4d %11s R[%d] %d\n", n, op_name[OP(i)], PA(i), PB(i));
+            break;
         case OP_GLOBAL_GET:
         case OP_GLOBAL_SET:
             printf("%4d %11s R[%d] G[%d]\n", n, op_name[OP(i)], PA(i), PB(i));
@@ -103,6 +194,7 @@ void lgx_bc_echo(unsigned n, unsigned i) {
             break;
         case OP_MOVI:
         case OP_TEST:
+        case OP_MAP_NEW:
             printf("%4d %11s R[%d] %d\n", n, op_name[OP(i)], PA(i), PD(i));
             break;
         case OP_JMP:
@@ -176,6 +268,108 @@ void bc_set_param_e(lgx_compiler_t* c, unsigned pos, unsigned pe) {
     c->bc.buffer[pos] |= pe << 8;
 }
 
+// 回填跳转指令的目标地址
+// TEST 指令保存相对距离，JMPI 指令（包括比较跳转指令的第二个字）保存绝对地址
+void bc_set_jump(lgx_compiler_t* c, unsigned pos, unsigned target) {
+    if (OP(c->bc.buffer[pos]) == OP_TEST) {
+        bc_set_param_d(c, pos, target - pos - 1);
+    } else {
+        assert(OP(c->bc.buffer[pos]) == OP_JMPI);
+        bc_set_param_e(c, pos, target);
+    }
+}
+
+// 把刚刚生成的、结果写入 reg 的整数比较指令与跳转合并为比较跳转指令：
+// 比较结果等于 expect 时跳转到 pos
+// 合并成功返回 0，否则返回 1 并且不修改字节码
+int bc_fuse_branch(lgx_compiler_t* c, unsigned char reg, int expect, unsigned pos) {
+    if (c->bc.length == 0) {
+        return 1;
+    }
+
+    unsigned n = 1;
+    unsigned i = c->bc.buffer[c->bc.length - 1];
+
+    // != 被编译为 EQ 与 LNOT 两条指令
+    if (OP(i) == OP_LNOT && PA(i) == reg && PB(i) == reg && c->bc.length >= 2) {
+        n = 2;
+        i = c->bc.buffer[c->bc.length - 2];
+        expect = !expect;
+    }
+
+    if (PA(i) != reg) {
+        return 1;
+    }
+
+    unsigned op, a = PB(i), b = PC(i);
+    switch (OP(i)) {
+        // !(a < b) 即 b <= a
+        case OP_ILT:
+            if (expect) {
+                op = OP_JLT;
+            } else {
+                op = OP_JLE;
+                a = PC(i);
+                b = PB(i);
+            }
+            break;
+        case OP_ILE:
+            if (expect) {
+                op = OP_JLE;
+            } else {
+                op = OP_JLT;
+                a = PC(i);
+                b = PB(i);
+            }
+            break;
+        case OP_IEQ:  op = expect ? OP_JEQ : OP_JNE; break;
+        case OP_ILTI: op = expect ? OP_JLTI : OP_JGEI; break;
+        case OP_ILEI: op = expect ? OP_JLEI : OP_JGTI; break;
+        case OP_IGTI: op = expect ? OP_JGTI : OP_JLEI; break;
+        case OP_IGEI: op = expect ? OP_JGEI : OP_JLTI; break;
+        case OP_IEQI: op = expect ? OP_JEQI : OP_JNEI; break;
+        default:
+            return 1;
+    }
+
+    c->bc.length -= n;
+
+    if (bc_append(c, I2(op, a, b))) {
+        return 1;
+    }
+
+    return bc_jmpi(c, pos);
+}
+
+// 如果 [start, 当前位置) 恰好为 IADDI T R I 与 MOV R T，则将其与跳转到 pos 的 JMPI
+// 合并为 INCJMP R I 指令
+// 合并成功返回 0，否则返回 1 并且不修改字节码
+int bc_fuse_loop(lgx_compiler_t* c, unsigned start, unsigned pos) {
+    if (c->bc.length != start + 2) {
+        return 1;
+    }
+
+    unsigned add = c->bc.buffer[start];
+    unsigned mov = c->bc.buffer[start + 1];
+
+    if (OP(add) != OP_IADDI || OP(mov) != OP_MOV) {
+        return 1;
+    }
+
+    // 临时寄存器 T 在语句结束后不再使用，可以省略
+    if (PA(add) == PB(add) || PA(mov) != PB(add) || PB(mov) != PA(add)) {
+        return 1;
+    }
+
+    c->bc.length = start;
+
+    if (bc_append(c, I2(OP_INCJMP, PB(add), PC(add)))) {
+        return 1;
+    }
+
+    return bc_jmpi(c, pos);
+}
+
 int bc_nop(lgx_compiler_t* c) {
     return bc_append(c, I0(OP_NOP));
 }
@@ -352,6 +546,175 @@ int bc_lnot(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2) {
     return bc_append(c, I2(OP_LNOT, reg1, reg2));
 }
 
+// 寄存器1 = 寄存器2 + 寄存器3（整数）
+int bc_iadd(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_IADD, reg1, reg2, reg3));
+}
+
+// 寄存器1 = 寄存器2 + 立即数（整数）
+int bc_iaddi(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num) {
+    return bc_append(c, I3(OP_IADDI, reg1, reg2, num));
+}
+
+// 寄存器1 = 寄存器2 - 寄存器3（整数）
+int bc_isub(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_ISUB, reg1, reg2, reg3));
+}
+
+// 寄存器1 = 寄存器2 - 立即数（整数）
+int bc_isubi(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num) {
+    return bc_append(c, I3(OP_ISUBI, reg1, reg2, num));
+}
+
+// 寄存器1 = 寄存器2 * 寄存器3（整数）
+int bc_imul(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_IMUL, reg1, reg2, reg3));
+}
+
+// 寄存器1 = 寄存器2 * 立即数（整数）
+int bc_imuli(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num) {
+    return bc_append(c, I3(OP_IMULI, reg1, reg2, num));
+}
+
+// 寄存器1 = 寄存器2 / 寄存器3（整数）
+int bc_idiv(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_IDIV, reg1, reg2, reg3));
+}
+
+// 寄存器1 = 寄存器2 / 立即数（整数）
+int bc_idivi(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num) {
+    return bc_append(c, I3(OP_IDIVI, reg1, reg2, num));
+}
+
+// 寄存器1 = - 寄存器2（整数）
+int bc_ineg(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2) {
+    return bc_append(c, I2(OP_INEG, reg1, reg2));
+}
+
+// 寄存器1 = 寄存器2 == 寄存器3（整数）
+int bc_ieq(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_IEQ, reg1, reg2, reg3));
+}
+
+// 寄存器1 = 寄存器2 == 立即数（整数）
+int bc_ieqi(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num) {
+    return bc_append(c, I3(OP_IEQI, reg1, reg2, num));
+}
+
+// 寄存器1 = 寄存器2 != 寄存器3（整数）
+int bc_ine(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    if (bc_ieq(c, reg1, reg2, reg3)) {
+        return 1;
+    }
+    return bc_lnot(c, reg1, reg1);
+}
+
+// 寄存器1 = 寄存器2 != 立即数（整数）
+int bc_inei(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num) {
+    if (bc_ieqi(c, reg1, reg2, num)) {
+        return 1;
+    }
+    return bc_lnot(c, reg1, reg1);
+}
+
+// 寄存器1 = 寄存器2 < 寄存器3（整数）
+int bc_ilt(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_ILT, reg1, reg2, reg3));
+}
+
+// 寄存器1 = 寄存器2 < 立即数（整数）
+int bc_ilti(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num) {
+    return bc_append(c, I3(OP_ILTI, reg1, reg2, num));
+}
+
+// 寄存器1 = 寄存器2 <= 寄存器3（整数）
+int bc_ile(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_ILE, reg1, reg2, reg3));
+}
+
+// 寄存器1 = 寄存器2 <= 立即数（整数）
+int bc_ilei(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num) {
+    return bc_append(c, I3(OP_ILEI, reg1, reg2, num));
+}
+
+// 寄存器1 = 寄存器2 > 寄存器3（整数）
+int bc_igt(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_ILT, reg1, reg3, reg2));
+}
+
+// 寄存器1 = 寄存器2 > 立即数（整数）
+int bc_igti(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num) {
+    return bc_append(c, I3(OP_IGTI, reg1, reg2, num));
+}
+
+// 寄存器1 = 寄存器2 >= 寄存器3（整数）
+int bc_ige(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_ILE, reg1, reg3, reg2));
+}
+
+// 寄存器1 = 寄存器2 >= 立即数（整数）
+int bc_igei(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num) {
+    return bc_append(c, I3(OP_IGEI, reg1, reg2, num));
+}
+
+// 寄存器1 = 寄存器2 + 寄存器3（浮点数）
+int bc_fadd(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_FADD, reg1, reg2, reg3));
+}
+
+// 寄存器1 = 寄存器2 - 寄存器3（浮点数）
+int bc_fsub(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_FSUB, reg1, reg2, reg3));
+}
+
+// 寄存器1 = 寄存器2 * 寄存器3（浮点数）
+int bc_fmul(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_FMUL, reg1, reg2, reg3));
+}
+
+// 寄存器1 = 寄存器2 / 寄存器3（浮点数）
+int bc_fdiv(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_FDIV, reg1, reg2, reg3));
+}
+
+// 寄存器1 = - 寄存器2（浮点数）
+int bc_fneg(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2) {
+    return bc_append(c, I2(OP_FNEG, reg1, reg2));
+}
+
+// 寄存器1 = 寄存器2 == 寄存器3（浮点数）
+int bc_feq(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_FEQ, reg1, reg2, reg3));
+}
+
+// 寄存器1 = 寄存器2 != 寄存器3（浮点数）
+int bc_fne(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    if (bc_feq(c, reg1, reg2, reg3)) {
+        return 1;
+    }
+    return bc_lnot(c, reg1, reg1);
+}
+
+// 寄存器1 = 寄存器2 < 寄存器3（浮点数）
+int bc_flt(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_FLT, reg1, reg2, reg3));
+}
+
+// 寄存器1 = 寄存器2 <= 寄存器3（浮点数）
+int bc_fle(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_FLE, reg1, reg2, reg3));
+}
+
+// 寄存器1 = 寄存器2 > 寄存器3（浮点数）
+int bc_fgt(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_FLT, reg1, reg3, reg2));
+}
+
+// 寄存器1 = 寄存器2 >= 寄存器3（浮点数）
+int bc_fge(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_FLE, reg1, reg3, reg2));
+}
+
 // 创建函数调用，函数信息存储于常量表中
 int bc_call_new(lgx_compiler_t* c, unsigned reg) {
     assert(reg <= 255);
@@ -426,6 +789,21 @@ int bc_array_set(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsi
     return bc_append(c, I3(OP_ARRAY_SET, reg1, reg2, reg3));
 }
 
+// 寄存器 = [key]unknown{}
+int bc_map_new(lgx_compiler_t* c, unsigned char reg, unsigned key) {
+    return bc_append(c, I2(OP_MAP_NEW, reg, key));
+}
+
+// 寄存器1 = 寄存器2[寄存器3]
+int bc_map_get(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_MAP_GET, reg1, reg2, reg3));
+}
+
+// 寄存器1[寄存器2] = 寄存器3
+int bc_map_set(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3) {
+    return bc_append(c, I3(OP_MAP_SET, reg1, reg2, reg3));
+}
+
 // 寄存器1 = typeof 寄存器2
 int bc_typeof(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2) {
     return bc_append(c, I2(OP_TYPEOF, reg1, reg2));
@@ -18,6 +18,7 @@ typedef enum {
     OP_MOVI,  // MOVI R I
 
     // 数学运算
+    // 操作数类型在编译期无法确定时使用，执行时检查操作数类型
     OP_ADD,   // ADD  R R R
     OP_ADDI,  // ADDI R R I
     OP_SUB,   // SUB  R R R
@@ -39,6 +40,7 @@ typedef enum {
     OP_NOT,   // NOT  R R
 
     // 逻辑运算
+    // 操作数类型在编译期无法确定时使用，执行时检查操作数类型
     OP_EQ,    // EQ   R R R
     OP_EQI,   // EQI  R R I
     OP_LE,    // LE   R R R
@@ -49,6 +51,68 @@ typedef enum {
     OP_GTI,   // GTI  R R I
     OP_LNOT,  // LNOT R R
 
+    // 整数运算
+    // 由编译器保证操作数均为整数，执行时不检查操作数类型
+    OP_IADD,  // IADD  R R R
+    OP_IADDI, // IADDI R R I
+    OP_ISUB,  // ISUB  R R R
+    OP_ISUBI, // ISUBI R R I
+    OP_IMUL,  // IMUL  R R R
+    OP_IMULI, // IMULI R R I
+    OP_IDIV,  // IDIV  R R R
+    OP_IDIVI, // IDIVI R R I
+    OP_INEG,  // INEG  R R
+
+    // 整数比较
+    OP_IEQ,   // IEQ   R R R
+    OP_IEQI,  // IEQI  R R I
+    OP_ILE,   // ILE   R R R
+    OP_ILEI,  // ILEI  R R I
+    OP_ILT,   // ILT   R R R
+    OP_ILTI,  // ILTI  R R I
+    OP_IGEI,  // IGEI  R R I
+    OP_IGTI,  // IGTI  R R I
+
+    // 浮点数运算
+    // 由编译器保证操作数均为浮点数，执行时不检查操作数类型
+    OP_FADD,  // FADD  R R R
+    OP_FSUB,  // FSUB  R R R
+    OP_FMUL,  // FMUL  R R R
+    OP_FDIV,  // FDIV  R R R
+    OP_FNEG,  // FNEG  R R
+
+    // 浮点数比较
+    OP_FEQ,   // FEQ   R R R
+    OP_FLE,   // FLE   R R R
+    OP_FLT,   // FLT   R R R
+
+    // 运行时特化指令
+    // 编译器不会生成这些指令，解释器观察到通用指令的操作数类型后将其改写为特化指令，
+    // 类型检查失败时恢复为通用指令
+    OP_ADD_LONG,        // ADD_LONG       R R R
+    OP_ADD_DOUBLE,      // ADD_DOUBLE     R R R
+    OP_LT_LONG,         // LT_LONG        R R R
+    OP_LT_DOUBLE,       // LT_DOUBLE      R R R
+    OP_ARRAY_GET_LONG,  // ARRAY_GET_LONG R R R
+
+    // 比较跳转指令
+    // 由比较指令与 TEST、JMPI 合并而来，占用两个字，第二个字为 JMPI 指令，保存跳转目标
+    // 比较结果为真时跳转到 JMPI 指定的位置，否则跳过第二个字继续执行
+    // 由编译器保证操作数均为整数，执行时不检查操作数类型
+    OP_JLT,   // JLT  R R + JMPI L
+    OP_JLE,   // JLE  R R + JMPI L
+    OP_JEQ,   // JEQ  R R + JMPI L
+    OP_JNE,   // JNE  R R + JMPI L
+    OP_JLTI,  // JLTI R I + JMPI L
+    OP_JLEI,  // JLEI R I + JMPI L
+    OP_JGTI,  // JGTI R I + JMPI L
+    OP_JGEI,  // JGEI R I + JMPI L
+    OP_JEQI,  // JEQI R I + JMPI L
+    OP_JNEI,  // JNEI R I + JMPI L
+
+    // 自增并跳转到循环起始位置，由 for 循环末尾的 IADDI、MOV、JMPI 合并而来
+    OP_INCJMP,// INCJMP R I + JMPI L
+
     // 类型运算
     OP_TYPEOF, // TYPEOF R R
 
@@ -74,6 +138,11 @@ typedef enum {
     OP_ARRAY_GET, // ARRAY_GET R R R    R1 = R2[R3]
     OP_ARRAY_SET, // ARRAY_SET R R R    R1[R2] = R3
 
+    // 图
+    OP_MAP_NEW,   // MAP_NEW R I        R = [I]unknown{}，I 为键的类型
+    OP_MAP_GET,   // MAP_GET R R R      R1 = R2[R3]
+    OP_MAP_SET,   // MAP_SET R R R      R1[R2] = R3
+
     // 全局变量
     // 全局变量数量上限为 64K 个
     OP_GLOBAL_GET,// GLOBAL_GET R G     R = G
@@ -95,7 +164,7 @@ typedef enum {
 #define I0(op)          (op)
 #define I1(op, e)       (op + (e << 8))
 #define I2(op, a, d)    (op + (a << 8) + (d << 16))
-#define I3(op, a, b, c) (op + (a << 8) + (b << 16) + (c << 24))
+#define I3(op, a, b, c) (op + (a << 8) + (b << 16) + ((unsigned)(c) << 24))
 
 #define OP(i) (   (i)         & 0xFF)
 #define PA(i) ( ( (i) >>  8 ) & 0xFF)
@@ -111,6 +180,10 @@ void bc_set(lgx_compiler_t* c, unsigned pos, unsigned i);
 void bc_set_param_a(lgx_compiler_t* c, unsigned pos, unsigned pa);
 void bc_set_param_d(lgx_compiler_t* c, unsigned pos, unsigned pd);
 void bc_set_param_e(lgx_compiler_t* c, unsigned pos, unsigned pe);
+void bc_set_jump(lgx_compiler_t* c, unsigned pos, unsigned target);
+
+int bc_fuse_branch(lgx_compiler_t* c, unsigned char reg, int expect, unsigned pos);
+int bc_fuse_loop(lgx_compiler_t* c, unsigned start, unsigned pos);
 
 int bc_nop(lgx_compiler_t* c);
 
@@ -151,6 +224,42 @@ int bc_ge(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned ch
 int bc_gei(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num);
 int bc_lnot(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2);
 
+int bc_iadd(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_iaddi(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num);
+int bc_isub(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_isubi(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num);
+int bc_imul(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_imuli(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num);
+int bc_idiv(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_idivi(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num);
+int bc_ineg(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2);
+
+int bc_ieq(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_ieqi(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num);
+int bc_ine(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_inei(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num);
+int bc_ilt(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_ilti(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num);
+int bc_ile(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_ilei(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num);
+int bc_igt(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_igti(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num);
+int bc_ige(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_igei(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char num);
+
+int bc_fadd(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_fsub(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_fmul(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_fdiv(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_fneg(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2);
+
+int bc_feq(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_fne(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_flt(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_fle(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_fgt(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_fge(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+
 int bc_call_new(lgx_compiler_t* c, unsigned reg);
 int bc_call_set(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2);
 int bc_call(lgx_compiler_t* c, unsigned reg1, unsigned char reg2);
@@ -169,6 +278,9 @@ int bc_array_new(lgx_compiler_t* c, unsigned char reg);
 int bc_array_add(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2);
 int bc_array_get(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
 int bc_array_set(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_map_new(lgx_compiler_t* c, unsigned char reg, unsigned key);
+int bc_map_get(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
+int bc_map_set(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2, unsigned char reg3);
 
 int bc_typeof(lgx_compiler_t* c, unsigned char reg1, unsigned char reg2);
 
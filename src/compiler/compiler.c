@@ -2,6 +2,7 @@
 #include "../common/escape.h"
 #include "../parser/symbol.h"
 #include "../runtime/exception.h"
+#include "../runtime/buildin.h"
 #include "register.h"
 #include "compiler.h"
 #include "bytecode.h"
@@ -15,19 +16,11 @@ void compiler_error(lgx_compiler_t* c, lgx_ast_node_t* node, const char *fmt, ..
     assert(c->ast);
     lgx_ast_t* ast = c->ast;
 
-    lgx_ast_error_list_t* err = xcalloc(1, sizeof(lgx_ast_error_list_t));
+    lgx_ast_error_list_t* err = lgx_ast_error_new(ast);
     if (!err) {
         return;
     }
 
-    lgx_list_init(&err->head);
-    err->err_no = 1;
-
-    if (lgx_str_init(&err->err_msg, 256)) {
-        xfree(err);
-        return;
-    }
-
     if (ast->lex.source.path) {
         err->err_msg.length = snprintf(err->err_msg.buffer, err->err_msg.size,
             "[COMPILER ERROR] [%s:%d:%d] ", ast->lex.source.path, node->line + 1, node->row);
@@ -152,7 +145,7 @@ static int jmp_add(lgx_compiler_t* c, lgx_ast_node_t *node) {
 
     // 初始化
     if (!loop->u.jmps) {
-        loop->u.jmps = (lgx_list_t *)xmalloc(sizeof(lgx_list_t));
+        loop->u.jmps = (lgx_list_t *)lgx_arena_alloc(&c->ast->arena, sizeof(lgx_list_t));
         if (loop->u.jmps) {
             lgx_list_init(loop->u.jmps);
         } else {
@@ -161,7 +154,7 @@ static int jmp_add(lgx_compiler_t* c, lgx_ast_node_t *node) {
         }
     }
 
-    lgx_ast_node_list_t *n = (lgx_ast_node_list_t *)xmalloc(sizeof(lgx_ast_node_list_t));
+    lgx_ast_node_list_t *n = (lgx_ast_node_list_t *)lgx_arena_alloc(&c->ast->arena, sizeof(lgx_ast_node_list_t));
     if (n) {
         n->node = node;
         lgx_list_init(&n->head);
@@ -434,7 +427,7 @@ static int op_div(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr_result_t* e,
             compiler_error(c, node, "divide by zero\n");
             return 1;
         }
-        e->v.l = l->v.l / r->v.l;
+        e->v.l = lgx_long_div(l->v.l, r->v.l);
     } else {
         cast_double(l);
         cast_double(r);
@@ -457,7 +450,11 @@ static int op_mod(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr_result_t* e,
     if (check_constant(l, T_LONG) && check_constant(r, T_LONG)) {
         e->type = EXPR_LITERAL;
         e->v_type.type = T_LONG;
-        e->v.l = l->v.l % r->v.l;
+        if (r->v.l == 0) {
+            compiler_error(c, node, "divide by zero\n");
+            return 1;
+        }
+        e->v.l = lgx_long_mod(l->v.l, r->v.l);
     } else {
         compiler_error(c, node, "invalid operand type for operator %%\n");
         return 1;
@@ -646,6 +643,66 @@ static int op_shr(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr_result_t* e,
     return 0;
 }
 
+// 整数运算的第二个操作数为 0 - 255 之间的字面量
+#define is_immediate(e) (is_literal(e) && check_type(e, T_LONG) && (e)->v.l >= 0 && (e)->v.l <= 255)
+
+// 使用立即数指令编译整数运算，不支持的运算符返回 -1
+static int binary_operator_immediate(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr_result_t* e, unsigned op, lgx_expr_result_t* l, lgx_expr_result_t* r) {
+    assert(check_type(l, T_LONG) && is_immediate(r));
+
+    unsigned char num = (unsigned char)r->v.l;
+
+    switch (op) {
+        case TK_ADD: case TK_MUL:
+        case TK_EQUAL: case TK_NOT_EQUAL:
+        case TK_LESS: case TK_LESS_EQUAL:
+        case TK_GREATER: case TK_GREATER_EQUAL:
+            break;
+        case TK_SUB:
+            break;
+        case TK_DIV:
+            // 除数为 0 时使用普通指令，在运行时抛出异常
+            if (num == 0) {
+                return -1;
+            }
+            break;
+        default:
+            return -1;
+    }
+
+    int r1, ret = 0;
+    if (is_local(l) || is_temp(l)) {
+        r1 = l->u.local;
+    } else {
+        r1 = load_to_reg(c, node, l);
+        if (r1 < 0) {
+            return 1;
+        }
+    }
+
+    e->type = EXPR_TEMP;
+    e->u.local = reg_pop(c, node);
+    switch (op) {
+        case TK_ADD: ret = bc_iaddi(c, e->u.local, r1, num); break;
+        case TK_SUB: ret = bc_isubi(c, e->u.local, r1, num); break;
+        case TK_MUL: ret = bc_imuli(c, e->u.local, r1, num); break;
+        case TK_DIV: ret = bc_idivi(c, e->u.local, r1, num); break;
+        case TK_EQUAL: ret = bc_ieqi(c, e->u.local, r1, num); break;
+        case TK_NOT_EQUAL: ret = bc_inei(c, e->u.local, r1, num); break;
+        case TK_LESS: ret = bc_ilti(c, e->u.local, r1, num); break;
+        case TK_LESS_EQUAL: ret = bc_ilei(c, e->u.local, r1, num); break;
+        case TK_GREATER: ret = bc_igti(c, e->u.local, r1, num); break;
+        case TK_GREATER_EQUAL: ret = bc_igei(c, e->u.local, r1, num); break;
+    }
+
+    // 临时寄存器由调用者释放，这里只释放为常量分配的寄存器
+    if (!is_local(l) && !is_temp(l)) {
+        reg_push(c, node, r1);
+    }
+
+    return ret;
+}
+
 static int binary_operator(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr_result_t* e, lgx_expr_result_t* l, lgx_expr_result_t* r) {
     if (is_constant(l) && is_constant(r)) {
         switch (node->u.op) {
@@ -670,8 +727,36 @@ static int binary_operator(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr_res
         }
     }
     
-    if (0) {
-        // TODO 如果一个操作数为立即数并且范围在 0 - 255 之内，使用立即数指令
+    // 两个操作数类型相同时使用对应类型的指令，否则使用带类型检查的通用指令
+    lgx_val_type_t t = T_UNKNOWN;
+    if (check_type(l, T_LONG) && check_type(r, T_LONG)) {
+        t = T_LONG;
+    } else if (check_type(l, T_DOUBLE) && check_type(r, T_DOUBLE)) {
+        t = T_DOUBLE;
+    }
+
+    // 如果一个操作数为立即数并且范围在 0 - 255 之内，使用立即数指令
+    if (t == T_LONG) {
+        if (is_immediate(r)) {
+            int ret = binary_operator_immediate(c, node, e, node->u.op, l, r);
+            if (ret >= 0) {
+                return ret;
+            }
+        } else if (is_immediate(l) && node->u.op != TK_SUB && node->u.op != TK_DIV) {
+            // 减法与除法不满足交换律，其它运算交换操作数
+            unsigned op;
+            switch (node->u.op) {
+                case TK_LESS: op = TK_GREATER; break;
+                case TK_LESS_EQUAL: op = TK_GREATER_EQUAL; break;
+                case TK_GREATER: op = TK_LESS; break;
+                case TK_GREATER_EQUAL: op = TK_LESS_EQUAL; break;
+                default: op = node->u.op;
+            }
+            int ret = binary_operator_immediate(c, node, e, op, r, l);
+            if (ret >= 0) {
+                return ret;
+            }
+        }
     }
 
     // 编译为普通指令
@@ -701,17 +786,77 @@ static int binary_operator(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr_res
         e->type = EXPR_TEMP;
         e->u.local = reg_pop(c, node);
         switch (node->u.op) {
-            case TK_ADD: ret = bc_add(c, e->u.local, r1, r2); break;
-            case TK_SUB: ret = bc_sub(c, e->u.local, r1, r2); break;
-            case TK_MUL: ret = bc_mul(c, e->u.local, r1, r2); break;
-            case TK_DIV: ret = bc_div(c, e->u.local, r1, r2); break;
+            case TK_ADD:
+                switch (t) {
+                    case T_LONG: ret = bc_iadd(c, e->u.local, r1, r2); break;
+                    case T_DOUBLE: ret = bc_fadd(c, e->u.local, r1, r2); break;
+                    default: ret = bc_add(c, e->u.local, r1, r2);
+                }
+                break;
+            case TK_SUB:
+                switch (t) {
+                    case T_LONG: ret = bc_isub(c, e->u.local, r1, r2); break;
+                    case T_DOUBLE: ret = bc_fsub(c, e->u.local, r1, r2); break;
+                    default: ret = bc_sub(c, e->u.local, r1, r2);
+                }
+                break;
+            case TK_MUL:
+                switch (t) {
+                    case T_LONG: ret = bc_imul(c, e->u.local, r1, r2); break;
+                    case T_DOUBLE: ret = bc_fmul(c, e->u.local, r1, r2); break;
+                    default: ret = bc_mul(c, e->u.local, r1, r2);
+                }
+                break;
+            case TK_DIV:
+                switch (t) {
+                    case T_LONG: ret = bc_idiv(c, e->u.local, r1, r2); break;
+                    case T_DOUBLE: ret = bc_fdiv(c, e->u.local, r1, r2); break;
+                    default: ret = bc_div(c, e->u.local, r1, r2);
+                }
+                break;
             //case TK_MOD: ret = bc_mod(c, e->u.local, r1, r2); break;
-            case TK_EQUAL: ret = bc_eq(c, e->u.local, r1, r2); break;
-            case TK_NOT_EQUAL: ret = bc_ne(c, e->u.local, r1, r2); break;
-            case TK_GREATER: ret = bc_gt(c, e->u.local, r1, r2); break;
-            case TK_GREATER_EQUAL: ret = bc_ge(c, e->u.local, r1, r2); break;
-            case TK_LESS: ret = bc_lt(c, e->u.local, r1, r2); break;
-            case TK_LESS_EQUAL: ret = bc_le(c, e->u.local, r1, r2); break;
+            case TK_EQUAL:
+                switch (t) {
+                    case T_LONG: ret = bc_ieq(c, e->u.local, r1, r2); break;
+                    case T_DOUBLE: ret = bc_feq(c, e->u.local, r1, r2); break;
+                    default: ret = bc_eq(c, e->u.local, r1, r2);
+                }
+                break;
+            case TK_NOT_EQUAL:
+                switch (t) {
+                    case T_LONG: ret = bc_ine(c, e->u.local, r1, r2); break;
+                    case T_DOUBLE: ret = bc_fne(c, e->u.local, r1, r2); break;
+                    default: ret = bc_ne(c, e->u.local, r1, r2);
+                }
+                break;
+            case TK_GREATER:
+                switch (t) {
+                    case T_LONG: ret = bc_igt(c, e->u.local, r1, r2); break;
+                    case T_DOUBLE: ret = bc_fgt(c, e->u.local, r1, r2); break;
+                    default: ret = bc_gt(c, e->u.local, r1, r2);
+                }
+                break;
+            case TK_GREATER_EQUAL:
+                switch (t) {
+                    case T_LONG: ret = bc_ige(c, e->u.local, r1, r2); break;
+                    case T_DOUBLE: ret = bc_fge(c, e->u.local, r1, r2); break;
+                    default: ret = bc_ge(c, e->u.local, r1, r2);
+                }
+                break;
+            case TK_LESS:
+                switch (t) {
+                    case T_LONG: ret = bc_ilt(c, e->u.local, r1, r2); break;
+                    case T_DOUBLE: ret = bc_flt(c, e->u.local, r1, r2); break;
+                    default: ret = bc_lt(c, e->u.local, r1, r2);
+                }
+                break;
+            case TK_LESS_EQUAL:
+                switch (t) {
+                    case T_LONG: ret = bc_ile(c, e->u.local, r1, r2); break;
+                    case T_DOUBLE: ret = bc_fle(c, e->u.local, r1, r2); break;
+                    default: ret = bc_le(c, e->u.local, r1, r2);
+                }
+                break;
             case TK_LEFT_BRACK: ret = bc_array_get(c, e->u.local, r1, r2); break;
             case TK_CONCAT: bc_concat(c, e->u.local, r1, r2); break;
             case TK_SHL: bc_shl(c, e->u.local, r1, r2); break;
@@ -722,11 +867,12 @@ static int binary_operator(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr_res
         }
     } while (0);
 
-    if (!is_local(l) && r1 >= 0) {
+    // 临时寄存器由调用者释放，这里只释放为常量分配的寄存器
+    if (!is_local(l) && !is_temp(l) && r1 >= 0) {
         reg_push(c, node, r1);
     }
 
-    if (!is_local(r) && r2 >= 0) {
+    if (!is_local(r) && !is_temp(r) && r2 >= 0) {
         reg_push(c, node, r2);
     }
 
@@ -805,7 +951,14 @@ static int unary_operator(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr_resu
             switch (node->u.op) {
                 case TK_LOGIC_NOT: return bc_lnot(c, e->u.local, r1);
                 case TK_NOT: return bc_not(c, e->u.local, r1);
-                case TK_SUB: return bc_neg(c, e->u.local, r1);
+                case TK_SUB:
+                    if (check_type(r, T_LONG)) {
+                        return bc_ineg(c, e->u.local, r1);
+                    } else if (check_type(r, T_DOUBLE)) {
+                        return bc_fneg(c, e->u.local, r1);
+                    } else {
+                        return bc_neg(c, e->u.local, r1);
+                    }
                 default:
                     compiler_error(c, node, "unknown unary operator %d\n", node->u.op);
                     return 1;
@@ -835,6 +988,7 @@ static void compiler_type_error(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_typ
 }
 
 static int compiler_expression(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr_result_t* e);
+static int compiler_expression_expect(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_type_t* type, lgx_expr_result_t* e);
 
 static int compiler_binary_expression_logic_and(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr_result_t* e) {
     assert(node->type == BINARY_EXPRESSION);
@@ -1084,6 +1238,12 @@ static int compiler_binary_expression_logic_or(lgx_compiler_t* c, lgx_ast_node_t
     return ret;
 }
 
+// 至少一个操作数的类型未知，并且另一个操作数为数字或类型未知
+// 此时只能在运行时检查操作数类型
+#define is_number_or_unknown(e) (check_type(e, T_LONG) || check_type(e, T_DOUBLE) || check_type(e, T_UNKNOWN))
+#define is_dynamic_number(e1, e2) ((check_type(e1, T_UNKNOWN) || check_type(e2, T_UNKNOWN)) && \
+    is_number_or_unknown(e1) && is_number_or_unknown(e2))
+
 static int compiler_binary_expression_math(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr_result_t* e) {
     assert(node->type == BINARY_EXPRESSION);
 
@@ -1106,8 +1266,9 @@ static int compiler_binary_expression_math(lgx_compiler_t* c, lgx_ast_node_t *no
         node->u.op = TK_CONCAT;
         ret = binary_operator(c, node, e, &e1, &e2);
     } else if ((check_type(&e1, T_LONG) && check_type(&e2, T_LONG)) ||
-        (check_type(&e1, T_DOUBLE) && check_type(&e2, T_DOUBLE))) {
-        e->v_type.type = e1.v_type.type;
+        (check_type(&e1, T_DOUBLE) && check_type(&e2, T_DOUBLE)) ||
+        is_dynamic_number(&e1, &e2)) {
+        e->v_type.type = check_type(&e2, T_UNKNOWN) ? T_UNKNOWN : e1.v_type.type;
         switch (node->u.op) {
             case TK_ADD:
             case TK_SUB:
@@ -1151,7 +1312,8 @@ static int compiler_binary_expression_relation(lgx_compiler_t* c, lgx_ast_node_t
     if (node->u.op == TK_EQUAL && check_type(&e1, T_STRING) && check_type(&e2, T_STRING)) {
         // TODO 字符串比较
     } else if ((check_type(&e1, T_LONG) && check_type(&e2, T_LONG)) ||
-        (check_type(&e1, T_DOUBLE) && check_type(&e2, T_DOUBLE))) {
+        (check_type(&e1, T_DOUBLE) && check_type(&e2, T_DOUBLE)) ||
+        is_dynamic_number(&e1, &e2)) {
         switch (node->u.op) {
             case TK_EQUAL:
                 if (check_type(&e1, T_DOUBLE) && check_type(&e2, T_DOUBLE)) {
@@ -1221,6 +1383,28 @@ static int compiler_binary_expression_bitwise(lgx_compiler_t* c, lgx_ast_node_t
     return ret;
 }
 
+// 计算赋值语句右侧的值，type 为左侧的类型（未知时为 NULL）。r 返回保存该值的寄存器
+static int compiler_assignment_value(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_type_t* type, lgx_expr_result_t* e, int* r) {
+    int ret = 0;
+
+    if (type) {
+        ret = compiler_expression_expect(c, node->child[1], type, e);
+    } else {
+        ret = compiler_expression(c, node->child[1], e);
+    }
+
+    if (is_local(e) || is_temp(e)) {
+        *r = e->u.local;
+    } else {
+        *r = load_to_reg(c, node, e);
+        if (*r < 0) {
+            ret = 1;
+        }
+    }
+
+    return ret;
+}
+
 static int compiler_binary_expression_assignment(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr_result_t* e) {
     assert(node->type == BINARY_EXPRESSION);
 
@@ -1230,19 +1414,7 @@ static int compiler_binary_expression_assignment(lgx_compiler_t* c, lgx_ast_node
     lgx_expr_result_init(&e1);
     lgx_expr_result_init(&e2);
 
-    if (compiler_expression(c, node->child[1], &e2)) {
-        ret = 1;
-    }
-
-    int r;
-    if (is_local(&e2) || is_temp(&e2)) {
-        r = e2.u.local;
-    } else {
-        r = load_to_reg(c, node, &e2);
-        if (r < 0) {
-            ret = 1;
-        }
-    }
+    int r = -1;
 
     if (node->child[0]->type == IDENTIFIER_TOKEN) {
         // 局部变量&全局变量赋值
@@ -1250,6 +1422,10 @@ static int compiler_binary_expression_assignment(lgx_compiler_t* c, lgx_ast_node
             ret = 1;
         }
 
+        if (compiler_assignment_value(c, node, &e1.v_type, &e2, &r)) {
+            ret = 1;
+        }
+
         if (e2.type == EXPR_LITERAL) {
             if (!lgx_type_is_fit(&e2.v_type, &e1.v_type)) {
                 compiler_type_error(c, node, &e1.v_type, &e2.v_type);
@@ -1278,6 +1454,16 @@ static int compiler_binary_expression_assignment(lgx_compiler_t* c, lgx_ast_node
             ret = 1;
         }
 
+        lgx_type_t* value = NULL;
+        if (check_type(&e1, T_ARRAY)) {
+            value = &e1.v_type.u.arr->value;
+        } else if (check_type(&e1, T_MAP)) {
+            value = &e1.v_type.u.map->value;
+        }
+        if (compiler_assignment_value(c, node, value, &e2, &r)) {
+            ret = 1;
+        }
+
         if (check_variable(&e1, T_ARRAY)) {
             if (e2.type == EXPR_LITERAL) {
                 if (!lgx_type_is_fit(&e2.v_type, &e1.v_type.u.arr->value)) {
@@ -1332,7 +1518,63 @@ static int compiler_binary_expression_assignment(lgx_compiler_t* c, lgx_ast_node
             }
             lgx_expr_result_cleanup(c, node, &k);
         } else if (check_variable(&e1, T_MAP)) {
-            // TODO
+            if (e2.type == EXPR_LITERAL) {
+                if (!lgx_type_is_fit(&e2.v_type, &e1.v_type.u.map->value)) {
+                    compiler_type_error(c, node, &e1.v_type.u.map->value, &e2.v_type);
+                    ret = 1;
+                }
+            } else {
+                if (lgx_type_cmp(&e1.v_type.u.map->value, &e2.v_type)) {
+                    compiler_type_error(c, node, &e1.v_type.u.map->value, &e2.v_type);
+                    ret = 1;
+                }
+            }
+
+            if (node->child[0]->children != 2) {
+                compiler_error(c, node, "missing key for map assignment\n");
+                ret = 1;
+            } else {
+                lgx_expr_result_t k;
+                lgx_expr_result_init(&k);
+                if (compiler_expression(c, node->child[0]->child[1], &k)) {
+                    ret = 1;
+                }
+
+                if (!check_type(&k, e1.v_type.u.map->key.type)) {
+                    compiler_type_error(c, node, &e1.v_type.u.map->key, &k.v_type);
+                    ret = 1;
+                }
+
+                int index;
+                if (is_local(&k) || is_temp(&k)) {
+                    index = k.u.local;
+                } else {
+                    index = load_to_reg(c, node, &k);
+                    if (index < 0) {
+                        ret = 1;
+                    }
+                }
+
+                int reg;
+                if (is_local(&e1) || is_temp(&e1)) {
+                    reg = e1.u.local;
+                } else {
+                    reg = load_to_reg(c, node, &e1);
+                    if (reg < 0) {
+                        ret = 1;
+                    }
+                }
+
+                bc_map_set(c, reg, index, r);
+
+                if (!is_local(&e1) && !is_temp(&e1)) {
+                    reg_push(c, node, reg);
+                }
+                if (!is_local(&k) && !is_temp(&k)) {
+                    reg_push(c, node, index);
+                }
+                lgx_expr_result_cleanup(c, node, &k);
+            }
         } else {
             compiler_error(c, node, "left variable should be array or map\n");
             ret = 1;
@@ -1384,6 +1626,12 @@ static int compiler_binary_expression_call(lgx_compiler_t* c, lgx_ast_node_t *no
 
     lgx_type_function_t* fun = e1.v_type.u.fun;
 
+    // 内建函数没有字节码，不能复用当前的函数栈，改为普通调用
+    if (type == 1 && e1.symbol && lgx_value_type(&e1.symbol->v) == T_FUNCTION &&
+        lgx_value_fun(&e1.symbol->v)->buildin) {
+        type = 0;
+    }
+
     // 实参数量必须等于形参
     if (node->child[1]->children != fun->arg_len) {
         compiler_error(c, node, "arguments length mismatch\n");
@@ -1394,11 +1642,31 @@ static int compiler_binary_expression_call(lgx_compiler_t* c, lgx_ast_node_t *no
     int i;
     lgx_expr_result_t *expr = (lgx_expr_result_t *)xcalloc(node->child[1]->children, sizeof(lgx_expr_result_t));
     for(i = 0; i < node->child[1]->children; i++) {
-        if (compiler_expression(c, node->child[1]->child[i], &expr[i])) {
+        if (i < fun->arg_len) {
+            if (compiler_expression_expect(c, node->child[1]->child[i], &fun->args[i], &expr[i])) {
+                ret = 1;
+            }
+        } else if (compiler_expression(c, node->child[1]->child[i], &expr[i])) {
             ret = 1;
         }
     }
 
+    // 参数为 map 的内建函数，根据第一个参数的具体类型确定函数原型
+    lgx_type_t generic;
+    lgx_type_init(&generic, T_UNKNOWN);
+    if (e1.symbol && lgx_value_type(&e1.symbol->v) == T_FUNCTION && lgx_value_fun(&e1.symbol->v)->buildin &&
+        node->child[1]->children > 0 && check_type(&expr[0], T_MAP)) {
+        const lgx_buildin_t* b = lgx_buildin_find(lgx_value_fun(&e1.symbol->v)->buildin);
+        if (b && strchr(b->type, 'M')) {
+            if (lgx_buildin_type(b, &expr[0].v_type, &generic)) {
+                compiler_error(c, node, "out of memory\n");
+                ret = 1;
+            } else {
+                fun = generic.u.fun;
+            }
+        }
+    }
+
     if (node->child[0]->type == BINARY_EXPRESSION &&
         (node->child[0]->u.op == TK_DOT || node->child[0]->u.op == TK_ARROW)) {
         // TODO 方法调用，传入 receiver
@@ -1460,11 +1728,71 @@ static int compiler_binary_expression_call(lgx_compiler_t* c, lgx_ast_node_t *no
         ret = 1;
     }
 
+    lgx_type_cleanup(&generic);
     lgx_expr_result_cleanup(c, node, &e1);
 
     return ret;
 }
 
+// 读取 map 中的元素，键不存在时结果为 null
+static int compiler_map_index(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr_result_t* e, lgx_expr_result_t* e1) {
+    int ret = 0;
+
+    lgx_expr_result_t e2;
+    lgx_expr_result_init(&e2);
+
+    if (compiler_expression(c, node->child[1], &e2)) {
+        ret = 1;
+    }
+
+    if (!check_type(&e2, e1->v_type.u.map->key.type)) {
+        compiler_type_error(c, node, &e1->v_type.u.map->key, &e2.v_type);
+        ret = 1;
+    }
+
+    int r1, r2;
+    if (is_local(e1) || is_temp(e1)) {
+        r1 = e1->u.local;
+    } else {
+        r1 = load_to_reg(c, node, e1);
+        if (r1 < 0) {
+            ret = 1;
+        }
+    }
+    if (is_local(&e2) || is_temp(&e2)) {
+        r2 = e2.u.local;
+    } else {
+        r2 = load_to_reg(c, node, &e2);
+        if (r2 < 0) {
+            ret = 1;
+        }
+    }
+
+    e->type = EXPR_TEMP;
+    e->u.local = reg_pop(c, node);
+    if (e->u.local < 0) {
+        ret = 1;
+    }
+
+    bc_map_get(c, e->u.local, r1, r2);
+
+    if (!is_local(e1) && !is_temp(e1) && r1 >= 0) {
+        reg_push(c, node, r1);
+    }
+    if (!is_local(&e2) && !is_temp(&e2) && r2 >= 0) {
+        reg_push(c, node, r2);
+    }
+
+    // 设置返回值类型
+    if (lgx_type_dup(&e1->v_type.u.map->value, &e->v_type)) {
+        ret = 1;
+    }
+
+    lgx_expr_result_cleanup(c, node, &e2);
+
+    return ret;
+}
+
 static int compiler_binary_expression_index(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr_result_t* e) {
     assert(node->type == BINARY_EXPRESSION);
     assert(node->u.op == TK_LEFT_BRACK);
@@ -1480,6 +1808,14 @@ static int compiler_binary_expression_index(lgx_compiler_t* c, lgx_ast_node_t *n
         ret = 1;
     }
 
+    if (check_type(&e1, T_MAP)) {
+        if (compiler_map_index(c, node, e, &e1)) {
+            ret = 1;
+        }
+        lgx_expr_result_cleanup(c, node, &e1);
+        return ret;
+    }
+
     if (!check_type(&e1, T_ARRAY)) {
         compiler_error(c, node, "cannot index into non-array\n");
         return 1;
@@ -1631,11 +1967,16 @@ static int compiler_unary_expression_math_negative(lgx_compiler_t* c, lgx_ast_no
     lgx_expr_result_t e1;
     lgx_expr_result_init(&e1);
 
-    if (compiler_expression(c, node->child[0], &e1)) {
+    // 负整数字面量取反之后再检查范围，T_LONG 的最小值本身的绝对值超出了范围
+    if (node->child[0]->type == LONG_TOKEN) {
+        if (compiler_long_token(c, node->child[0], &e1)) {
+            ret = 1;
+        }
+    } else if (compiler_expression(c, node->child[0], &e1)) {
         ret = 1;
     }
 
-    if (check_type(&e1, T_LONG) || check_type(&e1, T_DOUBLE)) {
+    if (is_number_or_unknown(&e1)) {
         e->v_type.type = e1.v_type.type;
         if (unary_operator(c, node, e, &e1)) {
             ret = 1;
@@ -1788,7 +2129,40 @@ static int compiler_array_expression(lgx_compiler_t* c, lgx_ast_node_t *node, lg
     return ret;
 }
 
-static int compiler_expression(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr_result_t* e) {
+// 期望类型为 map 时，空的数组字面量 [] 表示空 map
+#define is_map_literal(n, t) \
+    ((t)->type == T_MAP && lgx_type_is_definite(t) && \
+    (n)->type == ARRAY_EXPRESSION && (n)->children == 0)
+
+static int compiler_map_expression(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_type_t* type, lgx_expr_result_t* e) {
+    assert(node->type == ARRAY_EXPRESSION);
+
+    e->type = EXPR_TEMP;
+    if (lgx_type_dup(type, &e->v_type)) {
+        compiler_error(c, node, "out of memory\n");
+        return 1;
+    }
+
+    e->u.local = reg_pop(c, node);
+    if (e->u.local < 0) {
+        return 1;
+    }
+
+    bc_map_new(c, e->u.local, type->u.map->key.type);
+
+    return 0;
+}
+
+// 编译结果类型应当为 type 的表达式
+static int compiler_expression_expect(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_type_t* type, lgx_expr_result_t* e) {
+    if (is_map_literal(node, type)) {
+        return compiler_map_expression(c, node, type, e);
+    }
+
+    return compiler_expression(c, node, e);
+}
+
+static int compiler_expression_value(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr_result_t* e) {
     switch (node->type) {
         case STRING_TOKEN:
             return compiler_string_token(c, node, e);
@@ -1818,9 +2192,87 @@ static int compiler_expression(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr
     }
 }
 
+static int compiler_expression(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_expr_result_t* e) {
+    if (compiler_expression_value(c, node, e)) {
+        return 1;
+    }
+
+    // 整数常量（包括折叠后的结果）必须能够保存为 T_LONG
+    if (is_literal(e) && e->v_type.type == T_LONG && !lgx_long_fits(e->v.l)) {
+        compiler_error(c, node, "integer constant out of range\n");
+        return 1;
+    }
+
+    return 0;
+}
+
 static int compiler_statement(lgx_compiler_t* c, lgx_ast_node_t *node);
 static int compiler_block_statement(lgx_compiler_t* c, lgx_ast_node_t *node);
 
+// 判断表达式是否为比较运算
+static int is_relation_expression(lgx_ast_node_t *node) {
+    if (node->type != BINARY_EXPRESSION) {
+        return 0;
+    }
+
+    switch (node->u.op) {
+        case TK_EQUAL:
+        case TK_NOT_EQUAL:
+        case TK_GREATER:
+        case TK_GREATER_EQUAL:
+        case TK_LESS:
+        case TK_LESS_EQUAL:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// 条件表达式 cond 的值为假时跳转，跳转目标稍后通过 bc_set_jump 回填
+// 如果条件为整数比较，则把比较指令与跳转合并为一条比较跳转指令
+// 返回需要回填的指令位置，出错时返回 -1
+static int jmp_if_false(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_ast_node_t *cond, lgx_expr_result_t* e) {
+    assert(check_variable(e, T_BOOL));
+
+    if (is_temp(e) && is_relation_expression(cond) && bc_fuse_branch(c, e->u.local, 0, 0) == 0) {
+        return c->bc.length - 1;
+    }
+
+    int pos;
+    if (is_global(e)) {
+        int r = load_to_reg(c, node, e);
+        if (r < 0) {
+            return -1;
+        }
+        pos = c->bc.length;
+        bc_test(c, r, 0);
+        reg_push(c, node, r);
+    } else {
+        pos = c->bc.length;
+        bc_test(c, e->u.local, 0);
+    }
+
+    return pos;
+}
+
+// 条件表达式 cond 的值为真时跳转到 target
+static int jmp_if_true(lgx_compiler_t* c, lgx_ast_node_t *node, lgx_ast_node_t *cond, lgx_expr_result_t* e, unsigned target) {
+    assert(check_variable(e, T_BOOL));
+
+    if (is_temp(e) && is_relation_expression(cond) && bc_fuse_branch(c, e->u.local, 1, target) == 0) {
+        return 0;
+    }
+
+    int pos = jmp_if_false(c, node, cond, e);
+    if (pos < 0) {
+        return 1;
+    }
+    bc_jmpi(c, target);
+    bc_set_jump(c, pos, c->bc.length);
+
+    return 0;
+}
+
 static int compiler_if_statement(lgx_compiler_t* c, lgx_ast_node_t *node) {
     assert(node->type == IF_STATEMENT);
     assert(node->children == 2);
@@ -1846,29 +2298,19 @@ static int compiler_if_statement(lgx_compiler_t* c, lgx_ast_node_t *node) {
     }
 
     if (check_variable(&e, T_BOOL)) {
-        int ret = 0;
-
-        unsigned pos = c->bc.length; // 跳出指令位置
-        if (is_global(&e)) {
-            int r = load_to_reg(c, node, &e);
-            if (r >= 0) {
-                bc_test(c, r, 0);
-                reg_push(c, node, r);
-            } else {
-                ret = 1;
-            }
-        } else {
-            bc_test(c, e.u.local, 0);
-        }
+        int pos = jmp_if_false(c, node, node->child[0], &e); // 跳出指令位置
         lgx_expr_result_cleanup(c, node, &e);
+        if (pos < 0) {
+            return 1;
+        }
 
         if (compiler_block_statement(c, node->child[1])) {
             return 1;
         }
 
-        bc_set_param_d(c, pos, c->bc.length - pos - 1);
+        bc_set_jump(c, pos, c->bc.length);
 
-        return ret;
+        return 0;
     }
 
     lgx_expr_result_cleanup(c, node, &e);
@@ -1911,19 +2353,11 @@ static int compiler_if_else_statement(lgx_compiler_t* c, lgx_ast_node_t *node) {
     if (check_variable(&e, T_BOOL)) {
         int ret = 0;
 
-        unsigned pos1 = c->bc.length; // 跳转指令位置
-        if (is_global(&e)) {
-            int r = load_to_reg(c, node, &e);
-            if (r >= 0) {
-                bc_test(c, r, 0);
-                reg_push(c, node, r);
-            } else {
-                ret = 1;
-            }
-        } else {
-            bc_test(c, e.u.local, 0);
-        }
+        int pos1 = jmp_if_false(c, node, node->child[0], &e); // 跳转指令位置
         lgx_expr_result_cleanup(c, node, &e);
+        if (pos1 < 0) {
+            return 1;
+        }
 
         if (compiler_block_statement(c, node->child[1])) {
             ret = 1;
@@ -1931,7 +2365,7 @@ static int compiler_if_else_statement(lgx_compiler_t* c, lgx_ast_node_t *node) {
 
         unsigned pos2 = c->bc.length; // 跳转指令位置
         bc_jmpi(c, 0);
-        bc_set_param_d(c, pos1, c->bc.length - pos1 - 1);
+        bc_set_jump(c, pos1, c->bc.length);
 
         if (node->child[2]->type == BLOCK_STATEMENT) {
             if (compiler_block_statement(c, node->child[2])) {
@@ -1985,7 +2419,7 @@ static int compiler_for_statement(lgx_compiler_t* c, lgx_ast_node_t *node) {
     int ret = 0;
 
     unsigned pos1 = c->bc.length; // 跳转指令位置
-    unsigned pos2 = 0; // 跳出指令位置
+    int pos2 = -1; // 跳出指令位置
 
     // exp2: 每次循环开始前执行一次，如果值为假，则跳出循环
     if (node->child[1]->children == 1) {
@@ -2001,19 +2435,11 @@ static int compiler_for_statement(lgx_compiler_t* c, lgx_ast_node_t *node) {
                 return 0;
             }
         } else if (check_variable(&e, T_BOOL)) {
-            pos2 = c->bc.length; 
-            if (is_global(&e)) {
-                int r = load_to_reg(c, node, &e);
-                if (r >= 0) {
-                    bc_test(c, r, 0);
-                    reg_push(c, node, r);
-                } else {
-                    ret = 1;
-                }
-            } else {
-                bc_test(c, e.u.local, 0);
-            }
+            pos2 = jmp_if_false(c, node, node->child[1]->child[0], &e);
             lgx_expr_result_cleanup(c, node, &e);
+            if (pos2 < 0) {
+                return 1;
+            }
         } else {
             lgx_type_t t;
             lgx_type_init(&t, T_BOOL);
@@ -2039,10 +2465,13 @@ static int compiler_for_statement(lgx_compiler_t* c, lgx_ast_node_t *node) {
         lgx_expr_result_cleanup(c, node, &e);
     }
 
-    bc_jmpi(c, pos1);
+    // 如果 exp3 为循环变量自增，则与跳转合并为一条指令
+    if (bc_fuse_loop(c, pos3, pos1)) {
+        bc_jmpi(c, pos1);
+    }
 
-    if (pos2) {
-        bc_set_param_d(c, pos2, c->bc.length - pos2 - 1);
+    if (pos2 >= 0) {
+        bc_set_jump(c, pos2, c->bc.length);
     }
 
     jmp_fix(c, node, pos3, c->bc.length);
@@ -2080,19 +2509,11 @@ static int compiler_while_statement(lgx_compiler_t* c, lgx_ast_node_t *node) {
             bc_jmpi(c, start);
         }
     } else if (check_variable(&e, T_BOOL)) {
-        unsigned pos = c->bc.length; // 循环跳出指令位置
-        if (is_global(&e)) {
-            int r = load_to_reg(c, node, &e);
-            if (r >= 0) {
-                bc_test(c, r, 0);
-                reg_push(c, node, r);
-            } else {
-                ret = 1;
-            }
-        } else {
-            bc_test(c, e.u.local, 0);
-        }
+        int pos = jmp_if_false(c, node, node->child[0], &e); // 循环跳出指令位置
         lgx_expr_result_cleanup(c, node, &e);
+        if (pos < 0) {
+            return 1;
+        }
 
         if (compiler_block_statement(c, node->child[1])) {
             return 1;
@@ -2101,7 +2522,7 @@ static int compiler_while_statement(lgx_compiler_t* c, lgx_ast_node_t *node) {
         // 写入无条件跳转
         bc_jmpi(c, start);
         // 更新条件跳转
-        bc_set_param_d(c, pos, c->bc.length - pos - 1);
+        bc_set_jump(c, pos, c->bc.length);
     } else {
         lgx_expr_result_cleanup(c, node, &e);
         lgx_type_t t;
@@ -2146,22 +2567,11 @@ static int compiler_do_statement(lgx_compiler_t* c, lgx_ast_node_t *node) {
             bc_jmpi(c, start);
         }
     } else if (check_variable(&e, T_BOOL)) {
-        unsigned pos = c->bc.length;
-        if (is_global(&e)) {
-            int r = load_to_reg(c, node, &e);
-            if (r >= 0) {
-                bc_test(c, r, 0);
-                reg_push(c, node, r);
-            } else {
-                ret = 1;
-            }
-        } else {
-            bc_test(c, e.u.local, 0);
+        // 条件为真时跳转到循环起始位置
+        if (jmp_if_true(c, node, node->child[1], &e, start)) {
+            ret = 1;
         }
-        bc_jmpi(c, start);
         lgx_expr_result_cleanup(c, node, &e);
-
-        bc_set_param_d(c, pos, c->bc.length - pos - 1);
     } else {
         lgx_type_t t;
         lgx_type_init(&t, T_BOOL);
@@ -2477,7 +2887,7 @@ static int compiler_return_statement(lgx_compiler_t* c, lgx_ast_node_t *node) {
                 ret = 1;
             }
         } else {
-            if (compiler_expression(c, node->child[0], &e)) {
+            if (compiler_expression_expect(c, node->child[0], &fun->ret, &e)) {
                 ret = 1;
             }
         }
@@ -2602,7 +3012,14 @@ static int compiler_global_variable_declaration(lgx_compiler_t* c, lgx_ast_node_
     assert(is_global(&e1));
 
     if (node->children > 2) {
-        if (compiler_expression(c, node->child[2], &e2)) {
+        if (is_map_literal(node->child[2], &e1.v_type)) {
+            // 全局的 map 在编译时直接创建
+            e2.type = EXPR_LITERAL;
+            if (lgx_type_dup(&e1.v_type, &e2.v_type)) {
+                compiler_error(c, node, "out of memory\n");
+                ret = 1;
+            }
+        } else if (compiler_expression(c, node->child[2], &e2)) {
             ret = 1;
         }
 
@@ -2677,7 +3094,7 @@ static int compiler_local_variable_declaration(lgx_compiler_t* c, lgx_ast_node_t
     assert(is_local(&e1));
 
     if (node->children > 2) {
-        if (compiler_expression(c, node->child[2], &e2)) {
+        if (compiler_expression_expect(c, node->child[2], &e1.v_type, &e2)) {
             ret = 1;
         }
 
@@ -2886,22 +3303,23 @@ static int compiler_function_declaration(lgx_compiler_t* c, lgx_ast_node_t *node
     assert(symbol);
     assert(symbol->s_type == S_CONSTANT);
     assert(symbol->type.type == T_FUNCTION);
-    assert(symbol->v.v.fun == NULL);
+    assert(lgx_value_fun(&symbol->v) == NULL);
 
-    symbol->v.v.fun = xcalloc(1, sizeof(lgx_function_t));
-    if (!symbol->v.v.fun) {
+    lgx_function_t* fun = xcalloc(1, sizeof(lgx_function_t));
+    if (!fun) {
         return 1;
     }
-    if (lgx_type_dup(&symbol->type, &symbol->v.v.fun->gc.type)) {
-        xfree(symbol->v.v.fun);
+    if (lgx_type_dup(&symbol->type, &fun->gc.type)) {
+        xfree(fun);
         return 1;
     }
-    if (lgx_str_init(&symbol->v.v.fun->name, name.length)) {
-        lgx_type_cleanup(&symbol->v.v.fun->gc.type);
-        xfree(symbol->v.v.fun);
+    if (lgx_str_init(&fun->name, name.length)) {
+        lgx_type_cleanup(&fun->gc.type);
+        xfree(fun);
         return 1;
     }
-    lgx_str_dup(&name, &symbol->v.v.fun->name);
+    lgx_str_dup(&name, &fun->name);
+    lgx_value_set_fun(&symbol->v, fun);
 
     int ret = 0;
 
@@ -2911,7 +3329,7 @@ static int compiler_function_declaration(lgx_compiler_t* c, lgx_ast_node_t *node
         lgx_reg_pop(node->u.regs);
     }
 
-    symbol->v.v.fun->addr = c->bc.length;
+    fun->addr = c->bc.length;
 
     // 编译语句
     if (compiler_block_statement(c, node->child[4])) {
@@ -2923,8 +3341,8 @@ static int compiler_function_declaration(lgx_compiler_t* c, lgx_ast_node_t *node
     // 写入一句 ret null
     bc_ret(c, 0);
 
-    symbol->v.v.fun->end = c->bc.length - 1;
-    symbol->v.v.fun->stack_size = node->u.regs->max + 1;
+    fun->end = c->bc.length - 1;
+    fun->stack_size = node->u.regs->max + 1;
 
     return ret;
 }
@@ -2994,7 +3412,7 @@ static int compiler(lgx_compiler_t* c, lgx_ast_node_t *node) {
         lgx_symbol_t *symbol = (lgx_symbol_t *)n->v;
         if (symbol->s_type == S_CONSTANT) {
             if (symbol->type.type == T_FUNCTION) {
-                lgx_const_update_function(&c->constant, symbol->v.v.fun);
+                lgx_const_update_function(&c->constant, lgx_value_fun(&symbol->v));
             }
         }
     }
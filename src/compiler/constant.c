@@ -52,7 +52,10 @@ int const_key(lgx_str_t* key, lgx_expr_result_t* e) {
                 return 1;
             }
             lgx_str_concat(&prefix, key);
-            lgx_str_concat(&e->v.str, key);
+            // 空字符串只有前缀
+            if (e->v.str.length) {
+                lgx_str_concat(&e->v.str, key);
+            }
             return 0;
         }
         case T_ARRAY:  {
@@ -119,8 +122,7 @@ int lgx_const_get_function(lgx_ht_t* ct, lgx_str_t* fun_name) {
         return -1;
     }
 
-    c->v.type = T_LONG;
-    c->v.v.l = c->num;
+    lgx_value_set_long(&c->v, c->num);
 
     if (lgx_ht_set(ct, &key, c)) {
         lgx_str_cleanup(&key);
@@ -149,8 +151,7 @@ int lgx_const_update_function(lgx_ht_t* ct, lgx_function_t* fun) {
     }
     
     lgx_const_t* c = (lgx_const_t*)n->v;
-    c->v.type = T_FUNCTION;
-    c->v.v.fun = fun;
+    lgx_value_set_fun(&c->v, fun);
 
     lgx_str_cleanup(&key);
 
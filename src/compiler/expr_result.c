@@ -1,70 +1,82 @@
 #include "expr_result.h"
 
 int lgx_expr_to_value(lgx_expr_result_t* e, lgx_value_t* v) {
-    v->type = e->v_type.type;
+    lgx_value_set_unknown(v);
 
-    switch (v->type) {
+    switch (e->v_type.type) {
     case T_LONG:
-        v->v.l = e->v.l;
+        lgx_value_set_long(v, e->v.l);
         break;
     case T_DOUBLE:
-        v->v.d = e->v.d;
+        lgx_value_set_double(v, e->v.d);
         break;
     case T_BOOL:
-        v->v.l = e->v.l;
+        lgx_value_set_bool(v, e->v.l);
         break;
-    case T_STRING:
-        v->v.str = lgx_string_new();
-        if (!v->v.str) {
+    case T_STRING: {
+        // 字符串字面量全部驻留，相同内容的字面量共享同一个字符串
+        lgx_string_t* str = lgx_string_intern(&e->v.str);
+        if (!str) {
             return 1;
         }
-        if (lgx_type_dup(&e->v_type, &v->v.str->gc.type)) {
-            xfree(v->v.str);
-            v->v.str = NULL;
-            return 1;
-        }
-        if (lgx_str_init(&v->v.str->string, e->v.str.length)) {
-            lgx_type_cleanup(&v->v.str->gc.type);
-            xfree(v->v.str);
-            v->v.str = NULL;
-            return 1;
-        }
-        lgx_str_dup(&e->v.str, &v->v.str->string);
+        lgx_value_set_str(v, str);
         break;
+    }
     case T_ARRAY: {
-        v->v.arr = lgx_array_new();
-        if (!v->v.arr) {
+        lgx_array_t* arr = lgx_array_new();
+        if (!arr) {
             return 1;
         }
-        if (lgx_type_dup(&e->v_type, &v->v.arr->gc.type)) {
-            xfree(v->v.arr);
-            v->v.arr = NULL;
+        if (lgx_type_dup(&e->v_type, &arr->gc.type)) {
+            xfree(arr);
             return 1;
         }
-        if (lgx_ht_init(&v->v.arr->table, e->v.arr.length)) {
-            lgx_type_cleanup(&v->v.arr->gc.type);
-            xfree(v->v.arr);
-            v->v.arr = NULL;
+        if (lgx_array_init(arr, e->v.arr.length)) {
+            lgx_type_cleanup(&arr->gc.type);
+            xfree(arr);
             return 1;
         }
+        lgx_value_set_arr(v, arr);
         lgx_ht_node_t* n;
         for (n = lgx_ht_first(&e->v.arr); n; n = lgx_ht_next(n)) {
-            lgx_value_t* val = xcalloc(1, sizeof(lgx_value_t));
-            if (!val) {
+            lgx_value_t val;
+            if (lgx_value_dup((lgx_value_t*)n->v, &val)) {
+                lgx_value_cleanup(v);
+                lgx_value_set_unknown(v);
                 return 1;
             }
-            if (lgx_value_dup((lgx_value_t*)n->v, val)) {
-                xfree(v);
-                return 1;
+            // 整数下标以 8 字节的二进制保存在键中
+            int ret;
+            if (n->k.length == sizeof(long long)) {
+                long long num;
+                memcpy(&num, n->k.buffer, sizeof(num));
+                ret = lgx_array_set_long(arr, num, &val);
+            } else {
+                ret = lgx_array_set_str(arr, &n->k, n->hash, &val);
             }
-            if (lgx_ht_set(&v->v.arr->table, &n->k, val)) {
+            if (ret) {
+                lgx_value_cleanup(&val);
                 lgx_value_cleanup(v);
-                xfree(v);
+                lgx_value_set_unknown(v);
                 return 1;
             }
         }
         break;
     }
+    case T_MAP: {
+        // map 只有空的字面量
+        lgx_map_t* map = lgx_map_new();
+        if (!map) {
+            return 1;
+        }
+        if (lgx_type_dup(&e->v_type, &map->gc.type) || lgx_map_init(map, e->v_type.u.map->key.type, 0)) {
+            lgx_map_cleanup(map);
+            xfree(map);
+            return 1;
+        }
+        lgx_value_set_map(v, map);
+        break;
+    }
     // TODO 其他类型
     default:
         return 1;
@@ -73,51 +85,72 @@ int lgx_expr_to_value(lgx_expr_result_t* e, lgx_value_t* v) {
     return 0;
 }
 
+static int value_to_expr_element(lgx_expr_result_t* e, lgx_str_t* k, lgx_value_t* v) {
+    lgx_value_t* val = xcalloc(1, sizeof(lgx_value_t));
+    if (!val) {
+        return 1;
+    }
+    if (lgx_value_dup(v, val)) {
+        xfree(val);
+        return 1;
+    }
+    if (lgx_ht_set(&e->v.arr, k, val)) {
+        lgx_value_cleanup(val);
+        xfree(val);
+        return 1;
+    }
+    return 0;
+}
+
 int lgx_value_to_expr(lgx_value_t* v, lgx_expr_result_t* e) {
     e->type = EXPR_LITERAL;
     
-    switch (v->type) {
+    switch (lgx_value_type(v)) {
         case T_LONG:
             e->v_type.type = T_LONG;
-            e->v.l = v->v.l;
+            e->v.l = lgx_value_long(v);
             break;
         case T_DOUBLE:
             e->v_type.type = T_DOUBLE;
-            e->v.d = v->v.d;
+            e->v.d = lgx_value_double(v);
             break;
         case T_BOOL:
             e->v_type.type = T_BOOL;
-            e->v.l = v->v.l;
+            e->v.l = lgx_value_bool(v);
             break;
         case T_STRING:
             e->v_type.type = T_STRING;
-            if (lgx_str_init(&e->v.str, v->v.str->string.length)) {
+            if (lgx_str_init(&e->v.str, lgx_value_str(v)->string.length)) {
                 return 1;
             }
-            lgx_str_dup(&v->v.str->string, &e->v.str);
+            lgx_str_dup(&lgx_value_str(v)->string, &e->v.str);
             break;
         case T_ARRAY:
-            if (lgx_type_dup(&v->v.arr->gc.type, &e->v_type)) {
+            if (lgx_type_dup(&lgx_value_arr(v)->gc.type, &e->v_type)) {
                 return 1;
             }
-            if (lgx_ht_init(&e->v.arr, v->v.arr->table.length)) {
+            if (lgx_ht_init(&e->v.arr, lgx_array_length(lgx_value_arr(v)))) {
                 lgx_type_cleanup(&e->v_type);
                 return 1;
             }
-            lgx_ht_node_t* n;
-            for (n = lgx_ht_first(&v->v.arr->table); n; n = lgx_ht_next(n)) {
-                lgx_value_t* val = xcalloc(1, sizeof(lgx_value_t));
-                if (!val) {
-                    return 1;
-                }
-                if (lgx_value_dup((lgx_value_t*)n->v, val)) {
-                    xfree(v);
-                    return 1;
+            if (lgx_array_is_packed(lgx_value_arr(v))) {
+                unsigned i;
+                for (i = 0; i < lgx_value_arr(v)->length; i ++) {
+                    lgx_str_t key;
+                    long long num = i;
+                    lgx_array_key(&key, &num);
+                    lgx_value_t val;
+                    lgx_array_packed_get(lgx_value_arr(v), i, &val);
+                    if (value_to_expr_element(e, &key, &val)) {
+                        return 1;
+                    }
                 }
-                if (lgx_ht_set(&e->v.arr, &n->k, val)) {
-                    lgx_value_cleanup(v);
-                    xfree(v);
-                    return 1;
+            } else {
+                lgx_ht_node_t* n;
+                for (n = lgx_ht_first(&lgx_value_arr(v)->table); n; n = lgx_ht_next(n)) {
+                    if (value_to_expr_element(e, &n->k, (lgx_value_t*)n->v)) {
+                        return 1;
+                    }
                 }
             }
             break;
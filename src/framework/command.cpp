@@ -7,6 +7,12 @@ void command::init(int argc, char* argv[]) {
         {"config", required_argument, NULL, 'c'},
         {"env", required_argument, NULL, 'e'},
         {"daemon", no_argument, NULL, 'd'},
+        {"run", no_argument, NULL, 'r'},
+        {"stat", no_argument, NULL, 's'},
+        {"optimize", required_argument, NULL, 'O'},
+        {"jit", required_argument, NULL, 'j'},
+        {"trace", required_argument, NULL, 't'},
+        {"pause", required_argument, NULL, 'p'},
         {"help", no_argument, NULL, 'h'},
         {"version", no_argument, NULL, 'v'},
         {NULL, no_argument, NULL, 0}
@@ -15,7 +21,7 @@ void command::init(int argc, char* argv[]) {
     int c;
     int oi = -1;
     if(argv == NULL) return;
-    while((c = getopt_long(argc, argv, ":c:e:dvh", long_options, &oi)) != -1){
+    while((c = getopt_long(argc, argv, ":c:e:drsO:j:t:p:vh", long_options, &oi)) != -1){
         switch(c) {
         case 'c':
             fprintf(stderr, "-%c %s\n", c, optarg);
@@ -26,8 +32,46 @@ void command::init(int argc, char* argv[]) {
         case 'd':
             fprintf(stderr, "-%c\n", c);
             break;
+        case 'r':
+            run = true;
+            break;
+        case 's':
+            stat = true;
+            break;
+        case 'O':
+            optimize = atoi(optarg);
+            if (optimize < 0 || optimize > 2) {
+                fprintf(stderr, "%s: invalid optimization level '%s'\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case 'j':
+            jit = atoi(optarg);
+            if (jit < 0) {
+                fprintf(stderr, "%s: invalid jit threshold '%s'\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case 't':
+            trace = atoi(optarg);
+            if (trace < 0) {
+                fprintf(stderr, "%s: invalid trace threshold '%s'\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case 'p':
+            pause = atoi(optarg);
+            if (pause < 0) {
+                fprintf(stderr, "%s: invalid gc pause target '%s'\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
         case 'v':
+#ifdef LGX_VALUE_NAN_BOXING
+            fprintf(stderr, "xscript " _VERSION_MAJOR_ "." _VERSION_MINOR_ "." _VERSION_MICRO_ " (built: " _TIMESTAMP_ ", nan-boxing)\n");
+#else
             fprintf(stderr, "xscript " _VERSION_MAJOR_ "." _VERSION_MINOR_ "." _VERSION_MICRO_ " (built: " _TIMESTAMP_ ")\n");
+#endif
             exit(1);
             break;
         case 'h':
@@ -55,11 +99,41 @@ const std::vector<std::string>& command::get_source_files() {
     return source_files;
 }
 
+bool command::is_run() {
+    return run;
+}
+
+bool command::is_stat() {
+    return stat;
+}
+
+int command::get_optimize_level() {
+    return optimize;
+}
+
+int command::get_jit_threshold() {
+    return jit;
+}
+
+int command::get_trace_threshold() {
+    return trace;
+}
+
+int command::get_gc_pause() {
+    return pause;
+}
+
 void command::show_help() {
     fprintf(stderr, "Usage: xscript source_file [options]\n");
     fprintf(stderr, "    -c --config   file_path\n");
     fprintf(stderr, "    -e --env      name=value\n");
     fprintf(stderr, "    -d --daemon\n");
+    fprintf(stderr, "    -r --run\n");
+    fprintf(stderr, "    -s --stat\n");
+    fprintf(stderr, "    -O --optimize level (0-2, default 2)\n");
+    fprintf(stderr, "    -j --jit      threshold (calls before a function is compiled, 0 disables JIT, default 1000)\n");
+    fprintf(stderr, "    -t --trace    threshold (iterations before a loop is traced, 0 disables tracing, default 50)\n");
+    fprintf(stderr, "    -p --pause    microseconds (GC pause target, 0 runs a full GC at once, default 1000)\n");
     fprintf(stderr, "    -v --version\n");
     fprintf(stderr, "    -h --help\n");
     exit(1);
@@ -14,12 +14,37 @@ class command : public util::singleton<command> {
 private:
     std::vector<std::string> source_files;
 
+    // 使用字节码解释器执行源文件
+    bool run = false;
+
+    // 输出执行统计信息
+    bool stat = false;
+
+    // 字节码优化级别
+    int optimize = 2;
+
+    // 函数调用次数达到该阈值时编译为机器码，为 0 时关闭 JIT
+    int jit = 1000;
+
+    // 循环执行次数达到该阈值时记录并编译 trace，为 0 时关闭 trace
+    int trace = 50;
+
+    // 单次 GC 暂停时间的目标（微秒），为 0 时一次完成 Full GC
+    int pause = 1000;
+
 public:
     void init(int argc, char* argv[]);
 
     void show_help();
     
     const std::vector<std::string>& get_source_files();
+
+    bool is_run();
+    bool is_stat();
+    int get_optimize_level();
+    int get_jit_threshold();
+    int get_trace_threshold();
+    int get_gc_pause();
 };
 
 }
@@ -7,7 +7,7 @@
 
 #define LGX_MAX_STACK_SIZE (256 << 8)
 
-#define check_type(e, t)     ((e)->type == t)
+#define check_type(e, t)     (lgx_value_type(e) == t)
 
 int lgx_co_stack_init(lgx_co_stack_t *stack, unsigned size) {
     stack->size = size;
@@ -31,30 +31,26 @@ int lgx_co_stack_cleanup(lgx_co_stack_t *stack) {
 int lgx_co_set(lgx_co_t *co, unsigned pos, lgx_value_t *v) {
     assert(pos < co->stack.size);
 
-    co->stack.buf[pos].type = v->type;
-    co->stack.buf[pos].v = v->v;
+    co->stack.buf[pos] = *v;
 
     return 0;
 }
 
 int lgx_co_set_long(lgx_co_t *co, unsigned pos, long long l) {
     lgx_value_t v;
-    v.type = T_LONG;
-    v.v.l = l;
+    lgx_value_set_long(&v, l);
     return lgx_co_set(co, pos, &v);
 }
 
 int lgx_co_set_function(lgx_co_t *co, unsigned pos, lgx_function_t *fun) {
     lgx_value_t v;
-    v.type = T_FUNCTION;
-    v.v.fun = fun;
+    lgx_value_set_fun(&v, fun);
     return lgx_co_set(co, pos, &v);
 }
 
 int lgx_co_set_string(lgx_co_t *co, unsigned pos, lgx_string_t *str) {
     lgx_value_t v;
-    v.type = T_STRING;
-    v.v.str = str;
+    lgx_value_set_str(&v, str);
     return lgx_co_set(co, pos, &v);
 }
 
@@ -274,77 +270,76 @@ int lgx_co_return(lgx_co_t *co, lgx_value_t *v) {
     assert(check_type(&co->stack.buf[co->stack.base], T_FUNCTION));
 
     // 参数起始地址
-    int base = co->stack.base + co->stack.buf[co->stack.base].v.fun->stack_size;
+    int base = co->stack.base + lgx_value_fun(&co->stack.buf[co->stack.base])->stack_size;
 
     assert(check_type(&co->stack.buf[base], T_FUNCTION));
 
     // 返回值地址
-    int ret = co->stack.buf[base + 1].v.l;
+    int ret = lgx_value_long(&co->stack.buf[base + 1]);
 
     // 写入返回值
     co->stack.buf[co->stack.base + ret] = *v;    
 
     // 释放函数栈
     int n;
-    int size = co->stack.buf[base].v.fun->stack_size;
+    int size = lgx_value_fun(&co->stack.buf[base])->stack_size;
     for (n = 0; n < size; n ++) {
-        co->stack.buf[base + n].type = T_UNKNOWN;
+        lgx_value_set_unknown(&co->stack.buf[base + n]);
     }
 
     return 0;
 }
 
 int lgx_co_return_long(lgx_co_t *co, long long v) {
+    if (UNEXPECTED(!lgx_long_fits(v))) {
+        lgx_co_throw_s(co, "integer overflow");
+        return 1;
+    }
+
     lgx_value_t ret;
-    ret.type = T_LONG;
-    ret.v.l = v;
+    lgx_value_set_long(&ret, v);
 
     return lgx_co_return(co, &ret);
 }
 
 int lgx_co_return_double(lgx_co_t *co, double v) {
     lgx_value_t ret;
-    ret.type = T_DOUBLE;
-    ret.v.d = v;
+    lgx_value_set_double(&ret, v);
 
     return lgx_co_return(co, &ret);
 }
 
 int lgx_co_return_true(lgx_co_t *co) {
     lgx_value_t ret;
-    ret.type = T_BOOL;
-    ret.v.d = 1;
+    lgx_value_set_bool(&ret, 1);
 
     return lgx_co_return(co, &ret);
 }
 
 int lgx_co_return_false(lgx_co_t *co) {
     lgx_value_t ret;
-    ret.type = T_BOOL;
-    ret.v.d = 0;
+    lgx_value_set_bool(&ret, 0);
 
     return lgx_co_return(co, &ret);
 }
 
 int lgx_co_return_void(lgx_co_t *co) {
     lgx_value_t ret;
-    ret.type = T_UNKNOWN;
+    lgx_value_set_unknown(&ret);
 
     return lgx_co_return(co, &ret);
 }
 
 int lgx_co_return_string(lgx_co_t *co, lgx_string_t *str) {
     lgx_value_t ret;
-    ret.type = T_STRING;
-    ret.v.str = str;
+    lgx_value_set_str(&ret, str);
 
     return lgx_co_return(co, &ret);
 }
 
 int lgx_co_return_array(lgx_co_t *co, lgx_array_t *arr) {
     lgx_value_t ret;
-    ret.type = T_ARRAY;
-    ret.v.arr = arr;
+    lgx_value_set_arr(&ret, arr);
 
     return lgx_co_return(co, &ret);
 }
@@ -355,18 +350,34 @@ int lgx_co_backtrace(lgx_co_t *co) {
     int i = 0;
 
     while (base >= 0) {
-        lgx_function_t* fun = co->stack.buf[base].v.fun;
+        lgx_function_t* fun = lgx_value_fun(&co->stack.buf[base]);
 
         printf("#%d %.*s()\n", i, fun->name.length, fun->name.buffer);
 
         ++i;
 
-        base = co->stack.buf[base+3].v.l;
+        base = lgx_value_long(&co->stack.buf[base+3]);
     }
 
     return 0;
 }
 
+// 从 from 开始沿调用链释放栈帧中的所有局部变量和临时变量，直到 to 为止（不含 to）
+static void co_release(lgx_co_t *co, long long from, long long to) {
+    while (from != to) {
+        lgx_value_t *regs = co->stack.buf + from;
+
+        // 释放后不能再读取寄存器的值，所以先读出上一个栈帧的位置与栈帧大小
+        long long prev = lgx_value_long(&regs[3]);
+        int n, size = lgx_value_fun(&regs[0])->stack_size;
+        for (n = 0; n < size; n ++) {
+            lgx_value_set_unknown(&regs[n]);
+        }
+
+        from = prev;
+    }
+}
+
 void lgx_co_throw(lgx_co_t *co, lgx_value_t *e) {
     unsigned pc = co->pc - 1;
     long long base = co->stack.base;
@@ -388,8 +399,8 @@ void lgx_co_throw(lgx_co_t *co, lgx_value_t *e) {
                 // 匹配参数类型符合的 catch block
                 lgx_exception_block_t *b;
                 lgx_list_for_each_entry(b, lgx_exception_block_t, &exception->catch_blocks, head) {
-                    if (b->e.type == e->type) {
-                        switch (e->type) {
+                    if (b->e.type == lgx_value_type(e)) {
+                        switch (lgx_value_type(e)) {
                             case T_LONG:
                             case T_DOUBLE:
                             case T_BOOL:
@@ -417,6 +428,7 @@ void lgx_co_throw(lgx_co_t *co, lgx_value_t *e) {
 
             // 把异常变量写入到 catch block 的参数中
             //printf("%d\n",block->e->u.symbol.reg_num);
+            co_release(co, co->stack.base, base);
             co->stack.base = base;
             co->stack.buf[co->stack.base + block->reg] = *e;
 
@@ -429,18 +441,12 @@ void lgx_co_throw(lgx_co_t *co, lgx_value_t *e) {
             assert(check_type(&regs[2], T_LONG));
             assert(check_type(&regs[3], T_LONG));
 
-            if (regs[2].v.l >= 0) {
-                // 释放所有局部变量和临时变量
-                int n;
-                for (n = 0; n < regs[0].v.fun->stack_size; n ++) {
-                    regs[n].type = T_UNKNOWN;
-                }
-
+            if (lgx_value_long(&regs[2]) >= 0) {
                 // 切换执行堆栈
-                base = regs[3].v.l;
+                base = lgx_value_long(&regs[3]);
 
                 // 在函数调用点重新抛出异常
-                pc = regs[2].v.l - 1;
+                pc = lgx_value_long(&regs[2]) - 1;
             } else {
                 // 遍历调用栈依然未能找到匹配的 catch 块，退出当前协程
                 printf("[uncaught exception] ");
@@ -451,7 +457,8 @@ void lgx_co_throw(lgx_co_t *co, lgx_value_t *e) {
 
                 lgx_co_backtrace(co);
 
-                co->pc = regs[0].v.fun->end;
+                co_release(co, co->stack.base, base);
+                co->pc = lgx_value_fun(&regs[0])->end;
                 co->stack.base = base;
 
                 return;
@@ -461,20 +468,27 @@ void lgx_co_throw(lgx_co_t *co, lgx_value_t *e) {
 }
 
 void lgx_co_throw_s(lgx_co_t *co, const char *fmt, ...) {
-    char *buf = (char *)xmalloc(128);
+    char buf[128];
 
     va_list args;
     va_start(args, fmt);
-    int len = vsnprintf(buf, 128, fmt, args);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
     va_end(args);
 
+    if (len < 0) {
+        len = 0;
+    } else if (len >= (int)sizeof(buf)) {
+        len = sizeof(buf) - 1;
+    }
+
+    lgx_string_t *str = lgx_string_create(buf, len);
+    if (!str) {
+        return;
+    }
+    str->gc.type.type = T_STRING;
+
     lgx_value_t e;
-    e.type = T_STRING;
-    e.v.str = xcalloc(1, sizeof(lgx_string_t));
-    e.v.str->gc.type.type = T_STRING;
-    e.v.str->string.length = len;
-    e.v.str->string.size = 128;
-    e.v.str->string.buffer = buf;
+    lgx_value_set_str(&e, str);
 
     lgx_gc_trace(co->vm, &e);
 
@@ -486,7 +500,7 @@ void lgx_co_throw_v(lgx_co_t *co, lgx_value_t *v) {
     e = *v;
 
     // 把原始变量标记为 undefined，避免 exception 值被释放
-    v->type = T_UNKNOWN;
+    lgx_value_set_unknown(v);
 
     lgx_co_throw(co, &e);
 }
@@ -498,12 +512,12 @@ int lgx_co_checkstack(lgx_co_t *co, unsigned int stack_size) {
 
     assert(check_type(&regs[0], T_FUNCTION));
 
-    if (stack->base + regs[0].v.fun->stack_size + stack_size < stack->size) {
+    if (stack->base + lgx_value_fun(&regs[0])->stack_size + stack_size < stack->size) {
         return 0;
     }
 
     unsigned int size = stack->size;
-    while (stack->base + regs[0].v.fun->stack_size + stack_size >= size) {
+    while (stack->base + lgx_value_fun(&regs[0])->stack_size + stack_size >= size) {
         size *= 2;
     }
 
@@ -1,3 +1,4 @@
+#include <time.h>
 #include "../common/common.h"
 #include "value.h"
 #include "gc.h"
@@ -10,116 +11,743 @@ void lgx_gc_disable(lgx_vm_t *vm) {
     vm->gc_enable = 0;
 }
 
-static int gc_size(lgx_gc_t *gc) {
+static size_t ht_size(lgx_ht_t *ht) {
+    if (!ht->size) {
+        return 0;
+    }
+    return ht->size * sizeof(lgx_ht_slot_t) + (ht->size / 2 + 1) * sizeof(lgx_ht_node_t) +
+        ht->length * sizeof(lgx_value_t);
+}
+
+// 对象自身占用的内存，不包括保存在容器中的其它 GC 对象
+size_t lgx_gc_size(lgx_gc_t *gc) {
+    switch (gc->type.type) {
+        case T_STRING: {
+            lgx_string_t *str = (lgx_string_t*)gc;
+            size_t size = sizeof(lgx_string_t);
+            if (str->builder) {
+                // 共享的缓冲区由最后一个持有者计算
+                if (!str->builder->ref_cnt) {
+                    size += sizeof(lgx_string_buffer_t) + str->builder->size;
+                }
+            } else if (str->string.buffer == str->data) {
+                size += str->string.length;
+            } else {
+                size += str->string.size;
+            }
+            return size;
+        }
+        case T_ARRAY: {
+            lgx_array_t *arr = (lgx_array_t*)gc;
+            // 写时复制共享的存储不重复计算
+            if (arr->shared && *arr->shared) {
+                return sizeof(lgx_array_t);
+            }
+            if (lgx_array_is_packed(arr)) {
+                return sizeof(lgx_array_t) + (size_t)arr->size *
+                    (arr->kind == T_UNKNOWN ? sizeof(lgx_value_t) : sizeof(long long));
+            }
+            return sizeof(lgx_array_t) + ht_size(&arr->table);
+        }
+        case T_MAP: {
+            lgx_map_t *map = (lgx_map_t*)gc;
+            if (map->shared && *map->shared) {
+                return sizeof(lgx_map_t);
+            }
+            if (map->ordered) {
+                return sizeof(lgx_map_t) + (size_t)map->tree.size * (sizeof(lgx_rb_node_t) + sizeof(lgx_value_t));
+            }
+            return sizeof(lgx_map_t) + ht_size(&map->table);
+        }
+        case T_FUNCTION:
+            return sizeof(lgx_function_t) + ((lgx_function_t*)gc)->name.size;
+        default:
+            return sizeof(lgx_gc_t);
+    }
+}
+
+// 寄存器只保存对象的指针而不持有对象，对象被容器覆盖或者释放后寄存器中可能残留悬空指针，
+// 所以标记时只比较地址，不访问根指向的内容。残留的地址最多导致对象晚一些被回收
+static lgx_inline size_t roots_hash(lgx_gc_roots_t *roots, lgx_gc_t *gc) {
+    return (((uintptr_t)gc >> 4) * 0x9E3779B97F4A7C15ULL >> 32) & (roots->size - 1);
+}
+
+static void roots_add(lgx_gc_roots_t *roots, lgx_gc_t *gc) {
+    size_t pos = roots_hash(roots, gc);
+    while (roots->slots[pos]) {
+        if (roots->slots[pos] == gc) {
+            return;
+        }
+        pos = (pos + 1) & (roots->size - 1);
+    }
+    roots->slots[pos] = gc;
+}
+
+static int roots_has(lgx_gc_roots_t *roots, lgx_gc_t *gc) {
+    size_t pos = roots_hash(roots, gc);
+    while (roots->slots[pos]) {
+        if (roots->slots[pos] == gc) {
+            return 1;
+        }
+        pos = (pos + 1) & (roots->size - 1);
+    }
     return 0;
 }
 
-static int full_gc(lgx_vm_t *vm) {
-    // TODO
-    printf("[full gc]\n");
+// slots 为 NULL 时只统计根的数量
+static void roots_scan_value(lgx_gc_roots_t *roots, lgx_value_t *v) {
+    if (!IS_GC_VALUE(v)) {
+        return;
+    }
+    if (roots->slots) {
+        roots_add(roots, lgx_value_gc(v));
+    } else {
+        roots->length ++;
+    }
+}
+
+static void roots_scan(lgx_gc_roots_t *roots, lgx_value_t *values, size_t length) {
+    size_t i;
+    for (i = 0; i < length; i ++) {
+        roots_scan_value(roots, &values[i]);
+    }
+}
+
+// 只扫描协程中仍然有效的栈帧：从栈底到当前栈帧，再加上当前栈帧之后的参数区
+// （CALL_SET 写入的参数，以及正在执行的内建函数的参数），其大小不超过一个栈帧的寄存器个数。
+// 更高的位置只可能残留已经返回的栈帧中的值，不作为根
+static void roots_scan_stack(lgx_gc_roots_t *roots, lgx_co_t *co) {
+    lgx_co_stack_t *stack = &co->stack;
+    size_t top = stack->size;
+
+    if (lgx_value_type(&stack->buf[stack->base]) == T_FUNCTION) {
+        top = stack->base + lgx_value_fun(&stack->buf[stack->base])->stack_size + LGX_GC_CALL_AREA;
+        if (top > stack->size) {
+            top = stack->size;
+        }
+    }
+
+    roots_scan(roots, stack->buf, top);
+}
+
+static void roots_scan_co(lgx_gc_roots_t *roots, lgx_list_t *list) {
+    lgx_list_t *pos;
+    lgx_list_for_each(pos, list) {
+        roots_scan_stack(roots, lgx_list_entry(pos, lgx_co_t, head));
+    }
+}
 
-    // TODO 遍历新生代、老年代，进行一遍标记
+// 扫描所有未结束的协程的有效栈帧、全局变量与常量表
+// 已经结束的协程（co_died）不会再执行，栈中的值不再被引用
+static void roots_visit(lgx_vm_t *vm, lgx_gc_roots_t *roots) {
+    if (vm->co_running) {
+        roots_scan_stack(roots, vm->co_running);
+    }
+    roots_scan_co(roots, &vm->co_ready);
+    roots_scan_co(roots, &vm->co_suspend);
+    roots_scan(roots, vm->global, vm->global_length);
 
-    // TODO 遍历新生代，执行清除
+    unsigned i;
+    for (i = 0; i < vm->constant_length; i ++) {
+        roots_scan_value(roots, vm->constant[i]);
+    }
+}
 
-    // TODO 遍历老年代，执行清除、压缩
+// 复用上一次分配的槽位，避免每次 GC 都申请大块内存
+static int roots_init(lgx_vm_t *vm, lgx_gc_roots_t *roots) {
+    roots->length = 0;
+    lgx_gc_t **slots = roots->slots;
+    roots->slots = NULL;
+    roots_visit(vm, roots);
+
+    roots->size = roots->length > 8 ? ALIGN(roots->length * 2) : 16;
+    if (roots->size > roots->capacity) {
+        xfree(slots);
+        slots = xmalloc(roots->size * sizeof(lgx_gc_t*));
+        if (!slots) {
+            roots->capacity = 0;
+            return 1;
+        }
+        roots->capacity = roots->size;
+    }
+    memset(slots, 0, roots->size * sizeof(lgx_gc_t*));
+    roots->slots = slots;
+    roots_visit(vm, roots);
 
-    return 1;
+    return 0;
 }
 
-static int minor_gc(lgx_vm_t *vm) {
-    //int cnt = 0;
+static unsigned long long gc_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
 
-    lgx_list_t *list = vm->heap.young.next;
-    while(list != &vm->heap.young) {
-        lgx_list_t *next = list->next;
-        lgx_list_del(list);
-        
-        switch (((lgx_gc_t*)list)->type.type) {
-            case T_STRING: {
-                /*
-                if (((lgx_gc_t*)list)->ref_cnt == 0) {
-                    xfree(list);
-                } else {
-                    lgx_list_add_tail(list, &vm->heap.old);
+// 加入老年代。Full GC 期间加入的对象不在快照中，标记为黑色，本轮不会被清除；
+// 其它时候标记的颜色会在下一轮开始时成为白色
+static void gc_link_old(lgx_vm_t *vm, lgx_gc_t *gc) {
+    gc->color = vm->heap.black;
+    lgx_list_add_tail(&gc->head, &vm->heap.old);
+    vm->heap.old_size += lgx_gc_size(gc);
+}
 
-                    vm->heap.old_size += gc_size((lgx_gc_t*)list);
+static void gc_detach(lgx_vm_t *vm, lgx_gc_t *gc, lgx_gc_roots_t *roots);
 
-                    cnt ++;
+// 寄存器可能引用着容器中的元素（例如 ARRAY_GET 的结果）。释放容器前，
+// 把仍然被根引用的元素从容器中取出，改为由老年代持有。
+// 被其它持有者共享的元素在这里减少引用计数，剩余的元素只被该容器持有
+static void gc_detach_value(lgx_vm_t *vm, lgx_value_t *v, lgx_gc_roots_t *roots) {
+    if (!IS_GC_VALUE(v)) {
+        return;
+    }
+    if (lgx_value_type(v) == T_STRING && lgx_value_str(v)->interned) {
+        return;
+    }
+
+    lgx_gc_t *gc = lgx_value_gc(v);
+    if (!gc->head.next && roots_has(roots, gc)) {
+        gc_link_old(vm, gc);
+    } else if (gc->ref_cnt) {
+        -- gc->ref_cnt;
+    } else {
+        gc_detach(vm, gc, roots);
+        return;
+    }
+    lgx_value_set_unknown(v);
+}
+
+// 处理即将被释放的对象中与其它对象共享的部分
+static void gc_detach(lgx_vm_t *vm, lgx_gc_t *gc, lgx_gc_roots_t *roots) {
+    switch (gc->type.type) {
+        case T_STRING:
+            lgx_string_drop_builder((lgx_string_t*)gc);
+            break;
+        case T_ARRAY: {
+            lgx_array_t *arr = (lgx_array_t*)gc;
+            // 存储仍然被其它数组共享时，元素不会随该数组释放
+            lgx_array_drop_shared(arr);
+            if (lgx_array_is_packed(arr)) {
+                if (arr->kind == T_UNKNOWN) {
+                    unsigned i;
+                    for (i = 0; i < arr->length; i ++) {
+                        gc_detach_value(vm, &arr->values[i], roots);
+                    }
                 }
-                */
-                break;
+            } else {
+                lgx_ht_node_t *n;
+                for (n = lgx_ht_first(&arr->table); n; n = lgx_ht_next(n)) {
+                    gc_detach_value(vm, (lgx_value_t*)n->v, roots);
+                }
+            }
+            break;
+        }
+        case T_MAP: {
+            lgx_map_drop_shared((lgx_map_t*)gc);
+            lgx_map_iter_t it;
+            memset(&it, 0, sizeof(it));
+            while (!lgx_map_next((lgx_map_t*)gc, &it)) {
+                gc_detach_value(vm, it.v, roots);
             }
-            case T_ARRAY: {
-                /*
-                if (((lgx_gc_t*)list)->ref_cnt == 0) {
-                    lgx_hash_delete((lgx_hash_t *)list);
-                } else {
-                    lgx_list_add_tail(list, &vm->heap.old);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// 释放链表中的对象，返回释放的数量
+static size_t gc_release_list(lgx_gc_t *list) {
+    size_t n = 0;
+    while (list) {
+        lgx_gc_t *next = (lgx_gc_t*)list->head.next;
+        lgx_gc_cleanup(list);
+        xfree(list);
+        list = next;
+        n ++;
+    }
+    return n;
+}
+
+static void* gc_thread(void *arg) {
+    lgx_vm_t *vm = (lgx_vm_t*)arg;
+
+    pthread_mutex_lock(&vm->heap.free.lock);
+    for (;;) {
+        while (!vm->heap.free.queue && !vm->heap.free.stop) {
+            pthread_cond_wait(&vm->heap.free.cond, &vm->heap.free.lock);
+        }
+        if (!vm->heap.free.queue) {
+            break;
+        }
+
+        lgx_gc_t *list = vm->heap.free.queue;
+        vm->heap.free.queue = NULL;
+        pthread_mutex_unlock(&vm->heap.free.lock);
+
+        size_t n = gc_release_list(list);
 
-                    vm->heap.old_size += ((lgx_gc_t*)list)->size;
+        pthread_mutex_lock(&vm->heap.free.lock);
+        vm->heap.free.pending -= n;
+    }
+    pthread_mutex_unlock(&vm->heap.free.lock);
+
+    return NULL;
+}
+
+static int gc_thread_start(lgx_vm_t *vm) {
+    if (pthread_mutex_init(&vm->heap.free.lock, NULL)) {
+        return 1;
+    }
+    if (pthread_cond_init(&vm->heap.free.cond, NULL)) {
+        pthread_mutex_destroy(&vm->heap.free.lock);
+        return 1;
+    }
+    vm->heap.free.stop = 0;
+    vm->heap.free.queue = NULL;
+    vm->heap.free.pending = 0;
+    if (pthread_create(&vm->heap.free.thread, NULL, gc_thread, vm)) {
+        pthread_cond_destroy(&vm->heap.free.cond);
+        pthread_mutex_destroy(&vm->heap.free.lock);
+        return 1;
+    }
+    vm->heap.free.running = 1;
+    return 0;
+}
+
+// 把本次 GC 收集的对象交给后台线程。后台线程积压过多时在当前线程中释放
+static void gc_flush(lgx_vm_t *vm) {
+#ifndef LGX_SYSTEM_MALLOC
+    // 后台线程释放的内存块由当前线程分配，回收之前批次中已经释放的部分
+    lgx_mem_collect();
+#endif
+
+    lgx_gc_t *batch = vm->heap.free.batch;
+    if (!batch) {
+        return;
+    }
+    vm->heap.free.batch = NULL;
+
+    if (vm->heap.free.enable && !vm->heap.free.running && gc_thread_start(vm)) {
+        vm->heap.free.enable = 0;
+    }
 
-                    cnt ++;
+    if (vm->heap.free.running) {
+        pthread_mutex_lock(&vm->heap.free.lock);
+        if (vm->heap.free.pending < LGX_GC_FREE_LIMIT) {
+            vm->heap.free.tail->head.next = (lgx_list_t*)vm->heap.free.queue;
+            vm->heap.free.queue = batch;
+            vm->heap.free.pending += vm->heap.free.length;
+            batch = NULL;
+            pthread_cond_signal(&vm->heap.free.cond);
+        }
+        pthread_mutex_unlock(&vm->heap.free.lock);
+    }
+
+    gc_release_list(batch);
+}
+
+// 释放不再被根引用的对象
+static void gc_free(lgx_vm_t *vm, lgx_gc_t *gc, lgx_gc_roots_t *roots) {
+    lgx_list_del(&gc->head);
+    // 对象被容器共享时只是交出链表持有的引用
+    if (gc->ref_cnt) {
+        -- gc->ref_cnt;
+        gc->head.next = gc->head.prev = NULL;
+        return;
+    }
+
+    gc_detach(vm, gc, roots);
+
+    if (!vm->heap.free.enable) {
+        lgx_gc_cleanup(gc);
+        xfree(gc);
+        return;
+    }
+
+    if (!vm->heap.free.batch) {
+        vm->heap.free.tail = gc;
+        vm->heap.free.length = 0;
+    }
+    gc->head.next = (lgx_list_t*)vm->heap.free.batch;
+    vm->heap.free.batch = gc;
+    vm->heap.free.length ++;
+}
+
+// 把灰色对象加入工作表，失败返回 1
+static int grey_push(lgx_vm_t *vm, lgx_gc_t *gc) {
+    if (vm->heap.grey_length == vm->heap.grey_size) {
+        size_t size = vm->heap.grey_size ? vm->heap.grey_size * 2 : 256;
+        lgx_gc_t **grey = xrealloc(vm->heap.grey, size * sizeof(lgx_gc_t*));
+        if (!grey) {
+            return 1;
+        }
+        vm->heap.grey = grey;
+        vm->heap.grey_size = size;
+    }
+    vm->heap.grey[vm->heap.grey_length ++] = gc;
+    return 0;
+}
+
+static void gc_scan(lgx_vm_t *vm, lgx_gc_t *gc);
+
+// 把老年代中的白色对象标记为灰色。新生代与 aging 由 Minor GC 清理，不需要标记
+static void gc_shade_object(lgx_vm_t *vm, lgx_gc_t *gc) {
+    if (gc->color >= LGX_GC_YOUNG || gc->color == vm->heap.black) {
+        return;
+    }
+    gc->color = vm->heap.black;
+    // 清除阶段标记为黑色即可。工作表无法扩容时直接扫描
+    if (vm->heap.phase == LGX_GC_MARK && grey_push(vm, gc)) {
+        gc_scan(vm, gc);
+    }
+}
+
+// 不在链表中的对象只被所在的容器持有，与容器一起存活，直接扫描其中的元素。
+// 它们可能随容器一起被释放，所以不能放入工作表
+static void gc_shade_value(lgx_vm_t *vm, lgx_value_t *v) {
+    if (!IS_GC_VALUE(v)) {
+        return;
+    }
+    if (lgx_value_type(v) == T_STRING && lgx_value_str(v)->interned) {
+        return;
+    }
+
+    lgx_gc_t *gc = lgx_value_gc(v);
+    if (gc->head.next) {
+        gc_shade_object(vm, gc);
+    } else {
+        gc_scan(vm, gc);
+    }
+}
+
+// 扫描对象中的元素，把其中的对象标记为灰色
+static void gc_scan(lgx_vm_t *vm, lgx_gc_t *gc) {
+    switch (gc->type.type) {
+        case T_ARRAY: {
+            lgx_array_t *arr = (lgx_array_t*)gc;
+            if (lgx_array_is_packed(arr)) {
+                if (arr->kind == T_UNKNOWN) {
+                    unsigned i;
+                    for (i = 0; i < arr->length; i ++) {
+                        gc_shade_value(vm, &arr->values[i]);
+                    }
                 }
-                */
-                break;
+            } else {
+                lgx_ht_node_t *n;
+                for (n = lgx_ht_first(&arr->table); n; n = lgx_ht_next(n)) {
+                    gc_shade_value(vm, (lgx_value_t*)n->v);
+                }
+            }
+            break;
+        }
+        case T_MAP: {
+            lgx_map_iter_t it;
+            memset(&it, 0, sizeof(it));
+            while (!lgx_map_next((lgx_map_t*)gc, &it)) {
+                gc_shade_value(vm, it.v);
             }
-            default:
-                break;
+            break;
         }
+        default:
+            break;
+    }
+}
 
-        list = next;
+// 写屏障。只被容器持有的字符串即将从容器中移除，而其它持有者可能是本轮将被清除的容器，
+// 改为同时由老年代持有；其余对象标记为灰色
+void lgx_gc_shade(lgx_vm_t *vm, lgx_value_t *v) {
+    if (!IS_GC_VALUE(v)) {
+        return;
+    }
+    if (lgx_value_type(v) == T_STRING && lgx_value_str(v)->interned) {
+        return;
     }
 
-    vm->heap.young_size = 0;
+    lgx_gc_t *gc = lgx_value_gc(v);
+    if (!gc->head.next && lgx_value_type(v) == T_STRING) {
+        ++ gc->ref_cnt;
+        gc_link_old(vm, gc);
+    } else {
+        gc_shade_value(vm, v);
+    }
+}
+
+void lgx_gc_retain(lgx_vm_t *vm, lgx_value_t *v) {
+    if (!IS_GC_VALUE(v)) {
+        return;
+    }
+    if (lgx_value_type(v) == T_STRING && lgx_value_str(v)->interned) {
+        return;
+    }
+
+    lgx_gc_t *gc = lgx_value_gc(v);
+    if (gc->head.next) {
+        // 在 aging 中时，由下一次 Minor GC 重新判断是否存活
+        if (gc->color >= LGX_GC_YOUNG && gc->color != vm->heap.young_color) {
+            gc->color = vm->heap.young_color;
+            lgx_list_move_tail(&gc->head, &vm->heap.young);
+        }
+        return;
+    }
+
+    // 仍然被其它容器共享的对象，移除后依然存活
+    if (gc->ref_cnt) {
+        return;
+    }
 
-    // TODO
-    //printf("[minor gc] %d remain\n", cnt);
+    ++ gc->ref_cnt;
+    gc->color = vm->heap.young_color;
+    lgx_list_add_tail(&gc->head, &vm->heap.young);
+    vm->heap.young_size += lgx_gc_size(gc);
+}
+
+// 标记阶段，deadline 为 0 时一直执行到结束。标记完成返回 0
+// 依次把快照中的老年代对象标记为灰色，并在工作表非空时优先扫描灰色对象。
+// 标记期间老年代只会在末尾加入黑色对象，所以保存的 cursor 依然有效
+static int mark_step(lgx_vm_t *vm, unsigned long long deadline) {
+    unsigned n = 0;
+    while (vm->heap.grey_length || vm->heap.cursor != &vm->heap.old) {
+        if (vm->heap.grey_length) {
+            gc_scan(vm, vm->heap.grey[-- vm->heap.grey_length]);
+        } else {
+            lgx_gc_t *gc = (lgx_gc_t*)vm->heap.cursor;
+            vm->heap.cursor = vm->heap.cursor->next;
+            if (gc->color != vm->heap.black && roots_has(&vm->heap.snapshot, gc)) {
+                gc->color = vm->heap.black;
+                gc_scan(vm, gc);
+            }
+        }
 
-    if (vm->heap.old_size >= 4 * 1024 * 1024) {
-        if (full_gc(vm)) {
-            // Out Of Memory
+        // 每处理一批对象检查一次时间
+        if (deadline && (++ n & 63) == 0 && gc_now() >= deadline) {
             return 1;
         }
+    }
+    return 0;
+}
+
+// 清除阶段，释放仍然为白色的对象，deadline 为 0 时一直执行到结束
+// 被取出的元素只会加入老年代的末尾，所以保存的 next 依然有效
+static void sweep_step(lgx_vm_t *vm, unsigned long long deadline) {
+    unsigned n = 0;
+    lgx_list_t *pos = vm->heap.cursor;
+    while (pos != &vm->heap.old) {
+        lgx_list_t *next = pos->next;
+        lgx_gc_t *gc = (lgx_gc_t*)pos;
+
+        if (gc->color == vm->heap.black) {
+            vm->heap.live_size += lgx_gc_size(gc);
+        } else {
+            size_t size = lgx_gc_size(gc);
+            vm->heap.old_size -= size < vm->heap.old_size ? size : vm->heap.old_size;
+            gc_free(vm, gc, &vm->heap.snapshot);
+        }
+
+        pos = next;
+
+        if (deadline && (++ n & 63) == 0 && gc_now() >= deadline) {
+            vm->heap.cursor = pos;
+            return;
+        }
+    }
 
+    // 本轮结束，老年代的阈值为存活对象大小的两倍，但不低于 LGX_GC_OLD_LIMIT
+    vm->heap.phase = LGX_GC_IDLE;
+    vm->heap.cursor = NULL;
+    vm->heap.old_size = vm->heap.live_size;
+    vm->heap.old_limit = vm->heap.old_size * 2;
+    if (vm->heap.old_limit < LGX_GC_OLD_LIMIT) {
+        vm->heap.old_limit = LGX_GC_OLD_LIMIT;
     }
+}
+
+// 处理 aging 中的对象，被扫描时的根引用的移入老年代，其余释放。
+// deadline 为 0 时一直执行到结束。处理完成返回 0
+static int aging_step(lgx_vm_t *vm, unsigned long long deadline) {
+    unsigned n = 0;
+    while (!lgx_list_empty(&vm->heap.aging)) {
+        lgx_gc_t *gc = (lgx_gc_t*)vm->heap.aging.next;
+
+        if (roots_has(vm->heap.aging_roots, gc)) {
+            lgx_list_del(&gc->head);
+            gc_link_old(vm, gc);
+        } else {
+            gc_free(vm, gc, vm->heap.aging_roots);
+        }
 
+        if (deadline && (++ n & 63) == 0 && gc_now() >= deadline) {
+            return 1;
+        }
+    }
     return 0;
 }
 
+// 扫描根集合，把整个新生代移入 aging，由 aging_step 分多次处理
+// 老年代超过阈值时，以本次的根集合为快照开始新一轮 Full GC
+static void minor_gc(lgx_vm_t *vm) {
+    lgx_gc_roots_t *roots = &vm->heap.roots;
+    if (roots_init(vm, roots)) {
+        // 内存不足时放弃本次回收
+        vm->heap.young_size = 0;
+        return;
+    }
+
+    if (!lgx_list_empty(&vm->heap.young)) {
+        vm->heap.aging.next = vm->heap.young.next;
+        vm->heap.aging.prev = vm->heap.young.prev;
+        vm->heap.aging.next->prev = &vm->heap.aging;
+        vm->heap.aging.prev->next = &vm->heap.aging;
+        lgx_list_init(&vm->heap.young);
+    }
+    vm->heap.aging_roots = roots;
+    vm->heap.young_color = vm->heap.young_color == LGX_GC_YOUNG ? LGX_GC_YOUNG + 1 : LGX_GC_YOUNG;
+
+    vm->heap.young_size = 0;
+    vm->heap.minor_count ++;
+
+    if (!vm->heap.phase && vm->heap.old_size >= vm->heap.old_limit) {
+        // 交换两个集合，上一轮快照的槽位留给之后的 Minor GC 使用
+        lgx_gc_roots_t snapshot = vm->heap.snapshot;
+        vm->heap.snapshot = *roots;
+        *roots = snapshot;
+        vm->heap.aging_roots = &vm->heap.snapshot;
+
+        // 翻转黑色的取值，老年代中的对象全部成为白色
+        vm->heap.black = !vm->heap.black;
+        vm->heap.phase = LGX_GC_MARK;
+        vm->heap.cursor = vm->heap.old.next;
+        vm->heap.grey_length = 0;
+        vm->heap.live_size = 0;
+        vm->heap.full_count ++;
+    }
+}
+
+// 每次执行的耗时不超过 pause，但 Minor GC 扫描根集合的部分不能分步执行，另外计时
+static void gc_run(lgx_vm_t *vm) {
+    unsigned long long start = gc_now();
+    unsigned long long now = start;
+
+    // 上一次的新生代处理完毕之前推迟 Minor GC
+    if (vm->heap.young_size >= LGX_GC_YOUNG_LIMIT && lgx_list_empty(&vm->heap.aging)) {
+        minor_gc(vm);
+        now = gc_now();
+        if (now - start > vm->heap.max_scan) {
+            vm->heap.max_scan = now - start;
+        }
+    }
+
+    unsigned long long deadline = vm->heap.pause ? now + vm->heap.pause : 0;
+
+    // Full GC 期间 aging 最多使用一半的时间，保证两者都能持续推进
+    aging_step(vm, deadline && vm->heap.phase ? now + vm->heap.pause / 2 : deadline);
+
+    if (vm->heap.phase && (!deadline || gc_now() < deadline)) {
+        if (vm->heap.phase == LGX_GC_MARK && !mark_step(vm, deadline)) {
+            vm->heap.phase = LGX_GC_SWEEP;
+            vm->heap.cursor = vm->heap.old.next;
+        }
+        if (vm->heap.phase == LGX_GC_SWEEP && (!deadline || gc_now() < deadline)) {
+            sweep_step(vm, deadline);
+        }
+    }
+
+    if (vm->heap.phase || !lgx_list_empty(&vm->heap.aging)) {
+        // 分配速度超过清理速度，导致老年代膨胀或者 Minor GC 被推迟时，
+        // 缩短两次 GC 的间隔，而不是取消时间限制
+        size_t step = LGX_GC_STEP_SIZE;
+        if (vm->heap.old_size >= vm->heap.old_limit * 2 || vm->heap.young_size >= LGX_GC_YOUNG_LIMIT) {
+            step /= 8;
+        }
+        vm->heap.next_step = vm->heap.young_size + step;
+    } else {
+        vm->heap.next_step = LGX_GC_YOUNG_LIMIT;
+    }
+
+    gc_flush(vm);
+
+    unsigned long long pause = gc_now() - start;
+    if (pause > vm->heap.max_pause) {
+        vm->heap.max_pause = pause;
+    }
+}
+
 int lgx_gc_trace(lgx_vm_t *vm, lgx_value_t *v) {
     if (!IS_GC_VALUE(v)) {
         return 0;
     }
 
-    // 每分配 4M 空间就尝试执行一次 GC
-    /*
-    if (vm->heap.young_size >= 4 * 1024 * 1024) {
-        if (minor_gc(vm)) {
-            // Out Of Memory
-            return 1;
-        }
+    // 驻留字符串由驻留表持有
+    if (lgx_value_type(v) == T_STRING && lgx_value_str(v)->interned) {
+        return 0;
+    }
 
-    }*/
+    // 共享的对象可能已经在跟踪中
+    if (lgx_value_gc(v)->head.next) {
+        return 0;
+    }
+
+    // 新对象加入链表之前执行回收，此时它只被调用者持有，不会被误回收
+    if (vm->gc_enable && vm->heap.young_size >= vm->heap.next_step) {
+        gc_run(vm);
+    }
 
-    lgx_list_add_tail(&v->v.gc->head, &vm->heap.young);
-    vm->heap.young_size += gc_size(v->v.gc);
+    lgx_value_gc(v)->color = vm->heap.young_color;
+    lgx_list_add_tail(&lgx_value_gc(v)->head, &vm->heap.young);
+    vm->heap.young_size += lgx_gc_size(lgx_value_gc(v));
 
     return 0;
 }
 
+// 等待后台线程释放所有对象后退出
+void lgx_gc_stop(lgx_vm_t *vm) {
+    if (!vm->heap.free.running) {
+        return;
+    }
+
+    pthread_mutex_lock(&vm->heap.free.lock);
+    vm->heap.free.stop = 1;
+    pthread_cond_signal(&vm->heap.free.cond);
+    pthread_mutex_unlock(&vm->heap.free.lock);
+
+    pthread_join(vm->heap.free.thread, NULL);
+    pthread_cond_destroy(&vm->heap.free.cond);
+    pthread_mutex_destroy(&vm->heap.free.lock);
+    vm->heap.free.running = 0;
+}
+
+// 容器扩容时把新增的内存计入新生代的分配量
+void lgx_gc_grow(lgx_vm_t *vm, size_t before, size_t after) {
+    if (after > before) {
+        vm->heap.young_size += after - before;
+    }
+}
+
+// 对象仍然被其它持有者共享时只减少引用计数，由最后一个持有者释放
+void lgx_gc_release(lgx_gc_t* gc) {
+    if (gc->ref_cnt) {
+        -- gc->ref_cnt;
+        return;
+    }
+
+    lgx_gc_cleanup(gc);
+    xfree(gc);
+}
+
 void lgx_gc_cleanup(lgx_gc_t* gc) {
     switch (gc->type.type) {
         case T_STRING:
             lgx_string_cleanup((lgx_string_t*)gc);
             break;
-        case T_ARRAY: 
+        case T_ARRAY:
             lgx_array_cleanup((lgx_array_t*)gc);
             break;
+        case T_MAP:
+            lgx_map_cleanup((lgx_map_t*)gc);
+            break;
         case T_FUNCTION:
             lgx_function_cleanup((lgx_function_t*)gc);
             break;
         default:
             break;
     }
-}
\ No newline at end of file
+}
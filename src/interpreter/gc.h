@@ -4,7 +4,34 @@
 #include "../parser/type.h"
 #include "vm.h"
 
-#define IS_GC_VALUE(p) ((p)->type > T_BOOL)
+#define IS_GC_VALUE(p) (lgx_value_type(p) > T_BOOL)
+
+// 新生代每分配 4M 空间执行一次 Minor GC
+#define LGX_GC_YOUNG_LIMIT (4 * 1024 * 1024)
+
+// 老年代超过该大小时执行 Full GC
+#define LGX_GC_OLD_LIMIT (16 * 1024 * 1024)
+
+// 处理 aging 或者清理老年代期间，每分配 256K 空间执行一次 GC
+#define LGX_GC_STEP_SIZE (256 * 1024)
+
+// 当前栈帧之后作为根扫描的参数区大小，即一个栈帧最多拥有的寄存器个数
+#define LGX_GC_CALL_AREA 256
+
+// 默认的单次 GC 暂停时间目标（微秒）
+#define LGX_GC_PAUSE 1000
+
+// 后台线程积压的对象超过该数量时，在当前线程中释放
+#define LGX_GC_FREE_LIMIT (1024 * 1024)
+
+// Full GC 的阶段
+#define LGX_GC_IDLE  0
+#define LGX_GC_MARK  1
+#define LGX_GC_SWEEP 2
+
+// 新生代对象的颜色为 LGX_GC_YOUNG 或 LGX_GC_YOUNG + 1（见 heap.young_color）。
+// 老年代对象的颜色等于 heap.black 时为黑色（在工作表中时为灰色），否则为白色
+#define LGX_GC_YOUNG 2
 
 // 启用垃圾回收
 void lgx_gc_enable(lgx_vm_t *vm);
@@ -17,6 +44,32 @@ void lgx_gc_disable(lgx_vm_t *vm);
 // 把一个变量加入 GC 跟踪
 int lgx_gc_trace(lgx_vm_t *vm, lgx_value_t *v);
 
+// 对象占用的内存大小
+size_t lgx_gc_size(lgx_gc_t *gc);
+
+// 记录对象扩容所分配的内存，before 与 after 为扩容前后 lgx_gc_size 的结果
+void lgx_gc_grow(lgx_vm_t *vm, size_t before, size_t after);
+
+// 写屏障：Full GC 期间覆盖或删除容器中的元素、全局变量之前调用，v 为原来的值。
+// 原来的值可能已经被读入寄存器，而寄存器不在快照中，由 lgx_gc_shade 保证它在本轮不会被清除
+#define lgx_gc_barrier(vm, v) do {              \
+    if (UNEXPECTED((vm)->heap.phase)) {         \
+        lgx_gc_shade((vm), (v));                \
+    }                                           \
+} while (0)
+
+void lgx_gc_shade(lgx_vm_t *vm, lgx_value_t *v);
+
+// 覆盖或删除容器中的元素之前调用，v 为原来的值，需要在 lgx_gc_barrier 之后调用。
+// ARRAY_GET 等只把元素的指针复制到寄存器，只被容器持有的对象改为同时由新生代持有，
+// 移除后等到 Minor GC 确认不再被根引用时再释放。aging 中的对象移回新生代，
+// 因为上一次扫描根集合时它可能还没有被读入寄存器
+void lgx_gc_retain(lgx_vm_t *vm, lgx_value_t *v);
+
+// 结束后台释放线程
+void lgx_gc_stop(lgx_vm_t *vm);
+
 void lgx_gc_cleanup(lgx_gc_t* gc);
+void lgx_gc_release(lgx_gc_t* gc);
 
 #endif // LGX_GC_H
\ No newline at end of file
@@ -8,37 +8,104 @@ int lgx_value_init(lgx_value_t* v) {
 
 // TODO
 void lgx_value_cleanup(lgx_value_t* v) {
-    switch (v->type) {
+    // 容器中的对象同时被 GC 持有（lgx_gc_retain）时，只交出容器持有的引用
+    if (lgx_value_type(v) > T_STRING && lgx_value_gc(v)->ref_cnt) {
+        -- lgx_value_gc(v)->ref_cnt;
+        return;
+    }
+
+    switch (lgx_value_type(v)) {
         case T_FUNCTION:
-            lgx_function_cleanup(v->v.fun);
-            xfree(v->v.fun);
+            lgx_function_cleanup(lgx_value_fun(v));
+            xfree(lgx_value_fun(v));
             break;
         case T_ARRAY:
-            lgx_array_cleanup(v->v.arr);
-            xfree(v->v.arr);
+            lgx_array_cleanup(lgx_value_arr(v));
+            xfree(lgx_value_arr(v));
+            break;
+        case T_MAP:
+            lgx_map_cleanup(lgx_value_map(v));
+            xfree(lgx_value_map(v));
             break;
         case T_STRING:
-            lgx_string_cleanup(v->v.str);
-            xfree(v->v.str);
+            if (lgx_value_str(v)->interned) {
+                break;
+            }
+            // 字符串仍然被其它持有者共享
+            if (lgx_value_str(v)->gc.ref_cnt) {
+                -- lgx_value_str(v)->gc.ref_cnt;
+                break;
+            }
+            lgx_string_cleanup(lgx_value_str(v));
+            xfree(lgx_value_str(v));
         default:
             break;
     }
 }
 
+// 缓冲区仍然被其它字符串共享时，只减少共享计数并且不再引用该缓冲区
+void lgx_string_drop_builder(lgx_string_t* str) {
+    if (str->builder && str->builder->ref_cnt) {
+        -- str->builder->ref_cnt;
+        str->builder = NULL;
+    }
+}
+
 void lgx_string_cleanup(lgx_string_t* str) {
+    lgx_string_drop_builder(str);
+    if (str->builder) {
+        xfree(str->builder);
+        str->builder = NULL;
+    }
     lgx_str_cleanup(&str->string);
     lgx_type_cleanup(&str->gc.type);
 }
 
+// 释放数组的元素存储
+static void array_storage_cleanup(lgx_array_t* arr) {
+    if (lgx_array_is_packed(arr)) {
+        if (arr->kind == T_UNKNOWN) {
+            unsigned i;
+            for (i = 0; i < arr->length; i ++) {
+                lgx_value_cleanup(&arr->values[i]);
+            }
+        }
+        xfree(arr->values);
+        arr->values = NULL;
+        arr->size = arr->length = 0;
+        arr->kind = T_UNKNOWN;
+    } else {
+        lgx_ht_node_t* n;
+        for (n = lgx_ht_first(&arr->table); n; n = lgx_ht_next(n)) {
+            lgx_value_cleanup((lgx_value_t*)n->v);
+            xfree(n->v);
+            n->v = NULL;
+        }
+
+        lgx_ht_cleanup(&arr->table);
+    }
+}
+
+// 存储仍然被其它数组共享时，只减少共享计数并且不再引用该存储
+void lgx_array_drop_shared(lgx_array_t* arr) {
+    if (arr->shared && *arr->shared) {
+        -- *arr->shared;
+        memset(&arr->table, 0, sizeof(lgx_ht_t));
+        arr->values = NULL;
+        arr->size = arr->length = 0;
+        arr->shared = NULL;
+    }
+}
+
 void lgx_array_cleanup(lgx_array_t* arr) {
-    lgx_ht_node_t* n;
-    for (n = lgx_ht_first(&arr->table); n; n = lgx_ht_next(n)) {
-        lgx_value_cleanup((lgx_value_t*)n->v);
-        xfree(n->v);
-        n->v = NULL;
+    lgx_array_drop_shared(arr);
+    if (arr->shared) {
+        xfree(arr->shared);
+        arr->shared = NULL;
     }
 
-    lgx_ht_cleanup(&arr->table);
+    array_storage_cleanup(arr);
+
     lgx_type_cleanup(&arr->gc.type);
 }
 
@@ -52,11 +119,869 @@ lgx_string_t* lgx_string_new() {
     return str;
 }
 
+// 分配可以容纳 length 字节内容的字符串，内容由调用者填充
+static lgx_string_t* string_alloc(unsigned length) {
+    lgx_string_t* str;
+    if (length <= LGX_STRING_INLINE_SIZE) {
+        str = xcalloc(1, sizeof(lgx_string_t) + length);
+        if (!str) {
+            return NULL;
+        }
+        str->string.buffer = str->data;
+    } else {
+        str = lgx_string_new();
+        if (!str) {
+            return NULL;
+        }
+        if (lgx_str_init(&str->string, length)) {
+            xfree(str);
+            return NULL;
+        }
+    }
+    str->string.length = length;
+
+    return str;
+}
+
+lgx_string_t* lgx_string_create(const char* buf, unsigned length) {
+    lgx_string_t* str = string_alloc(length);
+    if (!str) {
+        return NULL;
+    }
+    if (length) {
+        memcpy(str->string.buffer, buf, length);
+    }
+
+    return str;
+}
+
+lgx_string_t* lgx_string_concat(lgx_string_t* s1, lgx_string_t* s2) {
+    unsigned length = s1->string.length + s2->string.length;
+    if (UNEXPECTED(length < s1->string.length)) {
+        return NULL;
+    }
+
+    lgx_string_buffer_t* b = s1->builder;
+    int append = b && s1->string.length == b->length && b->size - b->length >= s2->string.length;
+
+    lgx_string_t* str;
+    if (!append && length <= LGX_STRING_INLINE_SIZE) {
+        // 结果是短字符串时直接保存在对象内部
+        str = string_alloc(length);
+        if (!str) {
+            return NULL;
+        }
+        memcpy(str->string.buffer, s1->string.buffer, s1->string.length);
+        memcpy(str->string.buffer + s1->string.length, s2->string.buffer, s2->string.length);
+        return str;
+    }
+
+    str = lgx_string_new();
+    if (!str) {
+        return NULL;
+    }
+
+    if (append) {
+        // 缓冲区末尾还有空间，其它共享者只会看到各自的前缀，可以直接追加
+        ++ b->ref_cnt;
+    } else {
+        // 按照两倍长度分配，使后续的追加可以均摊
+        unsigned size = length < LGX_STRING_BUFFER_MIN_SIZE / 2 ? LGX_STRING_BUFFER_MIN_SIZE : length * 2;
+        if (UNEXPECTED(size < length)) {
+            size = length;
+        }
+        b = xmalloc(sizeof(lgx_string_buffer_t) + size);
+        if (!b) {
+            xfree(str);
+            return NULL;
+        }
+        b->ref_cnt = 0;
+        b->size = size;
+        b->length = s1->string.length;
+        memcpy(b->buffer, s1->string.buffer, s1->string.length);
+    }
+    // s1 与 s2 可能是同一个字符串，追加前 s2 的内容不会被修改
+    memcpy(b->buffer + b->length, s2->string.buffer, s2->string.length);
+    b->length = length;
+
+    str->builder = b;
+    str->string.buffer = b->buffer;
+    str->string.length = length;
+    str->string.size = 0;
+
+    return str;
+}
+
+// 字符串驻留表，键直接引用驻留字符串自身的内容
+static lgx_ht_t string_interned;
+// 空字符串不能作为哈希表的键，单独驻留
+static lgx_string_t* string_empty;
+
+lgx_string_t* lgx_string_intern(lgx_str_t* s) {
+    if (!s->length && string_empty) {
+        return string_empty;
+    }
+
+    unsigned hash = lgx_ht_hash(s);
+
+    lgx_ht_node_t* n = lgx_ht_get_with_hash(&string_interned, s, hash);
+    if (n) {
+        return (lgx_string_t*)n->v;
+    }
+
+    lgx_string_t* str = lgx_string_create(s->buffer, s->length);
+    if (!str) {
+        return NULL;
+    }
+    if (lgx_type_init(&str->gc.type, T_STRING)) {
+        lgx_string_cleanup(str);
+        xfree(str);
+        return NULL;
+    }
+    str->hash = hash;
+
+    if (!s->length) {
+        str->interned = 1;
+        string_empty = str;
+        return str;
+    }
+
+    if (lgx_ht_set_shared(&string_interned, &str->string, hash, str)) {
+        lgx_string_cleanup(str);
+        xfree(str);
+        return NULL;
+    }
+    str->interned = 1;
+
+    return str;
+}
+
+void lgx_string_intern_cleanup() {
+    lgx_ht_node_t* n;
+    for (n = lgx_ht_first(&string_interned); n; n = lgx_ht_next(n)) {
+        lgx_string_cleanup((lgx_string_t*)n->v);
+        xfree(n->v);
+        n->v = NULL;
+    }
+
+    lgx_ht_cleanup(&string_interned);
+
+    if (string_empty) {
+        lgx_string_cleanup(string_empty);
+        xfree(string_empty);
+        string_empty = NULL;
+    }
+}
+
 lgx_array_t* lgx_array_new() {
     lgx_array_t* arr = xcalloc(1, sizeof(lgx_array_t));
     return arr;
 }
 
+// 初始化为连续存储的空数组，size 为预先分配的元素个数
+int lgx_array_init(lgx_array_t* arr, unsigned size) {
+    memset(&arr->table, 0, sizeof(lgx_ht_t));
+    arr->length = 0;
+    arr->size = 0;
+    arr->kind = T_UNKNOWN;
+    arr->values = NULL;
+    arr->shared = NULL;
+
+    if (size) {
+        arr->values = xmalloc(size * sizeof(lgx_value_t));
+        if (UNEXPECTED(!arr->values)) {
+            return 1;
+        }
+        arr->size = size;
+    }
+
+    return 0;
+}
+
+int lgx_array_init_kind(lgx_array_t* arr, unsigned kind, unsigned length) {
+    assert(kind == T_LONG || kind == T_DOUBLE);
+
+    if (lgx_array_init(arr, 0)) {
+        return 1;
+    }
+    arr->kind = kind;
+
+    if (length) {
+        arr->longs = xmalloc(length * sizeof(long long));
+        if (UNEXPECTED(!arr->longs)) {
+            return 1;
+        }
+        arr->size = arr->length = length;
+    }
+
+    return 0;
+}
+
+// 连续存储中每个元素占用的字节数
+static lgx_inline unsigned array_elem_size(unsigned kind) {
+    return kind == T_UNKNOWN ? sizeof(lgx_value_t) : sizeof(long long);
+}
+
+// 修改空数组的元素类型，已分配的空间按字节数换算为新的元素个数
+static void array_set_kind(lgx_array_t* arr, unsigned kind) {
+    assert(!arr->length);
+    arr->size = (unsigned long long)arr->size * array_elem_size(arr->kind) / array_elem_size(kind);
+    arr->kind = kind;
+}
+
+// 把以原始值保存的元素转换为 lgx_value_t
+static int array_box(lgx_array_t* arr) {
+    lgx_value_t* values = xrealloc(arr->values, arr->size * sizeof(lgx_value_t));
+    if (UNEXPECTED(!values)) {
+        return 1;
+    }
+
+    // lgx_value_t 不小于原始值，从后向前转换不会覆盖尚未读取的元素
+    unsigned i = arr->length;
+    if (arr->kind == T_LONG) {
+        long long* longs = (long long*)values;
+        while (i --) {
+            long long l = longs[i];
+            lgx_value_set_long(&values[i], l);
+        }
+    } else {
+        double* doubles = (double*)values;
+        while (i --) {
+            double d = doubles[i];
+            lgx_value_set_double(&values[i], d);
+        }
+    }
+
+    arr->values = values;
+    arr->kind = T_UNKNOWN;
+
+    return 0;
+}
+
+// 确保连续存储可以保存 v，必要时把原始值转换为 lgx_value_t
+static int array_fit(lgx_array_t* arr, lgx_value_t* v) {
+    unsigned type = lgx_value_type(v);
+    if (EXPECTED(arr->kind == type)) {
+        return 0;
+    }
+
+    if (arr->length) {
+        return arr->kind == T_UNKNOWN ? 0 : array_box(arr);
+    }
+
+    // 空数组的元素类型由第一个元素决定
+    array_set_kind(arr, type == T_LONG || type == T_DOUBLE ? type : T_UNKNOWN);
+
+    return 0;
+}
+
+// 写入连续存储中的第 i 个元素，调用前必须先调用 array_fit
+static lgx_inline void array_packed_set(lgx_array_t* arr, unsigned i, lgx_value_t* v) {
+    switch (arr->kind) {
+        case T_LONG:
+            arr->longs[i] = lgx_value_long(v);
+            break;
+        case T_DOUBLE:
+            arr->doubles[i] = lgx_value_double(v);
+            break;
+        default:
+            arr->values[i] = *v;
+    }
+}
+
+// 将连续存储的空间扩容一倍
+static int array_resize(lgx_array_t* arr) {
+    unsigned size = arr->size ? arr->size * 2 : LGX_ARRAY_MIN_SIZE;
+    lgx_value_t* values = xrealloc(arr->values, size * array_elem_size(arr->kind));
+    if (UNEXPECTED(!values)) {
+        return 1;
+    }
+
+    arr->values = values;
+    arr->size = size;
+
+    return 0;
+}
+
+// 将连续存储的数组转换为哈希表
+static int array_to_hash(lgx_array_t* arr) {
+    lgx_ht_t table;
+    if (lgx_ht_init(&table, arr->length)) {
+        return 1;
+    }
+
+    unsigned i;
+    for (i = 0; i < arr->length; i ++) {
+        lgx_value_t* v = xmalloc(sizeof(lgx_value_t));
+        if (UNEXPECTED(!v)) {
+            break;
+        }
+        lgx_array_packed_get(arr, i, v);
+
+        lgx_str_t key;
+        long long num = i;
+        lgx_array_key(&key, &num);
+        if (lgx_ht_set(&table, &key, v)) {
+            xfree(v);
+            break;
+        }
+    }
+
+    if (i < arr->length) {
+        // 值仍然归 values 所有，只需要释放哈希表本身
+        lgx_ht_node_t* n;
+        for (n = lgx_ht_first(&table); n; n = lgx_ht_next(n)) {
+            xfree(n->v);
+            n->v = NULL;
+        }
+        lgx_ht_cleanup(&table);
+        return 1;
+    }
+
+    xfree(arr->values);
+    arr->values = NULL;
+    arr->size = arr->length = 0;
+    arr->kind = T_UNKNOWN;
+    arr->table = table;
+
+    return 0;
+}
+
+static int array_hash_set(lgx_array_t* arr, lgx_str_t* k, unsigned hash, lgx_value_t* v) {
+    lgx_ht_node_t* n = lgx_ht_get_with_hash(&arr->table, k, hash);
+    if (n) {
+        lgx_value_cleanup((lgx_value_t*)n->v);
+        *(lgx_value_t*)n->v = *v;
+        return 0;
+    }
+
+    lgx_value_t* val = xmalloc(sizeof(lgx_value_t));
+    if (UNEXPECTED(!val)) {
+        return 1;
+    }
+    *val = *v;
+
+    if (lgx_ht_set_with_hash(&arr->table, k, hash, val)) {
+        xfree(val);
+        return 1;
+    }
+
+    return 0;
+}
+
+// 为 dst 创建独立的存储并复制 src 的所有元素，dst 的存储必须为空
+// 失败时 dst 中可能已经保存了部分元素，需要由调用者释放
+static int array_copy(lgx_array_t* src, lgx_array_t* dst) {
+    if (lgx_array_is_packed(src)) {
+        if (lgx_array_init(dst, src->length)) {
+            return 1;
+        }
+        if (src->kind != T_UNKNOWN) {
+            // 原始值可以直接复制
+            array_set_kind(dst, src->kind);
+            memcpy(dst->values, src->values, src->length * array_elem_size(src->kind));
+            dst->length = src->length;
+            return 0;
+        }
+        while (dst->length < src->length) {
+            if (lgx_value_dup(&src->values[dst->length], &dst->values[dst->length])) {
+                return 1;
+            }
+            dst->length ++;
+        }
+        return 0;
+    }
+
+    if (lgx_ht_init(&dst->table, src->table.length)) {
+        return 1;
+    }
+
+    lgx_ht_node_t* n;
+    for (n = lgx_ht_first(&src->table); n; n = lgx_ht_next(n)) {
+        lgx_value_t v;
+        if (lgx_value_dup((lgx_value_t*)n->v, &v)) {
+            return 1;
+        }
+        if (array_hash_set(dst, &n->k, n->hash, &v)) {
+            lgx_value_cleanup(&v);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// 修改数组前调用，确保数组拥有独立的存储。复制存储时元素也被复制，
+// 嵌套的数组与 map 成为新的对象，与原存储中的元素互不影响
+int lgx_array_unshare(lgx_array_t* arr) {
+    if (!*arr->shared) {
+        // 其它共享者都已经释放
+        xfree(arr->shared);
+        arr->shared = NULL;
+        return 0;
+    }
+
+    lgx_array_t copy;
+    memset(&copy, 0, sizeof(copy));
+    if (array_copy(arr, &copy)) {
+        array_storage_cleanup(&copy);
+        return 1;
+    }
+
+    -- *arr->shared;
+    arr->shared = NULL;
+    arr->size = copy.size;
+    arr->length = copy.length;
+    arr->kind = copy.kind;
+    arr->values = copy.values;
+    arr->table = copy.table;
+
+    return 0;
+}
+
+lgx_value_t* lgx_array_get_str(lgx_array_t* arr, lgx_str_t* k, unsigned hash) {
+    // 连续存储的数组中只有整数下标
+    if (lgx_array_is_packed(arr)) {
+        return NULL;
+    }
+
+    lgx_ht_node_t* n = lgx_ht_get_with_hash(&arr->table, k, hash);
+    return n ? (lgx_value_t*)n->v : NULL;
+}
+
+int lgx_array_set_long(lgx_array_t* arr, long long k, lgx_value_t* v) {
+    if (UNEXPECTED(arr->shared) && lgx_array_unshare(arr)) {
+        return 1;
+    }
+
+    if (EXPECTED(lgx_array_is_packed(arr))) {
+        if ((unsigned long long)k <= arr->length) {
+            if (UNEXPECTED(array_fit(arr, v))) {
+                return 1;
+            }
+            if (k == arr->length) {
+                if (arr->length == arr->size && array_resize(arr)) {
+                    return 1;
+                }
+                arr->length ++;
+            } else if (arr->kind == T_UNKNOWN) {
+                lgx_value_cleanup(&arr->values[k]);
+            }
+            array_packed_set(arr, k, v);
+            return 0;
+        }
+
+        // 下标不再连续
+        if (array_to_hash(arr)) {
+            return 1;
+        }
+    }
+
+    lgx_str_t key;
+    lgx_array_key(&key, &k);
+    return array_hash_set(arr, &key, lgx_ht_hash(&key), v);
+}
+
+int lgx_array_set_str(lgx_array_t* arr, lgx_str_t* k, unsigned hash, lgx_value_t* v) {
+    if (UNEXPECTED(arr->shared) && lgx_array_unshare(arr)) {
+        return 1;
+    }
+
+    if (lgx_array_is_packed(arr) && array_to_hash(arr)) {
+        return 1;
+    }
+
+    return array_hash_set(arr, k, hash, v);
+}
+
+int lgx_array_set_string(lgx_array_t* arr, lgx_string_t* k, lgx_value_t* v) {
+    if (!k->interned) {
+        return lgx_array_set_str(arr, &k->string, lgx_string_hash(k), v);
+    }
+
+    if (UNEXPECTED(arr->shared) && lgx_array_unshare(arr)) {
+        return 1;
+    }
+
+    if (lgx_array_is_packed(arr) && array_to_hash(arr)) {
+        return 1;
+    }
+
+    // 驻留字符串的生命周期比数组长，键直接引用它的内容
+    lgx_ht_node_t* n = lgx_ht_get_with_hash(&arr->table, &k->string, k->hash);
+    if (n) {
+        lgx_value_cleanup((lgx_value_t*)n->v);
+        *(lgx_value_t*)n->v = *v;
+        return 0;
+    }
+
+    lgx_value_t* val = xmalloc(sizeof(lgx_value_t));
+    if (UNEXPECTED(!val)) {
+        return 1;
+    }
+    *val = *v;
+
+    if (lgx_ht_set_shared(&arr->table, &k->string, k->hash, val)) {
+        xfree(val);
+        return 1;
+    }
+
+    return 0;
+}
+
+int lgx_array_append(lgx_array_t* arr, lgx_value_t* v) {
+    return lgx_array_set_long(arr, lgx_array_length(arr), v);
+}
+
+lgx_map_t* lgx_map_new() {
+    lgx_map_t* map = xcalloc(1, sizeof(lgx_map_t));
+    return map;
+}
+
+int lgx_map_init(lgx_map_t* map, unsigned key, unsigned size) {
+    assert(key == T_LONG || key == T_STRING);
+
+    map->key = key;
+    map->ordered = 0;
+
+    return lgx_ht_init(&map->table, size);
+}
+
+static void map_storage_cleanup(lgx_map_t* map) {
+    lgx_map_iter_t it;
+    memset(&it, 0, sizeof(it));
+    while (!lgx_map_next(map, &it)) {
+        lgx_value_cleanup(it.v);
+        xfree(it.v);
+        // 释放哈希表时要求节点的值已经被清空
+        if (it.hn) {
+            it.hn->v = NULL;
+        }
+    }
+
+    if (map->ordered) {
+        lgx_rb_cleanup(&map->tree);
+    } else {
+        lgx_ht_cleanup(&map->table);
+    }
+}
+
+// 存储仍然被其它 map 共享时，只减少共享计数并且不再引用该存储
+void lgx_map_drop_shared(lgx_map_t* map) {
+    if (map->shared && *map->shared) {
+        -- *map->shared;
+        memset(&map->table, 0, sizeof(lgx_ht_t));
+        memset(&map->tree, 0, sizeof(lgx_rb_t));
+        map->shared = NULL;
+    }
+}
+
+void lgx_map_cleanup(lgx_map_t* map) {
+    lgx_map_drop_shared(map);
+    if (map->shared) {
+        xfree(map->shared);
+        map->shared = NULL;
+    }
+
+    map_storage_cleanup(map);
+
+    lgx_type_cleanup(&map->gc.type);
+}
+
+// 哈希表使用的哈希值，key 为 lgx_map_key 根据 k 生成的键。字符串键使用缓存的哈希值
+static lgx_inline unsigned map_hash(lgx_value_t* k, lgx_str_t* key) {
+    if (lgx_value_type(k) == T_STRING) {
+        return lgx_string_hash(lgx_value_str(k));
+    }
+    return lgx_ht_hash(key);
+}
+
+// 键值由调用者保证不存在。shared 为 1 时 key 是驻留字符串的内容，
+// 它的生命周期比 map 长，哈希表直接引用而不复制；红黑树总是复制键
+static int map_insert(lgx_map_t* map, lgx_str_t* key, unsigned hash, int shared, lgx_value_t* v) {
+    lgx_value_t* val = xmalloc(sizeof(lgx_value_t));
+    if (UNEXPECTED(!val)) {
+        return 1;
+    }
+    *val = *v;
+
+    if (map->ordered) {
+        lgx_rb_node_t* n = lgx_rb_set(&map->tree, key);
+        if (!n) {
+            xfree(val);
+            return 1;
+        }
+        n->value = val;
+    } else if (shared ? lgx_ht_set_shared(&map->table, key, hash, val) :
+                        lgx_ht_set_with_hash(&map->table, key, hash, val)) {
+        xfree(val);
+        return 1;
+    }
+
+    return 0;
+}
+
+static lgx_value_t* map_find(lgx_map_t* map, lgx_str_t* key, unsigned hash) {
+    if (map->ordered) {
+        lgx_rb_node_t* n = lgx_rb_get(&map->tree, key);
+        return n ? (lgx_value_t*)n->value : NULL;
+    }
+
+    lgx_ht_node_t* n = lgx_ht_get_with_hash(&map->table, key, hash);
+    return n ? (lgx_value_t*)n->v : NULL;
+}
+
+// 逐个复制 src 的元素到新创建的 dst 中
+static int map_copy(lgx_map_t* src, lgx_map_t* dst) {
+    if (lgx_map_init(dst, src->key, lgx_map_length(src))) {
+        return 1;
+    }
+    if (src->ordered && lgx_map_order(dst)) {
+        return 1;
+    }
+
+    lgx_map_iter_t it;
+    memset(&it, 0, sizeof(it));
+    while (!lgx_map_next(src, &it)) {
+        lgx_value_t v;
+        if (lgx_value_dup(it.v, &v)) {
+            return 1;
+        }
+        unsigned hash = src->ordered ? 0 : it.hn->hash;
+        if (map_insert(dst, it.k, hash, 0, &v)) {
+            lgx_value_cleanup(&v);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// dst 必须是新创建的 map，复制后与 src 共享元素存储，直到其中一方被修改
+int lgx_map_dup(lgx_map_t* src, lgx_map_t* dst) {
+    if (!lgx_map_length(src)) {
+        if (lgx_map_init(dst, src->key, 0)) {
+            return 1;
+        }
+        return src->ordered ? lgx_map_order(dst) : 0;
+    }
+
+    if (!src->shared) {
+        src->shared = xcalloc(1, sizeof(unsigned));
+        if (UNEXPECTED(!src->shared)) {
+            return 1;
+        }
+    }
+    ++ *src->shared;
+
+    dst->shared = src->shared;
+    dst->key = src->key;
+    dst->ordered = src->ordered;
+    dst->table = src->table;
+    dst->tree = src->tree;
+
+    return 0;
+}
+
+int lgx_map_unshare(lgx_map_t* map) {
+    if (!*map->shared) {
+        // 其它共享者都已经释放
+        xfree(map->shared);
+        map->shared = NULL;
+        return 0;
+    }
+
+    lgx_map_t copy;
+    memset(&copy, 0, sizeof(copy));
+    if (map_copy(map, &copy)) {
+        map_storage_cleanup(&copy);
+        return 1;
+    }
+
+    -- *map->shared;
+    map->shared = NULL;
+    map->ordered = copy.ordered;
+    map->table = copy.table;
+    map->tree = copy.tree;
+
+    return 0;
+}
+
+int lgx_map_key_value(lgx_map_t* map, lgx_str_t* key, lgx_value_t* v) {
+    if (map->key == T_LONG) {
+        long long num;
+        memcpy(&num, key->buffer, sizeof(num));
+        lgx_value_set_long(v, num);
+        return 0;
+    }
+
+    lgx_string_t* str = lgx_string_create(key->buffer, key->length);
+    if (UNEXPECTED(!str)) {
+        lgx_value_set_unknown(v);
+        return 1;
+    }
+    str->gc.type.type = T_STRING;
+    lgx_value_set_str(v, str);
+
+    return 0;
+}
+
+lgx_value_t* lgx_map_get(lgx_map_t* map, lgx_value_t* k) {
+    long long num;
+    lgx_str_t key;
+    lgx_map_key(k, &num, &key);
+    unsigned hash = map->ordered ? 0 : map_hash(k, &key);
+
+    lgx_value_t* v = map_find(map, &key, hash);
+    if (v && lgx_map_elem_unshare(map, v) && !lgx_map_unshare(map)) {
+        v = map_find(map, &key, hash);
+    }
+    return v;
+}
+
+int lgx_map_set(lgx_map_t* map, lgx_value_t* k, lgx_value_t* v) {
+    if (UNEXPECTED(map->shared) && lgx_map_unshare(map)) {
+        return 1;
+    }
+
+    long long num;
+    lgx_str_t key;
+    lgx_map_key(k, &num, &key);
+    unsigned hash = map->ordered ? 0 : map_hash(k, &key);
+
+    lgx_value_t* val = map_find(map, &key, hash);
+    if (val) {
+        lgx_value_cleanup(val);
+        *val = *v;
+        return 0;
+    }
+
+    // 与 lgx_array_set_string 相同，驻留字符串的键直接引用它的内容
+    int shared = lgx_value_type(k) == T_STRING && lgx_value_str(k)->interned;
+    return map_insert(map, &key, hash, shared, v);
+}
+
+int lgx_map_del(lgx_map_t* map, lgx_value_t* k) {
+    long long num;
+    lgx_str_t key;
+    lgx_value_t* val;
+
+    // 键不存在时不需要复制共享的存储
+    if (UNEXPECTED(map->shared) && (!lgx_map_get(map, k) || lgx_map_unshare(map))) {
+        return 1;
+    }
+
+    lgx_map_key(k, &num, &key);
+    if (map->ordered) {
+        lgx_rb_node_t* n = lgx_rb_get(&map->tree, &key);
+        if (!n) {
+            return 1;
+        }
+        val = (lgx_value_t*)n->value;
+        lgx_rb_del(&map->tree, n);
+    } else {
+        lgx_ht_node_t* n = lgx_ht_get_with_hash(&map->table, &key, map_hash(k, &key));
+        if (!n) {
+            return 1;
+        }
+        val = (lgx_value_t*)n->v;
+        lgx_ht_del(&map->table, &key);
+    }
+
+    lgx_value_cleanup(val);
+    xfree(val);
+
+    return 0;
+}
+
+int lgx_map_range(lgx_map_t* src, lgx_value_t* lo, lgx_value_t* hi, lgx_map_t* dst) {
+    assert(src->ordered);
+
+    if (lgx_map_init(dst, src->key, 0) || lgx_map_order(dst)) {
+        return 1;
+    }
+
+    long long l, h;
+    lgx_str_t lk, hk;
+    lgx_map_key(lo, &l, &lk);
+    lgx_map_key(hi, &h, &hk);
+    if (src->key == T_LONG ? l >= h : lgx_str_cmp(&lk, &hk) >= 0) {
+        return 0;
+    }
+
+    // 遍历到第一个不小于 hi 的节点为止
+    lgx_rb_node_t* end = lgx_rb_get_greater_or_equal(&src->tree, &hk);
+    lgx_rb_node_t* n;
+    for (n = lgx_rb_get_greater_or_equal(&src->tree, &lk); n && n != end; n = lgx_rb_next(n)) {
+        lgx_value_t v;
+        if (lgx_value_dup((lgx_value_t*)n->value, &v)) {
+            return 1;
+        }
+        if (map_insert(dst, &n->key, 0, 0, &v)) {
+            lgx_value_cleanup(&v);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int lgx_map_order(lgx_map_t* map) {
+    if (map->ordered) {
+        return 0;
+    }
+    if (UNEXPECTED(map->shared) && lgx_map_unshare(map)) {
+        return 1;
+    }
+
+    lgx_rb_t tree;
+    lgx_rb_init(&tree, map->key == T_LONG ? LGX_RB_KEY_INTEGER : LGX_RB_KEY_STRING);
+
+    // 值的所有权直接转移到红黑树的节点
+    lgx_ht_node_t* n;
+    for (n = lgx_ht_first(&map->table); n; n = lgx_ht_next(n)) {
+        lgx_rb_node_t* node = lgx_rb_set(&tree, &n->k);
+        if (UNEXPECTED(!node)) {
+            lgx_rb_cleanup(&tree);
+            return 1;
+        }
+        node->value = n->v;
+    }
+
+    for (n = lgx_ht_first(&map->table); n; n = lgx_ht_next(n)) {
+        n->v = NULL;
+    }
+    lgx_ht_cleanup(&map->table);
+    map->tree = tree;
+    map->ordered = 1;
+
+    return 0;
+}
+
+void lgx_map_print(lgx_map_t* map) {
+    printf("[");
+    lgx_map_iter_t it;
+    memset(&it, 0, sizeof(it));
+    while (!lgx_map_next(map, &it)) {
+        if (map->key == T_LONG) {
+            long long num;
+            memcpy(&num, it.k->buffer, sizeof(num));
+            printf("%lld:", num);
+        } else {
+            printf("\"");
+            lgx_str_print(it.k);
+            printf("\":");
+        }
+        lgx_value_print(it.v);
+        printf(",");
+    }
+    if (lgx_map_length(map)) {
+        printf("\b]");
+    } else {
+        printf("]");
+    }
+}
+
 lgx_function_t* lgx_fucntion_new() {
     lgx_function_t* fun = xcalloc(1, sizeof(lgx_function_t));
     return fun;
@@ -73,12 +998,22 @@ void lgx_array_value_cleanup(lgx_ht_t* arr) {
 
 void lgx_array_print(lgx_array_t* arr) {
     printf("[");
-    lgx_ht_node_t* n = NULL;
-    for (n = lgx_ht_first(&arr->table); n; n = lgx_ht_next(n)) {
-        lgx_value_print((lgx_value_t*)n->v);
-        printf(",");
+    if (lgx_array_is_packed(arr)) {
+        unsigned i;
+        for (i = 0; i < arr->length; i ++) {
+            lgx_value_t v;
+            lgx_array_packed_get(arr, i, &v);
+            lgx_value_print(&v);
+            printf(",");
+        }
+    } else {
+        lgx_ht_node_t* n = NULL;
+        for (n = lgx_ht_first(&arr->table); n; n = lgx_ht_next(n)) {
+            lgx_value_print((lgx_value_t*)n->v);
+            printf(",");
+        }
     }
-    if (arr->table.length) {
+    if (lgx_array_length(arr)) {
         printf("\b]");
     } else {
         printf("]");
@@ -86,7 +1021,7 @@ void lgx_array_print(lgx_array_t* arr) {
 }
 
 void lgx_value_type_print(lgx_value_t* v) {
-    switch (v->type) {
+    switch (lgx_value_type(v)) {
         case T_UNKNOWN:
             printf("unknown");
             break;
@@ -105,10 +1040,11 @@ void lgx_value_type_print(lgx_value_t* v) {
         case T_NULL:
             printf("null");
             break;
-        case T_ARRAY:{
+        case T_ARRAY:
+        case T_MAP:{
             lgx_str_t type;
             lgx_str_set_null(type);
-            lgx_type_to_string(&v->v.arr->gc.type, &type);
+            lgx_type_to_string(&lgx_value_gc(v)->type, &type);
             printf("%.*s", type.length, type.buffer);
             lgx_str_cleanup(&type);
             break;
@@ -116,13 +1052,12 @@ void lgx_value_type_print(lgx_value_t* v) {
         case T_FUNCTION:{
             lgx_str_t type;
             lgx_str_set_null(type);
-            lgx_type_to_string(&v->v.fun->gc.type, &type);
+            lgx_type_to_string(&lgx_value_fun(v)->gc.type, &type);
             printf("%.*s", type.length, type.buffer);
             lgx_str_cleanup(&type);
             break;
         }
         case T_CUSTOM:
-        case T_MAP:
         case T_STRUCT:
         case T_INTERFACE:
             // TODO
@@ -132,15 +1067,15 @@ void lgx_value_type_print(lgx_value_t* v) {
 }
 
 void lgx_value_print(lgx_value_t* v) {
-   switch (v->type) {
+   switch (lgx_value_type(v)) {
         case T_LONG:
-            printf("%lld", v->v.l);
+            printf("%lld", lgx_value_long(v));
             break;
         case T_DOUBLE:
-            printf("%lg", v->v.d);
+            printf("%lg", lgx_value_double(v));
             break;
         case T_BOOL:
-            if (v->v.l) {
+            if (lgx_value_bool(v)) {
                 printf("true");
             } else {
                 printf("false");
@@ -148,15 +1083,18 @@ void lgx_value_print(lgx_value_t* v) {
             break;
         case T_STRING:
             printf("\"");
-            lgx_str_print(&v->v.str->string);
+            lgx_str_print(&lgx_value_str(v)->string);
             printf("\"");
             break;
         case T_FUNCTION:
-            lgx_str_print(&v->v.fun->name);
+            lgx_str_print(&lgx_value_fun(v)->name);
             printf("()");
             break;
         case T_ARRAY:
-            lgx_array_print(v->v.arr);
+            lgx_array_print(lgx_value_arr(v));
+            break;
+        case T_MAP:
+            lgx_map_print(lgx_value_map(v));
             break;
         case T_NULL:
             printf("null");
@@ -164,7 +1102,6 @@ void lgx_value_print(lgx_value_t* v) {
         case T_UNKNOWN:
             printf("unknwon");
             break;
-        case T_MAP:
         case T_STRUCT:
         case T_INTERFACE:
         case T_CUSTOM:
@@ -176,7 +1113,7 @@ void lgx_value_print(lgx_value_t* v) {
 int lgx_value_typeof(lgx_value_t* v, lgx_str_t* str) {
     lgx_str_t append;
 
-    switch (v->type) {
+    switch (lgx_value_type(v)) {
         case T_UNKNOWN:
             lgx_str_set(append, "unknown");
             return lgx_str_append(&append, str);
@@ -193,7 +1130,7 @@ int lgx_value_typeof(lgx_value_t* v, lgx_str_t* str) {
             lgx_str_set(append, "bool");
             return lgx_str_append(&append, str);
         default:
-            return lgx_type_to_string(&v->v.gc->type, str);
+            return lgx_type_to_string(&lgx_value_gc(v)->type, str);
     }
 }
 
@@ -205,88 +1142,106 @@ int lgx_string_dup(lgx_string_t* src, lgx_string_t* dst) {
     return 0;
 }
 
+
+// dst 必须是新创建的数组，复制后与 src 共享元素存储，直到其中一方被修改
 int lgx_array_dup(lgx_array_t* src, lgx_array_t* dst) {
+    if (lgx_array_is_packed(src) && !src->length) {
+        return lgx_array_init(dst, 0);
+    }
+
+    if (!src->shared) {
+        src->shared = xcalloc(1, sizeof(unsigned));
+        if (UNEXPECTED(!src->shared)) {
+            return 1;
+        }
+    }
+    ++ *src->shared;
+
+    dst->shared = src->shared;
+    dst->size = src->size;
+    dst->length = src->length;
+    dst->kind = src->kind;
+    dst->values = src->values;
+    dst->table = src->table;
+
     return 0;
 }
 
 int lgx_value_dup(lgx_value_t* src, lgx_value_t* dst) {
-    dst->type = src->type;
-    dst->v = src->v;
+    *dst = *src;
 
     // TODO
-    switch (src->type) {
+    switch (lgx_value_type(src)) {
         case T_STRING:
-            dst->v.str = lgx_string_new();
-            if (!dst->v.str) {
+            // 字符串的内容不会改变，直接共享。驻留字符串由驻留表持有，不需要计数
+            if (!lgx_value_str(src)->interned) {
+                ++ lgx_value_str(src)->gc.ref_cnt;
+            }
+            break;
+        case T_ARRAY: {
+            lgx_array_t *arr = lgx_array_new();
+            if (!arr) {
+                lgx_value_set_unknown(dst);
                 return 1;
             }
-            if (lgx_type_dup(&src->v.str->gc.type, &dst->v.str->gc.type)) {
-                xfree(dst->v.str);
-                dst->v.str = NULL;
+            if (lgx_type_dup(&lgx_value_arr(src)->gc.type, &arr->gc.type)) {
+                xfree(arr);
+                lgx_value_set_unknown(dst);
                 return 1;
             }
-            if (lgx_str_init(&dst->v.str->string, src->v.str->string.length)) {
-                lgx_type_cleanup(&dst->v.str->gc.type);
-                xfree(dst->v.str);
-                dst->v.str = NULL;
+            lgx_value_set_arr(dst, arr);
+            if (lgx_array_dup(lgx_value_arr(src), arr)) {
+                lgx_value_cleanup(dst);
+                lgx_value_set_unknown(dst);
                 return 1;
             }
-            lgx_str_dup(&src->v.str->string, &dst->v.str->string);
             break;
-        case T_ARRAY:
-            dst->v.arr = lgx_array_new();
-            if (!dst->v.arr) {
+        }
+        case T_MAP: {
+            lgx_map_t *map = lgx_map_new();
+            if (!map) {
+                lgx_value_set_unknown(dst);
                 return 1;
             }
-            if (lgx_type_dup(&src->v.arr->gc.type, &dst->v.arr->gc.type)) {
-                xfree(dst->v.arr);
-                dst->v.arr = NULL;
+            if (lgx_type_dup(&lgx_value_map(src)->gc.type, &map->gc.type)) {
+                xfree(map);
+                lgx_value_set_unknown(dst);
                 return 1;
             }
-            if (lgx_ht_init(&dst->v.arr->table, src->v.arr->table.length)) {
-                lgx_type_cleanup(&dst->v.arr->gc.type);
-                xfree(dst->v.arr);
-                dst->v.arr = NULL;
+            lgx_value_set_map(dst, map);
+            if (lgx_map_dup(lgx_value_map(src), map)) {
+                lgx_value_cleanup(dst);
+                lgx_value_set_unknown(dst);
                 return 1;
             }
-            lgx_ht_node_t* n;
-            for (n = lgx_ht_first(&src->v.arr->table); n; n = lgx_ht_next(n)) {
-                lgx_value_t* val = xcalloc(1, sizeof(lgx_value_t));
-                if (lgx_value_dup((lgx_value_t*)n->v, val)) {
-                    xfree(val);
-                    lgx_value_cleanup(dst);
-                    return 1;
-                }
-                if (lgx_ht_set(&dst->v.arr->table, &n->k, val)) {
-                    lgx_value_cleanup(val);
-                    xfree(val);
-                    lgx_value_cleanup(dst);
-                    return 1;
-                }
-            }
             break;
-        case T_FUNCTION:
-            dst->v.fun = xcalloc(1, sizeof(lgx_function_t));
-            if (!dst->v.fun) {
+        }
+        case T_FUNCTION: {
+            lgx_function_t *fun = xcalloc(1, sizeof(lgx_function_t));
+            if (!fun) {
+                lgx_value_set_unknown(dst);
                 return 1;
             }
-            if (lgx_type_dup(&src->v.fun->gc.type, &dst->v.fun->gc.type)) {
-                xfree(dst->v.fun);
-                dst->v.fun = NULL;
+            if (lgx_type_dup(&lgx_value_fun(src)->gc.type, &fun->gc.type)) {
+                xfree(fun);
+                lgx_value_set_unknown(dst);
                 return 1;
             }
-            if (lgx_str_init(&dst->v.fun->name, src->v.fun->name.length)) {
-                lgx_type_cleanup(&dst->v.fun->gc.type);
-                xfree(dst->v.fun);
-                dst->v.fun = NULL;
+            if (lgx_str_init(&fun->name, lgx_value_fun(src)->name.length)) {
+                lgx_type_cleanup(&fun->gc.type);
+                xfree(fun);
+                lgx_value_set_unknown(dst);
                 return 1;
             }
-            lgx_str_dup(&src->v.fun->name, &dst->v.fun->name);
-            dst->v.fun->addr = src->v.fun->addr;
-            dst->v.fun->end = src->v.fun->end;
-            dst->v.fun->buildin = src->v.fun->buildin;
-            dst->v.fun->stack_size = src->v.fun->stack_size;
+            lgx_str_dup(&lgx_value_fun(src)->name, &fun->name);
+            fun->addr = lgx_value_fun(src)->addr;
+            fun->end = lgx_value_fun(src)->end;
+            fun->buildin = lgx_value_fun(src)->buildin;
+            fun->stack_size = lgx_value_fun(src)->stack_size;
+            fun->jit = lgx_value_fun(src)->jit;
+            lgx_value_set_fun(dst, fun);
             break;
+        }
         default:
             break;
     }
@@ -15,13 +15,191 @@ void lgx_value_type_print(lgx_value_t* v);
 int lgx_value_typeof(lgx_value_t* v, lgx_str_t* str);
 
 lgx_string_t* lgx_string_new();
+
+// 长度不超过该值的字符串与字符串对象一起分配，不需要单独的缓冲区
+#define LGX_STRING_INLINE_SIZE 24
+
+// 创建内容为 buf 的字符串，短字符串的内容保存在对象内部
+lgx_string_t* lgx_string_create(const char* buf, unsigned length);
 void lgx_string_cleanup(lgx_string_t* str);
+void lgx_string_drop_builder(lgx_string_t* str);
 int lgx_string_dup(lgx_string_t* src, lgx_string_t* dst);
 
+static lgx_inline unsigned lgx_string_hash(lgx_string_t* str) {
+    if (UNEXPECTED(!str->hash)) {
+        str->hash = lgx_ht_hash(&str->string);
+    }
+    return str->hash;
+}
+
+// 拼接缓冲区的最小长度
+#define LGX_STRING_BUFFER_MIN_SIZE 32
+
+// 返回 s1 与 s2 拼接后的新字符串。
+// s1 由拼接产生并且位于缓冲区末尾时，直接在缓冲区中追加，循环拼接的总开销为线性
+lgx_string_t* lgx_string_concat(lgx_string_t* s1, lgx_string_t* s2);
+
+// 返回与 s 内容相同的驻留字符串，不存在时创建
+lgx_string_t* lgx_string_intern(lgx_str_t* s);
+void lgx_string_intern_cleanup();
+
 lgx_array_t* lgx_array_new();
+int lgx_array_init(lgx_array_t* arr, unsigned size);
+// 初始化为元素类型为 kind（T_LONG 或 T_DOUBLE）的连续数组，包含 length 个尚未赋值的元素
+int lgx_array_init_kind(lgx_array_t* arr, unsigned kind, unsigned length);
 void lgx_array_cleanup(lgx_array_t* arr);
+void lgx_array_drop_shared(lgx_array_t* arr);
 void lgx_array_value_cleanup(lgx_ht_t* arr);
 int lgx_array_dup(lgx_array_t* src, lgx_array_t* dst);
+// 存储被共享时为 arr 复制独立的存储，调用前 arr->shared 必须不为 NULL
+int lgx_array_unshare(lgx_array_t* arr);
+
+// 连续存储的数组初始分配的元素个数
+#define LGX_ARRAY_MIN_SIZE 8
+
+// 数组是否仍然使用连续存储
+#define lgx_array_is_packed(arr) (!(arr)->table.size)
+
+#define lgx_array_length(arr) (lgx_array_is_packed(arr) ? (arr)->length : (arr)->table.length)
+
+// 整数下标在哈希表中使用 8 字节的二进制作为键
+static lgx_inline void lgx_array_key(lgx_str_t* key, long long* num) {
+    key->buffer = (char *)num;
+    key->length = sizeof(*num);
+    key->size = 0;
+}
+
+// 不存在时返回 NULL。hash 必须等于 lgx_ht_hash(k)
+lgx_value_t* lgx_array_get_str(lgx_array_t* arr, lgx_str_t* k, unsigned hash);
+
+// 读取连续存储中的第 i 个元素，i 必须小于 arr->length
+static lgx_inline void lgx_array_packed_get(lgx_array_t* arr, unsigned i, lgx_value_t* dst) {
+    switch (arr->kind) {
+        case T_LONG:
+            lgx_value_set_long(dst, arr->longs[i]);
+            break;
+        case T_DOUBLE:
+            lgx_value_set_double(dst, arr->doubles[i]);
+            break;
+        default:
+            *dst = arr->values[i];
+    }
+}
+
+// 读取到的数组或 map 可能随后被修改，例如 a[i][j] = v。如果 arr 的存储仍然被共享，
+// 该元素同时属于其它数组，需要先为 arr 复制独立的存储，再重新读取。复制失败时仍然返回共享的元素
+#define lgx_array_elem_unshare(arr, v) \
+    (UNEXPECTED((arr)->shared) && (lgx_value_type(v) == T_ARRAY || lgx_value_type(v) == T_MAP))
+
+// 元素不存在时返回 1。dst 与数组中的元素共享内容，不需要释放
+static lgx_inline int lgx_array_get_long(lgx_array_t* arr, long long k, lgx_value_t* dst) {
+    if (EXPECTED(lgx_array_is_packed(arr))) {
+        if ((unsigned long long)k >= arr->length) {
+            return 1;
+        }
+        lgx_array_packed_get(arr, k, dst);
+    } else {
+        lgx_str_t key;
+        lgx_array_key(&key, &k);
+        lgx_ht_node_t* n = lgx_ht_get(&arr->table, &key);
+        if (!n) {
+            return 1;
+        }
+        *dst = *(lgx_value_t*)n->v;
+    }
+
+    if (lgx_array_elem_unshare(arr, dst) && !lgx_array_unshare(arr)) {
+        return lgx_array_get_long(arr, k, dst);
+    }
+    return 0;
+}
+
+// 成功时 v 的内容转移给数组，数组中原有的值会被释放
+// 成功返回 0，失败返回 1
+int lgx_array_set_long(lgx_array_t* arr, long long k, lgx_value_t* v);
+int lgx_array_set_str(lgx_array_t* arr, lgx_str_t* k, unsigned hash, lgx_value_t* v);
+
+// 使用字符串值作为下标，驻留字符串会被直接引用而不复制
+static lgx_inline lgx_value_t* lgx_array_get_string(lgx_array_t* arr, lgx_string_t* k) {
+    lgx_value_t* v = lgx_array_get_str(arr, &k->string, lgx_string_hash(k));
+    if (v && lgx_array_elem_unshare(arr, v) && !lgx_array_unshare(arr)) {
+        v = lgx_array_get_str(arr, &k->string, lgx_string_hash(k));
+    }
+    return v;
+}
+int lgx_array_set_string(lgx_array_t* arr, lgx_string_t* k, lgx_value_t* v);
+int lgx_array_append(lgx_array_t* arr, lgx_value_t* v);
+
+lgx_map_t* lgx_map_new();
+// key 为键的类型：T_LONG 或 T_STRING。新创建的 map 使用哈希表保存
+int lgx_map_init(lgx_map_t* map, unsigned key, unsigned size);
+void lgx_map_cleanup(lgx_map_t* map);
+// dst 必须是新创建的 map，复制 src 的全部元素
+void lgx_map_drop_shared(lgx_map_t* map);
+int lgx_map_dup(lgx_map_t* src, lgx_map_t* dst);
+// 存储被共享时为 map 复制独立的存储，调用前 map->shared 必须不为 NULL
+int lgx_map_unshare(lgx_map_t* map);
+void lgx_map_print(lgx_map_t* map);
+
+#define lgx_map_length(map) ((map)->ordered ? (map)->tree.size : (map)->table.length)
+
+// 生成查找使用的键，k 的类型必须与 map 的键类型一致。整数键以 8 字节的二进制保存在 num 中
+static lgx_inline void lgx_map_key(lgx_value_t* k, long long* num, lgx_str_t* key) {
+    if (lgx_value_type(k) == T_LONG) {
+        *num = lgx_value_long(k);
+        lgx_array_key(key, num);
+    } else {
+        *key = lgx_value_str(k)->string;
+    }
+}
+
+// 把 map 中保存的键转换为值。字符串键会创建新的字符串，需要由调用者加入 GC 跟踪
+int lgx_map_key_value(lgx_map_t* map, lgx_str_t* key, lgx_value_t* v);
+
+// 读取到的数组或 map 可能随后被修改，规则与 lgx_array_elem_unshare 相同
+#define lgx_map_elem_unshare(map, v) lgx_array_elem_unshare(map, v)
+
+// 不存在时返回 NULL
+lgx_value_t* lgx_map_get(lgx_map_t* map, lgx_value_t* k);
+// 成功时 v 的内容转移给 map，map 中原有的值会被释放。成功返回 0，失败返回 1
+int lgx_map_set(lgx_map_t* map, lgx_value_t* k, lgx_value_t* v);
+// 删除成功返回 0，键不存在时返回 1
+int lgx_map_del(lgx_map_t* map, lgx_value_t* k);
+
+// 转为按键排序的红黑树保存，之后可以通过 tree 进行范围查询。成功返回 0，失败返回 1
+int lgx_map_order(lgx_map_t* map);
+// dst 必须是新创建的 map，复制有序的 src 中键在 [lo, hi) 范围内的元素，结果同样是有序的
+int lgx_map_range(lgx_map_t* src, lgx_value_t* lo, lgx_value_t* hi, lgx_map_t* dst);
+
+// 遍历 map：有序的 map 按照键的升序，否则按照插入顺序。
+// 迭代器需要初始化为 0，每次调用 lgx_map_next 后 k 与 v 指向下一个元素，遍历结束时返回 1。
+// 遍历期间不能修改 map
+typedef struct {
+    lgx_ht_node_t* hn;
+    lgx_rb_node_t* rn;
+
+    lgx_str_t* k;
+    lgx_value_t* v;
+} lgx_map_iter_t;
+
+static lgx_inline int lgx_map_next(lgx_map_t* map, lgx_map_iter_t* it) {
+    if (map->ordered) {
+        it->rn = it->rn ? lgx_rb_next(it->rn) : lgx_rb_first(&map->tree);
+        if (!it->rn) {
+            return 1;
+        }
+        it->k = &it->rn->key;
+        it->v = (lgx_value_t*)it->rn->value;
+    } else {
+        it->hn = it->hn ? lgx_ht_next(it->hn) : lgx_ht_first(&map->table);
+        if (!it->hn) {
+            return 1;
+        }
+        it->k = &it->hn->k;
+        it->v = (lgx_value_t*)it->hn->v;
+    }
+    return 0;
+}
 
 lgx_function_t* lgx_fucntion_new();
 void lgx_function_cleanup(lgx_function_t* fun);
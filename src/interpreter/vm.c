@@ -1,3 +1,5 @@
+#include <unistd.h>
+
 #include "../common/common.h"
 #include "../common/ht.h"
 #include "../compiler/bytecode.h"
@@ -6,8 +8,169 @@
 #include "value.h"
 #include "gc.h"
 #include "coroutine.h"
-
-#define R(r)  (vm->regs[r])
+#include "../jit/jit.h"
+
+// 解释器循环中使用局部变量 regs 缓存当前寄存器组
+#define R(r)  (regs[r])
+
+// GCC 与 Clang 支持标签地址（computed goto），每条指令执行完毕后直接跳转到下一条指令的
+// 处理代码，使每个操作码拥有独立的间接跳转，便于分支预测。其它编译器使用 switch 分发。
+// 定义 LGX_VM_SWITCH_DISPATCH 可以强制使用 switch 分发。
+#if defined(__GNUC__) && !defined(LGX_VM_SWITCH_DISPATCH)
+#define LGX_VM_THREADED
+#endif
+
+// 读取并解码下一条指令
+// pd 和 pe 较少使用，所以不默认解析
+#define VM_FETCH() do {                 \
+        i = *ip++;                      \
+        op = OP(i);                     \
+        pa = PA(i);                     \
+        pb = PB(i);                     \
+        pc = PC(i);                     \
+        ++ count;                       \
+    } while (0)
+
+#ifdef LGX_VM_THREADED
+#define VM_SWITCH(op)   goto *table[op];
+#define VM_CASE(op)     L_##op:
+#define VM_DEFAULT      L_DEFAULT:
+#define VM_NEXT         do { VM_FETCH(); goto *table[op]; } while (0)
+#else
+#define VM_SWITCH(op)   switch (op)
+#define VM_CASE(op)     case op:
+#define VM_DEFAULT      default:
+#define VM_NEXT         break
+#endif
+
+// 指令指针 ip 与寄存器组 regs 缓存在局部变量中，仅在函数调用、抛出异常、协程切换等
+// 可能读取或修改协程状态的位置与 lgx_co_t 同步：
+// VM_SAVE 把 ip 写回协程，VM_LOAD 重新读取 ip 与 regs
+#define VM_SAVE() do {                              \
+        vm->co_running->pc = ip - bc;               \
+    } while (0)
+
+#define VM_LOAD() do {                              \
+        ip = bc + vm->co_running->pc;               \
+        regs = vm->regs;                            \
+    } while (0)
+
+// 当前函数已经被 JIT 编译时，转入机器码执行
+// 机器码在遇到需要由解释器执行的指令时返回，之后重新读取 pc 与寄存器组
+#define VM_JIT() do {                               \
+        lgx_jit_function_t *jit = lgx_value_fun(&R(0))->jit; \
+        if (UNEXPECTED(jit && jit->code)) {         \
+            VM_SAVE();                              \
+            lgx_jit_execute(vm, lgx_value_fun(&R(0)));  \
+            VM_LOAD();                              \
+        }                                           \
+    } while (0)
+
+// 进入函数时累加调用计数，达到阈值时编译函数
+#define VM_JIT_COUNT(fun) do {                      \
+        lgx_jit_function_t *jit = (fun)->jit;       \
+        if (UNEXPECTED(jit && jit->calls < vm->jit.threshold && ++jit->calls == vm->jit.threshold)) { \
+            lgx_jit_compile(vm, fun);               \
+        }                                           \
+    } while (0)
+
+// 循环回边：循环入口已经编译为 trace 时转入机器码执行，否则累加执行次数，
+// 达到阈值时开始记录下一次迭代执行的指令
+#define VM_LOOP() do {                              \
+        lgx_jit_loop_t *loop = &vm->jit.loops[ip - bc]; \
+        if (UNEXPECTED(loop->trace != NULL)) {      \
+            VM_SAVE();                              \
+            lgx_jit_trace_execute(vm, loop->trace); \
+            VM_LOAD();                              \
+        } else if (UNEXPECTED(loop->count < vm->jit.trace_threshold && ++loop->count == vm->jit.trace_threshold)) { \
+            if (lgx_jit_trace_start(vm, ip - bc) == 0) { \
+                VM_RECORD();                        \
+            }                                       \
+        }                                           \
+    } while (0)
+
+// 跳转到 target，向后跳转时视为循环回边
+#define VM_JUMP(target) do {                        \
+        unsigned *to = (target);                    \
+        if (to < ip) {                              \
+            ip = to;                                \
+            VM_LOOP();                              \
+        } else {                                    \
+            ip = to;                                \
+        }                                           \
+    } while (0)
+
+// 记录 trace 时每条指令执行前先交给 lgx_jit_trace_record 记录
+// computed goto 通过切换分发表实现，不记录时没有额外开销
+#ifdef LGX_VM_THREADED
+#define VM_RECORD() do {                            \
+        table = record;                             \
+    } while (0)
+#else
+#define VM_RECORD()
+#endif
+
+// 抛出异常会修改 pc 与寄存器组，所以需要先写回再重新读取
+// catch block 可能位于已编译的函数中
+#define VM_CATCH() do {                             \
+        VM_LOAD();                                  \
+        VM_JIT();                                   \
+    } while (0)
+
+#define VM_THROW_S(...) do {                        \
+        VM_SAVE();                                  \
+        lgx_vm_throw_s(vm, __VA_ARGS__);            \
+        VM_CATCH();                                 \
+    } while (0)
+
+#define VM_THROW_V(v) do {                          \
+        VM_SAVE();                                  \
+        lgx_vm_throw_v(vm, v);                      \
+        VM_CATCH();                                 \
+    } while (0)
+
+// 写入整数运算的结果。NaN-boxing 时结果超出 T_LONG 的范围抛出异常，而不是截断
+#define VM_SET_LONG(r, l) do {                      \
+        long long _l = (l);                         \
+        if (UNEXPECTED(!lgx_long_fits(_l))) {       \
+            VM_THROW_S("integer overflow");         \
+        } else {                                    \
+            lgx_value_set_long(r, _l);              \
+        }                                           \
+    } while (0)
+
+// 改写当前正在执行的指令的操作码（快速化）
+// 通用指令观察到操作数类型后，把自身替换为对应的特化指令；特化指令的类型检查失败时，
+// 恢复为通用指令并重新执行。同一条指令恢复的次数达到 LGX_VM_DEOPT_LIMIT 后，
+// 说明操作数的类型在变化，该指令保持为通用指令，不再改写
+#define VM_REWRITE(op) do {                                         \
+        if (EXPECTED(vm->deopt[ip - bc - 1] < LGX_VM_DEOPT_LIMIT)) { \
+            ip[-1] = (ip[-1] & 0xFFFFFF00) | (op);                  \
+        }                                                           \
+    } while (0)
+
+#define VM_DEOPT(op) do {                                           \
+        ++ vm->deopt[ip - bc - 1];                                  \
+        ip[-1] = (ip[-1] & 0xFFFFFF00) | (op);                      \
+        -- ip;                                                      \
+    } while (0)
+
+// 比较跳转指令：条件成立时跳转到第二个字（JMPI）指定的位置，否则跳过第二个字
+#define VM_BRANCH(cond) do {                        \
+        if (cond) {                                 \
+            VM_JUMP(bc + PE(*ip));                  \
+        } else {                                    \
+            ++ ip;                                  \
+        }                                           \
+    } while (0)
+
+// 退出解释器循环，同时累加执行的指令数
+// 尚未完成的 trace 记录不能跨越解释器循环
+#define VM_RETURN(r) do {               \
+        vm->instructions += count;      \
+        lgx_jit_trace_abort(vm);        \
+        return r;                       \
+    } while (0)
 
 void lgx_vm_throw(lgx_vm_t *vm, lgx_value_t *e) {
     assert(vm->co_running);
@@ -16,23 +179,27 @@ void lgx_vm_throw(lgx_vm_t *vm, lgx_value_t *e) {
 }
 
 void lgx_vm_throw_s(lgx_vm_t *vm, const char *fmt, ...) {
-    char *buf = (char *)xmalloc(128);
-    if (!buf) {
-        return;
-    }
+    char buf[128];
 
     va_list args;
     va_start(args, fmt);
-    int len = vsnprintf(buf, 128, fmt, args);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
     va_end(args);
 
+    if (len < 0) {
+        len = 0;
+    } else if (len >= (int)sizeof(buf)) {
+        len = sizeof(buf) - 1;
+    }
+
+    lgx_string_t *str = lgx_string_create(buf, len);
+    if (!str) {
+        return;
+    }
+    str->gc.type.type = T_STRING;
+
     lgx_value_t e;
-    e.type = T_STRING;
-    e.v.str = xcalloc(1, sizeof(lgx_string_t));
-    e.v.str->gc.type.type = T_STRING;
-    e.v.str->string.length = len;
-    e.v.str->string.size = 128;
-    e.v.str->string.buffer = buf;
+    lgx_value_set_str(&e, str);
 
     lgx_gc_trace(vm, &e);
 
@@ -44,7 +211,7 @@ void lgx_vm_throw_v(lgx_vm_t *vm, lgx_value_t *v) {
     e = *v;
 
     // 把原始变量标记为 unknown，避免 exception 值被释放
-    v->type = T_UNKNOWN;
+    lgx_value_set_unknown(v);
 
     lgx_vm_throw(vm, &e);
 }
@@ -55,9 +222,33 @@ int lgx_vm_init(lgx_vm_t *vm, lgx_compiler_t *c) {
     lgx_list_init(&vm->co_died);
 
     lgx_list_init(&vm->heap.young);
+    lgx_list_init(&vm->heap.aging);
     lgx_list_init(&vm->heap.old);
     vm->heap.young_size = 0;
+    vm->heap.young_color = LGX_GC_YOUNG;
+    vm->heap.aging_roots = NULL;
     vm->heap.old_size = 0;
+    vm->heap.old_limit = LGX_GC_OLD_LIMIT;
+    vm->heap.pause = LGX_GC_PAUSE;
+    vm->heap.phase = LGX_GC_IDLE;
+    vm->heap.black = 0;
+    vm->heap.cursor = NULL;
+    vm->heap.grey = NULL;
+    vm->heap.grey_length = 0;
+    vm->heap.grey_size = 0;
+    vm->heap.live_size = 0;
+    vm->heap.next_step = LGX_GC_YOUNG_LIMIT;
+    memset(&vm->heap.roots, 0, sizeof(lgx_gc_roots_t));
+    memset(&vm->heap.snapshot, 0, sizeof(lgx_gc_roots_t));
+    memset(&vm->heap.free, 0, sizeof(vm->heap.free));
+    // 只有一个 CPU 时后台线程无法与脚本并行执行
+    vm->heap.free.enable = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+    vm->heap.minor_count = 0;
+    vm->heap.full_count = 0;
+    vm->heap.max_pause = 0;
+    vm->heap.max_scan = 0;
+
+    vm->gc_enable = 1;
 
     vm->c = c;
     vm->exception = &c->exception;
@@ -84,7 +275,15 @@ int lgx_vm_init(lgx_vm_t *vm, lgx_compiler_t *c) {
 
     vm->co_running = NULL;
 
-    return 0;
+    vm->instructions = 0;
+
+    // 每条指令的特化失败次数
+    vm->deopt = xcalloc(c->bc.length ? c->bc.length : 1, sizeof(unsigned char));
+    if (!vm->deopt) {
+        return 1;
+    }
+
+    return lgx_jit_init(vm);
 }
 
 
@@ -102,21 +301,30 @@ int lgx_vm_call(lgx_vm_t *vm, lgx_function_t *fun) {
 int lgx_vm_cleanup(lgx_vm_t *vm) {
     // TODO 释放消息队列
 
+    lgx_gc_stop(vm);
+
     // TODO 回收所有内存
     lgx_list_t *list = vm->heap.young.next;
     while(list != &vm->heap.young) {
         lgx_list_t *next = list->next;
-        lgx_gc_cleanup((lgx_gc_t*)list);
-        xfree(list);
+        lgx_gc_release((lgx_gc_t*)list);
+        list = next;
+    }
+    list = vm->heap.aging.next;
+    while(list != &vm->heap.aging) {
+        lgx_list_t *next = list->next;
+        lgx_gc_release((lgx_gc_t*)list);
         list = next;
     }
     list = vm->heap.old.next;
     while(list != &vm->heap.old) {
         lgx_list_t *next = list->next;
-        lgx_gc_cleanup((lgx_gc_t*)list);
-        xfree(list);
+        lgx_gc_release((lgx_gc_t*)list);
         list = next;
     }
+    xfree(vm->heap.roots.slots);
+    xfree(vm->heap.snapshot.slots);
+    xfree(vm->heap.grey);
 
     // 释放常量表
     xfree(vm->constant);
@@ -124,6 +332,10 @@ int lgx_vm_cleanup(lgx_vm_t *vm) {
     // 释放全局变量
     xfree(vm->global);
 
+    xfree(vm->deopt);
+
+    lgx_jit_cleanup(vm);
+
     memset(vm, 0, sizeof(lgx_vm_t));
 
     return 0;
@@ -141,6 +353,227 @@ int lgx_vm_checkstack(lgx_vm_t *vm, unsigned int stack_size) {
     }
 }
 
+// 以下函数实现需要调用运行时的指令，由解释器与 JIT 共用
+// 调用前需要把 pc 写回协程，返回值不为 0 时表示抛出了异常，需要重新读取 pc 与寄存器组
+
+int lgx_vm_array_new(lgx_vm_t *vm, lgx_value_t *dst) {
+    lgx_array_t *arr = lgx_array_new();
+    if (UNEXPECTED(!arr)) {
+        lgx_value_set_unknown(dst);
+        lgx_vm_throw_s(vm, "out of memory");
+        return 1;
+    }
+    if (lgx_type_init(&arr->gc.type, T_ARRAY)) {
+        lgx_value_set_unknown(dst);
+        xfree(arr);
+        lgx_vm_throw_s(vm, "out of memory");
+        return 1;
+    }
+    if (lgx_array_init(arr, 0)) {
+        lgx_type_cleanup(&arr->gc.type);
+        lgx_value_set_unknown(dst);
+        xfree(arr);
+        lgx_vm_throw_s(vm, "out of memory");
+        return 1;
+    }
+
+    lgx_value_set_arr(dst, arr);
+
+    lgx_gc_trace(vm, dst);
+    return 0;
+}
+
+int lgx_vm_array_get(lgx_vm_t *vm, lgx_value_t *dst, lgx_value_t *arr, lgx_value_t *k) {
+    if (EXPECTED(lgx_value_type(arr) == T_ARRAY)) {
+        if (EXPECTED(lgx_value_type(k) == T_LONG || lgx_value_type(k) == T_STRING)) {
+            if (lgx_value_type(k) == T_STRING) {
+                lgx_value_t *v = lgx_array_get_string(lgx_value_arr(arr), lgx_value_str(k));
+                if (v) {
+                    *dst = *v;
+                } else {
+                    // TODO runtime warning
+                    lgx_value_set_null(dst);
+                }
+            } else if (lgx_array_get_long(lgx_value_arr(arr), lgx_value_long(k), dst)) {
+                // TODO runtime warning
+                lgx_value_set_null(dst);
+            }
+        } else {
+            // runtime warning
+            //lgx_vm_throw_s(vm, "attempt to index a %s key, integer or string expected", lgx_value_typeof(k));
+            lgx_vm_throw_s(vm, "runtime error");
+            return 1;
+        }
+    } else {
+        //lgx_vm_throw_s(vm, "attempt to index a %s value, array expected", lgx_value_typeof(arr));
+        lgx_vm_throw_s(vm, "runtime error");
+        return 1;
+    }
+    return 0;
+}
+
+// k 为 NULL 时追加到数组末尾
+// 覆盖数组中 k 对应的元素之前调用：执行写屏障，并保留可能已经被读入寄存器的原来的值。
+// 存储仍然被其它数组共享时，修改前会先复制，原来的值依然由共享的存储持有。
+// 其它共享者都已经释放时，存储只属于该数组，原来的值（例如读入寄存器的字符串）随之释放
+static void vm_array_retain(lgx_vm_t *vm, lgx_array_t *arr, lgx_value_t *k) {
+    int shared = arr->shared && *arr->shared;
+    if (!vm->heap.phase && (shared || (lgx_array_is_packed(arr) && arr->kind != T_UNKNOWN))) {
+        return;
+    }
+
+    lgx_value_t *v = NULL;
+    if (lgx_value_type(k) == T_STRING) {
+        v = lgx_array_get_str(arr, &lgx_value_str(k)->string, lgx_string_hash(lgx_value_str(k)));
+    } else if (lgx_array_is_packed(arr)) {
+        long long i = lgx_value_long(k);
+        if (arr->kind == T_UNKNOWN && (unsigned long long)i < arr->length) {
+            v = &arr->values[i];
+        }
+    } else {
+        long long i = lgx_value_long(k);
+        lgx_str_t key;
+        lgx_array_key(&key, &i);
+        lgx_ht_node_t *n = lgx_ht_get(&arr->table, &key);
+        if (n) {
+            v = (lgx_value_t*)n->v;
+        }
+    }
+    if (v) {
+        lgx_gc_barrier(vm, v);
+        if (!shared) {
+            lgx_gc_retain(vm, v);
+        }
+    }
+}
+
+int lgx_vm_array_set(lgx_vm_t *vm, lgx_value_t *arr, lgx_value_t *k, lgx_value_t *src) {
+    if (EXPECTED(lgx_value_type(arr) == T_ARRAY)) {
+        if (k && lgx_value_type(k) != T_LONG && lgx_value_type(k) != T_STRING) {
+            // runtime warning
+            //lgx_vm_throw_s(vm, "attempt to set a %s key, integer or string expected", lgx_value_typeof(arr));
+            lgx_vm_throw_s(vm, "runtime error");
+            return 1;
+        }
+        lgx_value_t v;
+        if (lgx_value_dup(src, &v)) {
+            lgx_vm_throw_s(vm, "out of memory");
+            return 1;
+        }
+        if (k) {
+            vm_array_retain(vm, lgx_value_arr(arr), k);
+        }
+        size_t size = lgx_gc_size(lgx_value_gc(arr));
+        int ret;
+        if (!k) {
+            ret = lgx_array_append(lgx_value_arr(arr), &v);
+        } else if (lgx_value_type(k) == T_LONG) {
+            ret = lgx_array_set_long(lgx_value_arr(arr), lgx_value_long(k), &v);
+        } else {
+            ret = lgx_array_set_string(lgx_value_arr(arr), lgx_value_str(k), &v);
+        }
+        if (ret) {
+            lgx_value_cleanup(&v);
+            lgx_vm_throw_s(vm, "out of memory");
+            return 1;
+        }
+        lgx_gc_grow(vm, size, lgx_gc_size(lgx_value_gc(arr)));
+    } else {
+        // runtime error
+        //lgx_vm_throw_s(vm, "attempt to set a %s value, array expected", lgx_value_typeof(arr));
+        lgx_vm_throw_s(vm, "runtime error");
+        return 1;
+    }
+    return 0;
+}
+
+// key 为键的类型，T_LONG 或 T_STRING
+int lgx_vm_map_new(lgx_vm_t *vm, lgx_value_t *dst, unsigned key) {
+    lgx_map_t *map = lgx_map_new();
+    if (UNEXPECTED(!map)) {
+        lgx_value_set_unknown(dst);
+        lgx_vm_throw_s(vm, "out of memory");
+        return 1;
+    }
+    if (lgx_type_init(&map->gc.type, T_MAP) || lgx_type_init(&map->gc.type.u.map->key, key) ||
+        lgx_map_init(map, key, 0)) {
+        lgx_map_cleanup(map);
+        lgx_value_set_unknown(dst);
+        xfree(map);
+        lgx_vm_throw_s(vm, "out of memory");
+        return 1;
+    }
+
+    lgx_value_set_map(dst, map);
+
+    lgx_gc_trace(vm, dst);
+    return 0;
+}
+
+// 键的类型由编译器保证与 map 一致
+int lgx_vm_map_get(lgx_vm_t *vm, lgx_value_t *dst, lgx_value_t *map, lgx_value_t *k) {
+    if (UNEXPECTED(lgx_value_type(map) != T_MAP || lgx_value_type(k) != lgx_value_map(map)->key)) {
+        lgx_vm_throw_s(vm, "runtime error");
+        return 1;
+    }
+
+    lgx_value_t *v = lgx_map_get(lgx_value_map(map), k);
+    if (v) {
+        *dst = *v;
+    } else {
+        // TODO runtime warning
+        lgx_value_set_null(dst);
+    }
+    return 0;
+}
+
+int lgx_vm_map_set(lgx_vm_t *vm, lgx_value_t *map, lgx_value_t *k, lgx_value_t *src) {
+    if (UNEXPECTED(lgx_value_type(map) != T_MAP || lgx_value_type(k) != lgx_value_map(map)->key)) {
+        lgx_vm_throw_s(vm, "runtime error");
+        return 1;
+    }
+
+    lgx_value_t v;
+    if (lgx_value_dup(src, &v)) {
+        lgx_vm_throw_s(vm, "out of memory");
+        return 1;
+    }
+    // 写屏障，并保留可能已经被读入寄存器的原来的值。存储仍然被其它 map 共享时，原来的值由共享的存储持有
+    lgx_value_t *old = lgx_map_get(lgx_value_map(map), k);
+    if (old) {
+        lgx_gc_barrier(vm, old);
+        if (!lgx_value_map(map)->shared || !*lgx_value_map(map)->shared) {
+            lgx_gc_retain(vm, old);
+        }
+    }
+    size_t size = lgx_gc_size(lgx_value_gc(map));
+    if (lgx_map_set(lgx_value_map(map), k, &v)) {
+        lgx_value_cleanup(&v);
+        lgx_vm_throw_s(vm, "out of memory");
+        return 1;
+    }
+    lgx_gc_grow(vm, size, lgx_gc_size(lgx_value_gc(map)));
+    return 0;
+}
+
+int lgx_vm_concat(lgx_vm_t *vm, lgx_value_t *dst, lgx_value_t *s1, lgx_value_t *s2) {
+    if (lgx_value_type(s1) == T_STRING && lgx_value_type(s2) == T_STRING) {
+        lgx_string_t *str = lgx_string_concat(lgx_value_str(s1), lgx_value_str(s2));
+        if (str) {
+            lgx_value_set_str(dst, str);
+            lgx_gc_trace(vm, dst);
+        } else {
+            lgx_vm_throw_s(vm, "out of memory");
+            return 1;
+        }
+    } else {
+        //lgx_vm_throw_s(vm, "error operation: %s %s %s", lgx_value_typeof(s1), "-", lgx_value_typeof(s2));
+        lgx_vm_throw_s(vm, "runtime error");
+        return 1;
+    }
+    return 0;
+}
+
 int lgx_vm_execute(lgx_vm_t *vm) {
     if (!vm->co_running) {
         return 0;
@@ -149,390 +582,675 @@ int lgx_vm_execute(lgx_vm_t *vm) {
     lgx_op_t op;
     unsigned i, pa, pb, pc;
     unsigned *bc = vm->c->bc.buffer;
+    unsigned *ip = bc + vm->co_running->pc;
+    lgx_value_t *regs = vm->regs;
+    unsigned long long count = 0;
+
+#ifdef LGX_VM_THREADED
+    // 每个操作码对应一个标签，未定义的操作码统一跳转到 L_DEFAULT
+    static const void *dispatch[256] = {
+        [0 ... 255] = &&L_DEFAULT,
+        [OP_NOP] = &&L_OP_NOP,
+        [OP_LOAD] = &&L_OP_LOAD,
+        [OP_MOV] = &&L_OP_MOV,
+        [OP_MOVI] = &&L_OP_MOVI,
+        [OP_ADD] = &&L_OP_ADD,
+        [OP_ADDI] = &&L_OP_ADDI,
+        [OP_SUB] = &&L_OP_SUB,
+        [OP_SUBI] = &&L_OP_SUBI,
+        [OP_MUL] = &&L_OP_MUL,
+        [OP_MULI] = &&L_OP_MULI,
+        [OP_DIV] = &&L_OP_DIV,
+        [OP_DIVI] = &&L_OP_DIVI,
+        [OP_NEG] = &&L_OP_NEG,
+        [OP_SHL] = &&L_OP_SHL,
+        [OP_SHLI] = &&L_OP_SHLI,
+        [OP_SHR] = &&L_OP_SHR,
+        [OP_SHRI] = &&L_OP_SHRI,
+        [OP_AND] = &&L_OP_AND,
+        [OP_OR] = &&L_OP_OR,
+        [OP_XOR] = &&L_OP_XOR,
+        [OP_NOT] = &&L_OP_NOT,
+        [OP_EQ] = &&L_OP_EQ,
+        [OP_EQI] = &&L_OP_EQI,
+        [OP_LE] = &&L_OP_LE,
+        [OP_LEI] = &&L_OP_LEI,
+        [OP_LT] = &&L_OP_LT,
+        [OP_LTI] = &&L_OP_LTI,
+        [OP_GEI] = &&L_OP_GEI,
+        [OP_GTI] = &&L_OP_GTI,
+        [OP_LNOT] = &&L_OP_LNOT,
+        [OP_IADD] = &&L_OP_IADD,
+        [OP_IADDI] = &&L_OP_IADDI,
+        [OP_ISUB] = &&L_OP_ISUB,
+        [OP_ISUBI] = &&L_OP_ISUBI,
+        [OP_IMUL] = &&L_OP_IMUL,
+        [OP_IMULI] = &&L_OP_IMULI,
+        [OP_IDIV] = &&L_OP_IDIV,
+        [OP_IDIVI] = &&L_OP_IDIVI,
+        [OP_INEG] = &&L_OP_INEG,
+        [OP_IEQ] = &&L_OP_IEQ,
+        [OP_IEQI] = &&L_OP_IEQI,
+        [OP_ILE] = &&L_OP_ILE,
+        [OP_ILEI] = &&L_OP_ILEI,
+        [OP_ILT] = &&L_OP_ILT,
+        [OP_ILTI] = &&L_OP_ILTI,
+        [OP_IGEI] = &&L_OP_IGEI,
+        [OP_IGTI] = &&L_OP_IGTI,
+        [OP_FADD] = &&L_OP_FADD,
+        [OP_FSUB] = &&L_OP_FSUB,
+        [OP_FMUL] = &&L_OP_FMUL,
+        [OP_FDIV] = &&L_OP_FDIV,
+        [OP_FNEG] = &&L_OP_FNEG,
+        [OP_FEQ] = &&L_OP_FEQ,
+        [OP_FLE] = &&L_OP_FLE,
+        [OP_FLT] = &&L_OP_FLT,
+        [OP_ADD_LONG] = &&L_OP_ADD_LONG,
+        [OP_ADD_DOUBLE] = &&L_OP_ADD_DOUBLE,
+        [OP_LT_LONG] = &&L_OP_LT_LONG,
+        [OP_LT_DOUBLE] = &&L_OP_LT_DOUBLE,
+        [OP_ARRAY_GET_LONG] = &&L_OP_ARRAY_GET_LONG,
+        [OP_JLT] = &&L_OP_JLT,
+        [OP_JLE] = &&L_OP_JLE,
+        [OP_JEQ] = &&L_OP_JEQ,
+        [OP_JNE] = &&L_OP_JNE,
+        [OP_JLTI] = &&L_OP_JLTI,
+        [OP_JLEI] = &&L_OP_JLEI,
+        [OP_JGTI] = &&L_OP_JGTI,
+        [OP_JGEI] = &&L_OP_JGEI,
+        [OP_JEQI] = &&L_OP_JEQI,
+        [OP_JNEI] = &&L_OP_JNEI,
+        [OP_INCJMP] = &&L_OP_INCJMP,
+        [OP_TYPEOF] = &&L_OP_TYPEOF,
+        [OP_TEST] = &&L_OP_TEST,
+        [OP_JMP] = &&L_OP_JMP,
+        [OP_JMPI] = &&L_OP_JMPI,
+        [OP_CALL_NEW] = &&L_OP_CALL_NEW,
+        [OP_CALL_SET] = &&L_OP_CALL_SET,
+        [OP_CALL] = &&L_OP_CALL,
+        [OP_RET] = &&L_OP_RET,
+        [OP_TAIL_CALL] = &&L_OP_TAIL_CALL,
+        [OP_CO_CALL] = &&L_OP_CO_CALL,
+        [OP_ARRAY_NEW] = &&L_OP_ARRAY_NEW,
+        [OP_ARRAY_GET] = &&L_OP_ARRAY_GET,
+        [OP_ARRAY_SET] = &&L_OP_ARRAY_SET,
+        [OP_MAP_NEW] = &&L_OP_MAP_NEW,
+        [OP_MAP_GET] = &&L_OP_MAP_GET,
+        [OP_MAP_SET] = &&L_OP_MAP_SET,
+        [OP_GLOBAL_GET] = &&L_OP_GLOBAL_GET,
+        [OP_GLOBAL_SET] = &&L_OP_GLOBAL_SET,
+        [OP_THROW] = &&L_OP_THROW,
+        [OP_CONCAT] = &&L_OP_CONCAT,
+        [OP_ECHO] = &&L_OP_ECHO,
+        [OP_HLT] = &&L_OP_HLT
+    };
+
+    // 记录 trace 时使用的分发表
+    static const void *record[256] = {
+        [0 ... 255] = &&L_RECORD
+    };
+
+    const void **table = dispatch;
+#endif
+
+    // 新创建的协程从函数入口开始执行，挂起的协程从中断处恢复执行
+    if (ip == bc + lgx_value_fun(&R(0))->addr) {
+        VM_JIT_COUNT(lgx_value_fun(&R(0)));
+    }
+    VM_JIT();
 
     for(;;) {
-        i = bc[vm->co_running->pc++];
-
-        // 单步执行
-        //lgx_bc_echo(vm->co_running->pc-1, i);
-        //getchar();
-
-        op = OP(i);
-        pa = PA(i);
-        pb = PB(i);
-        pc = PC(i);
-        // pd 和 pe 较少使用，所以不默认解析
-
-        switch(op) {
-            case OP_MOV:{
-                R(pa).type = R(pb).type;
-                R(pa).v = R(pb).v;
-
-                break;
-            }
-            case OP_MOVI:{
-                R(pa).type = T_LONG;
-                R(pa).v.l = PD(i);
-                break;
-            }
-            case OP_ADD:{
-                if (R(pb).type == T_LONG && R(pc).type == T_LONG) {
-                    R(pa).type = T_LONG;
-                    R(pa).v.l = R(pb).v.l + R(pc).v.l;
-                } else if (R(pb).type == T_DOUBLE && R(pc).type == T_DOUBLE) {
-                    R(pa).type = T_DOUBLE;
-                    R(pa).v.d = R(pb).v.d + R(pc).v.d;
+        VM_FETCH();
+
+#ifndef LGX_VM_THREADED
+        if (UNEXPECTED(vm->jit.recording)) {
+            lgx_jit_trace_record(vm, ip - bc - 1, regs);
+        }
+#endif
+
+        VM_SWITCH(op) {
+#ifdef LGX_VM_THREADED
+            L_RECORD: {
+                if (lgx_jit_trace_record(vm, ip - bc - 1, regs)) {
+                    table = dispatch;
+                }
+                goto *dispatch[op];
+            }
+#endif
+            VM_CASE(OP_MOV) {
+                R(pa) = R(pb);
+                VM_NEXT;
+            }
+            VM_CASE(OP_MOVI) {
+                lgx_value_set_long(&R(pa), PD(i));
+                VM_NEXT;
+            }
+            VM_CASE(OP_ADD) {
+                if (lgx_value_type(&R(pb)) == T_LONG && lgx_value_type(&R(pc)) == T_LONG) {
+                    VM_REWRITE(OP_ADD_LONG);
+                    VM_SET_LONG(&R(pa), lgx_value_long(&R(pb)) + lgx_value_long(&R(pc)));
+                } else if (lgx_value_type(&R(pb)) == T_DOUBLE && lgx_value_type(&R(pc)) == T_DOUBLE) {
+                    VM_REWRITE(OP_ADD_DOUBLE);
+                    lgx_value_set_double(&R(pa), lgx_value_double(&R(pb)) + lgx_value_double(&R(pc)));
                 } else {
                     //lgx_vm_throw_s(vm, "error operation: %s %s %s", lgx_value_typeof(&R(pb)), "+", lgx_value_typeof(&R(pc)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
 ;                }
-                break;
+                VM_NEXT;
             }
-            case OP_SUB:{
-                if (R(pb).type == T_LONG && R(pc).type == T_LONG) {
-                    R(pa).type = T_LONG;
-                    R(pa).v.l = R(pb).v.l - R(pc).v.l;
-                } else if (R(pb).type == T_DOUBLE && R(pc).type == T_DOUBLE) {
-                    R(pa).type = T_DOUBLE;
-                    R(pa).v.d = R(pb).v.d - R(pc).v.d;
+            VM_CASE(OP_SUB) {
+                if (lgx_value_type(&R(pb)) == T_LONG && lgx_value_type(&R(pc)) == T_LONG) {
+                    VM_SET_LONG(&R(pa), lgx_value_long(&R(pb)) - lgx_value_long(&R(pc)));
+                } else if (lgx_value_type(&R(pb)) == T_DOUBLE && lgx_value_type(&R(pc)) == T_DOUBLE) {
+                    lgx_value_set_double(&R(pa), lgx_value_double(&R(pb)) - lgx_value_double(&R(pc)));
                 } else {
                     //lgx_vm_throw_s(vm, "error operation: %s %s %s", lgx_value_typeof(&R(pb)), "-", lgx_value_typeof(&R(pc)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_MUL:{
-                if (R(pb).type == T_LONG && R(pc).type == T_LONG) {
-                    R(pa).type = T_LONG;
-                    R(pa).v.l = R(pb).v.l * R(pc).v.l;
-                } else if (R(pb).type == T_DOUBLE && R(pc).type == T_DOUBLE) {
-                    R(pa).type = T_DOUBLE;
-                    R(pa).v.d = R(pb).v.d * R(pc).v.d;
+            VM_CASE(OP_MUL) {
+                if (lgx_value_type(&R(pb)) == T_LONG && lgx_value_type(&R(pc)) == T_LONG) {
+                    VM_SET_LONG(&R(pa), lgx_value_long(&R(pb)) * lgx_value_long(&R(pc)));
+                } else if (lgx_value_type(&R(pb)) == T_DOUBLE && lgx_value_type(&R(pc)) == T_DOUBLE) {
+                    lgx_value_set_double(&R(pa), lgx_value_double(&R(pb)) * lgx_value_double(&R(pc)));
                 } else {
                     //lgx_vm_throw_s(vm, "error operation: %s %s %s", lgx_value_typeof(&R(pb)), "*", lgx_value_typeof(&R(pc)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_DIV:{
-                if (R(pb).type == T_LONG && R(pc).type == T_LONG) {
-                    if (UNEXPECTED(R(pc).v.l == 0)) {
-                        lgx_vm_throw_s(vm, "division by zero\n");
+            VM_CASE(OP_DIV) {
+                if (lgx_value_type(&R(pb)) == T_LONG && lgx_value_type(&R(pc)) == T_LONG) {
+                    if (UNEXPECTED(lgx_value_long(&R(pc)) == 0)) {
+                        VM_THROW_S("division by zero\n");
                     } else {
-                        R(pa).type = T_LONG;
-                        R(pa).v.l = R(pb).v.l / R(pc).v.l;
+                        VM_SET_LONG(&R(pa), lgx_long_div(lgx_value_long(&R(pb)), lgx_value_long(&R(pc))));
                     }
-                } else if (R(pb).type == T_DOUBLE && R(pc).type == T_DOUBLE) {
-                    if (UNEXPECTED(R(pc).v.d == 0)) {
-                        lgx_vm_throw_s(vm, "division by zero\n");
+                } else if (lgx_value_type(&R(pb)) == T_DOUBLE && lgx_value_type(&R(pc)) == T_DOUBLE) {
+                    if (UNEXPECTED(lgx_value_double(&R(pc)) == 0)) {
+                        VM_THROW_S("division by zero\n");
                     } else {
-                        R(pa).type = T_DOUBLE;
-                        R(pa).v.d = R(pb).v.d / R(pc).v.d;
+                        lgx_value_set_double(&R(pa), lgx_value_double(&R(pb)) / lgx_value_double(&R(pc)));
                     }
                 } else {
                     //lgx_vm_throw_s(vm, "error operation: %s %s %s", lgx_value_typeof(&R(pb)), "/", lgx_value_typeof(&R(pc)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_ADDI:{
-                if (R(pb).type == T_LONG) {
-                    R(pa).type = T_LONG;
-                    R(pa).v.l = R(pb).v.l + pc;
-                } else if (R(pb).type == T_DOUBLE) {
-                    R(pa).type = T_DOUBLE;
-                    R(pa).v.d = R(pb).v.d + pc;
+            VM_CASE(OP_ADDI) {
+                if (lgx_value_type(&R(pb)) == T_LONG) {
+                    VM_SET_LONG(&R(pa), lgx_value_long(&R(pb)) + pc);
+                } else if (lgx_value_type(&R(pb)) == T_DOUBLE) {
+                    lgx_value_set_double(&R(pa), lgx_value_double(&R(pb)) + pc);
                 } else {
                     //lgx_vm_throw_s(vm, "makes number from %s without a cast", lgx_value_typeof(&R(pb)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_SUBI:{
-                if (R(pb).type == T_LONG) {
-                    R(pa).type = T_LONG;
-                    R(pa).v.l = R(pb).v.l - pc;
-                } else if (R(pb).type == T_DOUBLE) {
-                    R(pa).type = T_DOUBLE;
-                    R(pa).v.d = R(pb).v.d - pc;
+            VM_CASE(OP_SUBI) {
+                if (lgx_value_type(&R(pb)) == T_LONG) {
+                    VM_SET_LONG(&R(pa), lgx_value_long(&R(pb)) - pc);
+                } else if (lgx_value_type(&R(pb)) == T_DOUBLE) {
+                    lgx_value_set_double(&R(pa), lgx_value_double(&R(pb)) - pc);
                 } else {
                     //lgx_vm_throw_s(vm, "makes number from %s without a cast", lgx_value_typeof(&R(pb)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_MULI:{
-                if (R(pb).type == T_LONG) {
-                    R(pa).type = T_LONG;
-                    R(pa).v.l = R(pb).v.l * pc;
-                } else if (R(pb).type == T_DOUBLE) {
-                    R(pa).type = T_DOUBLE;
-                    R(pa).v.d = R(pb).v.d * pc;
+            VM_CASE(OP_MULI) {
+                if (lgx_value_type(&R(pb)) == T_LONG) {
+                    VM_SET_LONG(&R(pa), lgx_value_long(&R(pb)) * pc);
+                } else if (lgx_value_type(&R(pb)) == T_DOUBLE) {
+                    lgx_value_set_double(&R(pa), lgx_value_double(&R(pb)) * pc);
                 } else {
                     //lgx_vm_throw_s(vm, "makes number from %s without a cast", lgx_value_typeof(&R(pb)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_DIVI:{
-                if (R(pb).type == T_LONG) {
-                    R(pa).type = T_LONG;
-                    R(pa).v.l = R(pb).v.l / pc;
-                } else if (R(pb).type == T_DOUBLE) {
-                    R(pa).type = T_DOUBLE;
-                    R(pa).v.d = R(pb).v.d / pc;
+            VM_CASE(OP_DIVI) {
+                if (lgx_value_type(&R(pb)) == T_LONG) {
+                    lgx_value_set_long(&R(pa), lgx_value_long(&R(pb)) / pc);
+                } else if (lgx_value_type(&R(pb)) == T_DOUBLE) {
+                    lgx_value_set_double(&R(pa), lgx_value_double(&R(pb)) / pc);
                 } else {
                     //lgx_vm_throw_s(vm, "makes number from %s without a cast", lgx_value_typeof(&R(pb)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_NEG:{
-                if (R(pb).type == T_LONG) {
-                    R(pa).type = T_LONG;
-                    R(pa).v.l = -R(pb).v.l;
-                } else if (R(pb).type == T_DOUBLE) {
-                    R(pa).type = T_LONG;
-                    R(pa).v.d = -R(pb).v.d;
+            VM_CASE(OP_NEG) {
+                if (lgx_value_type(&R(pb)) == T_LONG) {
+                    VM_SET_LONG(&R(pa), -lgx_value_long(&R(pb)));
+                } else if (lgx_value_type(&R(pb)) == T_DOUBLE) {
+                    lgx_value_set_double(&R(pa), -lgx_value_double(&R(pb)));
                 } else {
                     //lgx_vm_throw_s(vm, "makes number from %s without a cast", lgx_value_typeof(&R(pb)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_SHL:{
-                if (EXPECTED(R(pb).type == T_LONG && R(pc).type == T_LONG)) {
-                    R(pa).type = T_LONG;
-                    R(pa).v.l = R(pb).v.l << R(pc).v.l;
+            VM_CASE(OP_SHL) {
+                if (EXPECTED(lgx_value_type(&R(pb)) == T_LONG && lgx_value_type(&R(pc)) == T_LONG)) {
+                    VM_SET_LONG(&R(pa), lgx_value_long(&R(pb)) << lgx_value_long(&R(pc)));
                 } else {
                     //lgx_vm_throw_s(vm, "error operation: %s %s %s", lgx_value_typeof(&R(pb)), "<<", lgx_value_typeof(&R(pc)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_SHR:{
-                if (EXPECTED(R(pb).type == T_LONG && R(pc).type == T_LONG)) {
-                    R(pa).type = T_LONG;
-                    R(pa).v.l = R(pb).v.l >> R(pc).v.l;
+            VM_CASE(OP_SHR) {
+                if (EXPECTED(lgx_value_type(&R(pb)) == T_LONG && lgx_value_type(&R(pc)) == T_LONG)) {
+                    lgx_value_set_long(&R(pa), lgx_value_long(&R(pb)) >> lgx_value_long(&R(pc)));
                 } else {
                     //lgx_vm_throw_s(vm, "error operation: %s %s %s", lgx_value_typeof(&R(pb)), ">>", lgx_value_typeof(&R(pc)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_SHLI:{
-                if (EXPECTED(R(pb).type == T_LONG)) {
-                    R(pa).type = T_LONG;
-                    R(pa).v.l = R(pb).v.l << pc;
+            VM_CASE(OP_SHLI) {
+                if (EXPECTED(lgx_value_type(&R(pb)) == T_LONG)) {
+                    VM_SET_LONG(&R(pa), lgx_value_long(&R(pb)) << pc);
                 } else {
                     //lgx_vm_throw_s(vm, "makes integer from %s without a cast", lgx_value_typeof(&R(pb)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_SHRI:{
-                if (EXPECTED(R(pb).type == T_LONG)) {
-                    R(pa).type = T_LONG;
-                    R(pa).v.l = R(pb).v.l >> pc;
+            VM_CASE(OP_SHRI) {
+                if (EXPECTED(lgx_value_type(&R(pb)) == T_LONG)) {
+                    lgx_value_set_long(&R(pa), lgx_value_long(&R(pb)) >> pc);
                 } else {
                     //lgx_vm_throw_s(vm, "makes integer from %s without a cast", lgx_value_typeof(&R(pb)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_AND:{
-                if (EXPECTED(R(pb).type == T_LONG && R(pc).type == T_LONG)) {
-                    R(pa).type = T_LONG;
-                    R(pa).v.l = R(pb).v.l & R(pc).v.l;
+            VM_CASE(OP_AND) {
+                if (EXPECTED(lgx_value_type(&R(pb)) == T_LONG && lgx_value_type(&R(pc)) == T_LONG)) {
+                    lgx_value_set_long(&R(pa), lgx_value_long(&R(pb)) & lgx_value_long(&R(pc)));
                 } else {
                     //lgx_vm_throw_s(vm, "error operation: %s %s %s", lgx_value_typeof(&R(pb)), "&", lgx_value_typeof(&R(pc)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_OR:{
-                if (EXPECTED(R(pb).type == T_LONG && R(pc).type == T_LONG)) {
-                    R(pa).type = T_LONG;
-                    R(pa).v.l = R(pb).v.l | R(pc).v.l;
+            VM_CASE(OP_OR) {
+                if (EXPECTED(lgx_value_type(&R(pb)) == T_LONG && lgx_value_type(&R(pc)) == T_LONG)) {
+                    lgx_value_set_long(&R(pa), lgx_value_long(&R(pb)) | lgx_value_long(&R(pc)));
                 } else {
                     //lgx_vm_throw_s(vm, "error operation: %s %s %s", lgx_value_typeof(&R(pb)), "|", lgx_value_typeof(&R(pc)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_XOR:{
-                if (EXPECTED(R(pb).type == T_LONG && R(pc).type == T_LONG)) {
-                    R(pa).type = T_LONG;
-                    R(pa).v.l = R(pb).v.l ^ R(pc).v.l;
+            VM_CASE(OP_XOR) {
+                if (EXPECTED(lgx_value_type(&R(pb)) == T_LONG && lgx_value_type(&R(pc)) == T_LONG)) {
+                    lgx_value_set_long(&R(pa), lgx_value_long(&R(pb)) ^ lgx_value_long(&R(pc)));
                 } else {
                     //lgx_vm_throw_s(vm, "error operation: %s %s %s", lgx_value_typeof(&R(pb)), "^", lgx_value_typeof(&R(pc)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_NOT:{
-                if (EXPECTED(R(pb).type == T_LONG)) {
-                    R(pa).type = T_LONG;
-                    R(pa).v.l = ~R(pb).v.l;
+            VM_CASE(OP_NOT) {
+                if (EXPECTED(lgx_value_type(&R(pb)) == T_LONG)) {
+                    lgx_value_set_long(&R(pa), ~lgx_value_long(&R(pb)));
                 } else {
                     //lgx_vm_throw_s(vm, "error operation: %s %s %s", lgx_value_typeof(&R(pb)), "~", lgx_value_typeof(&R(pc)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_EQ:{
-                R(pa).type = T_BOOL;
-
+            VM_CASE(OP_EQ) {
                 if (lgx_value_cmp(&R(pb), &R(pc))) {
-                    R(pa).v.l = 1;
+                    lgx_value_set_bool(&R(pa), 1);
                 } else {
-                    R(pa).v.l = 0;
+                    lgx_value_set_bool(&R(pa), 0);
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_LE:{
-                R(pa).type = T_BOOL;
-
-                if (R(pb).type == T_LONG && R(pc).type == T_LONG) {
-                    R(pa).v.l = R(pb).v.l <= R(pc).v.l;
-                } else if (R(pb).type == T_DOUBLE && R(pc).type == T_DOUBLE) {
-                    R(pa).v.l = R(pb).v.d <= R(pc).v.d;
+            VM_CASE(OP_LE) {
+                if (lgx_value_type(&R(pb)) == T_LONG && lgx_value_type(&R(pc)) == T_LONG) {
+                    lgx_value_set_bool(&R(pa), lgx_value_long(&R(pb)) <= lgx_value_long(&R(pc)));
+                } else if (lgx_value_type(&R(pb)) == T_DOUBLE && lgx_value_type(&R(pc)) == T_DOUBLE) {
+                    lgx_value_set_bool(&R(pa), lgx_value_double(&R(pb)) <= lgx_value_double(&R(pc)));
                 } else {
                     // 类型转换
+                    lgx_value_set_bool(&R(pa), 0);
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_LT:{
-                R(pa).type = T_BOOL;
-
-                if (R(pb).type == T_LONG && R(pc).type == T_LONG) {
-                    R(pa).v.l = R(pb).v.l < R(pc).v.l;
-                } else if (R(pb).type == T_DOUBLE && R(pc).type == T_DOUBLE) {
-                    R(pa).v.l = R(pb).v.d < R(pc).v.d;
+            VM_CASE(OP_LT) {
+                if (lgx_value_type(&R(pb)) == T_LONG && lgx_value_type(&R(pc)) == T_LONG) {
+                    VM_REWRITE(OP_LT_LONG);
+                    lgx_value_set_bool(&R(pa), lgx_value_long(&R(pb)) < lgx_value_long(&R(pc)));
+                } else if (lgx_value_type(&R(pb)) == T_DOUBLE && lgx_value_type(&R(pc)) == T_DOUBLE) {
+                    VM_REWRITE(OP_LT_DOUBLE);
+                    lgx_value_set_bool(&R(pa), lgx_value_double(&R(pb)) < lgx_value_double(&R(pc)));
                 } else {
                     // 类型转换
+                    lgx_value_set_bool(&R(pa), 0);
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_EQI:{
-                R(pa).type = T_BOOL;
-
-                if (R(pb).type == T_LONG) {
-                    R(pa).v.l = R(pb).v.l == pc;
+            VM_CASE(OP_EQI) {
+                if (lgx_value_type(&R(pb)) == T_LONG) {
+                    lgx_value_set_bool(&R(pa), lgx_value_long(&R(pb)) == pc);
                 } else {
-                    R(pa).v.l = 0;
+                    lgx_value_set_bool(&R(pa), 0);
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_GEI:{
-                R(pa).type = T_BOOL;
-                
-                if (R(pb).type == T_LONG) {
-                    R(pa).v.l = R(pb).v.l >= pc;
-                } else if (R(pb).type == T_DOUBLE) {
-                    R(pa).v.l = R(pb).v.d >= pc;
+            VM_CASE(OP_GEI) {
+                if (lgx_value_type(&R(pb)) == T_LONG) {
+                    lgx_value_set_bool(&R(pa), lgx_value_long(&R(pb)) >= pc);
+                } else if (lgx_value_type(&R(pb)) == T_DOUBLE) {
+                    lgx_value_set_bool(&R(pa), lgx_value_double(&R(pb)) >= pc);
                 } else {
                     //lgx_vm_throw_s(vm, "makes number from %s without a cast", lgx_value_typeof(&R(pb)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_LEI:{
-                R(pa).type = T_BOOL;
-                
-                if (R(pb).type == T_LONG) {
-                    R(pa).v.l = R(pb).v.l <= pc;
-                } else if (R(pb).type == T_DOUBLE) {
-                    R(pa).v.l = R(pb).v.d <= pc;
+            VM_CASE(OP_LEI) {
+                if (lgx_value_type(&R(pb)) == T_LONG) {
+                    lgx_value_set_bool(&R(pa), lgx_value_long(&R(pb)) <= pc);
+                } else if (lgx_value_type(&R(pb)) == T_DOUBLE) {
+                    lgx_value_set_bool(&R(pa), lgx_value_double(&R(pb)) <= pc);
                 } else {
                     //lgx_vm_throw_s(vm, "makes number from %s without a cast", lgx_value_typeof(&R(pb)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_GTI:{
-                R(pa).type = T_BOOL;
-                
-                if (R(pb).type == T_LONG) {
-                    R(pa).v.l = R(pb).v.l > pc;
-                } else if (R(pb).type == T_DOUBLE) {
-                    R(pa).v.l = R(pb).v.d > pc;
+            VM_CASE(OP_GTI) {
+                if (lgx_value_type(&R(pb)) == T_LONG) {
+                    lgx_value_set_bool(&R(pa), lgx_value_long(&R(pb)) > pc);
+                } else if (lgx_value_type(&R(pb)) == T_DOUBLE) {
+                    lgx_value_set_bool(&R(pa), lgx_value_double(&R(pb)) > pc);
                 } else {
                     //lgx_vm_throw_s(vm, "makes number from %s without a cast", lgx_value_typeof(&R(pb)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_LTI:{
-                R(pa).type = T_BOOL;
-                
-                if (R(pb).type == T_LONG) {
-                    R(pa).v.l = R(pb).v.l < pc;
-                } else if (R(pb).type == T_DOUBLE) {
-                    R(pa).v.l = R(pb).v.d < pc;
+            VM_CASE(OP_LTI) {
+                if (lgx_value_type(&R(pb)) == T_LONG) {
+                    lgx_value_set_bool(&R(pa), lgx_value_long(&R(pb)) < pc);
+                } else if (lgx_value_type(&R(pb)) == T_DOUBLE) {
+                    lgx_value_set_bool(&R(pa), lgx_value_double(&R(pb)) < pc);
                 } else {
                     //lgx_vm_throw_s(vm, "makes number from %s without a cast", lgx_value_typeof(&R(pb)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_LNOT:{
-                R(pa).type = T_BOOL;
-
-                if (EXPECTED(R(pb).type == T_BOOL)) {
-                    R(pa).v.l = !R(pb).v.l;
+            VM_CASE(OP_LNOT) {
+                if (EXPECTED(lgx_value_type(&R(pb)) == T_BOOL)) {
+                    lgx_value_set_bool(&R(pa), !lgx_value_bool(&R(pb)));
                 } else {
                     //lgx_vm_throw_s(vm, "makes boolean from %s without a cast", lgx_value_typeof(&R(pb)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
+                }
+                VM_NEXT;
+            }
+            // 以下指令的操作数类型由编译器保证，不检查操作数类型
+            VM_CASE(OP_IADD) {
+                VM_SET_LONG(&R(pa), lgx_value_long(&R(pb)) + lgx_value_long(&R(pc)));
+                VM_NEXT;
+            }
+            VM_CASE(OP_IADDI) {
+                VM_SET_LONG(&R(pa), lgx_value_long(&R(pb)) + pc);
+                VM_NEXT;
+            }
+            VM_CASE(OP_ISUB) {
+                VM_SET_LONG(&R(pa), lgx_value_long(&R(pb)) - lgx_value_long(&R(pc)));
+                VM_NEXT;
+            }
+            VM_CASE(OP_ISUBI) {
+                VM_SET_LONG(&R(pa), lgx_value_long(&R(pb)) - pc);
+                VM_NEXT;
+            }
+            VM_CASE(OP_IMUL) {
+                VM_SET_LONG(&R(pa), lgx_value_long(&R(pb)) * lgx_value_long(&R(pc)));
+                VM_NEXT;
+            }
+            VM_CASE(OP_IMULI) {
+                VM_SET_LONG(&R(pa), lgx_value_long(&R(pb)) * pc);
+                VM_NEXT;
+            }
+            VM_CASE(OP_IDIV) {
+                if (UNEXPECTED(lgx_value_long(&R(pc)) == 0)) {
+                    VM_THROW_S("division by zero\n");
+                } else {
+                    VM_SET_LONG(&R(pa), lgx_long_div(lgx_value_long(&R(pb)), lgx_value_long(&R(pc))));
+                }
+                VM_NEXT;
+            }
+            VM_CASE(OP_IDIVI) {
+                lgx_value_set_long(&R(pa), lgx_value_long(&R(pb)) / pc);
+                VM_NEXT;
+            }
+            VM_CASE(OP_INEG) {
+                VM_SET_LONG(&R(pa), -lgx_value_long(&R(pb)));
+                VM_NEXT;
+            }
+            VM_CASE(OP_IEQ) {
+                lgx_value_set_bool(&R(pa), lgx_value_long(&R(pb)) == lgx_value_long(&R(pc)));
+                VM_NEXT;
+            }
+            VM_CASE(OP_IEQI) {
+                lgx_value_set_bool(&R(pa), lgx_value_long(&R(pb)) == pc);
+                VM_NEXT;
+            }
+            VM_CASE(OP_ILE) {
+                lgx_value_set_bool(&R(pa), lgx_value_long(&R(pb)) <= lgx_value_long(&R(pc)));
+                VM_NEXT;
+            }
+            VM_CASE(OP_ILEI) {
+                lgx_value_set_bool(&R(pa), lgx_value_long(&R(pb)) <= pc);
+                VM_NEXT;
+            }
+            VM_CASE(OP_ILT) {
+                lgx_value_set_bool(&R(pa), lgx_value_long(&R(pb)) < lgx_value_long(&R(pc)));
+                VM_NEXT;
+            }
+            VM_CASE(OP_ILTI) {
+                lgx_value_set_bool(&R(pa), lgx_value_long(&R(pb)) < pc);
+                VM_NEXT;
+            }
+            VM_CASE(OP_IGEI) {
+                lgx_value_set_bool(&R(pa), lgx_value_long(&R(pb)) >= pc);
+                VM_NEXT;
+            }
+            VM_CASE(OP_IGTI) {
+                lgx_value_set_bool(&R(pa), lgx_value_long(&R(pb)) > pc);
+                VM_NEXT;
+            }
+            VM_CASE(OP_FADD) {
+                lgx_value_set_double(&R(pa), lgx_value_double(&R(pb)) + lgx_value_double(&R(pc)));
+                VM_NEXT;
+            }
+            VM_CASE(OP_FSUB) {
+                lgx_value_set_double(&R(pa), lgx_value_double(&R(pb)) - lgx_value_double(&R(pc)));
+                VM_NEXT;
+            }
+            VM_CASE(OP_FMUL) {
+                lgx_value_set_double(&R(pa), lgx_value_double(&R(pb)) * lgx_value_double(&R(pc)));
+                VM_NEXT;
+            }
+            VM_CASE(OP_FDIV) {
+                if (UNEXPECTED(lgx_value_double(&R(pc)) == 0)) {
+                    VM_THROW_S("division by zero\n");
+                } else {
+                    lgx_value_set_double(&R(pa), lgx_value_double(&R(pb)) / lgx_value_double(&R(pc)));
+                }
+                VM_NEXT;
+            }
+            VM_CASE(OP_FNEG) {
+                lgx_value_set_double(&R(pa), -lgx_value_double(&R(pb)));
+                VM_NEXT;
+            }
+            VM_CASE(OP_FEQ) {
+                lgx_value_set_bool(&R(pa), lgx_value_double(&R(pb)) == lgx_value_double(&R(pc)));
+                VM_NEXT;
+            }
+            VM_CASE(OP_FLE) {
+                lgx_value_set_bool(&R(pa), lgx_value_double(&R(pb)) <= lgx_value_double(&R(pc)));
+                VM_NEXT;
+            }
+            VM_CASE(OP_FLT) {
+                lgx_value_set_bool(&R(pa), lgx_value_double(&R(pb)) < lgx_value_double(&R(pc)));
+                VM_NEXT;
+            }
+            // 以下为运行时特化指令，由通用指令改写而来
+            VM_CASE(OP_ADD_LONG) {
+                if (EXPECTED(lgx_value_type(&R(pb)) == T_LONG && lgx_value_type(&R(pc)) == T_LONG)) {
+                    VM_SET_LONG(&R(pa), lgx_value_long(&R(pb)) + lgx_value_long(&R(pc)));
+                } else {
+                    VM_DEOPT(OP_ADD);
+                }
+                VM_NEXT;
+            }
+            VM_CASE(OP_ADD_DOUBLE) {
+                if (EXPECTED(lgx_value_type(&R(pb)) == T_DOUBLE && lgx_value_type(&R(pc)) == T_DOUBLE)) {
+                    lgx_value_set_double(&R(pa), lgx_value_double(&R(pb)) + lgx_value_double(&R(pc)));
+                } else {
+                    VM_DEOPT(OP_ADD);
+                }
+                VM_NEXT;
+            }
+            VM_CASE(OP_LT_LONG) {
+                if (EXPECTED(lgx_value_type(&R(pb)) == T_LONG && lgx_value_type(&R(pc)) == T_LONG)) {
+                    lgx_value_set_bool(&R(pa), lgx_value_long(&R(pb)) < lgx_value_long(&R(pc)));
+                } else {
+                    VM_DEOPT(OP_LT);
+                }
+                VM_NEXT;
+            }
+            VM_CASE(OP_LT_DOUBLE) {
+                if (EXPECTED(lgx_value_type(&R(pb)) == T_DOUBLE && lgx_value_type(&R(pc)) == T_DOUBLE)) {
+                    lgx_value_set_bool(&R(pa), lgx_value_double(&R(pb)) < lgx_value_double(&R(pc)));
+                } else {
+                    VM_DEOPT(OP_LT);
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_TEST:{
-                if (EXPECTED(R(pa).type == T_BOOL)) {
-                    if (!R(pa).v.l) {
-                        vm->co_running->pc += PD(i);
+            VM_CASE(OP_ARRAY_GET_LONG) {
+                if (EXPECTED(lgx_value_type(&R(pb)) == T_ARRAY && lgx_value_type(&R(pc)) == T_LONG)) {
+                    if (lgx_array_get_long(lgx_value_arr(&R(pb)), lgx_value_long(&R(pc)), &R(pa))) {
+                        // TODO runtime warning
+                        lgx_value_set_null(&R(pa));
+                    }
+                } else {
+                    VM_DEOPT(OP_ARRAY_GET);
+                }
+                VM_NEXT;
+            }
+            // 比较跳转指令，操作数类型由编译器保证
+            VM_CASE(OP_JLT) {
+                VM_BRANCH(lgx_value_long(&R(pa)) < lgx_value_long(&R(pb)));
+                VM_NEXT;
+            }
+            VM_CASE(OP_JLE) {
+                VM_BRANCH(lgx_value_long(&R(pa)) <= lgx_value_long(&R(pb)));
+                VM_NEXT;
+            }
+            VM_CASE(OP_JEQ) {
+                VM_BRANCH(lgx_value_long(&R(pa)) == lgx_value_long(&R(pb)));
+                VM_NEXT;
+            }
+            VM_CASE(OP_JNE) {
+                VM_BRANCH(lgx_value_long(&R(pa)) != lgx_value_long(&R(pb)));
+                VM_NEXT;
+            }
+            VM_CASE(OP_JLTI) {
+                VM_BRANCH(lgx_value_long(&R(pa)) < pb);
+                VM_NEXT;
+            }
+            VM_CASE(OP_JLEI) {
+                VM_BRANCH(lgx_value_long(&R(pa)) <= pb);
+                VM_NEXT;
+            }
+            VM_CASE(OP_JGTI) {
+                VM_BRANCH(lgx_value_long(&R(pa)) > pb);
+                VM_NEXT;
+            }
+            VM_CASE(OP_JGEI) {
+                VM_BRANCH(lgx_value_long(&R(pa)) >= pb);
+                VM_NEXT;
+            }
+            VM_CASE(OP_JEQI) {
+                VM_BRANCH(lgx_value_long(&R(pa)) == pb);
+                VM_NEXT;
+            }
+            VM_CASE(OP_JNEI) {
+                VM_BRANCH(lgx_value_long(&R(pa)) != pb);
+                VM_NEXT;
+            }
+            VM_CASE(OP_INCJMP) {
+                if (UNEXPECTED(!lgx_long_fits(lgx_value_long(&R(pa)) + pb))) {
+                    VM_THROW_S("integer overflow");
+                } else {
+                    lgx_value_set_long(&R(pa), lgx_value_long(&R(pa)) + pb);
+                    VM_JUMP(bc + PE(*ip));
+                }
+                VM_NEXT;
+            }
+            VM_CASE(OP_TEST) {
+                if (EXPECTED(lgx_value_type(&R(pa)) == T_BOOL)) {
+                    if (!lgx_value_bool(&R(pa))) {
+                        ip += PD(i);
                     }
                 } else {
                     //lgx_vm_throw_s(vm, "makes boolean from %s without a cast", lgx_value_typeof(&R(pa)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_JMP:{                
-                if (R(pa).type == T_LONG) {
-                    vm->co_running->pc = R(pa).v.l;
+            VM_CASE(OP_JMP) {                
+                if (lgx_value_type(&R(pa)) == T_LONG) {
+                    ip = bc + lgx_value_long(&R(pa));
                 } else {
                     //lgx_vm_throw_s(vm, "makes integer from %s without a cast", lgx_value_typeof(&R(pa)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_JMPI:{
-                vm->co_running->pc = PE(i);
-                break;
+            VM_CASE(OP_JMPI) {
+                VM_JUMP(bc + PE(i));
+                VM_NEXT;
             }
-            case OP_CALL_NEW:{
-                if (EXPECTED(R(pa).type == T_FUNCTION)) {
+            VM_CASE(OP_CALL_NEW) {
+                if (EXPECTED(lgx_value_type(&R(pa)) == T_FUNCTION)) {
                     // 确保空余堆栈空间足够容纳本次函数调用
-                    if (UNEXPECTED(lgx_vm_checkstack(vm, R(pa).v.fun->stack_size) != 0)) {
+                    if (UNEXPECTED(lgx_vm_checkstack(vm, lgx_value_fun(&R(pa))->stack_size) != 0)) {
                         // runtime error
-                        lgx_vm_throw_s(vm, "maximum call stack size exceeded");
+                        VM_THROW_S("maximum call stack size exceeded");
+                    } else {
+                        // 堆栈扩容后寄存器组的地址可能发生变化
+                        regs = vm->regs;
                     }
                 } else {
                     // runtime error
                     //lgx_vm_throw_s(vm, "attempt to call a %s value, function expected", lgx_value_typeof(&R(pa)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_CALL_SET:{
-                R(R(0).v.fun->stack_size + pa) = R(pb);
-                break;
+            VM_CASE(OP_CALL_SET) {
+                R(lgx_value_fun(&R(0))->stack_size + pa) = R(pb);
+                VM_NEXT;
             }
-            case OP_TAIL_CALL:{
-                if (EXPECTED(R(pa).type == T_FUNCTION)) {
-                    lgx_function_t *fun = R(pa).v.fun;
-                    unsigned int base = R(0).v.fun->stack_size;
+            VM_CASE(OP_TAIL_CALL) {
+                if (EXPECTED(lgx_value_type(&R(pa)) == T_FUNCTION)) {
+                    lgx_function_t *fun = lgx_value_fun(&R(pa));
+                    unsigned int base = lgx_value_fun(&R(0))->stack_size;
 
                     R(0) = R(pa);
 
@@ -540,304 +1258,254 @@ int lgx_vm_execute(lgx_vm_t *vm) {
                     int n;
                     for (n = 4; n < 4 + fun->gc.type.u.fun->arg_len + 1; n ++) {
                         R(n) = R(base + n);
-                        R(base + n).type = T_UNKNOWN;
+                        lgx_value_set_unknown(&R(base + n));
                     }
 
                     // 跳转到函数入口
-                    vm->co_running->pc = fun->addr;
+                    ip = bc + fun->addr;
+                    VM_JIT_COUNT(fun);
+                    VM_JIT();
                 } else {
                     // runtime error
                     //lgx_vm_throw_s(vm, "attempt to call a %s value, function expected", lgx_value_typeof(&R(pa)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_CO_CALL:{
-                if (EXPECTED(R(pa).type == T_FUNCTION)) {
-                    lgx_function_t *fun = R(pa).v.fun;
-                    unsigned int base = R(0).v.fun->stack_size;
+            VM_CASE(OP_CO_CALL) {
+                if (EXPECTED(lgx_value_type(&R(pa)) == T_FUNCTION)) {
+                    lgx_function_t *fun = lgx_value_fun(&R(pa));
+                    unsigned int base = lgx_value_fun(&R(0))->stack_size;
 
                     if (fun->buildin) {
+                        VM_SAVE();
                         fun->buildin(vm);
                         // 如果触发了协程切换，则返回
                         if (vm->co_running == NULL) {
-                            return 0;
+                            VM_RETURN(0);
                         }
+                        VM_LOAD();
+                        VM_JIT();
                     } else {
                         lgx_co_t *co = lgx_co_create(vm, fun);
                         if (!co) {
-                            lgx_vm_throw_s(vm, "out of memory");
+                            VM_THROW_S("out of memory");
                         } else {
                             // 复制参数到新的 coroutine 中
                             int n;
                             for (n = 4; n < 4 + fun->gc.type.u.fun->arg_len; n ++) {
                                 co->stack.buf[n] = R(base + n);
-                                R(base + n).type = T_UNKNOWN;
+                                lgx_value_set_unknown(&R(base + n));
                             }
+                            VM_JIT();
                         }
                     }
                 } else {
                     // runtime error
                     //lgx_vm_throw_s(vm, "attempt to call a %s value, function expected", lgx_value_typeof(&R(pa)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_CALL:{
-                if (EXPECTED(R(pb).type == T_FUNCTION)) {
-                    lgx_function_t *fun = R(pb).v.fun;
-                    unsigned int base = R(0).v.fun->stack_size;
+            VM_CASE(OP_CALL) {
+                if (EXPECTED(lgx_value_type(&R(pb)) == T_FUNCTION)) {
+                    lgx_function_t *fun = lgx_value_fun(&R(pb));
+                    unsigned int base = lgx_value_fun(&R(0))->stack_size;
 
                     // 写入函数信息
                     R(base + 0) = R(pb);
 
                     // 写入返回值地址
-                    R(base + 1).type = T_LONG;
-                    R(base + 1).v.l = pa;
+                    lgx_value_set_long(&R(base + 1), pa);
 
                     // 写入返回地址
-                    R(base + 2).type = T_LONG;
-                    R(base + 2).v.l = vm->co_running->pc;
+                    lgx_value_set_long(&R(base + 2), ip - bc);
 
                     // 写入堆栈地址
-                    R(base + 3).type = T_LONG;
-                    R(base + 3).v.l = vm->co_running->stack.base;
+                    lgx_value_set_long(&R(base + 3), vm->co_running->stack.base);
 
                     if (fun->buildin) {
+                        VM_SAVE();
                         fun->buildin(vm);
                         // 如果触发了协程切换，则返回
                         if (vm->co_running == NULL) {
-                            return 0;
+                            VM_RETURN(0);
                         }
+                        VM_LOAD();
+                        VM_JIT();
                     } else {
                         // 切换执行堆栈
-                        vm->co_running->stack.base += R(0).v.fun->stack_size;
-                        vm->regs = vm->co_running->stack.buf + vm->co_running->stack.base;
+                        vm->co_running->stack.base += lgx_value_fun(&R(0))->stack_size;
+                        vm->regs = regs = vm->co_running->stack.buf + vm->co_running->stack.base;
 
                         // 跳转到函数入口
-                        vm->co_running->pc = fun->addr;
+                        ip = bc + fun->addr;
+                        VM_JIT_COUNT(fun);
+                        VM_JIT();
                     }
                 } else {
                     // runtime error
                     //lgx_vm_throw_s(vm, "attempt to call a %s value, function expected", lgx_value_typeof(&R(pb)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    VM_THROW_S("runtime error");
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_RET:{
+            VM_CASE(OP_RET) {
                 // 跳转到调用点
-                long long pc = R(2).v.l;
+                long long ret_pc = lgx_value_long(&R(2));
 
                 // 判断返回值
-                int ret_idx = R(1).v.l;
+                int ret_idx = lgx_value_long(&R(1));
                 int has_ret = pa;
                 lgx_value_t ret_val;
                 if (has_ret) {
                     ret_val = R(pa);
                 }
 
+                // 调用者的堆栈地址
+                long long ret_base = lgx_value_long(&R(3));
+
                 // 释放所有局部变量和临时变量
-                int n;
-                for (n = 0; n < R(0).v.fun->stack_size; n ++) {
-                    R(n).type = T_UNKNOWN;
+                // 释放后不能再读取 R(0) 等寄存器的值，所以先读出栈帧大小
+                int n, size = lgx_value_fun(&R(0))->stack_size;
+                for (n = 0; n < size; n ++) {
+                    lgx_value_set_unknown(&R(n));
                 }
 
                 // 切换执行堆栈
-                if (EXPECTED(pc >= 0)) {
-                    vm->co_running->stack.base = R(3).v.l;
-                    vm->regs = vm->co_running->stack.buf + vm->co_running->stack.base;
+                if (EXPECTED(ret_pc >= 0)) {
+                    vm->co_running->stack.base = ret_base;
+                    vm->regs = regs = vm->co_running->stack.buf + vm->co_running->stack.base;
                 }
 
                 // 写入返回值
                 if (has_ret) {
                     R(ret_idx) = ret_val;
                 } else {
-                    R(ret_idx).type = T_UNKNOWN;
+                    lgx_value_set_unknown(&R(ret_idx));
                 }
 
-                if (UNEXPECTED(pc < 0)) {
+                if (UNEXPECTED(ret_pc < 0)) {
                     // 如果在顶层作用域 return，则终止运行
                     // 此时，寄存器 1 中保存着返回值
+                    VM_SAVE();
                     lgx_co_died(vm);
-                    return 0;
-                } else {
-                    vm->co_running->pc = pc;
-                }
-
-                break;
-            }
-            case OP_ARRAY_SET:{
-                if (EXPECTED(R(pa).type == T_ARRAY)) {
-                    lgx_str_t key;
-                    long long num = pb;
-                    if (num == 0) {
-                        num = R(pa).v.arr->table.length;
-                        key.buffer = (char*)&num;
-                        key.length = sizeof(num);
-                        key.size = 0;
-                    } else if (R(pb).type == T_LONG) {
-                        num = R(pb).v.l;
-                        key.buffer = (char*)&num;
-                        key.length = sizeof(num);
-                        key.size = 0;
-                    } else if (R(pb).type == T_STRING) {
-                        key = R(pb).v.str->string;
-                    } else {
-                        // runtime warning
-                        //lgx_vm_throw_s(vm, "attempt to set a %s key, integer or string expected", lgx_value_typeof(&R(pa)));
-                        lgx_vm_throw_s(vm, "runtime error");
-                        break;
-                    }
-                    lgx_value_t* v = xcalloc(1, sizeof(lgx_value_t));
-                    if (lgx_value_dup(&R(pc), v)) {
-                        xfree(v);
-                        lgx_vm_throw_s(vm, "out of memory");
-                        break;
-                    }
-                    lgx_ht_node_t* n = lgx_ht_get(&R(pa).v.arr->table, &key);
-                    if (n) {
-                        lgx_value_cleanup((lgx_value_t*)n->v);
-                        xfree(n->v);
-                        n->v = v;
-                    } else {
-                        if (lgx_ht_set(&R(pa).v.arr->table, &key, v)) {
-                            lgx_value_cleanup(v);
-                            xfree(v);
-                            lgx_vm_throw_s(vm, "out of memory");
-                            break;
-                        }
-                    }
+                    VM_RETURN(0);
                 } else {
-                    // runtime error
-                    //lgx_vm_throw_s(vm, "attempt to set a %s value, array expected", lgx_value_typeof(&R(pa)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                    ip = bc + ret_pc;
+                    VM_JIT();
                 }
-                break;
+
+                VM_NEXT;
             }
-            case OP_ARRAY_NEW:{
-                R(pa).type = T_ARRAY;
-                R(pa).v.arr = lgx_array_new();
-                if (UNEXPECTED(!R(pa).v.arr)) {
-                    R(pa).type = T_UNKNOWN;
-                    lgx_vm_throw_s(vm, "out of memory");
-                    break;
+            VM_CASE(OP_ARRAY_SET) {
+                VM_SAVE();
+                if (UNEXPECTED(lgx_vm_array_set(vm, &R(pa), pb ? &R(pb) : NULL, &R(pc)))) {
+                    VM_CATCH();
                 }
-                if (lgx_type_init(&R(pa).v.arr->gc.type, T_ARRAY)) {
-                    R(pa).type = T_UNKNOWN;
-                    xfree(R(pa).v.arr);
-                    lgx_vm_throw_s(vm, "out of memory");
-                    break;
+                VM_NEXT;
+            }
+            VM_CASE(OP_ARRAY_NEW) {
+                VM_SAVE();
+                if (UNEXPECTED(lgx_vm_array_new(vm, &R(pa)))) {
+                    VM_CATCH();
                 }
-                if (lgx_ht_init(&R(pa).v.arr->table, 0)) {
-                    R(pa).type = T_UNKNOWN;
-                    xfree(R(pa).v.arr);
-                    lgx_vm_throw_s(vm, "out of memory");
-                    break;
+                VM_NEXT;
+            }
+            VM_CASE(OP_ARRAY_GET) {
+                if (lgx_value_type(&R(pb)) == T_ARRAY && lgx_value_type(&R(pc)) == T_LONG) {
+                    VM_REWRITE(OP_ARRAY_GET_LONG);
                 }
-
-                lgx_gc_trace(vm, &R(pa));
-                break;
-            }
-            case OP_ARRAY_GET:{
-                if (EXPECTED(R(pb).type == T_ARRAY)) {
-                    if (EXPECTED(R(pc).type == T_LONG || R(pc).type == T_STRING)) {
-                        lgx_str_t key;
-                        if (R(pc).type == T_STRING) {
-                            key = R(pc).v.str->string;
-                        } else {
-                            key.buffer = (char*)&R(pc).v.l;
-                            key.length = sizeof(R(pc).v.l);
-                            key.size = 0;
-                        }
-                        lgx_ht_node_t *n = lgx_ht_get(&R(pb).v.arr->table, &key);
-                        if (n) {
-                            R(pa) = *(lgx_value_t*)n->v;
-                        } else {
-                            // TODO runtime warning
-                            R(pa).type = T_NULL;
-                        }
-                    } else {
-                        // runtime warning
-                        //lgx_vm_throw_s(vm, "attempt to index a %s key, integer or string expected", lgx_value_typeof(&R(pc)));
-                        lgx_vm_throw_s(vm, "runtime error");
-                    }
-                } else {
-                    //lgx_vm_throw_s(vm, "attempt to index a %s value, array expected", lgx_value_typeof(&R(pb)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                VM_SAVE();
+                if (UNEXPECTED(lgx_vm_array_get(vm, &R(pa), &R(pb), &R(pc)))) {
+                    VM_CATCH();
+                }
+                VM_NEXT;
+            }
+            VM_CASE(OP_MAP_NEW) {
+                VM_SAVE();
+                if (UNEXPECTED(lgx_vm_map_new(vm, &R(pa), PD(i)))) {
+                    VM_CATCH();
                 }
-                break;
+                VM_NEXT;
             }
-            case OP_LOAD:{
+            VM_CASE(OP_MAP_GET) {
+                VM_SAVE();
+                if (UNEXPECTED(lgx_vm_map_get(vm, &R(pa), &R(pb), &R(pc)))) {
+                    VM_CATCH();
+                }
+                VM_NEXT;
+            }
+            VM_CASE(OP_MAP_SET) {
+                VM_SAVE();
+                if (UNEXPECTED(lgx_vm_map_set(vm, &R(pa), &R(pb), &R(pc)))) {
+                    VM_CATCH();
+                }
+                VM_NEXT;
+            }
+            VM_CASE(OP_LOAD) {
                 unsigned pd = PD(i);
 
                 lgx_value_dup(vm->constant[pd], &R(pa));
                 lgx_gc_trace(vm, &R(pa));
-                break;
+                VM_NEXT;
             }
-            case OP_GLOBAL_GET:{
+            VM_CASE(OP_GLOBAL_GET) {
                 unsigned pd = PD(i);
 
                 R(pa) = vm->global[pd];
-                break;
+                VM_NEXT;
             }
-            case OP_GLOBAL_SET:{
+            VM_CASE(OP_GLOBAL_SET) {
                 unsigned pd = PD(i);
 
+                lgx_gc_barrier(vm, &vm->global[pd]);
                 vm->global[pd] = R(pa);
-                break;
+                VM_NEXT;
             }
-            case OP_THROW: {
-                lgx_vm_throw_v(vm, &R(pa));
-                break;
+            VM_CASE(OP_THROW) {
+                VM_THROW_V(&R(pa));
+                VM_NEXT;
             }
-            case OP_ECHO: {
+            VM_CASE(OP_ECHO) {
                 lgx_value_print(&R(pa));
                 printf("\n");
-                break;
+                VM_NEXT;
             }
-            case OP_NOP: break;
-            case OP_HLT: {
+            VM_CASE(OP_NOP) {
+                VM_NEXT;
+            }
+            VM_CASE(OP_HLT) {
+                VM_SAVE();
+
                 // 释放所有局部变量和临时变量
-                int n;
-                for (n = 0; n < R(0).v.fun->stack_size; n ++) {
-                    R(n).type = T_UNKNOWN;
+                int n, size = lgx_value_fun(&R(0))->stack_size;
+                for (n = 0; n < size; n ++) {
+                    lgx_value_set_unknown(&R(n));
                 }
 
                 // 写入返回值
-                R(1).type = T_UNKNOWN;
+                lgx_value_set_unknown(&R(1));
 
-                return 0;
+                VM_RETURN(0);
             }
-            case OP_TYPEOF:{
+            VM_CASE(OP_TYPEOF) {
                 /*
                 lgx_op_typeof(&R(pa), &R(pb));
                 */
-                break;
-            }
-            case OP_CONCAT:{
-                if (R(pb).type == T_STRING && R(pc).type == T_STRING) {
-                    R(pa).type = T_STRING;
-                    R(pa).v.str = xcalloc(1, sizeof(lgx_string_t));
-                    if (R(pa).v.str) {
-                        if (lgx_str_init(&R(pa).v.str->string, R(pb).v.str->string.length + R(pc).v.str->string.length)) {
-                            xfree(R(pa).v.str);
-                            lgx_vm_throw_s(vm, "out of memory");
-                            break;
-                        }
-                        lgx_str_concat(&R(pb).v.str->string, &R(pa).v.str->string);
-                        lgx_str_concat(&R(pc).v.str->string, &R(pa).v.str->string);
-                        lgx_gc_trace(vm, &R(pa));
-                    } else {
-                        lgx_vm_throw_s(vm, "out of memory");
-                    }
-                } else {
-                    //lgx_vm_throw_s(vm, "error operation: %s %s %s", lgx_value_typeof(&R(pb)), "-", lgx_value_typeof(&R(pc)));
-                    lgx_vm_throw_s(vm, "runtime error");
+                VM_NEXT;
+            }
+            VM_CASE(OP_CONCAT) {
+                VM_SAVE();
+                if (UNEXPECTED(lgx_vm_concat(vm, &R(pa), &R(pb), &R(pc)))) {
+                    VM_CATCH();
                 }
-                break;
+                VM_NEXT;
+            }
+            VM_DEFAULT {
+                VM_THROW_S("unknown op %d @ %d", OP(i), (int)(ip - bc) - 1);
+                VM_NEXT;
             }
-            default:
-                lgx_vm_throw_s(vm, "unknown op %d @ %d", OP(i), vm->co_running->pc - 1);
         }
     }
 
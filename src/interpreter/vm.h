@@ -1,9 +1,14 @@
 #ifndef LGX_VM_H
 #define LGX_VM_H
 
+#include <pthread.h>
+
 #include "../parser/type.h"
 #include "../compiler/compiler.h"
 
+// 特化指令恢复为通用指令的次数达到该值后，不再对该指令进行特化
+#define LGX_VM_DEOPT_LIMIT 4
+
 typedef enum {
     CO_READY,
     CO_RUNNING,
@@ -20,7 +25,21 @@ typedef struct {
     unsigned int base;
 } lgx_co_stack_t;
 
+// GC 根集合：寄存器与全局变量中保存的 GC 对象地址组成的哈希集合
+typedef struct {
+    // 槽位总数，总是 2 的幂
+    size_t size;
+    size_t length;
+    // 已分配的槽位数量
+    size_t capacity;
+    lgx_gc_t **slots;
+} lgx_gc_roots_t;
+
 typedef struct lgx_vm_s lgx_vm_t;
+typedef struct lgx_jit_function_s lgx_jit_function_t;
+typedef struct lgx_jit_trace_s lgx_jit_trace_t;
+typedef struct lgx_jit_loop_s lgx_jit_loop_t;
+typedef struct lgx_jit_recorder_s lgx_jit_recorder_t;
 
 typedef struct lgx_co_s {
     lgx_list_t head;
@@ -65,18 +84,83 @@ struct lgx_vm_s {
 
     // 堆内存
     // 新的 value 会加入新生代链表。每当 young_size 超过阈值，会触发一次 Minor GC，
-    // 清理该内存区，把其中依然存活的 value 移入老年代。
-    // Minor GC 使用 引用计数 算法。
-    // 每当 old_size 超过阈值，会触发一次 Full GC。
-    // Full GC 使用 标记/清除/压缩 算法
-    // 如果 Full GC 触发过于频繁，将会抛出 OutOfMemory 异常。
+    // 扫描根集合后把整个新生代移入 aging，之后分多次处理：依然存活的 value 移入老年代，其余释放。
+    // 扫描根集合之后，不被根引用的对象只可能通过容器再次被读入寄存器，
+    // 而从容器中移除之前会调用 lgx_gc_retain，把它从 aging 移回新生代。
+    // 每当 old_size 超过 old_limit，会以此时的根集合为快照开始清理老年代（Full GC）。
+    // 容器只保存对象的副本，所以 Minor GC 只需要扫描根集合，不需要记录老年代到新生代的引用。
+    // Full GC 使用三色标记，分成多次执行，每次的耗时不超过 pause：
+    // 标记阶段把快照中的老年代对象标记为黑色，并扫描其中的元素，
+    // 被容器共享的对象（例如字符串）标记为灰色放入工作表，之后逐个扫描；
+    // 清除阶段释放仍然为白色的对象。本轮进入老年代的对象直接标记为黑色。
+    // 快照之后，容器中的元素可能先被读入寄存器再被覆盖，
+    // 所以覆盖容器元素与全局变量时由写屏障（lgx_gc_barrier）把原来的值标记为灰色，
+    // 只被容器持有的字符串则改为同时由老年代持有。
     struct {
         // 新生代
         lgx_list_t young;
-        unsigned young_size;
+        size_t young_size;
+        // 新生代对象的颜色，每次 Minor GC 时在 LGX_GC_YOUNG 与 LGX_GC_YOUNG + 1 之间切换，
+        // 以此区分 aging 中的对象
+        unsigned char young_color;
+        // 上一次 Minor GC 时的新生代，处理完毕之前推迟下一次 Minor GC
+        lgx_list_t aging;
+        // 处理 aging 使用的根集合，即上一次 Minor GC 扫描的结果
+        lgx_gc_roots_t *aging_roots;
         // 老年代
         lgx_list_t old;
-        unsigned old_size;
+        size_t old_size;
+        size_t old_limit;
+
+        // 单次 GC 暂停时间的目标（微秒），不包括 Minor GC 扫描根集合的时间。为 0 时每次 GC 一次完成
+        unsigned pause;
+
+        // Full GC 的阶段：LGX_GC_IDLE、LGX_GC_MARK 或 LGX_GC_SWEEP
+        unsigned phase;
+        // 黑色对象的颜色值，每轮 Full GC 开始时翻转，上一轮的黑色对象随之成为白色
+        unsigned char black;
+        // 下一个待标记或清除的老年代对象
+        lgx_list_t *cursor;
+        // 灰色对象的工作表
+        lgx_gc_t **grey;
+        size_t grey_length;
+        size_t grey_size;
+        // 本轮已经清理过的存活对象大小
+        size_t live_size;
+        // young_size 达到该值时执行下一次 GC
+        size_t next_step;
+        // Minor GC 使用的根集合
+        lgx_gc_roots_t roots;
+        // Full GC 开始时的根集合
+        lgx_gc_roots_t snapshot;
+
+        // 后台释放线程
+        // 对象与其它对象共享的部分（字符串、缓冲区与数组存储的共享计数）在当前线程中处理，
+        // 剩余部分只被该对象持有，交给后台线程释放，不会与脚本的执行相互影响
+        struct {
+            // 为 0 时在当前线程中释放
+            unsigned enable;
+            unsigned running;
+            unsigned stop;
+            pthread_t thread;
+            pthread_mutex_t lock;
+            pthread_cond_t cond;
+            // 本次 GC 中收集的对象，通过 head.next 连接，tail 为最后一个对象
+            lgx_gc_t *batch;
+            lgx_gc_t *tail;
+            size_t length;
+            // 等待后台线程释放的对象
+            lgx_gc_t *queue;
+            // 尚未释放完毕的对象数量
+            size_t pending;
+        } free;
+
+        // 统计信息
+        unsigned minor_count;
+        unsigned full_count;
+        unsigned long long max_pause;
+        // Minor GC 扫描根集合的最长时间，该部分不能分步执行
+        unsigned long long max_scan;
     } heap;
 
     // 常量
@@ -92,6 +176,33 @@ struct lgx_vm_s {
 
     // GC 开关
     unsigned gc_enable;
+
+    // 已执行的指令数
+    unsigned long long instructions;
+
+    // 快速化：以 pc 为下标，记录特化指令因类型检查失败恢复为通用指令的次数
+    unsigned char *deopt;
+
+    // JIT
+    struct {
+        // 函数调用次数达到该阈值时编译为机器码，为 0 时关闭 JIT
+        unsigned threshold;
+        // 已编译的函数数量
+        unsigned compiled;
+        // 所有函数的调用计数与编译结果
+        unsigned length;
+        lgx_jit_function_t *functions;
+
+        // 循环回边执行次数达到该阈值时记录 trace，为 0 时关闭 trace
+        unsigned trace_threshold;
+        // 已编译的 trace 数量
+        unsigned traces;
+        // 以循环入口的 pc 为下标
+        lgx_jit_loop_t *loops;
+        // 不为 0 时表示正在记录 trace
+        unsigned recording;
+        lgx_jit_recorder_t *recorder;
+    } jit;
 };
 
 int lgx_vm_init(lgx_vm_t *vm, lgx_compiler_t *c);
@@ -107,4 +218,12 @@ void lgx_vm_throw_v(lgx_vm_t *vm, lgx_value_t *v);
 
 int lgx_vm_checkstack(lgx_vm_t *vm, unsigned int stack_size);
 
+int lgx_vm_array_new(lgx_vm_t *vm, lgx_value_t *dst);
+int lgx_vm_array_get(lgx_vm_t *vm, lgx_value_t *dst, lgx_value_t *arr, lgx_value_t *k);
+int lgx_vm_array_set(lgx_vm_t *vm, lgx_value_t *arr, lgx_value_t *k, lgx_value_t *src);
+int lgx_vm_map_new(lgx_vm_t *vm, lgx_value_t *dst, unsigned key);
+int lgx_vm_map_get(lgx_vm_t *vm, lgx_value_t *dst, lgx_value_t *map, lgx_value_t *k);
+int lgx_vm_map_set(lgx_vm_t *vm, lgx_value_t *map, lgx_value_t *k, lgx_value_t *src);
+int lgx_vm_concat(lgx_vm_t *vm, lgx_value_t *dst, lgx_value_t *s1, lgx_value_t *s2);
+
 #endif // LGX_VM_H
\ No newline at end of file
@@ -0,0 +1,1823 @@
+#include "../common/common.h"
+#include "../compiler/bytecode.h"
+#include "../compiler/constant.h"
+#include "../interpreter/value.h"
+#include "../interpreter/gc.h"
+#include "jit.h"
+
+#ifdef LGX_JIT
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#endif
+
+// trace 的最大指令数
+#define TRACE_LENGTH 512
+// 循环记录失败的次数达到该值后不再记录
+#define TRACE_ABORTS 4
+// trace 在入口处退出的次数达到该值后丢弃
+#define TRACE_MISSES 16
+
+// 记录的指令
+typedef struct {
+    unsigned pc;
+    // 指令执行前 PA、PB、PC 寄存器的类型，不是寄存器或者不需要记录时为 T_UNKNOWN
+    unsigned char types[3];
+} jit_record_t;
+
+struct lgx_jit_recorder_s {
+    // 循环入口
+    unsigned pc;
+    lgx_co_t *co;
+    lgx_function_t *fun;
+
+    // 上一条指令可能的下一条指令位置
+    unsigned next[2];
+
+    unsigned length;
+    jit_record_t insns[TRACE_LENGTH];
+};
+
+int lgx_jit_init(lgx_vm_t *vm) {
+    lgx_ht_node_t* n;
+    unsigned i = 0;
+
+    vm->jit.length = 0;
+    vm->jit.compiled = 0;
+    vm->jit.traces = 0;
+    vm->jit.recording = 0;
+#ifdef LGX_JIT
+    vm->jit.threshold = LGX_JIT_THRESHOLD;
+    vm->jit.trace_threshold = LGX_JIT_TRACE_THRESHOLD;
+#else
+    vm->jit.threshold = 0;
+    vm->jit.trace_threshold = 0;
+#endif
+
+    vm->jit.loops = xcalloc(vm->c->bc.length ? vm->c->bc.length : 1, sizeof(lgx_jit_loop_t));
+    vm->jit.recorder = xmalloc(sizeof(lgx_jit_recorder_t));
+    if (!vm->jit.loops || !vm->jit.recorder) {
+        return 1;
+    }
+
+    for (n = lgx_ht_first(&vm->c->constant); n; n = lgx_ht_next(n)) {
+        lgx_const_t* c = (lgx_const_t*)n->v;
+        if (lgx_value_type(&c->v) == T_FUNCTION && !lgx_value_fun(&c->v)->buildin) {
+            ++vm->jit.length;
+        }
+    }
+
+    vm->jit.functions = xcalloc(vm->jit.length ? vm->jit.length : 1, sizeof(lgx_jit_function_t));
+    if (!vm->jit.functions) {
+        return 1;
+    }
+
+    // 函数在 LOAD 时会被复制，所以调用计数与机器码保存在各个副本共享的结构中
+    for (n = lgx_ht_first(&vm->c->constant); n; n = lgx_ht_next(n)) {
+        lgx_const_t* c = (lgx_const_t*)n->v;
+        if (lgx_value_type(&c->v) == T_FUNCTION && !lgx_value_fun(&c->v)->buildin) {
+            lgx_value_fun(&c->v)->jit = &vm->jit.functions[i ++];
+        }
+    }
+
+    return 0;
+}
+
+void lgx_jit_cleanup(lgx_vm_t *vm) {
+    lgx_ht_node_t* n;
+    unsigned i;
+
+    for (n = lgx_ht_first(&vm->c->constant); n; n = lgx_ht_next(n)) {
+        lgx_const_t* c = (lgx_const_t*)n->v;
+        if (lgx_value_type(&c->v) == T_FUNCTION) {
+            lgx_value_fun(&c->v)->jit = NULL;
+        }
+    }
+
+    for (i = 0; i < vm->jit.length; ++i) {
+        lgx_jit_function_t *jit = &vm->jit.functions[i];
+#ifdef LGX_JIT
+        if (jit->code) {
+            munmap(jit->code, jit->size);
+        }
+#endif
+        xfree(jit->entries);
+    }
+
+    xfree(vm->jit.functions);
+    vm->jit.functions = NULL;
+    vm->jit.length = 0;
+
+    if (vm->jit.loops) {
+        for (i = 0; i < vm->c->bc.length; ++i) {
+            lgx_jit_trace_t *trace = vm->jit.loops[i].trace;
+            if (trace) {
+#ifdef LGX_JIT
+                munmap(trace->code, trace->size);
+#endif
+                xfree(trace);
+            }
+        }
+    }
+
+    xfree(vm->jit.loops);
+    vm->jit.loops = NULL;
+    xfree(vm->jit.recorder);
+    vm->jit.recorder = NULL;
+    vm->jit.recording = 0;
+}
+
+#ifndef LGX_JIT
+
+int lgx_jit_compile(lgx_vm_t *vm, lgx_function_t *fun) {
+    return 1;
+}
+
+void lgx_jit_execute(lgx_vm_t *vm, lgx_function_t *fun) {
+}
+
+int lgx_jit_trace_start(lgx_vm_t *vm, unsigned pc) {
+    return 1;
+}
+
+int lgx_jit_trace_record(lgx_vm_t *vm, unsigned pc, lgx_value_t *regs) {
+    vm->jit.recording = 0;
+    return 1;
+}
+
+void lgx_jit_trace_abort(lgx_vm_t *vm) {
+}
+
+void lgx_jit_trace_execute(lgx_vm_t *vm, lgx_jit_trace_t *trace) {
+}
+
+#else
+
+// 机器码入口：jit_entry_t(vm, regs, target)
+// 序言保存 callee-saved 寄存器后跳转到 target 指向的指令
+typedef void (*jit_entry_t)(lgx_vm_t *vm, lgx_value_t *regs, void *target);
+
+// 通用寄存器编号
+enum {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// 机器码执行期间固定使用的寄存器
+#define REG_VM    RBX   // lgx_vm_t*
+#define REG_REGS  R14   // 当前寄存器组
+#define REG_COUNT R15   // 已执行的指令数
+
+// 条件码
+enum {
+    CC_O, CC_NO, CC_B, CC_AE, CC_E, CC_NE, CC_BE, CC_A,
+    CC_S, CC_NS, CC_P, CC_NP, CC_L, CC_GE, CC_LE, CC_G
+};
+
+// 字节码寄存器在寄存器组中的偏移
+#define OFF_V(r) ((int32_t)((r) * sizeof(lgx_value_t) + offsetof(lgx_value_t, v)))
+#define OFF_T(r) ((int32_t)((r) * sizeof(lgx_value_t) + offsetof(lgx_value_t, type)))
+
+typedef int (*jit_helper_t)();
+
+// 需要在代码生成结束后回填的跳转
+typedef struct {
+    // rel32 在机器码中的位置
+    unsigned at;
+    // 跳转目标的字节码位置
+    unsigned pc;
+    // 不为 NULL 时跳转到调用该函数抛出异常的代码
+    jit_helper_t helper;
+} jit_fixup_t;
+
+typedef struct {
+    unsigned char *buf;
+    unsigned length;
+    unsigned size;
+
+    jit_fixup_t *fixups;
+    unsigned fixups_length;
+    unsigned fixups_size;
+
+    // 退出机器码的代码位置
+    unsigned exit;
+
+    int error;
+} jit_compiler_t;
+
+// 比较运算
+enum {
+    CMP_LT, CMP_LE, CMP_GT, CMP_GE, CMP_EQ, CMP_NE
+};
+
+static const int cmp_cc[] = {
+    [CMP_LT] = CC_L, [CMP_LE] = CC_LE, [CMP_GT] = CC_G,
+    [CMP_GE] = CC_GE, [CMP_EQ] = CC_E, [CMP_NE] = CC_NE
+};
+
+static void emit_byte(jit_compiler_t *j, unsigned char b) {
+    if (j->length == j->size) {
+        unsigned size = j->size ? j->size * 2 : 4096;
+        unsigned char *buf = xrealloc(j->buf, size);
+        if (!buf) {
+            j->error = 1;
+            j->length = 0;
+            return;
+        }
+        j->buf = buf;
+        j->size = size;
+    }
+    j->buf[j->length ++] = b;
+}
+
+static void emit_u32(jit_compiler_t *j, uint32_t v) {
+    int i;
+    for (i = 0; i < 4; ++i) {
+        emit_byte(j, (v >> (i * 8)) & 0xFF);
+    }
+}
+
+static void emit_u64(jit_compiler_t *j, uint64_t v) {
+    emit_u32(j, (uint32_t)v);
+    emit_u32(j, (uint32_t)(v >> 32));
+}
+
+static void emit_rex(jit_compiler_t *j, int w, int reg, int rm) {
+    unsigned char rex = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+    if (rex != 0x40) {
+        emit_byte(j, rex);
+    }
+}
+
+static void emit_opcode(jit_compiler_t *j, unsigned prefix, int w, unsigned op, int reg, int rm) {
+    if (prefix) {
+        emit_byte(j, prefix);
+    }
+    emit_rex(j, w, reg, rm);
+    if (op > 0xFF) {
+        emit_byte(j, op >> 8);
+    }
+    emit_byte(j, op & 0xFF);
+}
+
+// op reg, [base + disp32]
+static void emit_op_mem(jit_compiler_t *j, unsigned prefix, int w, unsigned op, int reg, int base, int32_t disp) {
+    emit_opcode(j, prefix, w, op, reg, base);
+    emit_byte(j, 0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == RSP) {
+        emit_byte(j, 0x24);
+    }
+    emit_u32(j, (uint32_t)disp);
+}
+
+// op reg, rm
+static void emit_op_reg(jit_compiler_t *j, unsigned prefix, int w, unsigned op, int reg, int rm) {
+    emit_opcode(j, prefix, w, op, reg, rm);
+    emit_byte(j, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+static void emit_load(jit_compiler_t *j, int reg, int base, int32_t disp) {
+    emit_op_mem(j, 0, 1, 0x8B, reg, base, disp);
+}
+
+static void emit_store(jit_compiler_t *j, int base, int32_t disp, int reg) {
+    emit_op_mem(j, 0, 1, 0x89, reg, base, disp);
+}
+
+static void emit_mov_imm(jit_compiler_t *j, int reg, uint64_t imm) {
+    emit_rex(j, 1, 0, reg);
+    emit_byte(j, 0xB8 + (reg & 7));
+    emit_u64(j, imm);
+}
+
+// mov dword [base + disp], imm32
+static void emit_store_imm32(jit_compiler_t *j, int base, int32_t disp, uint32_t imm) {
+    emit_op_mem(j, 0, 0, 0xC7, 0, base, disp);
+    emit_u32(j, imm);
+}
+
+// mov qword [base + disp], simm32
+static void emit_store_imm64(jit_compiler_t *j, int base, int32_t disp, int32_t imm) {
+    emit_op_mem(j, 0, 1, 0xC7, 0, base, disp);
+    emit_u32(j, (uint32_t)imm);
+}
+
+// 81 /ext qword [base + disp], simm32
+static void emit_alu_mem_imm(jit_compiler_t *j, int ext, int base, int32_t disp, int32_t imm) {
+    emit_op_mem(j, 0, 1, 0x81, ext, base, disp);
+    emit_u32(j, (uint32_t)imm);
+}
+
+// 81 /ext reg, simm32
+static void emit_alu_reg_imm(jit_compiler_t *j, int ext, int reg, int32_t imm) {
+    emit_op_reg(j, 0, 1, 0x81, ext, reg);
+    emit_u32(j, (uint32_t)imm);
+}
+
+static void emit_store_type(jit_compiler_t *j, unsigned r, lgx_val_type_t type) {
+    emit_store_imm32(j, REG_REGS, OFF_T(r), type);
+}
+
+// cmp dword [regs + type], type
+static void emit_cmp_type(jit_compiler_t *j, unsigned r, lgx_val_type_t type) {
+    emit_op_mem(j, 0, 0, 0x83, 7, REG_REGS, OFF_T(r));
+    emit_byte(j, type);
+}
+
+// setcc al; movzx eax, al
+static void emit_setcc(jit_compiler_t *j, int cc) {
+    emit_byte(j, 0x0F);
+    emit_byte(j, 0x90 + cc);
+    emit_byte(j, 0xC0);
+    emit_byte(j, 0x0F);
+    emit_byte(j, 0xB6);
+    emit_byte(j, 0xC0);
+}
+
+static void emit_call(jit_compiler_t *j, void *fn) {
+    emit_mov_imm(j, RAX, (uint64_t)(uintptr_t)fn);
+    emit_op_reg(j, 0, 0, 0xFF, 2, RAX);
+}
+
+static void emit_jmp_to(jit_compiler_t *j, unsigned target) {
+    emit_byte(j, 0xE9);
+    emit_u32(j, target - (j->length + 4));
+}
+
+static void emit_jcc_to(jit_compiler_t *j, int cc, unsigned target) {
+    emit_byte(j, 0x0F);
+    emit_byte(j, 0x80 + cc);
+    emit_u32(j, target - (j->length + 4));
+}
+
+// 跳转到当前指令之后的位置，返回需要回填的 rel32 位置
+static unsigned emit_jmp_forward(jit_compiler_t *j) {
+    emit_byte(j, 0xE9);
+    emit_u32(j, 0);
+    return j->length - 4;
+}
+
+static unsigned emit_jcc_forward(jit_compiler_t *j, int cc) {
+    emit_byte(j, 0x0F);
+    emit_byte(j, 0x80 + cc);
+    emit_u32(j, 0);
+    return j->length - 4;
+}
+
+static void emit_patch(jit_compiler_t *j, unsigned at) {
+    uint32_t rel = j->length - (at + 4);
+    if (!j->error) {
+        memcpy(j->buf + at, &rel, 4);
+    }
+}
+
+static void add_fixup(jit_compiler_t *j, unsigned at, unsigned pc, jit_helper_t helper) {
+    if (j->fixups_length == j->fixups_size) {
+        unsigned size = j->fixups_size ? j->fixups_size * 2 : 64;
+        jit_fixup_t *fixups = xrealloc(j->fixups, size * sizeof(jit_fixup_t));
+        if (!fixups) {
+            j->error = 1;
+            return;
+        }
+        j->fixups = fixups;
+        j->fixups_size = size;
+    }
+    j->fixups[j->fixups_length].at = at;
+    j->fixups[j->fixups_length].pc = pc;
+    j->fixups[j->fixups_length].helper = helper;
+    ++ j->fixups_length;
+}
+
+// 跳转到字节码 pc 处
+static void emit_branch(jit_compiler_t *j, int cc, unsigned pc) {
+    if (cc < 0) {
+        add_fixup(j, emit_jmp_forward(j), pc, NULL);
+    } else {
+        add_fixup(j, emit_jcc_forward(j, cc), pc, NULL);
+    }
+}
+
+// 条件成立时抛出异常，pc 为当前指令的位置
+static void emit_guard(jit_compiler_t *j, int cc, unsigned pc, jit_helper_t helper) {
+    add_fixup(j, emit_jcc_forward(j, cc), pc, helper);
+}
+
+// 把 pc 写回协程
+static void emit_save_pc(jit_compiler_t *j, unsigned pc) {
+    emit_load(j, RAX, REG_VM, offsetof(lgx_vm_t, co_running));
+    emit_store_imm32(j, RAX, offsetof(lgx_co_t, pc), pc);
+}
+
+// 退出机器码，由解释器从 pc 处继续执行
+static void emit_exit(jit_compiler_t *j, unsigned pc) {
+    emit_save_pc(j, pc);
+    emit_jmp_to(j, j->exit);
+}
+
+// 调用运行时函数，返回值不为 0 时表示抛出了异常，pc 与 vm->regs 已经指向 catch block
+// 运行时函数可能扩容协程栈，所以调用后重新读取寄存器组
+static void emit_helper(jit_compiler_t *j, void *fn) {
+    emit_op_reg(j, 0, 1, 0x89, REG_VM, RDI);
+    emit_call(j, fn);
+    emit_load(j, REG_REGS, REG_VM, offsetof(lgx_vm_t, regs));
+    emit_op_reg(j, 0, 0, 0x85, RAX, RAX);
+    emit_jcc_to(j, CC_NE, j->exit);
+}
+
+// lea reg, [regs + r]
+static void emit_reg_addr(jit_compiler_t *j, int reg, unsigned r) {
+    emit_op_mem(j, 0, 1, 0x8D, reg, REG_REGS, OFF_V(r));
+}
+
+// 复制寄存器（包括类型）
+static void emit_copy(jit_compiler_t *j, int dst_base, int32_t dst, int src_base, int32_t src) {
+    emit_load(j, RAX, src_base, src);
+    emit_load(j, RCX, src_base, src + 8);
+    emit_store(j, dst_base, dst, RAX);
+    emit_store(j, dst_base, dst + 8, RCX);
+}
+
+static int jit_runtime_error(lgx_vm_t *vm) {
+    lgx_vm_throw_s(vm, "runtime error");
+    return 1;
+}
+
+static int jit_division_by_zero(lgx_vm_t *vm) {
+    lgx_vm_throw_s(vm, "division by zero\n");
+    return 1;
+}
+
+static int jit_load(lgx_vm_t *vm, lgx_value_t *dst, unsigned num) {
+    lgx_value_dup(vm->constant[num], dst);
+    lgx_gc_trace(vm, dst);
+    return 0;
+}
+
+static int jit_eq(lgx_vm_t *vm, lgx_value_t *dst, lgx_value_t *a, lgx_value_t *b) {
+    lgx_value_set_bool(dst, lgx_value_cmp(a, b));
+    return 0;
+}
+
+static int jit_echo(lgx_vm_t *vm, lgx_value_t *v) {
+    lgx_value_print(v);
+    printf("\n");
+    return 0;
+}
+
+static int jit_global_barrier(lgx_vm_t *vm, unsigned num) {
+    lgx_gc_shade(vm, &vm->global[num]);
+    return 0;
+}
+
+static int jit_throw(lgx_vm_t *vm, lgx_value_t *v) {
+    lgx_vm_throw_v(vm, v);
+    return 1;
+}
+
+static int jit_call_new(lgx_vm_t *vm, lgx_value_t *f) {
+    if (EXPECTED(lgx_value_type(f) == T_FUNCTION)) {
+        // 确保空余堆栈空间足够容纳本次函数调用
+        if (UNEXPECTED(lgx_vm_checkstack(vm, lgx_value_fun(f)->stack_size) != 0)) {
+            lgx_vm_throw_s(vm, "maximum call stack size exceeded");
+            return 1;
+        }
+    } else {
+        lgx_vm_throw_s(vm, "runtime error");
+        return 1;
+    }
+    return 0;
+}
+
+// 序言与退出代码位于机器码的起始位置
+static void emit_prologue(jit_compiler_t *j) {
+    emit_byte(j, 0x55);                          // push rbp
+    emit_op_reg(j, 0, 1, 0x89, RSP, RBP);        // mov rbp, rsp
+    emit_byte(j, 0x53);                          // push rbx
+    emit_byte(j, 0x41); emit_byte(j, 0x56);      // push r14
+    emit_byte(j, 0x41); emit_byte(j, 0x57);      // push r15
+    emit_op_reg(j, 0, 1, 0x83, 5, RSP);          // sub rsp, 8
+    emit_byte(j, 8);
+    emit_op_reg(j, 0, 1, 0x89, RDI, REG_VM);     // mov rbx, rdi
+    emit_op_reg(j, 0, 1, 0x89, RSI, REG_REGS);   // mov r14, rsi
+    emit_op_reg(j, 0, 0, 0x31, REG_COUNT, REG_COUNT); // xor r15d, r15d
+    emit_op_reg(j, 0, 0, 0xFF, 4, RDX);          // jmp rdx
+
+    j->exit = j->length;
+    emit_op_mem(j, 0, 1, 0x01, REG_COUNT, REG_VM, offsetof(lgx_vm_t, instructions));
+    emit_op_reg(j, 0, 1, 0x83, 0, RSP);          // add rsp, 8
+    emit_byte(j, 8);
+    emit_byte(j, 0x41); emit_byte(j, 0x5F);      // pop r15
+    emit_byte(j, 0x41); emit_byte(j, 0x5E);      // pop r14
+    emit_byte(j, 0x5B);                          // pop rbx
+    emit_byte(j, 0x5D);                          // pop rbp
+    emit_byte(j, 0xC3);                          // ret
+}
+
+// 整数比较，结果写入 al
+static void emit_icmp(jit_compiler_t *j, unsigned b, unsigned c) {
+    emit_load(j, RAX, REG_REGS, OFF_V(b));
+    emit_op_mem(j, 0, 1, 0x3B, RAX, REG_REGS, OFF_V(c));
+}
+
+// 浮点数比较 xmm0 与 xmm1，结果写入 eax，NaN 参与的比较结果均为 false
+static void emit_fcmp(jit_compiler_t *j, int cmp) {
+    switch (cmp) {
+        case CMP_LT:
+            emit_op_reg(j, 0x66, 0, 0x0F2E, 1, 0);
+            emit_setcc(j, CC_A);
+            break;
+        case CMP_LE:
+            emit_op_reg(j, 0x66, 0, 0x0F2E, 1, 0);
+            emit_setcc(j, CC_AE);
+            break;
+        case CMP_GT:
+            emit_op_reg(j, 0x66, 0, 0x0F2E, 0, 1);
+            emit_setcc(j, CC_A);
+            break;
+        case CMP_GE:
+            emit_op_reg(j, 0x66, 0, 0x0F2E, 0, 1);
+            emit_setcc(j, CC_AE);
+            break;
+        case CMP_EQ:
+            // sete al; setnp cl; and al, cl
+            emit_op_reg(j, 0x66, 0, 0x0F2E, 0, 1);
+            emit_byte(j, 0x0F); emit_byte(j, 0x94); emit_byte(j, 0xC0);
+            emit_byte(j, 0x0F); emit_byte(j, 0x9B); emit_byte(j, 0xC1);
+            emit_byte(j, 0x20); emit_byte(j, 0xC8);
+            emit_byte(j, 0x0F); emit_byte(j, 0xB6); emit_byte(j, 0xC0);
+            break;
+    }
+}
+
+// xmm = (double)imm
+static void emit_double_imm(jit_compiler_t *j, int xmm, unsigned imm) {
+    emit_op_reg(j, 0, 0, 0xC7, 0, RAX);
+    emit_u32(j, imm);
+    emit_op_reg(j, 0xF2, 1, 0x0F2A, xmm, RAX);
+}
+
+static void emit_movsd_load(jit_compiler_t *j, int xmm, unsigned r) {
+    emit_op_mem(j, 0xF2, 0, 0x0F10, xmm, REG_REGS, OFF_V(r));
+}
+
+static void emit_movsd_store(jit_compiler_t *j, unsigned r, int xmm) {
+    emit_op_mem(j, 0xF2, 0, 0x0F11, xmm, REG_REGS, OFF_V(r));
+}
+
+// 写入整数结果
+static void emit_result(jit_compiler_t *j, unsigned a, lgx_val_type_t type) {
+    emit_store_type(j, a, type);
+    emit_store(j, REG_REGS, OFF_V(a), RAX);
+}
+
+// 整数运算：rax = b op c
+// op 为 add/sub/imul 的 r64, r/m64 形式
+static void emit_iarith(jit_compiler_t *j, unsigned op, unsigned b, unsigned c) {
+    emit_load(j, RAX, REG_REGS, OFF_V(b));
+    emit_op_mem(j, 0, 1, op, RAX, REG_REGS, OFF_V(c));
+}
+
+// 整数运算：rax = b op imm
+static void emit_iarith_imm(jit_compiler_t *j, unsigned op, unsigned b, unsigned imm) {
+    emit_load(j, RAX, REG_REGS, OFF_V(b));
+    if (op == 0x0FAF) {
+        // imul rax, rax, imm32
+        emit_op_reg(j, 0, 1, 0x69, RAX, RAX);
+        emit_u32(j, imm);
+    } else {
+        emit_alu_reg_imm(j, op == 0x03 ? 0 : 5, RAX, imm);
+    }
+}
+
+// 整数除法：rax = b / rcx，rcx 为 -1 时使用取反避免溢出异常，与解释器的 lgx_long_div 一致
+static void emit_idiv(jit_compiler_t *j, unsigned b) {
+    emit_load(j, RAX, REG_REGS, OFF_V(b));
+    emit_op_reg(j, 0, 1, 0x83, 7, RCX);   // cmp rcx, -1
+    emit_byte(j, 0xFF);
+    unsigned l_div = emit_jcc_forward(j, CC_NE);
+    emit_op_reg(j, 0, 1, 0xF7, 3, RAX);   // neg rax
+    unsigned l_done = emit_jmp_forward(j);
+    emit_patch(j, l_div);
+    emit_byte(j, 0x48); emit_byte(j, 0x99); // cqo
+    emit_op_reg(j, 0, 1, 0xF7, 7, RCX);   // idiv rcx
+    emit_patch(j, l_done);
+}
+
+// 浮点数除数为 0 时抛出异常（NaN 不等于 0）
+static void emit_fzero_guard(jit_compiler_t *j, unsigned pc) {
+    emit_op_reg(j, 0x66, 0, 0x0F57, 2, 2);  // xorpd xmm2, xmm2
+    emit_op_reg(j, 0x66, 0, 0x0F2E, 1, 2);  // ucomisd xmm1, xmm2
+    unsigned l_ok = emit_jcc_forward(j, CC_NE);
+    emit_guard(j, CC_NP, pc, jit_division_by_zero);
+    emit_patch(j, l_ok);
+}
+
+// 通用算术指令，操作数同为整数或同为浮点数，否则抛出异常
+// imm 不为 NULL 时第二个操作数为立即数
+static void emit_arith(jit_compiler_t *j, unsigned pc, uint32_t i, unsigned iop, unsigned fop, int imm) {
+    unsigned a = PA(i), b = PB(i), c = PC(i);
+
+    emit_cmp_type(j, b, T_LONG);
+    unsigned l_double = emit_jcc_forward(j, CC_NE);
+    unsigned l_double2 = 0;
+    if (!imm) {
+        emit_cmp_type(j, c, T_LONG);
+        l_double2 = emit_jcc_forward(j, CC_NE);
+    }
+    if (iop == 0xF7) {
+        // 整数除法
+        if (imm) {
+            emit_mov_imm(j, RCX, c);
+        } else {
+            emit_load(j, RCX, REG_REGS, OFF_V(c));
+            emit_op_reg(j, 0, 1, 0x85, RCX, RCX);
+            emit_guard(j, CC_E, pc, jit_division_by_zero);
+        }
+        emit_idiv(j, b);
+    } else if (imm) {
+        emit_iarith_imm(j, iop, b, c);
+    } else {
+        emit_iarith(j, iop, b, c);
+    }
+    emit_result(j, a, T_LONG);
+    unsigned l_done = emit_jmp_forward(j);
+
+    emit_patch(j, l_double);
+    if (!imm) {
+        emit_patch(j, l_double2);
+    }
+    emit_cmp_type(j, b, T_DOUBLE);
+    emit_guard(j, CC_NE, pc, jit_runtime_error);
+    if (imm) {
+        emit_double_imm(j, 1, c);
+    } else {
+        emit_cmp_type(j, c, T_DOUBLE);
+        emit_guard(j, CC_NE, pc, jit_runtime_error);
+        emit_movsd_load(j, 1, c);
+        if (fop == 0x0F5E) {
+            emit_fzero_guard(j, pc);
+        }
+    }
+    emit_movsd_load(j, 0, b);
+    emit_op_reg(j, 0xF2, 0, fop, 0, 1);
+    emit_store_type(j, a, T_DOUBLE);
+    emit_movsd_store(j, a, 0);
+
+    emit_patch(j, l_done);
+}
+
+// 通用比较指令，先写入结果类型再检查操作数类型，与解释器一致
+// imm 不为 0 时第二个操作数为立即数；strict 为 0 时操作数类型不匹配不抛出异常
+static void emit_compare(jit_compiler_t *j, unsigned pc, uint32_t i, int cmp, int imm, int strict) {
+    unsigned a = PA(i), b = PB(i), c = PC(i);
+
+    emit_store_type(j, a, T_BOOL);
+
+    emit_cmp_type(j, b, T_LONG);
+    unsigned l_double = emit_jcc_forward(j, CC_NE);
+    unsigned l_double2 = 0;
+    if (imm) {
+        emit_load(j, RAX, REG_REGS, OFF_V(b));
+        emit_alu_reg_imm(j, 7, RAX, c);
+    } else {
+        emit_cmp_type(j, c, T_LONG);
+        l_double2 = emit_jcc_forward(j, CC_NE);
+        emit_icmp(j, b, c);
+    }
+    emit_setcc(j, cmp_cc[cmp]);
+    emit_store(j, REG_REGS, OFF_V(a), RAX);
+    unsigned l_done = emit_jmp_forward(j);
+
+    emit_patch(j, l_double);
+    if (!imm) {
+        emit_patch(j, l_double2);
+    }
+    unsigned l_other = 0, l_other2 = 0;
+    emit_cmp_type(j, b, T_DOUBLE);
+    if (strict) {
+        emit_guard(j, CC_NE, pc, jit_runtime_error);
+    } else {
+        l_other = emit_jcc_forward(j, CC_NE);
+    }
+    if (imm) {
+        emit_double_imm(j, 1, c);
+    } else {
+        emit_cmp_type(j, c, T_DOUBLE);
+        l_other2 = emit_jcc_forward(j, CC_NE);
+        emit_movsd_load(j, 1, c);
+    }
+    emit_movsd_load(j, 0, b);
+    emit_fcmp(j, cmp);
+    emit_store(j, REG_REGS, OFF_V(a), RAX);
+
+    if (l_other) {
+        emit_patch(j, l_other);
+    }
+    if (l_other2) {
+        emit_patch(j, l_other2);
+    }
+    emit_patch(j, l_done);
+}
+
+// 只接受整数操作数的位运算，rax = b op c
+static void emit_bitwise(jit_compiler_t *j, unsigned pc, uint32_t i, int imm) {
+    unsigned a = PA(i), b = PB(i), c = PC(i);
+
+    emit_cmp_type(j, b, T_LONG);
+    emit_guard(j, CC_NE, pc, jit_runtime_error);
+    if (!imm && OP(i) != OP_NOT) {
+        emit_cmp_type(j, c, T_LONG);
+        emit_guard(j, CC_NE, pc, jit_runtime_error);
+    }
+
+    emit_load(j, RAX, REG_REGS, OFF_V(b));
+    switch (OP(i)) {
+        case OP_SHL:
+        case OP_SHR:
+            emit_load(j, RCX, REG_REGS, OFF_V(c));
+            emit_op_reg(j, 0, 1, 0xD3, OP(i) == OP_SHL ? 4 : 7, RAX);
+            break;
+        case OP_SHLI:
+        case OP_SHRI:
+            emit_op_reg(j, 0, 1, 0xC1, OP(i) == OP_SHLI ? 4 : 7, RAX);
+            emit_byte(j, c);
+            break;
+        case OP_AND:
+            emit_op_mem(j, 0, 1, 0x23, RAX, REG_REGS, OFF_V(c));
+            break;
+        case OP_OR:
+            emit_op_mem(j, 0, 1, 0x0B, RAX, REG_REGS, OFF_V(c));
+            break;
+        case OP_XOR:
+            emit_op_mem(j, 0, 1, 0x33, RAX, REG_REGS, OFF_V(c));
+            break;
+        case OP_NOT:
+            emit_op_reg(j, 0, 1, 0xF7, 2, RAX);
+            break;
+    }
+    emit_result(j, a, T_LONG);
+}
+
+// 比较跳转指令的比较部分
+static void emit_jump_test(jit_compiler_t *j, uint32_t i, int imm) {
+    if (imm) {
+        // cmp qword [a], imm32
+        emit_op_mem(j, 0, 1, 0x81, 7, REG_REGS, OFF_V(PA(i)));
+        emit_u32(j, PB(i));
+    } else {
+        emit_icmp(j, PA(i), PB(i));
+    }
+}
+
+// 比较跳转指令
+static void emit_jump_compare(jit_compiler_t *j, uint32_t i, uint32_t target, int cmp, int imm) {
+    emit_jump_test(j, i, imm);
+    emit_branch(j, cmp_cc[cmp], PE(target));
+}
+
+static void emit_inc_count(jit_compiler_t *j) {
+    emit_op_reg(j, 0, 1, 0xFF, 0, REG_COUNT);
+}
+
+// 编译一条指令，返回 0 表示该指令需要由解释器执行
+static int jit_compile_insn(jit_compiler_t *j, lgx_function_t *fun, unsigned *bc, unsigned pc) {
+    uint32_t i = bc[pc];
+    unsigned a = PA(i), b = PB(i), c = PC(i);
+
+    switch (OP(i)) {
+        case OP_CALL:
+        case OP_TAIL_CALL:
+        case OP_CO_CALL:
+        case OP_RET:
+        case OP_HLT:
+        case OP_JMP:
+            // 切换栈帧的指令由解释器执行
+            emit_exit(j, pc);
+            return 0;
+        case OP_DIVI:
+        case OP_IDIVI:
+            if (c == 0) {
+                emit_exit(j, pc);
+                return 0;
+            }
+            break;
+        default:
+            break;
+    }
+
+    emit_inc_count(j);
+
+    switch (OP(i)) {
+        case OP_NOP:
+        case OP_TYPEOF:
+            break;
+        case OP_MOV:
+            emit_copy(j, REG_REGS, OFF_V(a), REG_REGS, OFF_V(b));
+            break;
+        case OP_MOVI:
+            emit_store_type(j, a, T_LONG);
+            emit_store_imm64(j, REG_REGS, OFF_V(a), PD(i));
+            break;
+        case OP_LOAD:
+            emit_reg_addr(j, RSI, a);
+            emit_op_reg(j, 0, 0, 0xC7, 0, RDX);
+            emit_u32(j, PD(i));
+            emit_helper(j, jit_load);
+            break;
+        case OP_ADD:
+        case OP_ADD_LONG:
+        case OP_ADD_DOUBLE:
+            emit_arith(j, pc, i, 0x03, 0x0F58, 0);
+            break;
+        case OP_SUB:
+            emit_arith(j, pc, i, 0x2B, 0x0F5C, 0);
+            break;
+        case OP_MUL:
+            emit_arith(j, pc, i, 0x0FAF, 0x0F59, 0);
+            break;
+        case OP_DIV:
+            emit_arith(j, pc, i, 0xF7, 0x0F5E, 0);
+            break;
+        case OP_ADDI:
+            emit_arith(j, pc, i, 0x03, 0x0F58, 1);
+            break;
+        case OP_SUBI:
+            emit_arith(j, pc, i, 0x2B, 0x0F5C, 1);
+            break;
+        case OP_MULI:
+            emit_arith(j, pc, i, 0x0FAF, 0x0F59, 1);
+            break;
+        case OP_DIVI:
+            emit_arith(j, pc, i, 0xF7, 0x0F5E, 1);
+            break;
+        case OP_NEG: {
+            emit_cmp_type(j, b, T_LONG);
+            unsigned l_double = emit_jcc_forward(j, CC_NE);
+            emit_load(j, RAX, REG_REGS, OFF_V(b));
+            emit_op_reg(j, 0, 1, 0xF7, 3, RAX);
+            emit_result(j, a, T_LONG);
+            unsigned l_done = emit_jmp_forward(j);
+            emit_patch(j, l_double);
+            emit_cmp_type(j, b, T_DOUBLE);
+            emit_guard(j, CC_NE, pc, jit_runtime_error);
+            emit_load(j, RAX, REG_REGS, OFF_V(b));
+            emit_op_reg(j, 0, 1, 0x0FBA, 7, RAX);   // btc rax, 63
+            emit_byte(j, 63);
+            emit_result(j, a, T_DOUBLE);
+            emit_patch(j, l_done);
+            break;
+        }
+        case OP_SHL:
+        case OP_SHR:
+        case OP_AND:
+        case OP_OR:
+        case OP_XOR:
+        case OP_NOT:
+            emit_bitwise(j, pc, i, 0);
+            break;
+        case OP_SHLI:
+        case OP_SHRI:
+            emit_bitwise(j, pc, i, 1);
+            break;
+        case OP_EQ:
+            emit_reg_addr(j, RSI, a);
+            emit_reg_addr(j, RDX, b);
+            emit_reg_addr(j, RCX, c);
+            emit_helper(j, jit_eq);
+            break;
+        case OP_LE:
+            emit_compare(j, pc, i, CMP_LE, 0, 0);
+            break;
+        case OP_LT:
+            emit_compare(j, pc, i, CMP_LT, 0, 0);
+            break;
+        case OP_LT_LONG:
+        case OP_LT_DOUBLE: {
+            // 特化指令先检查操作数类型，类型不匹配时按照通用指令执行
+            unsigned l_generic, l_generic2, l_done;
+            lgx_val_type_t type = OP(i) == OP_LT_LONG ? T_LONG : T_DOUBLE;
+            emit_cmp_type(j, b, type);
+            l_generic = emit_jcc_forward(j, CC_NE);
+            emit_cmp_type(j, c, type);
+            l_generic2 = emit_jcc_forward(j, CC_NE);
+            if (type == T_LONG) {
+                emit_icmp(j, b, c);
+                emit_setcc(j, CC_L);
+            } else {
+                emit_movsd_load(j, 0, b);
+                emit_movsd_load(j, 1, c);
+                emit_fcmp(j, CMP_LT);
+            }
+            emit_result(j, a, T_BOOL);
+            l_done = emit_jmp_forward(j);
+            emit_patch(j, l_generic);
+            emit_patch(j, l_generic2);
+            emit_compare(j, pc, i, CMP_LT, 0, 0);
+            emit_patch(j, l_done);
+            break;
+        }
+        case OP_EQI: {
+            emit_store_type(j, a, T_BOOL);
+            emit_op_reg(j, 0, 0, 0x31, RAX, RAX);
+            emit_cmp_type(j, b, T_LONG);
+            unsigned l_store = emit_jcc_forward(j, CC_NE);
+            emit_load(j, RAX, REG_REGS, OFF_V(b));
+            emit_alu_reg_imm(j, 7, RAX, c);
+            emit_setcc(j, CC_E);
+            emit_patch(j, l_store);
+            emit_store(j, REG_REGS, OFF_V(a), RAX);
+            break;
+        }
+        case OP_GEI:
+            emit_compare(j, pc, i, CMP_GE, 1, 1);
+            break;
+        case OP_GTI:
+            emit_compare(j, pc, i, CMP_GT, 1, 1);
+            break;
+        case OP_LEI:
+            emit_compare(j, pc, i, CMP_LE, 1, 1);
+            break;
+        case OP_LTI:
+            emit_compare(j, pc, i, CMP_LT, 1, 1);
+            break;
+        case OP_LNOT:
+            emit_store_type(j, a, T_BOOL);
+            emit_cmp_type(j, b, T_BOOL);
+            emit_guard(j, CC_NE, pc, jit_runtime_error);
+            emit_op_mem(j, 0, 1, 0x83, 7, REG_REGS, OFF_V(b));  // cmp qword [b], 0
+            emit_byte(j, 0);
+            emit_setcc(j, CC_E);
+            emit_store(j, REG_REGS, OFF_V(a), RAX);
+            break;
+        case OP_IADD:
+            emit_iarith(j, 0x03, b, c);
+            emit_result(j, a, T_LONG);
+            break;
+        case OP_ISUB:
+            emit_iarith(j, 0x2B, b, c);
+            emit_result(j, a, T_LONG);
+            break;
+        case OP_IMUL:
+            emit_iarith(j, 0x0FAF, b, c);
+            emit_result(j, a, T_LONG);
+            break;
+        case OP_IADDI:
+            emit_iarith_imm(j, 0x03, b, c);
+            emit_result(j, a, T_LONG);
+            break;
+        case OP_ISUBI:
+            emit_iarith_imm(j, 0x2B, b, c);
+            emit_result(j, a, T_LONG);
+            break;
+        case OP_IMULI:
+            emit_iarith_imm(j, 0x0FAF, b, c);
+            emit_result(j, a, T_LONG);
+            break;
+        case OP_IDIV:
+            emit_load(j, RCX, REG_REGS, OFF_V(c));
+            emit_op_reg(j, 0, 1, 0x85, RCX, RCX);
+            emit_guard(j, CC_E, pc, jit_division_by_zero);
+            emit_idiv(j, b);
+            emit_result(j, a, T_LONG);
+            break;
+        case OP_IDIVI:
+            emit_mov_imm(j, RCX, c);
+            emit_idiv(j, b);
+            emit_result(j, a, T_LONG);
+            break;
+        case OP_INEG:
+            emit_load(j, RAX, REG_REGS, OFF_V(b));
+            emit_op_reg(j, 0, 1, 0xF7, 3, RAX);
+            emit_result(j, a, T_LONG);
+            break;
+        case OP_IEQ:
+        case OP_ILE:
+        case OP_ILT:
+            emit_icmp(j, b, c);
+            emit_setcc(j, OP(i) == OP_IEQ ? CC_E : OP(i) == OP_ILE ? CC_LE : CC_L);
+            emit_result(j, a, T_BOOL);
+            break;
+        case OP_IEQI:
+        case OP_ILEI:
+        case OP_ILTI:
+        case OP_IGEI:
+        case OP_IGTI: {
+            int cc;
+            switch (OP(i)) {
+                case OP_IEQI: cc = CC_E; break;
+                case OP_ILEI: cc = CC_LE; break;
+                case OP_ILTI: cc = CC_L; break;
+                case OP_IGEI: cc = CC_GE; break;
+                default: cc = CC_G; break;
+            }
+            emit_load(j, RAX, REG_REGS, OFF_V(b));
+            emit_alu_reg_imm(j, 7, RAX, c);
+            emit_setcc(j, cc);
+            emit_result(j, a, T_BOOL);
+            break;
+        }
+        case OP_FADD:
+        case OP_FSUB:
+        case OP_FMUL:
+        case OP_FDIV: {
+            unsigned op;
+            switch (OP(i)) {
+                case OP_FADD: op = 0x0F58; break;
+                case OP_FSUB: op = 0x0F5C; break;
+                case OP_FMUL: op = 0x0F59; break;
+                default: op = 0x0F5E; break;
+            }
+            emit_movsd_load(j, 1, c);
+            if (op == 0x0F5E) {
+                emit_fzero_guard(j, pc);
+            }
+            emit_movsd_load(j, 0, b);
+            emit_op_reg(j, 0xF2, 0, op, 0, 1);
+            emit_store_type(j, a, T_DOUBLE);
+            emit_movsd_store(j, a, 0);
+            break;
+        }
+        case OP_FNEG:
+            emit_load(j, RAX, REG_REGS, OFF_V(b));
+            emit_op_reg(j, 0, 1, 0x0FBA, 7, RAX);   // btc rax, 63
+            emit_byte(j, 63);
+            emit_result(j, a, T_DOUBLE);
+            break;
+        case OP_FEQ:
+        case OP_FLE:
+        case OP_FLT:
+            emit_movsd_load(j, 0, b);
+            emit_movsd_load(j, 1, c);
+            emit_fcmp(j, OP(i) == OP_FEQ ? CMP_EQ : OP(i) == OP_FLE ? CMP_LE : CMP_LT);
+            emit_result(j, a, T_BOOL);
+            break;
+        case OP_JLT:  emit_jump_compare(j, i, bc[pc + 1], CMP_LT, 0); break;
+        case OP_JLE:  emit_jump_compare(j, i, bc[pc + 1], CMP_LE, 0); break;
+        case OP_JEQ:  emit_jump_compare(j, i, bc[pc + 1], CMP_EQ, 0); break;
+        case OP_JNE:  emit_jump_compare(j, i, bc[pc + 1], CMP_NE, 0); break;
+        case OP_JLTI: emit_jump_compare(j, i, bc[pc + 1], CMP_LT, 1); break;
+        case OP_JLEI: emit_jump_compare(j, i, bc[pc + 1], CMP_LE, 1); break;
+        case OP_JGTI: emit_jump_compare(j, i, bc[pc + 1], CMP_GT, 1); break;
+        case OP_JGEI: emit_jump_compare(j, i, bc[pc + 1], CMP_GE, 1); break;
+        case OP_JEQI: emit_jump_compare(j, i, bc[pc + 1], CMP_EQ, 1); break;
+        case OP_JNEI: emit_jump_compare(j, i, bc[pc + 1], CMP_NE, 1); break;
+        case OP_INCJMP:
+            emit_store_type(j, a, T_LONG);
+            emit_alu_mem_imm(j, 0, REG_REGS, OFF_V(a), b);
+            emit_branch(j, -1, PE(bc[pc + 1]));
+            break;
+        case OP_TEST:
+            emit_cmp_type(j, a, T_BOOL);
+            emit_guard(j, CC_NE, pc, jit_runtime_error);
+            emit_op_mem(j, 0, 1, 0x83, 7, REG_REGS, OFF_V(a));  // cmp qword [a], 0
+            emit_byte(j, 0);
+            emit_branch(j, CC_E, pc + 1 + PD(i));
+            break;
+        case OP_JMPI:
+            emit_branch(j, -1, PE(i));
+            break;
+        case OP_CALL_NEW:
+            emit_save_pc(j, pc + 1);
+            emit_reg_addr(j, RSI, a);
+            emit_helper(j, jit_call_new);
+            break;
+        case OP_CALL_SET:
+            // 被调用函数的栈帧紧接在当前函数的栈帧之后
+            emit_copy(j, REG_REGS, OFF_V(fun->stack_size + a), REG_REGS, OFF_V(b));
+            break;
+        case OP_ARRAY_NEW:
+            emit_save_pc(j, pc + 1);
+            emit_reg_addr(j, RSI, a);
+            emit_helper(j, lgx_vm_array_new);
+            break;
+        case OP_ARRAY_GET:
+        case OP_ARRAY_GET_LONG:
+            emit_save_pc(j, pc + 1);
+            emit_reg_addr(j, RSI, a);
+            emit_reg_addr(j, RDX, b);
+            emit_reg_addr(j, RCX, c);
+            emit_helper(j, lgx_vm_array_get);
+            break;
+        case OP_ARRAY_SET:
+            emit_save_pc(j, pc + 1);
+            emit_reg_addr(j, RSI, a);
+            if (b) {
+                emit_reg_addr(j, RDX, b);
+            } else {
+                emit_op_reg(j, 0, 0, 0x31, RDX, RDX);
+            }
+            emit_reg_addr(j, RCX, c);
+            emit_helper(j, lgx_vm_array_set);
+            break;
+        case OP_MAP_NEW:
+            emit_save_pc(j, pc + 1);
+            emit_reg_addr(j, RSI, a);
+            emit_mov_imm(j, RDX, PD(i));
+            emit_helper(j, lgx_vm_map_new);
+            break;
+        case OP_MAP_GET:
+            emit_save_pc(j, pc + 1);
+            emit_reg_addr(j, RSI, a);
+            emit_reg_addr(j, RDX, b);
+            emit_reg_addr(j, RCX, c);
+            emit_helper(j, lgx_vm_map_get);
+            break;
+        case OP_MAP_SET:
+            emit_save_pc(j, pc + 1);
+            emit_reg_addr(j, RSI, a);
+            emit_reg_addr(j, RDX, b);
+            emit_reg_addr(j, RCX, c);
+            emit_helper(j, lgx_vm_map_set);
+            break;
+        case OP_CONCAT:
+            emit_save_pc(j, pc + 1);
+            emit_reg_addr(j, RSI, a);
+            emit_reg_addr(j, RDX, b);
+            emit_reg_addr(j, RCX, c);
+            emit_helper(j, lgx_vm_concat);
+            break;
+        case OP_GLOBAL_GET:
+            emit_load(j, RDX, REG_VM, offsetof(lgx_vm_t, global));
+            emit_copy(j, REG_REGS, OFF_V(a), RDX, PD(i) * sizeof(lgx_value_t));
+            break;
+        case OP_GLOBAL_SET: {
+            // 写屏障，只在 Full GC 期间调用：cmp dword [vm + heap.phase], 0
+            emit_op_mem(j, 0, 0, 0x83, 7, REG_VM, offsetof(lgx_vm_t, heap.phase));
+            emit_byte(j, 0);
+            unsigned l_idle = emit_jcc_forward(j, CC_E);
+            emit_mov_imm(j, RSI, PD(i));
+            emit_helper(j, jit_global_barrier);
+            emit_patch(j, l_idle);
+            emit_load(j, RDX, REG_VM, offsetof(lgx_vm_t, global));
+            emit_copy(j, RDX, PD(i) * sizeof(lgx_value_t), REG_REGS, OFF_V(a));
+            break;
+        }
+        case OP_THROW:
+            emit_save_pc(j, pc + 1);
+            emit_reg_addr(j, RSI, a);
+            emit_helper(j, jit_throw);
+            break;
+        case OP_ECHO:
+            emit_reg_addr(j, RSI, a);
+            emit_helper(j, jit_echo);
+            break;
+        default:
+            // 未知指令，撤销计数并由解释器抛出异常
+            emit_op_reg(j, 0, 1, 0xFF, 1, REG_COUNT);
+            emit_exit(j, pc);
+            return 0;
+    }
+
+    return 1;
+}
+
+static unsigned insn_size(uint32_t i) {
+    switch (OP(i)) {
+        case OP_JLT: case OP_JLE: case OP_JEQ: case OP_JNE:
+        case OP_JLTI: case OP_JLEI: case OP_JGTI: case OP_JGEI: case OP_JEQI: case OP_JNEI:
+        case OP_INCJMP:
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+// 回填跳转并把机器码复制到可执行内存，失败时返回 NULL
+// 跳转到 offsets 中没有机器码的指令时退出机器码，由解释器执行；fun 为 NULL 时所有跳转都退出
+static void* jit_link(jit_compiler_t *j, lgx_function_t *fun, unsigned *offsets) {
+    unsigned k;
+
+    for (k = 0; k < j->fixups_length; ++k) {
+        jit_fixup_t *f = &j->fixups[k];
+        unsigned target;
+        if (f->helper) {
+            if (k > 0 && j->fixups[k - 1].helper == f->helper && j->fixups[k - 1].pc == f->pc) {
+                // 同一条指令的多个类型检查共用抛出异常的代码
+                uint32_t rel;
+                memcpy(&rel, j->buf + j->fixups[k - 1].at, 4);
+                target = j->fixups[k - 1].at + 4 + rel;
+            } else {
+                target = j->length;
+                emit_save_pc(j, f->pc + 1);
+                emit_op_reg(j, 0, 1, 0x89, REG_VM, RDI);
+                emit_call(j, f->helper);
+                emit_jmp_to(j, j->exit);
+            }
+        } else if (fun && f->pc >= fun->addr && f->pc <= fun->end && offsets[f->pc - fun->addr]) {
+            target = offsets[f->pc - fun->addr];
+        } else {
+            target = j->length;
+            emit_exit(j, f->pc);
+        }
+        if (j->error) {
+            break;
+        }
+        uint32_t rel = target - (f->at + 4);
+        memcpy(j->buf + f->at, &rel, 4);
+    }
+
+    xfree(j->fixups);
+    j->fixups = NULL;
+
+    if (j->error) {
+        xfree(j->buf);
+        return NULL;
+    }
+
+    void *code = mmap(NULL, j->length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        xfree(j->buf);
+        return NULL;
+    }
+    memcpy(code, j->buf, j->length);
+    xfree(j->buf);
+    j->buf = NULL;
+    if (mprotect(code, j->length, PROT_READ | PROT_EXEC)) {
+        munmap(code, j->length);
+        return NULL;
+    }
+
+    return code;
+}
+
+int lgx_jit_compile(lgx_vm_t *vm, lgx_function_t *fun) {
+    lgx_jit_function_t *jit = fun->jit;
+    unsigned *bc = vm->c->bc.buffer;
+    unsigned length = fun->end - fun->addr + 1;
+    unsigned pc, k;
+
+    if (!jit || jit->code || fun->buildin) {
+        return 1;
+    }
+
+    // 每条指令的机器码位置，为 0 时表示该位置不能进入机器码
+    unsigned *offsets = xcalloc(length, sizeof(unsigned));
+    if (!offsets) {
+        return 1;
+    }
+
+    jit_compiler_t j;
+    memset(&j, 0, sizeof(j));
+
+    emit_prologue(&j);
+
+    for (pc = fun->addr; pc <= fun->end; pc += insn_size(bc[pc])) {
+        unsigned offset = j.length;
+        if (jit_compile_insn(&j, fun, bc, pc)) {
+            offsets[pc - fun->addr] = offset;
+        }
+    }
+    // 函数的最后一条指令必然是 RET，不会执行到这里
+    emit_exit(&j, fun->end);
+
+    void *code = jit_link(&j, fun, offsets);
+    if (!code) {
+        xfree(offsets);
+        return 1;
+    }
+
+    jit->entries = xcalloc(length, sizeof(void*));
+    if (!jit->entries) {
+        munmap(code, j.length);
+        xfree(offsets);
+        return 1;
+    }
+    for (k = 0; k < length; ++k) {
+        if (offsets[k]) {
+            jit->entries[k] = (unsigned char*)code + offsets[k];
+        }
+    }
+    xfree(offsets);
+
+    jit->code = code;
+    jit->size = j.length;
+
+    ++ vm->jit.compiled;
+
+    return 0;
+}
+
+void lgx_jit_execute(lgx_vm_t *vm, lgx_function_t *fun) {
+    lgx_jit_function_t *jit = fun->jit;
+    unsigned pc = vm->co_running->pc;
+
+    if (pc < fun->addr || pc > fun->end || !jit->entries[pc - fun->addr]) {
+        return;
+    }
+
+    ((jit_entry_t)jit->code)(vm, vm->regs, jit->entries[pc - fun->addr]);
+}
+
+// 指令写入的寄存器，不写入寄存器时返回 -1
+static int insn_def(uint32_t i) {
+    switch (OP(i)) {
+        case OP_NOP: case OP_TYPEOF:
+        case OP_TEST: case OP_JMP: case OP_JMPI:
+        case OP_JLT: case OP_JLE: case OP_JEQ: case OP_JNE:
+        case OP_JLTI: case OP_JLEI: case OP_JGTI: case OP_JGEI: case OP_JEQI: case OP_JNEI:
+        case OP_CALL_NEW: case OP_CALL_SET: case OP_CALL: case OP_TAIL_CALL: case OP_CO_CALL:
+        case OP_RET: case OP_HLT:
+        case OP_ARRAY_SET: case OP_MAP_SET: case OP_GLOBAL_SET: case OP_THROW: case OP_ECHO:
+            return -1;
+        default:
+            return PA(i);
+    }
+}
+
+// 模板指令的结果类型，无法确定时返回 T_UNKNOWN
+static lgx_val_type_t insn_result(uint32_t i, const unsigned char *known) {
+    switch (OP(i)) {
+        case OP_MOV:
+            return known[PB(i)];
+        case OP_MOVI: case OP_INCJMP:
+        case OP_IADD: case OP_IADDI: case OP_ISUB: case OP_ISUBI: case OP_IMUL: case OP_IMULI:
+        case OP_IDIV: case OP_IDIVI: case OP_INEG:
+        case OP_SHL: case OP_SHLI: case OP_SHR: case OP_SHRI:
+        case OP_AND: case OP_OR: case OP_XOR: case OP_NOT:
+            return T_LONG;
+        case OP_FADD: case OP_FSUB: case OP_FMUL: case OP_FDIV: case OP_FNEG:
+            return T_DOUBLE;
+        case OP_EQ: case OP_EQI: case OP_LE: case OP_LEI: case OP_LT: case OP_LTI:
+        case OP_GEI: case OP_GTI: case OP_LT_LONG: case OP_LT_DOUBLE: case OP_LNOT:
+        case OP_IEQ: case OP_IEQI: case OP_ILE: case OP_ILEI: case OP_ILT: case OP_ILTI:
+        case OP_IGEI: case OP_IGTI: case OP_FEQ: case OP_FLE: case OP_FLT:
+            return T_BOOL;
+        default:
+            return T_UNKNOWN;
+    }
+}
+
+// 需要记录类型的操作数：1 为 PA，2 为 PB，4 为 PC
+static int insn_observe(uint32_t i) {
+    switch (OP(i)) {
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
+        case OP_ADD_LONG: case OP_ADD_DOUBLE:
+        case OP_LE: case OP_LT: case OP_LT_LONG: case OP_LT_DOUBLE:
+            return 2 | 4;
+        case OP_ADDI: case OP_SUBI: case OP_MULI: case OP_DIVI: case OP_NEG:
+        case OP_LEI: case OP_LTI: case OP_GEI: case OP_GTI:
+            return 2;
+        case OP_TEST:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// 按照记录的类型特化指令时使用的操作数类型，不能特化时返回 T_UNKNOWN
+static lgx_val_type_t trace_type(uint32_t i, jit_record_t *rec) {
+    lgx_val_type_t b = rec->types[1], c = rec->types[2];
+
+    switch (OP(i)) {
+        case OP_TEST:
+            return rec->types[0] == T_BOOL ? T_BOOL : T_UNKNOWN;
+        case OP_DIVI:
+            if (PC(i) == 0) {
+                return T_UNKNOWN;
+            }
+            return b == T_LONG || b == T_DOUBLE ? b : T_UNKNOWN;
+        default:
+            switch (insn_observe(i)) {
+                case 2 | 4:
+                    return b == c && (b == T_LONG || b == T_DOUBLE) ? b : T_UNKNOWN;
+                case 2:
+                    return b == T_LONG || b == T_DOUBLE ? b : T_UNKNOWN;
+                default:
+                    return T_UNKNOWN;
+            }
+    }
+}
+
+// 寄存器的类型不是 type 时退出 trace，由解释器从 pc 处执行该指令
+static void trace_guard(jit_compiler_t *j, unsigned r, lgx_val_type_t type, unsigned pc, unsigned char *known) {
+    if (known[r] != type) {
+        emit_cmp_type(j, r, type);
+        emit_branch(j, CC_NE, pc);
+        known[r] = type;
+    }
+}
+
+// 条件跳转只编译记录时的方向，条件不同时退出到另一个方向
+static void trace_jump(jit_compiler_t *j, unsigned pc, uint32_t i, unsigned target, unsigned next, int cmp, int imm) {
+    emit_inc_count(j);
+    emit_jump_test(j, i, imm);
+    if (next == target) {
+        emit_branch(j, cmp_cc[cmp] ^ 1, pc + 2);
+    } else {
+        emit_branch(j, cmp_cc[cmp], target);
+    }
+}
+
+// 按照记录的类型编译算术指令
+static void trace_arith(jit_compiler_t *j, unsigned pc, uint32_t i, lgx_val_type_t type, unsigned char *known) {
+    unsigned a = PA(i), b = PB(i), c = PC(i);
+    unsigned iop, fop;
+    int imm = 0;
+
+    switch (OP(i)) {
+        case OP_ADDI: imm = 1;
+        case OP_ADD: case OP_ADD_LONG: case OP_ADD_DOUBLE:
+            iop = 0x03; fop = 0x0F58; break;
+        case OP_SUBI: imm = 1;
+        case OP_SUB:
+            iop = 0x2B; fop = 0x0F5C; break;
+        case OP_MULI: imm = 1;
+        case OP_MUL:
+            iop = 0x0FAF; fop = 0x0F59; break;
+        case OP_DIVI: imm = 1;
+        default:
+            iop = 0xF7; fop = 0x0F5E; break;
+    }
+
+    trace_guard(j, b, type, pc, known);
+    if (!imm) {
+        trace_guard(j, c, type, pc, known);
+    }
+    emit_inc_count(j);
+
+    if (type == T_LONG) {
+        if (iop == 0xF7) {
+            if (imm) {
+                emit_mov_imm(j, RCX, c);
+            } else {
+                emit_load(j, RCX, REG_REGS, OFF_V(c));
+                emit_op_reg(j, 0, 1, 0x85, RCX, RCX);
+                emit_guard(j, CC_E, pc, jit_division_by_zero);
+            }
+            emit_idiv(j, b);
+        } else if (imm) {
+            emit_iarith_imm(j, iop, b, c);
+        } else {
+            emit_iarith(j, iop, b, c);
+        }
+        emit_result(j, a, T_LONG);
+    } else {
+        if (imm) {
+            emit_double_imm(j, 1, c);
+        } else {
+            emit_movsd_load(j, 1, c);
+            if (fop == 0x0F5E) {
+                emit_fzero_guard(j, pc);
+            }
+        }
+        emit_movsd_load(j, 0, b);
+        emit_op_reg(j, 0xF2, 0, fop, 0, 1);
+        emit_store_type(j, a, T_DOUBLE);
+        emit_movsd_store(j, a, 0);
+    }
+
+    known[a] = type;
+}
+
+// 按照记录的类型编译比较指令
+static void trace_compare(jit_compiler_t *j, unsigned pc, uint32_t i, lgx_val_type_t type, unsigned char *known) {
+    unsigned a = PA(i), b = PB(i), c = PC(i);
+    int cmp, imm = 0;
+
+    switch (OP(i)) {
+        case OP_LE: cmp = CMP_LE; break;
+        case OP_LEI: cmp = CMP_LE; imm = 1; break;
+        case OP_LTI: cmp = CMP_LT; imm = 1; break;
+        case OP_GEI: cmp = CMP_GE; imm = 1; break;
+        case OP_GTI: cmp = CMP_GT; imm = 1; break;
+        default: cmp = CMP_LT; break;
+    }
+
+    trace_guard(j, b, type, pc, known);
+    if (!imm) {
+        trace_guard(j, c, type, pc, known);
+    }
+    emit_inc_count(j);
+
+    if (type == T_LONG) {
+        if (imm) {
+            emit_load(j, RAX, REG_REGS, OFF_V(b));
+            emit_alu_reg_imm(j, 7, RAX, c);
+        } else {
+            emit_icmp(j, b, c);
+        }
+        emit_setcc(j, cmp_cc[cmp]);
+    } else {
+        if (imm) {
+            emit_double_imm(j, 1, c);
+        } else {
+            emit_movsd_load(j, 1, c);
+        }
+        emit_movsd_load(j, 0, b);
+        emit_fcmp(j, cmp);
+    }
+    emit_result(j, a, T_BOOL);
+
+    known[a] = T_BOOL;
+}
+
+// 编译 trace 中的一条指令，next 为记录时执行的下一条指令，失败时返回 1
+static int trace_compile_insn(jit_compiler_t *j, lgx_vm_t *vm, lgx_jit_recorder_t *r, jit_record_t *rec, unsigned next, unsigned char *known) {
+    unsigned *bc = vm->c->bc.buffer;
+    unsigned pc = rec->pc;
+    uint32_t i = bc[pc];
+    unsigned a = PA(i);
+    lgx_val_type_t type = trace_type(i, rec);
+    int d;
+
+    switch (OP(i)) {
+        case OP_TEST:
+            if (type == T_UNKNOWN) {
+                break;
+            }
+            trace_guard(j, a, T_BOOL, pc, known);
+            emit_inc_count(j);
+            emit_op_mem(j, 0, 1, 0x83, 7, REG_REGS, OFF_V(a));  // cmp qword [a], 0
+            emit_byte(j, 0);
+            if (next == pc + 1 + PD(i)) {
+                emit_branch(j, CC_NE, pc + 1);
+            } else {
+                emit_branch(j, CC_E, pc + 1 + PD(i));
+            }
+            return 0;
+        case OP_JLT:  trace_jump(j, pc, i, PE(bc[pc + 1]), next, CMP_LT, 0); return 0;
+        case OP_JLE:  trace_jump(j, pc, i, PE(bc[pc + 1]), next, CMP_LE, 0); return 0;
+        case OP_JEQ:  trace_jump(j, pc, i, PE(bc[pc + 1]), next, CMP_EQ, 0); return 0;
+        case OP_JNE:  trace_jump(j, pc, i, PE(bc[pc + 1]), next, CMP_NE, 0); return 0;
+        case OP_JLTI: trace_jump(j, pc, i, PE(bc[pc + 1]), next, CMP_LT, 1); return 0;
+        case OP_JLEI: trace_jump(j, pc, i, PE(bc[pc + 1]), next, CMP_LE, 1); return 0;
+        case OP_JGTI: trace_jump(j, pc, i, PE(bc[pc + 1]), next, CMP_GT, 1); return 0;
+        case OP_JGEI: trace_jump(j, pc, i, PE(bc[pc + 1]), next, CMP_GE, 1); return 0;
+        case OP_JEQI: trace_jump(j, pc, i, PE(bc[pc + 1]), next, CMP_EQ, 1); return 0;
+        case OP_JNEI: trace_jump(j, pc, i, PE(bc[pc + 1]), next, CMP_NE, 1); return 0;
+        case OP_JMPI:
+            emit_inc_count(j);
+            return 0;
+        case OP_INCJMP:
+            emit_inc_count(j);
+            emit_store_type(j, a, T_LONG);
+            emit_alu_mem_imm(j, 0, REG_REGS, OFF_V(a), PB(i));
+            known[a] = T_LONG;
+            return 0;
+        case OP_LOAD: {
+            // 标量常量直接写入寄存器
+            lgx_value_t *v = vm->constant[PD(i)];
+            lgx_val_type_t t = lgx_value_type(v);
+            if (t == T_LONG || t == T_DOUBLE || t == T_BOOL) {
+                uint64_t bits;
+                memcpy(&bits, &v->v, sizeof(bits));
+                emit_inc_count(j);
+                emit_store_type(j, a, t);
+                emit_mov_imm(j, RAX, bits);
+                emit_store(j, REG_REGS, OFF_V(a), RAX);
+                known[a] = t;
+                return 0;
+            }
+            break;
+        }
+        case OP_ADD: case OP_ADD_LONG: case OP_ADD_DOUBLE:
+        case OP_SUB: case OP_MUL: case OP_DIV:
+        case OP_ADDI: case OP_SUBI: case OP_MULI: case OP_DIVI:
+            if (type != T_UNKNOWN) {
+                trace_arith(j, pc, i, type, known);
+                return 0;
+            }
+            break;
+        case OP_NEG:
+            if (type != T_UNKNOWN) {
+                trace_guard(j, PB(i), type, pc, known);
+                emit_inc_count(j);
+                emit_load(j, RAX, REG_REGS, OFF_V(PB(i)));
+                if (type == T_LONG) {
+                    emit_op_reg(j, 0, 1, 0xF7, 3, RAX);     // neg rax
+                } else {
+                    emit_op_reg(j, 0, 1, 0x0FBA, 7, RAX);   // btc rax, 63
+                    emit_byte(j, 63);
+                }
+                emit_result(j, a, type);
+                known[a] = type;
+                return 0;
+            }
+            break;
+        case OP_LE: case OP_LT: case OP_LT_LONG: case OP_LT_DOUBLE:
+        case OP_LEI: case OP_LTI: case OP_GEI: case OP_GTI:
+            if (type != T_UNKNOWN) {
+                trace_compare(j, pc, i, type, known);
+                return 0;
+            }
+            break;
+        default:
+            break;
+    }
+
+    // 其它指令使用与函数相同的模板，模板需要退出机器码时放弃编译
+    if (!jit_compile_insn(j, r->fun, bc, pc)) {
+        return 1;
+    }
+
+    d = insn_def(i);
+    if (d >= 0) {
+        known[d] = insn_result(i, known);
+    }
+
+    return 0;
+}
+
+static int trace_compile(lgx_vm_t *vm, lgx_jit_recorder_t *r) {
+    unsigned *bc = vm->c->bc.buffer;
+    unsigned char head[256], known[256], written[256];
+    unsigned k, f, entry, body;
+    int loop = 1;
+
+    memset(head, T_UNKNOWN, sizeof(head));
+    memset(written, 0, sizeof(written));
+
+    // 在 trace 中第一次访问为读取并且需要特化的寄存器在入口处检查类型，
+    // 循环体中不再重复检查
+    for (k = 0; k < r->length; ++k) {
+        uint32_t i = bc[r->insns[k].pc];
+        lgx_val_type_t type = trace_type(i, &r->insns[k]);
+        int observe = insn_observe(i);
+        unsigned regs[3] = { PA(i), PB(i), PC(i) };
+        if (type != T_UNKNOWN) {
+            for (f = 0; f < 3; ++f) {
+                if ((observe & (1 << f)) && !written[regs[f]]) {
+                    head[regs[f]] = type;
+                }
+            }
+        }
+        int d = insn_def(i);
+        if (d >= 0) {
+            written[d] = 1;
+        }
+    }
+
+    jit_compiler_t j;
+    memset(&j, 0, sizeof(j));
+
+    emit_prologue(&j);
+
+    entry = j.length;
+    for (k = 0; k < 256; ++k) {
+        if (head[k] != T_UNKNOWN) {
+            emit_cmp_type(&j, k, head[k]);
+            emit_branch(&j, CC_NE, r->pc);
+        }
+    }
+    memcpy(known, head, sizeof(known));
+
+    body = j.length;
+    for (k = 0; k < r->length; ++k) {
+        unsigned next = k + 1 < r->length ? r->insns[k + 1].pc : r->pc;
+        if (trace_compile_insn(&j, vm, r, &r->insns[k], next, known)) {
+            xfree(j.buf);
+            xfree(j.fixups);
+            return 1;
+        }
+    }
+
+    // 回边：循环体结束时入口处检查过的寄存器类型不变时跳过入口处的类型检查
+    for (k = 0; k < 256; ++k) {
+        if (head[k] != T_UNKNOWN && known[k] != head[k]) {
+            loop = 0;
+        }
+    }
+    emit_jmp_to(&j, loop ? body : entry);
+
+    void *code = jit_link(&j, NULL, NULL);
+    if (!code) {
+        return 1;
+    }
+
+    lgx_jit_trace_t *trace = xcalloc(1, sizeof(lgx_jit_trace_t));
+    if (!trace) {
+        munmap(code, j.length);
+        return 1;
+    }
+    trace->pc = r->pc;
+    trace->code = code;
+    trace->size = j.length;
+    trace->entry = entry;
+
+    vm->jit.loops[r->pc].trace = trace;
+    ++ vm->jit.traces;
+
+    return 0;
+}
+
+// 放弃记录，多次失败后不再尝试记录该循环
+static void trace_abort(lgx_vm_t *vm, unsigned pc) {
+    lgx_jit_loop_t *loop = &vm->jit.loops[pc];
+
+    vm->jit.recording = 0;
+    if (++ loop->aborts < TRACE_ABORTS) {
+        loop->count = 0;
+    }
+}
+
+void lgx_jit_trace_abort(lgx_vm_t *vm) {
+    if (vm->jit.recording) {
+        trace_abort(vm, vm->jit.recorder->pc);
+    }
+}
+
+int lgx_jit_trace_start(lgx_vm_t *vm, unsigned pc) {
+    lgx_jit_recorder_t *r = vm->jit.recorder;
+
+    if (vm->jit.recording) {
+        return 1;
+    }
+
+    r->pc = pc;
+    r->co = vm->co_running;
+    r->fun = lgx_value_fun(&vm->regs[0]);
+    r->length = 0;
+
+    vm->jit.recording = 1;
+
+    return 0;
+}
+
+int lgx_jit_trace_record(lgx_vm_t *vm, unsigned pc, lgx_value_t *regs) {
+    lgx_jit_recorder_t *r = vm->jit.recorder;
+    unsigned *bc = vm->c->bc.buffer;
+    uint32_t i = bc[pc];
+    unsigned f;
+
+    if (!vm->jit.recording) {
+        return 1;
+    }
+
+    if (vm->co_running != r->co || (r->length ? pc != r->next[0] && pc != r->next[1] : pc != r->pc)) {
+        // 执行路径离开了当前栈帧，例如抛出异常或者切换协程
+        trace_abort(vm, r->pc);
+        return 1;
+    }
+
+    if (r->length && pc == r->pc) {
+        // 回到循环入口
+        vm->jit.recording = 0;
+        if (trace_compile(vm, r)) {
+            trace_abort(vm, r->pc);
+        }
+        return 1;
+    }
+
+    if (r->length == TRACE_LENGTH) {
+        trace_abort(vm, r->pc);
+        return 1;
+    }
+
+    switch (OP(i)) {
+        case OP_CALL_NEW:
+        case OP_CALL:
+        case OP_TAIL_CALL:
+        case OP_CO_CALL:
+        case OP_RET:
+        case OP_HLT:
+        case OP_JMP:
+        case OP_THROW:
+            // 切换栈帧的指令不能出现在 trace 中
+            trace_abort(vm, r->pc);
+            return 1;
+        case OP_TEST:
+            r->next[0] = pc + 1;
+            r->next[1] = pc + 1 + PD(i);
+            break;
+        case OP_JMPI:
+            r->next[0] = r->next[1] = PE(i);
+            break;
+        case OP_INCJMP:
+            r->next[0] = r->next[1] = PE(bc[pc + 1]);
+            break;
+        default:
+            r->next[0] = r->next[1] = pc + insn_size(i);
+            if (insn_size(i) == 2) {
+                r->next[1] = PE(bc[pc + 1]);
+            }
+            break;
+    }
+
+    jit_record_t *rec = &r->insns[r->length ++];
+    int observe = insn_observe(i);
+    unsigned fields[3] = { PA(i), PB(i), PC(i) };
+
+    rec->pc = pc;
+    for (f = 0; f < 3; ++f) {
+        rec->types[f] = (observe & (1 << f)) ? lgx_value_type(&regs[fields[f]]) : T_UNKNOWN;
+    }
+
+    return 0;
+}
+
+void lgx_jit_trace_execute(lgx_vm_t *vm, lgx_jit_trace_t *trace) {
+    ((jit_entry_t)trace->code)(vm, vm->regs, trace->code + trace->entry);
+
+    // 在入口处退出说明操作数的类型已经改变，多次发生后丢弃该 trace，按照新的类型重新记录
+    if (vm->co_running->pc == trace->pc && ++ trace->misses >= TRACE_MISSES) {
+        lgx_jit_loop_t *loop = &vm->jit.loops[trace->pc];
+        loop->trace = NULL;
+        if (++ loop->aborts < TRACE_ABORTS) {
+            loop->count = 0;
+        }
+        munmap(trace->code, trace->size);
+        xfree(trace);
+    }
+}
+
+#endif
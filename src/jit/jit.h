@@ -0,0 +1,83 @@
+#ifndef LGX_JIT_H
+#define LGX_JIT_H
+
+// 模板 JIT
+// 函数的调用次数达到阈值后，把字节码逐条翻译为 x86-64 机器码。
+// 机器码只在当前函数的栈帧内执行，遇到函数调用、返回、协程等会切换栈帧的指令时退出，
+// 由解释器执行该指令；解释器切换栈帧后，如果新的函数已经被编译，则重新进入机器码执行。
+// 数组、字符串等复杂指令通过调用运行时函数实现，抛出异常时同样退出到解释器。
+//
+// 循环 trace
+// 循环回边（向后跳转）的执行次数达到阈值后，解释器记录下一次迭代实际执行的指令序列以及
+// 操作数的类型，把这条路径编译为只包含一个循环的机器码。通用指令按照记录的类型特化，
+// 类型检查与分支方向作为 guard，条件不成立时退出到解释器。
+#include "../interpreter/vm.h"
+
+// 目前只支持 x86-64 System V ABI
+// 机器码按照 16 字节的值布局读写寄存器，使用 NaN-boxing 时不启用 JIT
+#if defined(__x86_64__) && !defined(_WIN32) && !defined(LGX_VALUE_NAN_BOXING)
+#define LGX_JIT
+#endif
+
+// 默认的编译阈值
+#define LGX_JIT_THRESHOLD 1000
+
+// 默认的循环 trace 阈值
+#define LGX_JIT_TRACE_THRESHOLD 50
+
+struct lgx_jit_function_s {
+    // 调用次数
+    unsigned calls;
+
+    // 机器码，未编译时为 NULL
+    unsigned char *code;
+    size_t size;
+
+    // 每条字节码对应的机器码入口，以 pc - fun->addr 为下标，无法进入时为 NULL
+    void **entries;
+};
+
+struct lgx_jit_trace_s {
+    // 循环入口
+    unsigned pc;
+
+    // 机器码
+    unsigned char *code;
+    size_t size;
+    unsigned entry;
+
+    // 在循环入口处退出的次数，类型检查持续失败时丢弃该 trace 并重新记录
+    unsigned misses;
+};
+
+struct lgx_jit_loop_s {
+    // 回边执行次数
+    unsigned count;
+    // 记录失败的次数，超过上限后不再尝试记录
+    unsigned aborts;
+    // 编译后的 trace，没有时为 NULL
+    lgx_jit_trace_t *trace;
+};
+
+int lgx_jit_init(lgx_vm_t *vm);
+void lgx_jit_cleanup(lgx_vm_t *vm);
+
+// 把函数编译为机器码
+int lgx_jit_compile(lgx_vm_t *vm, lgx_function_t *fun);
+
+// 从当前协程的 pc 处进入机器码执行，返回时 pc 与 vm->regs 指向需要由解释器继续执行的位置
+void lgx_jit_execute(lgx_vm_t *vm, lgx_function_t *fun);
+
+// 开始记录从 pc 处开始的循环，返回 0 表示开始记录
+int lgx_jit_trace_start(lgx_vm_t *vm, unsigned pc);
+
+// 记录即将执行的 pc 处的指令，返回不为 0 时表示记录已经结束
+int lgx_jit_trace_record(lgx_vm_t *vm, unsigned pc, lgx_value_t *regs);
+
+// 放弃正在记录的 trace
+void lgx_jit_trace_abort(lgx_vm_t *vm);
+
+// 执行 trace，返回时 pc 与 vm->regs 指向需要由解释器继续执行的位置
+void lgx_jit_trace_execute(lgx_vm_t *vm, lgx_jit_trace_t *trace);
+
+#endif // LGX_JIT_H
@@ -1,2 +1,1694 @@
+#include <limits.h>
+#include "../common/common.h"
+#include "../runtime/exception.h"
+#include "../compiler/bytecode.h"
+#include "../compiler/constant.h"
 #include "optimizer.h"
 
+// 寄存器集合，单个函数最多使用 256 个寄存器
+typedef struct {
+    uint64_t bits[4];
+} opt_regs_t;
+
+#define REGS_SET(s, r) ((s)->bits[(r) >> 6] |= 1ULL << ((r) & 63))
+#define REGS_CLR(s, r) ((s)->bits[(r) >> 6] &= ~(1ULL << ((r) & 63)))
+#define REGS_HAS(s, r) ((s)->bits[(r) >> 6] & (1ULL << ((r) & 63)))
+
+// R0 - R3 保存调用信息，始终视为活跃
+#define REG_RESERVED 4
+
+// 常量传播的格值
+enum {
+    CV_UNDEF = 0,   // 尚未到达
+    CV_CONST,       // 常量
+    CV_VARYING      // 非常量
+};
+
+typedef struct {
+    int kind;
+    lgx_val_type_t type;
+    lgx_v_t v;
+} opt_cv_t;
+
+// 固定的指令位置，压缩时不会被删除
+enum {
+    PIN_NONE = 0,
+    // 异常表引用的位置，保存的是 NOP 指令
+    PIN_POSITION,
+    // 函数结束位置的 RET 指令，未捕获的异常会跳转到这里，不允许修改
+    PIN_INSTRUCTION
+};
+
+typedef struct {
+    // 基本块范围 [start, end)
+    unsigned start;
+    unsigned end;
+
+    unsigned char reachable;
+
+    // 活跃变量
+    opt_regs_t live_in;
+    opt_regs_t live_out;
+} opt_block_t;
+
+typedef struct {
+    lgx_compiler_t* c;
+
+    uint32_t* bc;
+    unsigned length;
+
+    unsigned char* leader;
+    unsigned char* pinned;
+
+    // 字节码位置 -> 基本块编号
+    unsigned* block_of;
+
+    opt_block_t* blocks;
+    unsigned blocks_length;
+
+    // 临时缓冲区，保存基本块内各条指令的起始位置
+    unsigned* insns;
+
+    lgx_function_t** functions;
+    unsigned functions_length;
+
+    lgx_exception_t** exceptions;
+    unsigned exceptions_length;
+
+    // 常量编号 -> 常量值
+    lgx_value_t** constants;
+    unsigned constants_length;
+} lgx_optimizer_t;
+
+// 指令占用的字数
+static unsigned insn_size(uint32_t i) {
+    switch (OP(i)) {
+        case OP_JLT: case OP_JLE: case OP_JEQ: case OP_JNE:
+        case OP_JLTI: case OP_JLEI: case OP_JGTI: case OP_JGEI: case OP_JEQI: case OP_JNEI:
+        case OP_INCJMP:
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+// 是否为比较跳转指令
+static int insn_is_branch(unsigned op) {
+    return op >= OP_JLT && op <= OP_JNEI;
+}
+
+// 获取指令的跳转目标，没有跳转目标时返回 0
+static int insn_target(uint32_t* bc, unsigned pos, unsigned* target) {
+    uint32_t i = bc[pos];
+    switch (OP(i)) {
+        case OP_JMPI:
+            *target = PE(i);
+            return 1;
+        case OP_TEST:
+            *target = pos + 1 + PD(i);
+            return 1;
+        default:
+            if (insn_is_branch(OP(i)) || OP(i) == OP_INCJMP) {
+                *target = PE(bc[pos + 1]);
+                return 1;
+            }
+            return 0;
+    }
+}
+
+// 执行后是否可能继续执行下一条指令
+static int insn_falls_through(unsigned op) {
+    switch (op) {
+        case OP_JMP:
+        case OP_JMPI:
+        case OP_INCJMP:
+        case OP_RET:
+        case OP_TAIL_CALL:
+        case OP_THROW:
+        case OP_HLT:
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+// 指令写入的寄存器，没有写入时返回 -1
+static int insn_def(uint32_t i) {
+    switch (OP(i)) {
+        case OP_LOAD: case OP_MOV: case OP_MOVI:
+        case OP_ADD: case OP_ADDI: case OP_SUB: case OP_SUBI:
+        case OP_MUL: case OP_MULI: case OP_DIV: case OP_DIVI: case OP_NEG:
+        case OP_SHL: case OP_SHLI: case OP_SHR: case OP_SHRI:
+        case OP_AND: case OP_OR: case OP_XOR: case OP_NOT:
+        case OP_EQ: case OP_EQI: case OP_LE: case OP_LEI: case OP_LT: case OP_LTI:
+        case OP_GEI: case OP_GTI: case OP_LNOT:
+        case OP_IADD: case OP_IADDI: case OP_ISUB: case OP_ISUBI:
+        case OP_IMUL: case OP_IMULI: case OP_IDIV: case OP_IDIVI: case OP_INEG:
+        case OP_IEQ: case OP_IEQI: case OP_ILE: case OP_ILEI: case OP_ILT: case OP_ILTI:
+        case OP_IGEI: case OP_IGTI:
+        case OP_FADD: case OP_FSUB: case OP_FMUL: case OP_FDIV: case OP_FNEG:
+        case OP_FEQ: case OP_FLE: case OP_FLT:
+        case OP_ADD_LONG: case OP_ADD_DOUBLE: case OP_LT_LONG: case OP_LT_DOUBLE:
+        case OP_ARRAY_GET_LONG:
+        case OP_INCJMP:
+        case OP_CALL:
+        case OP_ARRAY_NEW: case OP_ARRAY_GET:
+        case OP_MAP_NEW: case OP_MAP_GET:
+        case OP_GLOBAL_GET:
+        case OP_CONCAT:
+            return PA(i);
+        default:
+            return -1;
+    }
+}
+
+// 指令读取的寄存器，返回 -1 表示可能读取任意寄存器
+static int insn_uses(uint32_t i, unsigned* u) {
+    switch (OP(i)) {
+        case OP_NOP: case OP_LOAD: case OP_MOVI: case OP_JMPI: case OP_HLT:
+        case OP_ARRAY_NEW: case OP_MAP_NEW: case OP_GLOBAL_GET:
+            return 0;
+        case OP_MOV: case OP_CALL_SET: case OP_CALL:
+        case OP_ADDI: case OP_SUBI: case OP_MULI: case OP_DIVI: case OP_NEG:
+        case OP_SHLI: case OP_SHRI: case OP_NOT:
+        case OP_EQI: case OP_LEI: case OP_LTI: case OP_GEI: case OP_GTI: case OP_LNOT:
+        case OP_IADDI: case OP_ISUBI: case OP_IMULI: case OP_IDIVI: case OP_INEG:
+        case OP_IEQI: case OP_ILEI: case OP_ILTI: case OP_IGEI: case OP_IGTI:
+        case OP_FNEG:
+            u[0] = PB(i);
+            return 1;
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
+        case OP_SHL: case OP_SHR: case OP_AND: case OP_OR: case OP_XOR:
+        case OP_EQ: case OP_LE: case OP_LT:
+        case OP_IADD: case OP_ISUB: case OP_IMUL: case OP_IDIV:
+        case OP_IEQ: case OP_ILE: case OP_ILT:
+        case OP_FADD: case OP_FSUB: case OP_FMUL: case OP_FDIV:
+        case OP_FEQ: case OP_FLE: case OP_FLT:
+        case OP_ADD_LONG: case OP_ADD_DOUBLE: case OP_LT_LONG: case OP_LT_DOUBLE:
+        case OP_ARRAY_GET_LONG: case OP_ARRAY_GET: case OP_MAP_GET: case OP_CONCAT:
+            u[0] = PB(i);
+            u[1] = PC(i);
+            return 2;
+        case OP_JLT: case OP_JLE: case OP_JEQ: case OP_JNE:
+        case OP_TYPEOF:
+            u[0] = PA(i);
+            u[1] = PB(i);
+            return 2;
+        case OP_JLTI: case OP_JLEI: case OP_JGTI: case OP_JGEI: case OP_JEQI: case OP_JNEI:
+        case OP_INCJMP:
+        case OP_TEST: case OP_JMP:
+        case OP_CALL_NEW: case OP_RET: case OP_TAIL_CALL: case OP_CO_CALL:
+        case OP_GLOBAL_SET: case OP_THROW: case OP_ECHO:
+            u[0] = PA(i);
+            return 1;
+        case OP_ARRAY_SET: case OP_MAP_SET:
+            u[0] = PA(i);
+            u[1] = PB(i);
+            u[2] = PC(i);
+            return 3;
+        default:
+            return -1;
+    }
+}
+
+// 没有副作用且不会抛出异常的指令，结果未被使用时可以删除
+static int insn_is_pure(uint32_t i) {
+    switch (OP(i)) {
+        case OP_LOAD: case OP_MOV: case OP_MOVI:
+        case OP_ARRAY_NEW: case OP_MAP_NEW: case OP_GLOBAL_GET:
+        case OP_IADD: case OP_IADDI: case OP_ISUB: case OP_ISUBI:
+        case OP_IMUL: case OP_IMULI: case OP_IDIVI: case OP_INEG:
+        case OP_IEQ: case OP_IEQI: case OP_ILE: case OP_ILEI: case OP_ILT: case OP_ILTI:
+        case OP_IGEI: case OP_IGTI:
+        case OP_FADD: case OP_FSUB: case OP_FMUL: case OP_FNEG:
+        case OP_FEQ: case OP_FLE: case OP_FLT:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// 目标寄存器与源寄存器相同时语义不变的指令（读取全部操作数之后才改写目标寄存器的类型）
+// 通用比较指令与 LNOT、CONCAT 会先写入目标寄存器，不能用于 MOV 合并
+static int insn_can_coalesce(uint32_t i) {
+    switch (OP(i)) {
+        case OP_LOAD: case OP_MOV: case OP_MOVI:
+        case OP_ADD: case OP_ADDI: case OP_SUB: case OP_SUBI:
+        case OP_MUL: case OP_MULI: case OP_DIV: case OP_DIVI: case OP_NEG:
+        case OP_SHL: case OP_SHLI: case OP_SHR: case OP_SHRI:
+        case OP_AND: case OP_OR: case OP_XOR: case OP_NOT:
+        case OP_IADD: case OP_IADDI: case OP_ISUB: case OP_ISUBI:
+        case OP_IMUL: case OP_IMULI: case OP_IDIV: case OP_IDIVI: case OP_INEG:
+        case OP_IEQ: case OP_IEQI: case OP_ILE: case OP_ILEI: case OP_ILT: case OP_ILTI:
+        case OP_IGEI: case OP_IGTI:
+        case OP_FADD: case OP_FSUB: case OP_FMUL: case OP_FDIV: case OP_FNEG:
+        case OP_FEQ: case OP_FLE: case OP_FLT:
+        case OP_CALL:
+        case OP_ARRAY_NEW: case OP_ARRAY_GET:
+        case OP_MAP_NEW: case OP_MAP_GET:
+        case OP_GLOBAL_GET:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// 指令中保存寄存器编号的字段
+#define FIELD_A 1
+#define FIELD_B 2
+#define FIELD_C 4
+
+// 获取指令中保存寄存器编号的字段，返回 -1 表示未知指令
+// CALL_SET 的 A 字段为被调用函数的参数位置，不是当前函数的寄存器
+static int insn_reg_fields(uint32_t i) {
+    switch (OP(i)) {
+        case OP_NOP: case OP_JMPI: case OP_HLT:
+            return 0;
+        case OP_LOAD: case OP_MOVI: case OP_ARRAY_NEW: case OP_MAP_NEW:
+        case OP_GLOBAL_GET: case OP_GLOBAL_SET:
+        case OP_JLTI: case OP_JLEI: case OP_JGTI: case OP_JGEI: case OP_JEQI: case OP_JNEI:
+        case OP_INCJMP:
+        case OP_TEST: case OP_JMP:
+        case OP_CALL_NEW: case OP_RET: case OP_TAIL_CALL: case OP_CO_CALL:
+        case OP_THROW: case OP_ECHO:
+            return FIELD_A;
+        case OP_CALL_SET:
+            return FIELD_B;
+        case OP_MOV: case OP_CALL: case OP_TYPEOF:
+        case OP_ADDI: case OP_SUBI: case OP_MULI: case OP_DIVI: case OP_NEG:
+        case OP_SHLI: case OP_SHRI: case OP_NOT:
+        case OP_EQI: case OP_LEI: case OP_LTI: case OP_GEI: case OP_GTI: case OP_LNOT:
+        case OP_IADDI: case OP_ISUBI: case OP_IMULI: case OP_IDIVI: case OP_INEG:
+        case OP_IEQI: case OP_ILEI: case OP_ILTI: case OP_IGEI: case OP_IGTI:
+        case OP_FNEG:
+        case OP_JLT: case OP_JLE: case OP_JEQ: case OP_JNE:
+            return FIELD_A | FIELD_B;
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
+        case OP_SHL: case OP_SHR: case OP_AND: case OP_OR: case OP_XOR:
+        case OP_EQ: case OP_LE: case OP_LT:
+        case OP_IADD: case OP_ISUB: case OP_IMUL: case OP_IDIV:
+        case OP_IEQ: case OP_ILE: case OP_ILT:
+        case OP_FADD: case OP_FSUB: case OP_FMUL: case OP_FDIV:
+        case OP_FEQ: case OP_FLE: case OP_FLT:
+        case OP_ADD_LONG: case OP_ADD_DOUBLE: case OP_LT_LONG: case OP_LT_DOUBLE:
+        case OP_ARRAY_GET_LONG: case OP_ARRAY_GET: case OP_ARRAY_SET:
+        case OP_MAP_GET: case OP_MAP_SET: case OP_CONCAT:
+            return FIELD_A | FIELD_B | FIELD_C;
+        default:
+            return -1;
+    }
+}
+
+static uint32_t insn_rename(uint32_t i, int fields, unsigned char* map) {
+    if (fields & FIELD_A) {
+        i = (i & ~0xFF00u) | ((uint32_t)map[PA(i)] << 8);
+    }
+    if (fields & FIELD_B) {
+        i = (i & ~0xFF0000u) | ((uint32_t)map[PB(i)] << 16);
+    }
+    if (fields & FIELD_C) {
+        i = (i & ~0xFF000000u) | ((uint32_t)map[PC(i)] << 24);
+    }
+    return i;
+}
+
+// 删除指令，被删除的位置在压缩时移除
+static void insn_remove(lgx_optimizer_t* opt, unsigned pos) {
+    unsigned n = insn_size(opt->bc[pos]);
+    while (n--) {
+        opt->bc[pos + n] = I0(OP_NOP);
+    }
+}
+
+// 判断指令位置是否处于 try block 中
+static int in_try(lgx_exception_t* e, unsigned pos) {
+    return pos >= e->try_block.start && pos <= e->try_block.end;
+}
+
+static int optimizer_init(lgx_optimizer_t* opt, lgx_compiler_t* c) {
+    memset(opt, 0, sizeof(lgx_optimizer_t));
+
+    opt->c = c;
+    opt->bc = c->bc.buffer;
+    opt->length = c->bc.length;
+
+    opt->leader = xcalloc(opt->length + 1, sizeof(unsigned char));
+    opt->pinned = xcalloc(opt->length + 1, sizeof(unsigned char));
+    opt->block_of = xcalloc(opt->length + 1, sizeof(unsigned));
+    opt->blocks = xcalloc(opt->length + 1, sizeof(opt_block_t));
+    opt->insns = xcalloc(opt->length + 1, sizeof(unsigned));
+    opt->functions = xcalloc(c->constant.length + 1, sizeof(lgx_function_t*));
+    opt->exceptions = xcalloc(c->exception.size + 1, sizeof(lgx_exception_t*));
+    if (!opt->leader || !opt->pinned || !opt->block_of || !opt->blocks ||
+        !opt->insns || !opt->functions || !opt->exceptions) {
+        return 1;
+    }
+
+    // 收集函数
+    lgx_ht_node_t* n;
+    for (n = lgx_ht_first(&c->constant); n; n = lgx_ht_next(n)) {
+        lgx_const_t* k = (lgx_const_t*)n->v;
+        if (lgx_value_type(&k->v) == T_FUNCTION && lgx_value_fun(&k->v) && !lgx_value_fun(&k->v)->buildin) {
+            opt->functions[opt->functions_length ++] = lgx_value_fun(&k->v);
+            opt->pinned[lgx_value_fun(&k->v)->end] = PIN_INSTRUCTION;
+        }
+    }
+
+    // 收集异常表
+    lgx_rb_node_t* node;
+    for (node = lgx_rb_first(&c->exception); node; node = lgx_rb_next(node)) {
+        lgx_exception_t* e = (lgx_exception_t*)node->value;
+        opt->exceptions[opt->exceptions_length ++] = e;
+    }
+
+    return 0;
+}
+
+static void optimizer_cleanup(lgx_optimizer_t* opt) {
+    xfree(opt->leader);
+    xfree(opt->pinned);
+    xfree(opt->block_of);
+    xfree(opt->blocks);
+    xfree(opt->insns);
+    xfree(opt->functions);
+    xfree(opt->exceptions);
+    xfree(opt->constants);
+}
+
+// 划分基本块
+static void optimizer_build(lgx_optimizer_t* opt) {
+    unsigned p, next, target, i;
+
+    memset(opt->leader, 0, opt->length + 1);
+
+    opt->leader[0] = 1;
+    for (i = 0; i < opt->functions_length; ++i) {
+        opt->leader[opt->functions[i]->addr] = 1;
+    }
+
+    // try block 的边界也作为基本块的边界，使每个基本块要么完全处于 try block 中，要么完全不在
+    for (i = 0; i < opt->exceptions_length; ++i) {
+        lgx_exception_t* e = opt->exceptions[i];
+        opt->leader[e->try_block.start] = 1;
+        opt->leader[e->try_block.end + 1] = 1;
+
+        lgx_exception_block_t* block;
+        lgx_list_for_each_entry(block, lgx_exception_block_t, &e->catch_blocks, head) {
+            opt->leader[block->start] = 1;
+            opt->leader[block->end + 1] = 1;
+        }
+    }
+
+    for (p = 0; p < opt->length; p = next) {
+        next = p + insn_size(opt->bc[p]);
+        if (insn_target(opt->bc, p, &target)) {
+            opt->leader[target] = 1;
+            opt->leader[next] = 1;
+        } else if (!insn_falls_through(OP(opt->bc[p]))) {
+            opt->leader[next] = 1;
+        }
+    }
+
+    opt->blocks_length = 0;
+    for (p = 0; p < opt->length; p = next) {
+        if (opt->leader[p]) {
+            if (opt->blocks_length) {
+                opt->blocks[opt->blocks_length - 1].end = p;
+            }
+            memset(&opt->blocks[opt->blocks_length], 0, sizeof(opt_block_t));
+            opt->blocks[opt->blocks_length].start = p;
+            opt->blocks_length ++;
+        }
+
+        next = p + insn_size(opt->bc[p]);
+        for (i = p; i < next; ++i) {
+            opt->block_of[i] = opt->blocks_length - 1;
+        }
+    }
+    if (opt->blocks_length) {
+        opt->blocks[opt->blocks_length - 1].end = opt->length;
+    }
+}
+
+// 获取基本块中各条指令的起始位置，返回指令数量
+static unsigned block_insns(lgx_optimizer_t* opt, unsigned b) {
+    unsigned n = 0, p;
+    for (p = opt->blocks[b].start; p < opt->blocks[b].end; p += insn_size(opt->bc[p])) {
+        opt->insns[n ++] = p;
+    }
+    return n;
+}
+
+// 获取基本块的后继（不含异常处理入口），返回后继数量
+static unsigned block_successors(lgx_optimizer_t* opt, unsigned b, unsigned* succ) {
+    unsigned n = 0, target;
+    unsigned last = opt->insns[block_insns(opt, b) - 1];
+
+    if (insn_target(opt->bc, last, &target)) {
+        succ[n ++] = opt->block_of[target];
+    }
+    if (insn_falls_through(OP(opt->bc[last])) && opt->blocks[b].end < opt->length) {
+        succ[n ++] = b + 1;
+    }
+
+    return n;
+}
+
+// 从函数入口与 catch block 入口出发，标记所有可达的基本块
+static int optimizer_reachable(lgx_optimizer_t* opt) {
+    unsigned* stack = xcalloc(opt->blocks_length + 1, sizeof(unsigned));
+    if (!stack) {
+        return 1;
+    }
+
+    unsigned top = 0, i, j, b;
+
+#define MARK(blk) do {                          \
+        unsigned __b = (blk);                   \
+        if (!opt->blocks[__b].reachable) {      \
+            opt->blocks[__b].reachable = 1;     \
+            stack[top ++] = __b;                \
+        }                                       \
+    } while (0)
+
+    for (i = 0; i < opt->functions_length; ++i) {
+        MARK(opt->block_of[opt->functions[i]->addr]);
+    }
+    for (i = 0; i < opt->exceptions_length; ++i) {
+        lgx_exception_block_t* block;
+        lgx_list_for_each_entry(block, lgx_exception_block_t, &opt->exceptions[i]->catch_blocks, head) {
+            MARK(opt->block_of[block->start]);
+        }
+    }
+
+    while (top) {
+        unsigned succ[2];
+        b = stack[-- top];
+        unsigned n = block_successors(opt, b, succ);
+        for (j = 0; j < n; ++j) {
+            MARK(succ[j]);
+        }
+    }
+
+#undef MARK
+
+    xfree(stack);
+    return 0;
+}
+
+// 删除不可达代码
+static int optimizer_remove_unreachable(lgx_optimizer_t* opt) {
+    int changed = 0;
+    unsigned b, k, n;
+
+    optimizer_build(opt);
+    if (optimizer_reachable(opt)) {
+        return -1;
+    }
+
+    for (b = 0; b < opt->blocks_length; ++b) {
+        if (opt->blocks[b].reachable) {
+            continue;
+        }
+        n = block_insns(opt, b);
+        for (k = 0; k < n; ++k) {
+            unsigned p = opt->insns[k];
+            if (OP(opt->bc[p]) == OP_NOP || opt->pinned[p] == PIN_INSTRUCTION) {
+                continue;
+            }
+            insn_remove(opt, p);
+            changed = 1;
+        }
+    }
+
+    return changed;
+}
+
+// 跳过 NOP 与 JMPI，找到最终的跳转目标
+static unsigned jump_final(lgx_optimizer_t* opt, unsigned target) {
+    int hops = 0;
+    while (target < opt->length) {
+        unsigned op = OP(opt->bc[target]);
+        if (op == OP_NOP) {
+            ++ target;
+        } else if (op == OP_JMPI && hops < 16) {
+            // 限制跳转次数，避免死循环 JMPI 导致无法退出
+            target = PE(opt->bc[target]);
+            ++ hops;
+        } else {
+            break;
+        }
+    }
+    return target;
+}
+
+// 跳转穿透：跳转到 JMPI 的跳转指令直接跳转到最终目标，跳转到 RET 的 JMPI 直接替换为 RET
+static int optimizer_thread_jumps(lgx_optimizer_t* opt) {
+    int changed = 0;
+    unsigned p, next, target, final;
+
+    for (p = 0; p < opt->length; p = next) {
+        uint32_t i = opt->bc[p];
+        next = p + insn_size(i);
+
+        if (!insn_target(opt->bc, p, &target)) {
+            continue;
+        }
+
+        final = jump_final(opt, target);
+        if (final >= opt->length) {
+            continue;
+        }
+
+        if (OP(i) == OP_JMPI) {
+            if (OP(opt->bc[final]) == OP_RET) {
+                opt->bc[p] = opt->bc[final];
+                changed = 1;
+            } else if (final != target) {
+                bc_set_jump(opt->c, p, final);
+                changed = 1;
+            }
+        } else if (OP(i) == OP_TEST) {
+            // TEST 只能向后跳转，且跳转距离不能超过 64K
+            if (final != target && final > p && final - p - 1 <= 0xFFFF) {
+                bc_set_jump(opt->c, p, final);
+                changed = 1;
+            }
+        } else if (final != target) {
+            bc_set_jump(opt->c, p + 1, final);
+            changed = 1;
+        }
+    }
+
+    return changed;
+}
+
+// 删除跳转到下一条指令的跳转
+static int optimizer_remove_redundant_jumps(lgx_optimizer_t* opt) {
+    int changed = 0;
+    unsigned p, next, target, k;
+
+    // 逆序处理，使连续的多条跳转均能被删除
+    unsigned n = 0;
+    for (p = 0; p < opt->length; p = next) {
+        next = p + insn_size(opt->bc[p]);
+        opt->insns[n ++] = p;
+    }
+
+    while (n--) {
+        p = opt->insns[n];
+        uint32_t i = opt->bc[p];
+        if (OP(i) != OP_JMPI && !insn_is_branch(OP(i))) {
+            continue;
+        }
+        if (!insn_target(opt->bc, p, &target) || target <= p) {
+            continue;
+        }
+        for (k = p + insn_size(i); k < target; ++k) {
+            if (OP(opt->bc[k]) != OP_NOP) {
+                break;
+            }
+        }
+        if (k == target) {
+            insn_remove(opt, p);
+            changed = 1;
+        }
+    }
+
+    return changed;
+}
+
+// 计算基本块的异常处理入口的活跃寄存器
+static void block_exception_live(lgx_optimizer_t* opt, unsigned b, opt_regs_t* live) {
+    unsigned i, j;
+
+    memset(live, 0, sizeof(opt_regs_t));
+    for (i = 0; i < opt->exceptions_length; ++i) {
+        if (!in_try(opt->exceptions[i], opt->blocks[b].start)) {
+            continue;
+        }
+        lgx_exception_block_t* block;
+        lgx_list_for_each_entry(block, lgx_exception_block_t, &opt->exceptions[i]->catch_blocks, head) {
+            // 进入 catch block 时异常变量会被写入 block->reg
+            opt_regs_t in = opt->blocks[opt->block_of[block->start]].live_in;
+            REGS_CLR(&in, block->reg);
+            for (j = 0; j < 4; ++j) {
+                live->bits[j] |= in.bits[j];
+            }
+        }
+    }
+}
+
+static void live_transfer(uint32_t i, opt_regs_t* live) {
+    unsigned u[3];
+    int d = insn_def(i);
+    int n = insn_uses(i, u);
+
+    if (d >= 0) {
+        REGS_CLR(live, d);
+    }
+    if (n < 0) {
+        memset(live, 0xFF, sizeof(opt_regs_t));
+    } else {
+        while (n--) {
+            REGS_SET(live, u[n]);
+        }
+    }
+}
+
+static void live_union(opt_regs_t* dst, opt_regs_t* src) {
+    int j;
+    for (j = 0; j < 4; ++j) {
+        dst->bits[j] |= src->bits[j];
+    }
+}
+
+// 活跃变量分析
+// 处于 try block 中的指令都可能抛出异常，因此在每条指令处都合并 catch block 入口的活跃寄存器
+static void optimizer_liveness(lgx_optimizer_t* opt) {
+    int changed;
+    unsigned b, j, k, n;
+
+    optimizer_build(opt);
+    optimizer_reachable(opt);
+
+    do {
+        changed = 0;
+        b = opt->blocks_length;
+        while (b--) {
+            if (!opt->blocks[b].reachable) {
+                continue;
+            }
+
+            opt_regs_t out, live, exc;
+            unsigned succ[2];
+
+            memset(&out, 0, sizeof(out));
+            n = block_successors(opt, b, succ);
+            for (j = 0; j < n; ++j) {
+                live_union(&out, &opt->blocks[succ[j]].live_in);
+            }
+            block_exception_live(opt, b, &exc);
+            live_union(&out, &exc);
+
+            live = out;
+            n = block_insns(opt, b);
+            for (k = n; k-- > 0;) {
+                live_transfer(opt->bc[opt->insns[k]], &live);
+                live_union(&live, &exc);
+            }
+
+            if (memcmp(&out, &opt->blocks[b].live_out, sizeof(out)) ||
+                memcmp(&live, &opt->blocks[b].live_in, sizeof(live))) {
+                opt->blocks[b].live_out = out;
+                opt->blocks[b].live_in = live;
+                changed = 1;
+            }
+        }
+    } while (changed);
+}
+
+// 死存储删除与 MOV 合并
+// 把 OP t ...; MOV x t 合并为 OP x ...（t 在 MOV 之后不再活跃）
+static int optimizer_eliminate(lgx_optimizer_t* opt, int dead_store) {
+    int changed = 0;
+    unsigned b, k, n;
+
+    optimizer_liveness(opt);
+
+    for (b = 0; b < opt->blocks_length; ++b) {
+        if (!opt->blocks[b].reachable) {
+            continue;
+        }
+
+        opt_regs_t live, exc;
+        block_exception_live(opt, b, &exc);
+        live = opt->blocks[b].live_out;
+
+        n = block_insns(opt, b);
+        for (k = n; k-- > 0;) {
+            unsigned p = opt->insns[k];
+            uint32_t i = opt->bc[p];
+            int d = insn_def(i);
+
+            if (dead_store && d >= REG_RESERVED && !REGS_HAS(&live, d) && insn_is_pure(i)) {
+                insn_remove(opt, p);
+                changed = 1;
+                continue;
+            }
+
+            if (OP(i) == OP_MOV && k > 0) {
+                unsigned x = PA(i), t = PB(i);
+                unsigned prev = opt->insns[k - 1];
+                uint32_t j = opt->bc[prev];
+                if (t >= REG_RESERVED && t != x && !REGS_HAS(&live, t) &&
+                    insn_def(j) == (int)t && insn_can_coalesce(j)) {
+                    opt->bc[prev] = (j & ~0xFF00u) | (x << 8);
+                    insn_remove(opt, p);
+                    changed = 1;
+                    continue;
+                }
+            }
+
+            live_transfer(i, &live);
+            live_union(&live, &exc);
+        }
+    }
+
+    return changed;
+}
+
+// 超出 T_LONG 范围的结果不折叠，保留运行时的 integer overflow 异常
+static void cv_set_long(opt_cv_t* cv, long long l) {
+    if (!lgx_long_fits(l)) {
+        cv->kind = CV_VARYING;
+        return;
+    }
+    cv->kind = CV_CONST;
+    cv->type = T_LONG;
+    cv->v.l = l;
+}
+
+static void cv_set_double(opt_cv_t* cv, double d) {
+    cv->kind = CV_CONST;
+    cv->type = T_DOUBLE;
+    cv->v.d = d;
+}
+
+static void cv_set_bool(opt_cv_t* cv, int b) {
+    cv->kind = CV_CONST;
+    cv->type = T_BOOL;
+    cv->v.l = b ? 1 : 0;
+}
+
+// 合并格值，返回是否发生变化
+static int cv_meet(opt_cv_t* dst, opt_cv_t* src) {
+    if (src->kind == CV_UNDEF || dst->kind == CV_VARYING) {
+        return 0;
+    }
+    if (dst->kind == CV_UNDEF || src->kind == CV_VARYING) {
+        *dst = *src;
+        return 1;
+    }
+    if (dst->type != src->type || dst->v.l != src->v.l) {
+        dst->kind = CV_VARYING;
+        return 1;
+    }
+    return 0;
+}
+
+// 读取指定类型的操作数，操作数不是常量时把结果设置为 UNDEF 或 VARYING 并返回 0
+static int cv_operand(opt_cv_t* r, unsigned reg, lgx_val_type_t type, lgx_v_t* v, opt_cv_t* out) {
+    if (r[reg].kind == CV_CONST && r[reg].type == type) {
+        *v = r[reg].v;
+        return 1;
+    }
+    if (r[reg].kind == CV_UNDEF) {
+        if (out->kind != CV_VARYING) {
+            out->kind = CV_UNDEF;
+        }
+    } else {
+        out->kind = CV_VARYING;
+    }
+    return 0;
+}
+
+// 读取两个整数操作数，imm 不为 0 时第二个操作数为立即数
+static int cv_long2(opt_cv_t* r, uint32_t i, int imm, long long* a, long long* b, opt_cv_t* out) {
+    lgx_v_t va, vb;
+    out->kind = CV_CONST;
+    int ok = cv_operand(r, PB(i), T_LONG, &va, out);
+    if (imm) {
+        vb.l = PC(i);
+    } else if (!cv_operand(r, PC(i), T_LONG, &vb, out)) {
+        ok = 0;
+    }
+    if (!ok) {
+        return 0;
+    }
+    *a = va.l;
+    *b = vb.l;
+    return 1;
+}
+
+static int cv_double2(opt_cv_t* r, uint32_t i, double* a, double* b, opt_cv_t* out) {
+    lgx_v_t va, vb;
+    out->kind = CV_CONST;
+    int ok = cv_operand(r, PB(i), T_DOUBLE, &va, out);
+    if (!cv_operand(r, PC(i), T_DOUBLE, &vb, out)) {
+        ok = 0;
+    }
+    if (!ok) {
+        return 0;
+    }
+    *a = va.d;
+    *b = vb.d;
+    return 1;
+}
+
+// 计算指令写入的值
+static void cv_eval(lgx_optimizer_t* opt, uint32_t i, opt_cv_t* r, opt_cv_t* out) {
+    long long a, b;
+    double x, y;
+    lgx_v_t v;
+
+    out->kind = CV_VARYING;
+
+    switch (OP(i)) {
+        case OP_MOVI:
+            cv_set_long(out, PD(i));
+            break;
+        case OP_LOAD:
+            if (PD(i) < opt->constants_length && opt->constants[PD(i)]) {
+                lgx_value_t* k = opt->constants[PD(i)];
+                switch (lgx_value_type(k)) {
+                    case T_LONG:
+                        cv_set_long(out, lgx_value_long(k));
+                        break;
+                    case T_DOUBLE:
+                        cv_set_double(out, lgx_value_double(k));
+                        break;
+                    case T_BOOL:
+                        cv_set_bool(out, lgx_value_bool(k));
+                        break;
+                    default:
+                        break;
+                }
+            }
+            break;
+        case OP_MOV:
+            *out = r[PB(i)];
+            break;
+        case OP_IADD: case OP_IADDI:
+            if (cv_long2(r, i, OP(i) == OP_IADDI, &a, &b, out)) {
+                cv_set_long(out, (long long)((unsigned long long)a + (unsigned long long)b));
+            }
+            break;
+        case OP_ISUB: case OP_ISUBI:
+            if (cv_long2(r, i, OP(i) == OP_ISUBI, &a, &b, out)) {
+                cv_set_long(out, (long long)((unsigned long long)a - (unsigned long long)b));
+            }
+            break;
+        case OP_IMUL: case OP_IMULI:
+            if (cv_long2(r, i, OP(i) == OP_IMULI, &a, &b, out)) {
+                cv_set_long(out, (long long)((unsigned long long)a * (unsigned long long)b));
+            }
+            break;
+        case OP_IDIV: case OP_IDIVI:
+            if (cv_long2(r, i, OP(i) == OP_IDIVI, &a, &b, out)) {
+                // 除零需要在运行时抛出异常
+                if (b == 0) {
+                    out->kind = CV_VARYING;
+                } else {
+                    cv_set_long(out, lgx_long_div(a, b));
+                }
+            }
+            break;
+        case OP_INEG:
+            out->kind = CV_CONST;
+            if (cv_operand(r, PB(i), T_LONG, &v, out)) {
+                cv_set_long(out, (long long)(0 - (unsigned long long)v.l));
+            }
+            break;
+        case OP_IEQ: case OP_IEQI:
+            if (cv_long2(r, i, OP(i) == OP_IEQI, &a, &b, out)) {
+                cv_set_bool(out, a == b);
+            }
+            break;
+        case OP_ILE: case OP_ILEI:
+            if (cv_long2(r, i, OP(i) == OP_ILEI, &a, &b, out)) {
+                cv_set_bool(out, a <= b);
+            }
+            break;
+        case OP_ILT: case OP_ILTI:
+            if (cv_long2(r, i, OP(i) == OP_ILTI, &a, &b, out)) {
+                cv_set_bool(out, a < b);
+            }
+            break;
+        case OP_IGEI:
+            if (cv_long2(r, i, 1, &a, &b, out)) {
+                cv_set_bool(out, a >= b);
+            }
+            break;
+        case OP_IGTI:
+            if (cv_long2(r, i, 1, &a, &b, out)) {
+                cv_set_bool(out, a > b);
+            }
+            break;
+        case OP_FADD:
+            if (cv_double2(r, i, &x, &y, out)) {
+                cv_set_double(out, x + y);
+            }
+            break;
+        case OP_FSUB:
+            if (cv_double2(r, i, &x, &y, out)) {
+                cv_set_double(out, x - y);
+            }
+            break;
+        case OP_FMUL:
+            if (cv_double2(r, i, &x, &y, out)) {
+                cv_set_double(out, x * y);
+            }
+            break;
+        case OP_FDIV:
+            if (cv_double2(r, i, &x, &y, out)) {
+                if (y == 0) {
+                    out->kind = CV_VARYING;
+                } else {
+                    cv_set_double(out, x / y);
+                }
+            }
+            break;
+        case OP_FNEG:
+            out->kind = CV_CONST;
+            if (cv_operand(r, PB(i), T_DOUBLE, &v, out)) {
+                cv_set_double(out, -v.d);
+            }
+            break;
+        case OP_FEQ:
+            if (cv_double2(r, i, &x, &y, out)) {
+                cv_set_bool(out, x == y);
+            }
+            break;
+        case OP_FLE:
+            if (cv_double2(r, i, &x, &y, out)) {
+                cv_set_bool(out, x <= y);
+            }
+            break;
+        case OP_FLT:
+            if (cv_double2(r, i, &x, &y, out)) {
+                cv_set_bool(out, x < y);
+            }
+            break;
+        case OP_LNOT:
+            out->kind = CV_CONST;
+            if (cv_operand(r, PB(i), T_BOOL, &v, out)) {
+                cv_set_bool(out, !v.l);
+            }
+            break;
+        case OP_INCJMP:
+            out->kind = CV_CONST;
+            if (cv_operand(r, PA(i), T_LONG, &v, out)) {
+                cv_set_long(out, (long long)((unsigned long long)v.l + PB(i)));
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void cv_transfer(lgx_optimizer_t* opt, uint32_t i, opt_cv_t* r) {
+    int d = insn_def(i);
+    if (d >= 0) {
+        opt_cv_t out;
+        cv_eval(opt, i, r, &out);
+        r[d] = out;
+    }
+}
+
+// 判断条件跳转的方向
+// 返回 1 表示总是跳转，0 表示总是不跳转，-1 表示无法确定，-2 表示条件尚未到达
+static int cv_branch(uint32_t i, opt_cv_t* r) {
+    opt_cv_t out;
+    long long a, b;
+    lgx_v_t v;
+
+    out.kind = CV_CONST;
+
+    if (OP(i) == OP_TEST) {
+        if (!cv_operand(r, PA(i), T_BOOL, &v, &out)) {
+            return out.kind == CV_UNDEF ? -2 : -1;
+        }
+        return v.l ? 0 : 1;
+    }
+
+    if (!insn_is_branch(OP(i))) {
+        return -1;
+    }
+
+    int ok = cv_operand(r, PA(i), T_LONG, &v, &out);
+    a = v.l;
+    if (OP(i) >= OP_JLTI) {
+        b = PB(i);
+    } else {
+        if (!cv_operand(r, PB(i), T_LONG, &v, &out)) {
+            ok = 0;
+        }
+        b = v.l;
+    }
+    if (!ok) {
+        return out.kind == CV_UNDEF ? -2 : -1;
+    }
+
+    switch (OP(i)) {
+        case OP_JLT: case OP_JLTI: return a < b;
+        case OP_JLE: case OP_JLEI: return a <= b;
+        case OP_JGTI: return a > b;
+        case OP_JGEI: return a >= b;
+        case OP_JEQ: case OP_JEQI: return a == b;
+        case OP_JNE: case OP_JNEI: return a != b;
+        default: return -1;
+    }
+}
+
+// 把常量写入寄存器的指令，无法生成时返回 0
+static int cv_load(lgx_optimizer_t* opt, unsigned reg, opt_cv_t* cv, int allow_load, uint32_t* insn) {
+    if (cv->type == T_LONG && cv->v.l >= 0 && cv->v.l <= 0xFFFF) {
+        *insn = I2(OP_MOVI, reg, (unsigned)cv->v.l);
+        return 1;
+    }
+
+    if (!allow_load) {
+        return 0;
+    }
+
+    lgx_expr_result_t e;
+    memset(&e, 0, sizeof(e));
+    e.type = EXPR_LITERAL;
+    e.v_type.type = cv->type;
+    if (cv->type == T_DOUBLE) {
+        e.v.d = cv->v.d;
+    } else {
+        e.v.l = cv->v.l;
+    }
+
+    int num = lgx_const_get(&opt->c->constant, &e);
+    if (num < 0 || num > 0xFFFF) {
+        return 0;
+    }
+
+    *insn = I2(OP_LOAD, reg, (unsigned)num);
+    return 1;
+}
+
+// 操作数为常量时，改写为立即数形式的指令
+static int cv_immediate(uint32_t* bc, unsigned p, opt_cv_t* r) {
+    uint32_t i = bc[p];
+    unsigned op = OP(i), a, b, pa = PA(i), pb = PB(i), pc = PC(i);
+
+#define IS_IMM(reg) (r[reg].kind == CV_CONST && r[reg].type == T_LONG && r[reg].v.l >= 0 && r[reg].v.l <= 255)
+#define IMM(reg)    ((unsigned)r[reg].v.l)
+
+    switch (op) {
+        case OP_IADD:
+        case OP_IMUL:
+        case OP_IEQ:
+            // 满足交换律
+            a = op == OP_IADD ? OP_IADDI : op == OP_IMUL ? OP_IMULI : OP_IEQI;
+            if (IS_IMM(pc)) {
+                bc[p] = I3(a, pa, pb, IMM(pc));
+                return 1;
+            } else if (IS_IMM(pb)) {
+                bc[p] = I3(a, pa, pc, IMM(pb));
+                return 1;
+            }
+            return 0;
+        case OP_ISUB:
+        case OP_IDIV:
+            if (IS_IMM(pc) && (op == OP_ISUB || IMM(pc) != 0)) {
+                a = op == OP_ISUB ? OP_ISUBI : OP_IDIVI;
+                bc[p] = I3(a, pa, pb, IMM(pc));
+                return 1;
+            }
+            return 0;
+        case OP_ILT:
+        case OP_ILE:
+            // a < k => ILTI; k < b => b > k
+            if (IS_IMM(pc)) {
+                a = op == OP_ILT ? OP_ILTI : OP_ILEI;
+                bc[p] = I3(a, pa, pb, IMM(pc));
+                return 1;
+            } else if (IS_IMM(pb)) {
+                a = op == OP_ILT ? OP_IGTI : OP_IGEI;
+                bc[p] = I3(a, pa, pc, IMM(pb));
+                return 1;
+            }
+            return 0;
+        case OP_JLT:
+        case OP_JLE:
+        case OP_JEQ:
+        case OP_JNE:
+            if (IS_IMM(pb)) {
+                a = op == OP_JLT ? OP_JLTI : op == OP_JLE ? OP_JLEI : op == OP_JEQ ? OP_JEQI : OP_JNEI;
+                bc[p] = I2(a, pa, IMM(pb));
+                return 1;
+            } else if (IS_IMM(pa)) {
+                a = op == OP_JLT ? OP_JGTI : op == OP_JLE ? OP_JGEI : op == OP_JEQ ? OP_JEQI : OP_JNEI;
+                b = IMM(pa);
+                bc[p] = I2(a, pb, b);
+                return 1;
+            }
+            return 0;
+        default:
+            return 0;
+    }
+
+#undef IS_IMM
+#undef IMM
+}
+
+// 根据常量传播的结果改写指令
+static int cv_rewrite(lgx_optimizer_t* opt, unsigned p, opt_cv_t* r) {
+    uint32_t i = opt->bc[p];
+    unsigned op = OP(i);
+    unsigned target;
+
+    if (op == OP_TEST || insn_is_branch(op)) {
+        int taken = cv_branch(i, r);
+        if (taken < 0) {
+            return cv_immediate(opt->bc, p, r);
+        }
+        insn_target(opt->bc, p, &target);
+        insn_remove(opt, p);
+        if (taken) {
+            opt->bc[p] = I1(OP_JMPI, target);
+        }
+        return 1;
+    }
+
+    int d = insn_def(i);
+    if (d < 0 || op == OP_MOVI || op == OP_LOAD || op == OP_INCJMP) {
+        return 0;
+    }
+
+    opt_cv_t out;
+    cv_eval(opt, i, r, &out);
+    if (out.kind == CV_CONST) {
+        uint32_t insn;
+        // MOV 本身的开销不高于 LOAD，只在可以使用 MOVI 时替换
+        if (cv_load(opt, d, &out, op != OP_MOV, &insn)) {
+            opt->bc[p] = insn;
+            return 1;
+        }
+        return 0;
+    }
+
+    return cv_immediate(opt->bc, p, r);
+}
+
+// 跨基本块的常量传播与折叠（稀疏条件常量传播）
+static int optimizer_propagate(lgx_optimizer_t* opt) {
+    int changed = 0;
+    unsigned b, k, n, j, i;
+
+    optimizer_build(opt);
+
+    // 常量编号 -> 常量值
+    xfree(opt->constants);
+    opt->constants_length = opt->c->constant.length;
+    opt->constants = xcalloc(opt->constants_length + 1, sizeof(lgx_value_t*));
+    if (!opt->constants) {
+        return -1;
+    }
+    lgx_ht_node_t* node;
+    for (node = lgx_ht_first(&opt->c->constant); node; node = lgx_ht_next(node)) {
+        lgx_const_t* c = (lgx_const_t*)node->v;
+        opt->constants[c->num] = &c->v;
+    }
+
+    opt_cv_t* states = xcalloc((size_t)opt->blocks_length * 256, sizeof(opt_cv_t));
+    unsigned char* visited = xcalloc(opt->blocks_length + 1, sizeof(unsigned char));
+    unsigned char* queued = xcalloc(opt->blocks_length + 1, sizeof(unsigned char));
+    unsigned* worklist = xcalloc(opt->blocks_length + 1, sizeof(unsigned));
+    opt_cv_t* cur = xcalloc(256, sizeof(opt_cv_t));
+    if (!states || !visited || !queued || !worklist || !cur) {
+        xfree(states);
+        xfree(visited);
+        xfree(queued);
+        xfree(worklist);
+        xfree(cur);
+        return -1;
+    }
+
+    unsigned top = 0;
+
+#define PUSH(blk) do {                  \
+        unsigned __b = (blk);           \
+        if (!queued[__b]) {             \
+            queued[__b] = 1;            \
+            worklist[top ++] = __b;     \
+        }                               \
+    } while (0)
+
+    // 函数入口与 catch block 入口处所有寄存器均视为非常量
+#define ROOT(blk) do {                                  \
+        unsigned __r = (blk);                           \
+        for (j = 0; j < 256; ++j) {                     \
+            states[(size_t)__r * 256 + j].kind = CV_VARYING; \
+        }                                               \
+        visited[__r] = 1;                               \
+        PUSH(__r);                                      \
+    } while (0)
+
+    for (i = 0; i < opt->functions_length; ++i) {
+        ROOT(opt->block_of[opt->functions[i]->addr]);
+    }
+    for (i = 0; i < opt->exceptions_length; ++i) {
+        lgx_exception_block_t* block;
+        lgx_list_for_each_entry(block, lgx_exception_block_t, &opt->exceptions[i]->catch_blocks, head) {
+            ROOT(opt->block_of[block->start]);
+        }
+    }
+
+    while (top) {
+        b = worklist[-- top];
+        queued[b] = 0;
+
+        memcpy(cur, &states[(size_t)b * 256], 256 * sizeof(opt_cv_t));
+
+        n = block_insns(opt, b);
+        for (k = 0; k < n; ++k) {
+            cv_transfer(opt, opt->bc[opt->insns[k]], cur);
+        }
+
+        // 只沿着可能执行的分支传播
+        unsigned last = opt->insns[n - 1];
+        uint32_t li = opt->bc[last];
+        int taken = cv_branch(li, cur);
+        unsigned succ[2], count = 0, target;
+
+        if (insn_target(opt->bc, last, &target) && taken != 0 && taken != -2) {
+            succ[count ++] = opt->block_of[target];
+        }
+        if (insn_falls_through(OP(li)) && opt->blocks[b].end < opt->length && taken != 1 && taken != -2) {
+            succ[count ++] = b + 1;
+        }
+
+        for (j = 0; j < count; ++j) {
+            unsigned s = succ[j];
+            int update = !visited[s];
+            visited[s] = 1;
+            for (i = 0; i < 256; ++i) {
+                if (cv_meet(&states[(size_t)s * 256 + i], &cur[i])) {
+                    update = 1;
+                }
+            }
+            if (update) {
+                PUSH(s);
+            }
+        }
+    }
+
+#undef PUSH
+#undef ROOT
+
+    // 改写指令，未被访问的基本块由不可达代码删除处理
+    for (b = 0; b < opt->blocks_length; ++b) {
+        if (!visited[b]) {
+            continue;
+        }
+
+        memcpy(cur, &states[(size_t)b * 256], 256 * sizeof(opt_cv_t));
+
+        n = block_insns(opt, b);
+        for (k = 0; k < n; ++k) {
+            uint32_t insn = opt->bc[opt->insns[k]];
+            if (cv_rewrite(opt, opt->insns[k], cur)) {
+                changed = 1;
+            }
+            cv_transfer(opt, insn, cur);
+        }
+    }
+
+    xfree(states);
+    xfree(visited);
+    xfree(queued);
+    xfree(worklist);
+    xfree(cur);
+
+    return changed;
+}
+
+// 寄存器的活跃区间
+typedef struct {
+    unsigned first[256];
+    unsigned last[256];
+    // 在函数入口处活跃的寄存器（参数等）保持原有编号
+    unsigned char fixed[256];
+    // 由 MOV 定义的寄存器优先复用源寄存器
+    int hint[256];
+} opt_intervals_t;
+
+static void interval_mark(opt_intervals_t* iv, unsigned r, unsigned p) {
+    if (iv->first[r] > p) {
+        iv->first[r] = p;
+    }
+    if (iv->last[r] < p) {
+        iv->last[r] = p;
+    }
+}
+
+// 计算函数内各寄存器的活跃区间，函数包含未知指令时返回 1
+static int function_intervals(lgx_optimizer_t* opt, lgx_function_t* fun, opt_intervals_t* iv) {
+    unsigned b, k, n, r, i;
+
+    for (r = 0; r < 256; ++r) {
+        iv->first[r] = UINT_MAX;
+        iv->last[r] = 0;
+        iv->fixed[r] = 0;
+        iv->hint[r] = -1;
+    }
+
+    for (b = opt->block_of[fun->addr]; b < opt->blocks_length && opt->blocks[b].start <= fun->end; ++b) {
+        if (!opt->blocks[b].reachable) {
+            continue;
+        }
+
+        opt_regs_t live, exc;
+        block_exception_live(opt, b, &exc);
+        live = opt->blocks[b].live_out;
+
+        n = block_insns(opt, b);
+        for (k = n; k-- > 0;) {
+            unsigned p = opt->insns[k];
+            uint32_t insn = opt->bc[p];
+            int d = insn_def(insn);
+
+            if (insn_reg_fields(insn) < 0) {
+                return 1;
+            }
+
+            live_transfer(insn, &live);
+            live_union(&live, &exc);
+
+            // 指令执行前活跃的寄存器，加上指令写入的寄存器
+            for (i = 0; i < 4; ++i) {
+                uint64_t bits = live.bits[i];
+                while (bits) {
+                    interval_mark(iv, i * 64 + __builtin_ctzll(bits), p);
+                    bits &= bits - 1;
+                }
+            }
+            if (d >= 0) {
+                interval_mark(iv, d, p);
+            }
+        }
+    }
+
+    // 进入 catch block 时写入异常变量
+    for (i = 0; i < opt->exceptions_length; ++i) {
+        lgx_exception_block_t* block;
+        lgx_list_for_each_entry(block, lgx_exception_block_t, &opt->exceptions[i]->catch_blocks, head) {
+            if (block->start >= fun->addr && block->start <= fun->end) {
+                interval_mark(iv, block->reg, block->start);
+            }
+        }
+    }
+
+    opt_regs_t* entry = &opt->blocks[opt->block_of[fun->addr]].live_in;
+    for (r = REG_RESERVED; r < 256; ++r) {
+        if (REGS_HAS(entry, r)) {
+            iv->fixed[r] = 1;
+        }
+    }
+
+    // MOV v u：u 的活跃区间结束于 v 的活跃区间开始之处时，两者可以使用同一个寄存器
+    for (b = opt->block_of[fun->addr]; b < opt->blocks_length && opt->blocks[b].start <= fun->end; ++b) {
+        if (!opt->blocks[b].reachable) {
+            continue;
+        }
+        n = block_insns(opt, b);
+        for (k = 0; k < n; ++k) {
+            unsigned p = opt->insns[k];
+            uint32_t insn = opt->bc[p];
+            if (OP(insn) == OP_MOV && iv->first[PA(insn)] == p && iv->last[PB(insn)] == p) {
+                iv->hint[PA(insn)] = PB(insn);
+            }
+        }
+    }
+
+    return 0;
+}
+
+// 线性扫描寄存器分配，重新为函数内的寄存器编号，并缩小函数的栈空间
+static void function_allocate(lgx_optimizer_t* opt, lgx_function_t* fun) {
+    opt_intervals_t iv;
+    unsigned char map[256], owner[256], used[256];
+    unsigned end[256], order[256];
+    unsigned r, n = 0, i, j, max = REG_RESERVED - 1;
+
+    if (function_intervals(opt, fun, &iv)) {
+        return;
+    }
+
+    for (r = REG_RESERVED; r < 256; ++r) {
+        if (iv.first[r] != UINT_MAX) {
+            order[n ++] = r;
+        }
+    }
+
+    // 固定编号的寄存器优先，其余按照活跃区间的起点排序
+    for (i = 1; i < n; ++i) {
+        unsigned v = order[i];
+        for (j = i; j > 0; --j) {
+            unsigned u = order[j - 1];
+            if (iv.fixed[u] > iv.fixed[v] || (iv.fixed[u] == iv.fixed[v] && iv.first[u] <= iv.first[v])) {
+                break;
+            }
+            order[j] = u;
+        }
+        order[j] = v;
+    }
+
+    for (r = 0; r < 256; ++r) {
+        map[r] = r;
+        used[r] = r < REG_RESERVED;
+    }
+
+    for (i = 0; i < n; ++i) {
+        unsigned v = order[i];
+        int reg = -1;
+
+        // 释放已经结束的活跃区间
+        for (r = REG_RESERVED; r < 256; ++r) {
+            if (used[r] && end[r] < iv.first[v]) {
+                used[r] = 0;
+            }
+        }
+
+        if (iv.fixed[v]) {
+            if (used[v]) {
+                return;
+            }
+            reg = v;
+        } else {
+            if (iv.hint[v] >= 0) {
+                unsigned u = iv.hint[v];
+                unsigned pr = map[u];
+                if (used[pr] && owner[pr] == u && end[pr] == iv.first[v]) {
+                    reg = pr;
+                }
+            }
+            if (reg < 0) {
+                for (r = REG_RESERVED; r < 256 && used[r]; ++r);
+                reg = r;
+            }
+        }
+
+        used[reg] = 1;
+        owner[reg] = v;
+        end[reg] = iv.last[v];
+        map[v] = reg;
+        if (reg > (int)max) {
+            max = reg;
+        }
+    }
+
+    // 调用方总是把参数写入 R4 开始的位置
+    unsigned stack_size = max + 1;
+    if (fun->gc.type.u.fun && stack_size < REG_RESERVED + fun->gc.type.u.fun->arg_len) {
+        stack_size = REG_RESERVED + fun->gc.type.u.fun->arg_len;
+    }
+    if (stack_size > fun->stack_size) {
+        return;
+    }
+
+    unsigned p;
+    for (p = fun->addr; p <= fun->end; p += insn_size(opt->bc[p])) {
+        uint32_t insn = opt->bc[p];
+        opt->bc[p] = insn_rename(insn, insn_reg_fields(insn), map);
+        // 重新编号后源寄存器与目标寄存器相同的 MOV 可以删除
+        if (OP(opt->bc[p]) == OP_MOV && PA(opt->bc[p]) == PB(opt->bc[p])) {
+            insn_remove(opt, p);
+        }
+    }
+
+    for (i = 0; i < opt->exceptions_length; ++i) {
+        lgx_exception_block_t* block;
+        lgx_list_for_each_entry(block, lgx_exception_block_t, &opt->exceptions[i]->catch_blocks, head) {
+            if (block->start >= fun->addr && block->start <= fun->end) {
+                block->reg = map[block->reg];
+            }
+        }
+    }
+
+    fun->stack_size = stack_size;
+}
+
+static void optimizer_allocate(lgx_optimizer_t* opt) {
+    unsigned i;
+
+    optimizer_liveness(opt);
+
+    for (i = 0; i < opt->functions_length; ++i) {
+        function_allocate(opt, opt->functions[i]);
+    }
+}
+
+// 范围内的指令全部被删除时保留第一个位置，保证 try block 与 catch block 在压缩后依然非空
+static void pin_range(lgx_optimizer_t* opt, unsigned start, unsigned end) {
+    unsigned p;
+    for (p = start; p <= end; ++p) {
+        if (OP(opt->bc[p]) != OP_NOP || opt->pinned[p]) {
+            return;
+        }
+    }
+    opt->pinned[start] = PIN_POSITION;
+}
+
+// 删除 NOP 并重新计算跳转目标、函数地址与异常表
+static int optimizer_compact(lgx_optimizer_t* opt) {
+    unsigned p, next, n = 0, i;
+
+    for (i = 0; i < opt->exceptions_length; ++i) {
+        lgx_exception_t* e = opt->exceptions[i];
+        pin_range(opt, e->try_block.start, e->try_block.end);
+
+        lgx_exception_block_t* block;
+        lgx_list_for_each_entry(block, lgx_exception_block_t, &e->catch_blocks, head) {
+            pin_range(opt, block->start, block->end);
+        }
+    }
+
+    unsigned* map = xcalloc(opt->length + 1, sizeof(unsigned));
+    if (!map) {
+        return 1;
+    }
+
+    for (p = 0; p < opt->length; ++p) {
+        map[p] = n;
+        if (OP(opt->bc[p]) != OP_NOP || opt->pinned[p]) {
+            ++ n;
+        }
+    }
+    map[opt->length] = n;
+
+    if (n == opt->length) {
+        xfree(map);
+        return 0;
+    }
+
+    for (p = 0; p < opt->length; p = next) {
+        uint32_t insn = opt->bc[p];
+        unsigned size = insn_size(insn);
+        next = p + size;
+
+        if (OP(insn) == OP_NOP && !opt->pinned[p]) {
+            continue;
+        }
+
+        unsigned target;
+        if (insn_target(opt->bc, p, &target)) {
+            if (OP(insn) == OP_TEST) {
+                unsigned distance = map[target] - map[p] - 1;
+                insn = I2(OP_TEST, PA(insn), distance);
+            } else if (OP(insn) == OP_JMPI) {
+                insn = I1(OP_JMPI, map[target]);
+            }
+        }
+
+        opt->bc[map[p]] = insn;
+        if (size == 2) {
+            opt->bc[map[p] + 1] = I1(OP_JMPI, map[target]);
+        }
+    }
+
+    for (i = 0; i < opt->functions_length; ++i) {
+        lgx_function_t* fun = opt->functions[i];
+        fun->addr = map[fun->addr];
+        fun->end = map[fun->end];
+    }
+
+    lgx_rb_node_t* node;
+    for (node = lgx_rb_first(&opt->c->exception); node; node = lgx_rb_next(node)) {
+        lgx_exception_t* e = (lgx_exception_t*)node->value;
+
+        e->try_block.start = map[e->try_block.start];
+        e->try_block.end = map[e->try_block.end + 1] - 1;
+
+        lgx_exception_block_t* block;
+        lgx_list_for_each_entry(block, lgx_exception_block_t, &e->catch_blocks, head) {
+            block->start = map[block->start];
+            block->end = map[block->end + 1] - 1;
+        }
+
+        // 地址映射保持顺序不变，直接改写红黑树中的键即可
+        unsigned long long key = ((unsigned long long)e->try_block.start << 32) | (0XFFFFFFFF - e->try_block.end);
+        memcpy(node->key.buffer, &key, sizeof(key));
+    }
+
+    opt->c->bc.length = opt->length = n;
+
+    xfree(map);
+    return 0;
+}
+
+int lgx_optimizer_run(lgx_compiler_t* c, int level) {
+    unsigned p;
+
+    if (level <= LGX_OPTIMIZE_NONE || c->bc.length == 0) {
+        return 0;
+    }
+
+    // JMP 的跳转目标保存在寄存器中，无法进行控制流分析与重定位
+    for (p = 0; p < c->bc.length; p += insn_size(c->bc.buffer[p])) {
+        if (OP(c->bc.buffer[p]) == OP_JMP) {
+            return 0;
+        }
+    }
+
+    lgx_optimizer_t opt;
+    int ret = 0;
+
+    if (optimizer_init(&opt, c)) {
+        optimizer_cleanup(&opt);
+        return 1;
+    }
+
+    optimizer_thread_jumps(&opt);
+    if (optimizer_remove_unreachable(&opt) < 0) {
+        ret = 1;
+        goto cleanup;
+    }
+
+    if (level >= LGX_OPTIMIZE_FULL) {
+        int changed = optimizer_propagate(&opt);
+        if (changed < 0) {
+            ret = 1;
+            goto cleanup;
+        }
+        if (changed) {
+            optimizer_thread_jumps(&opt);
+            if (optimizer_remove_unreachable(&opt) < 0) {
+                ret = 1;
+                goto cleanup;
+            }
+        }
+    }
+
+    // 死存储删除可能使更多的 MOV 满足合并条件，反之亦然
+    while (optimizer_eliminate(&opt, level >= LGX_OPTIMIZE_FULL) && level >= LGX_OPTIMIZE_FULL);
+
+    // 所有改写完成后再分配寄存器
+    optimizer_allocate(&opt);
+
+    optimizer_remove_redundant_jumps(&opt);
+
+    if (optimizer_compact(&opt)) {
+        ret = 1;
+    }
+
+cleanup:
+    optimizer_cleanup(&opt);
+    return ret;
+}
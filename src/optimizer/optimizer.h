@@ -0,0 +1,21 @@
+#ifndef LGX_OPTIMIZER_H
+#define LGX_OPTIMIZER_H
+
+// 字节码优化器
+#include "../compiler/compiler.h"
+
+// 优化级别
+// 0: 不做任何优化
+// 1: 跳转穿透、MOV 合并、删除不可达代码、基于活跃区间的寄存器分配
+// 2: 在 1 的基础上增加跨基本块的常量传播与折叠、死存储删除
+#define LGX_OPTIMIZE_NONE    0
+#define LGX_OPTIMIZE_BASIC   1
+#define LGX_OPTIMIZE_FULL    2
+
+#define LGX_OPTIMIZE_DEFAULT LGX_OPTIMIZE_FULL
+
+// 对 lgx_compiler_generate 生成的字节码进行优化，必须在 lgx_vm_init 之前调用
+// 优化完成后会重新排列字节码，并同步更新函数入口地址与异常表
+int lgx_optimizer_run(lgx_compiler_t* c, int level);
+
+#endif // LGX_OPTIMIZER_H
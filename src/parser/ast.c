@@ -1,49 +1,8 @@
 #include "ast.h"
 #include "symbol.h"
 
-static void ast_node_del(lgx_ast_node_t* node) {
-    switch (node->type) {
-        case BLOCK_STATEMENT:
-            if (node->u.symbols) {
-                lgx_ht_cleanup(node->u.symbols);
-                xfree(node->u.symbols);
-            }
-            break;
-        case FUNCTION_DECLARATION:
-            if (node->u.regs) {
-                lgx_reg_cleanup(node->u.regs);
-                xfree(node->u.regs);
-            }
-            break;
-        case FOR_STATEMENT: case WHILE_STATEMENT: case DO_STATEMENT:
-        case SWITCH_STATEMENT:
-            if (node->u.jmps) {
-                while (!lgx_list_empty(node->u.jmps)) {
-                    lgx_ast_node_list_t* n = lgx_list_first_entry(node->u.jmps, lgx_ast_node_list_t, head);
-                    lgx_list_del(&n->head);
-                    xfree(n);
-                }
-                xfree(node->u.jmps);
-            }
-            break;
-        default:
-            break;
-    }
-
-    int i;
-    for (i = 0; i < node->children; ++i) {
-        ast_node_del(node->child[i]);
-    }
-
-    if (node->child) {
-        xfree(node->child);
-    }
-
-    xfree(node);
-}
-
 static lgx_ast_node_t* ast_node_new(lgx_ast_t* ast, lgx_ast_type_t type) {
-    lgx_ast_node_t* node = (lgx_ast_node_t*)xcalloc(1, sizeof(lgx_ast_node_t));
+    lgx_ast_node_t* node = (lgx_ast_node_t*)lgx_arena_alloc(&ast->arena, sizeof(lgx_ast_node_t));
     if (!node) {
         return NULL;
     }
@@ -55,22 +14,27 @@ static lgx_ast_node_t* ast_node_new(lgx_ast_t* ast, lgx_ast_type_t type) {
 
     node->type = type;
     switch (type) {
-        case BLOCK_STATEMENT:
-            node->u.symbols = (lgx_ht_t*)xmalloc(sizeof(lgx_ht_t));
-            if (!node->u.symbols) {
-                goto error;
+        case BLOCK_STATEMENT: {
+            // 符号表的节点数组由 lgx_symbol_cleanup 释放
+            lgx_ast_symbols_t* symbols = (lgx_ast_symbols_t*)lgx_arena_alloc(&ast->arena, sizeof(lgx_ast_symbols_t));
+            if (!symbols) {
+                return NULL;
             }
-            if (lgx_ht_init(node->u.symbols, 8) != 0) {
-                goto error;
+            if (lgx_ht_init(&symbols->table, 8) != 0) {
+                return NULL;
             }
+            symbols->next = ast->symbols;
+            ast->symbols = symbols;
+            node->u.symbols = &symbols->table;
             break;
+        }
         case FUNCTION_DECLARATION:
-            node->u.regs = (lgx_reg_t*)xmalloc(sizeof(lgx_reg_t));
+            node->u.regs = (lgx_reg_t*)lgx_arena_alloc(&ast->arena, sizeof(lgx_reg_t));
             if (!node->u.regs) {
-                goto error;
+                return NULL;
             }
             if (lgx_reg_init(node->u.regs) != 0) {
-                goto error;
+                return NULL;
             }
             break;
         default:
@@ -78,28 +42,22 @@ static lgx_ast_node_t* ast_node_new(lgx_ast_t* ast, lgx_ast_type_t type) {
     }
 
     return node;
-
-error:
-    if (node) {
-        ast_node_del(node);
-    }
-
-    return NULL;
 }
 
-static int ast_node_append_child(lgx_ast_node_t* parent, lgx_ast_node_t* child) {
+static int ast_node_append_child(lgx_ast_t* ast, lgx_ast_node_t* parent, lgx_ast_node_t* child) {
     child->parent = parent;
 
     // 如果空间不足，则扩展空间
     if (parent->size <= parent->children) {
         if (parent->size == 0) {
-            parent->child = (lgx_ast_node_t**)xmalloc(sizeof(lgx_ast_node_t*));
+            parent->child = (lgx_ast_node_t**)lgx_arena_alloc(&ast->arena, sizeof(lgx_ast_node_t*));
             if (!parent->child) {
                 return 1;
             }
             parent->size = 1;
         } else {
-            lgx_ast_node_t** p = (lgx_ast_node_t**)xrealloc(parent->child, 2 * parent->size * sizeof(lgx_ast_node_t*));
+            lgx_ast_node_t** p = (lgx_ast_node_t**)lgx_arena_realloc(&ast->arena, parent->child,
+                parent->size * sizeof(lgx_ast_node_t*), 2 * parent->size * sizeof(lgx_ast_node_t*));
             if (!p) {
                 return 1;
             }
@@ -162,20 +120,30 @@ static void ast_step(lgx_ast_t* ast) {
     }
 }
 
-// 追加一条错误信息
-static void ast_error(lgx_ast_t* ast, const char *fmt, ...) {
-    va_list   args;
-
-    lgx_ast_error_list_t* err = xcalloc(1, sizeof(lgx_ast_error_list_t));
+lgx_ast_error_list_t* lgx_ast_error_new(lgx_ast_t* ast) {
+    lgx_ast_error_list_t* err = (lgx_ast_error_list_t*)lgx_arena_alloc(&ast->arena, sizeof(lgx_ast_error_list_t));
     if (!err) {
-        return;
+        return NULL;
     }
 
     lgx_list_init(&err->head);
     err->err_no = 1;
 
-    if (lgx_str_init(&err->err_msg, 256)) {
-        xfree(err);
+    err->err_msg.buffer = (char*)lgx_arena_alloc(&ast->arena, 256);
+    if (!err->err_msg.buffer) {
+        return NULL;
+    }
+    err->err_msg.size = 256;
+
+    return err;
+}
+
+// 追加一条错误信息
+static void ast_error(lgx_ast_t* ast, const char *fmt, ...) {
+    va_list   args;
+
+    lgx_ast_error_list_t* err = lgx_ast_error_new(ast);
+    if (!err) {
         return;
     }
 
@@ -197,7 +165,7 @@ static void ast_error(lgx_ast_t* ast, const char *fmt, ...) {
 
 static int ast_parse_identifier_token(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* identifier_token = ast_node_new(ast, IDENTIFIER_TOKEN);
-    ast_node_append_child(parent, identifier_token);
+    ast_node_append_child(ast, parent, identifier_token);
 
     if (ast->cur_token != TK_IDENTIFIER) {
         ast_error(ast, "`<identifier>` expected before '%.*s'\n", ast->cur_length, ast->cur_start);
@@ -212,7 +180,7 @@ static int ast_parse_identifier_token(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
 static int ast_parse_string_token(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* string_token = ast_node_new(ast, STRING_TOKEN);
-    ast_node_append_child(parent, string_token);
+    ast_node_append_child(ast, parent, string_token);
 
     if (ast->cur_token != TK_LITERAL_STRING) {
         ast_error(ast, "`<string>` expected before '%.*s'\n", ast->cur_length, ast->cur_start);
@@ -235,7 +203,7 @@ static int ast_parse_type_expression(lgx_ast_t* ast, lgx_ast_node_t* parent);
 
 static int ast_parse_decl_parameter(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* param_list = ast_node_new(ast, FUNCTION_DECL_PARAMETER);
-    ast_node_append_child(parent, param_list);
+    ast_node_append_child(ast, parent, param_list);
 
     if (ast->cur_token == TK_RIGHT_PAREN) {
         // 参数为空
@@ -243,8 +211,13 @@ static int ast_parse_decl_parameter(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     }
 
     while (1) {
+        // 兼容 var name type 形式的参数声明
+        if (ast->cur_token == TK_VAR) {
+            ast_step(ast);
+        }
+
         lgx_ast_node_t* variable_declaration = ast_node_new(ast, VARIABLE_DECLARATION);
-        ast_node_append_child(param_list, variable_declaration);
+        ast_node_append_child(ast, param_list, variable_declaration);
 
         if (ast_parse_identifier_token(ast, variable_declaration)) {
             return 1;
@@ -291,7 +264,7 @@ static int ast_parse_decl_parameter_with_parentheses(lgx_ast_t* ast, lgx_ast_nod
 
 static int ast_parse_call_parameter(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* param_list = ast_node_new(ast, FUNCTION_CALL_PARAMETER);
-    ast_node_append_child(parent, param_list);
+    ast_node_append_child(ast, parent, param_list);
 
     if (ast->cur_token == TK_RIGHT_PAREN) {
         // 参数为空
@@ -314,7 +287,7 @@ static int ast_parse_block_statement_with_braces(lgx_ast_t* ast, lgx_ast_node_t*
 
 static int ast_parse_type_expression_function_parameter(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* function_parameter = ast_node_new(ast, FUNCTION_TYPE_DECL_PARAMETER);
-    ast_node_append_child(parent, function_parameter);
+    ast_node_append_child(ast, parent, function_parameter);
 
     if (ast->cur_token != TK_LEFT_PAREN) {
         ast_error(ast, "'(' expected before `%.*s`\n", ast->cur_length, ast->cur_start);
@@ -352,7 +325,7 @@ static int ast_parse_type_expression_interface(lgx_ast_t* ast, lgx_ast_node_t* p
 
 static int ast_parse_type_expression(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* type_expression = ast_node_new(ast, TYPE_EXPRESSION);
-    ast_node_append_child(parent, type_expression);
+    ast_node_append_child(ast, parent, type_expression);
 
     switch (ast->cur_token) {
         case TK_INT:
@@ -444,7 +417,7 @@ static int ast_parse_type_expression(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
 static int ast_parse_array_expression(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* array_expression = ast_node_new(ast, ARRAY_EXPRESSION);
-    ast_node_append_child(parent, array_expression);
+    ast_node_append_child(ast, parent, array_expression);
 
     if (ast->cur_token != TK_LEFT_BRACK) {
         ast_error(ast, "`[` expected before '%.*s'\n", ast->cur_length, ast->cur_start);
@@ -481,7 +454,7 @@ static int ast_parse_array_expression(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
 static int ast_parse_struct_expression(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* struct_expression = ast_node_new(ast, STRUCT_EXPRESSION);
-    ast_node_append_child(parent, struct_expression);
+    ast_node_append_child(ast, parent, struct_expression);
 
     if (ast->cur_token != TK_LEFT_BRACE) {
         ast_error(ast, "`{` expected before '%.*s'\n", ast->cur_length, ast->cur_start);
@@ -565,8 +538,8 @@ static int ast_parse_suf_expression(lgx_ast_t* ast, lgx_ast_node_t* parent) {
         binary_expression->row = last_child->row;
 
         ast_node_remove_child(parent, last_child);
-        ast_node_append_child(binary_expression, last_child);
-        ast_node_append_child(parent, binary_expression);
+        ast_node_append_child(ast, binary_expression, last_child);
+        ast_node_append_child(ast, parent, binary_expression);
 
         switch (ast->cur_token) {
             case TK_ARROW:
@@ -622,43 +595,43 @@ static int ast_parse_bsc_expression(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     switch (ast->cur_token) {
         case TK_LITERAL_LONG:
             node = ast_node_new(ast, LONG_TOKEN);
-            ast_node_append_child(parent, node);
+            ast_node_append_child(ast, parent, node);
 
             ast_step(ast);
             break;
         case TK_LITERAL_DOUBLE:
             node = ast_node_new(ast, DOUBLE_TOKEN);
-            ast_node_append_child(parent, node);
+            ast_node_append_child(ast, parent, node);
 
             ast_step(ast);
             break;
         case TK_LITERAL_STRING:
             node = ast_node_new(ast, STRING_TOKEN);
-            ast_node_append_child(parent, node);
+            ast_node_append_child(ast, parent, node);
 
             ast_step(ast);
             break;
         case TK_LITERAL_CHAR:
             node = ast_node_new(ast, CHAR_TOKEN);
-            ast_node_append_child(parent, node);
+            ast_node_append_child(ast, parent, node);
 
             ast_step(ast);
             break;
         case TK_TRUE:
             node = ast_node_new(ast, TRUE_TOKEN);
-            ast_node_append_child(parent, node);
+            ast_node_append_child(ast, parent, node);
 
             ast_step(ast);
             break;
         case TK_FALSE:
             node = ast_node_new(ast, FALSE_TOKEN);
-            ast_node_append_child(parent, node);
+            ast_node_append_child(ast, parent, node);
 
             ast_step(ast);
             break;
         case TK_NULL:
             node = ast_node_new(ast, NULL_TOKEN);
-            ast_node_append_child(parent, node);
+            ast_node_append_child(ast, parent, node);
 
             ast_step(ast);
             break;
@@ -740,7 +713,7 @@ static int ast_parse_sub_expression(lgx_ast_t* ast, lgx_ast_node_t* parent, int
             // 单目运算符
             lgx_ast_node_t* unary_expression = ast_node_new(ast, UNARY_EXPRESSION);
             unary_expression->u.op = ast->cur_token;
-            ast_node_append_child(parent, unary_expression);
+            ast_node_append_child(ast, parent, unary_expression);
 
             ast_step(ast);
 
@@ -801,8 +774,8 @@ static int ast_parse_sub_expression(lgx_ast_t* ast, lgx_ast_node_t* parent, int
         binary_expression->row = last_child->row;
 
         ast_node_remove_child(parent, last_child);
-        ast_node_append_child(binary_expression, last_child);
-        ast_node_append_child(parent, binary_expression);
+        ast_node_append_child(ast, binary_expression, last_child);
+        ast_node_append_child(ast, parent, binary_expression);
 
         if (ast_parse_sub_expression(ast, binary_expression, p)) {
             return 1;
@@ -841,7 +814,7 @@ static int ast_parse_statement(lgx_ast_t* ast, lgx_ast_node_t* parent);
 
 static int ast_parse_block_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* block_statement = ast_node_new(ast, BLOCK_STATEMENT);
-    ast_node_append_child(parent, block_statement);
+    ast_node_append_child(ast, parent, block_statement);
     
     return ast_parse_statement(ast, block_statement);
 }
@@ -868,7 +841,7 @@ static int ast_parse_block_statement_with_braces(lgx_ast_t* ast, lgx_ast_node_t*
 
 static int ast_parse_if_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* if_statement = ast_node_new(ast, IF_STATEMENT);
-    ast_node_append_child(parent, if_statement);
+    ast_node_append_child(ast, parent, if_statement);
 
     assert(ast->cur_token == TK_IF);
     ast_step(ast);
@@ -897,7 +870,7 @@ static int ast_parse_if_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
 static int ast_parse_for_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* for_statement = ast_node_new(ast, FOR_STATEMENT);
-    ast_node_append_child(parent, for_statement);
+    ast_node_append_child(ast, parent, for_statement);
 
     assert(ast->cur_token == TK_FOR);
     ast_step(ast);
@@ -910,7 +883,7 @@ static int ast_parse_for_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
     // 循环前表达式
     lgx_ast_node_t* for_condition = ast_node_new(ast, FOR_CONDITION);
-    ast_node_append_child(for_statement, for_condition);
+    ast_node_append_child(ast, for_statement, for_condition);
 
     if (ast->cur_token != TK_SEMICOLON) {
         if (ast_parse_expression(ast, for_condition)) {
@@ -926,7 +899,7 @@ static int ast_parse_for_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
     // 循环条件表达式
     for_condition = ast_node_new(ast, FOR_CONDITION);
-    ast_node_append_child(for_statement, for_condition);
+    ast_node_append_child(ast, for_statement, for_condition);
 
     if (ast->cur_token != TK_SEMICOLON) {
         if (ast_parse_expression(ast, for_condition)) {
@@ -942,7 +915,7 @@ static int ast_parse_for_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
     // 单次循环完毕表达式
     for_condition = ast_node_new(ast, FOR_CONDITION);
-    ast_node_append_child(for_statement, for_condition);
+    ast_node_append_child(ast, for_statement, for_condition);
 
     if (ast->cur_token != TK_RIGHT_PAREN) {
         if (ast_parse_expression(ast, for_condition)) {
@@ -961,7 +934,7 @@ static int ast_parse_for_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
 static int ast_parse_while_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* while_statement = ast_node_new(ast, WHILE_STATEMENT);
-    ast_node_append_child(parent, while_statement);
+    ast_node_append_child(ast, parent, while_statement);
 
     assert(ast->cur_token == TK_WHILE);
     ast_step(ast);
@@ -975,7 +948,7 @@ static int ast_parse_while_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
 static int ast_parse_do_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* do_statement = ast_node_new(ast, DO_STATEMENT);
-    ast_node_append_child(parent, do_statement);
+    ast_node_append_child(ast, parent, do_statement);
 
     assert(ast->cur_token == TK_DO);
     ast_step(ast);
@@ -995,7 +968,7 @@ static int ast_parse_do_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
 static int ast_parse_break_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* break_statement = ast_node_new(ast, BREAK_STATEMENT);
-    ast_node_append_child(parent, break_statement);
+    ast_node_append_child(ast, parent, break_statement);
 
     assert(ast->cur_token == TK_BREAK);
     ast_step(ast);
@@ -1005,7 +978,7 @@ static int ast_parse_break_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
 static int ast_parse_continue_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* continue_statement = ast_node_new(ast, CONTINUE_STATEMENT);
-    ast_node_append_child(parent, continue_statement);
+    ast_node_append_child(ast, parent, continue_statement);
 
     assert(ast->cur_token == TK_CONTINUE);
     ast_step(ast);
@@ -1015,7 +988,7 @@ static int ast_parse_continue_statement(lgx_ast_t* ast, lgx_ast_node_t* parent)
 
 static int ast_parse_case_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* case_statement = ast_node_new(ast, CASE_STATEMENT);
-    ast_node_append_child(parent, case_statement);
+    ast_node_append_child(ast, parent, case_statement);
 
     assert(ast->cur_token == TK_CASE);
     ast_step(ast);
@@ -1039,7 +1012,7 @@ static int ast_parse_case_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
 static int ast_parse_default_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* default_statement = ast_node_new(ast, DEFAULT_STATEMENT);
-    ast_node_append_child(parent, default_statement);
+    ast_node_append_child(ast, parent, default_statement);
 
     assert(ast->cur_token == TK_DEFAULT);
     ast_step(ast);
@@ -1059,7 +1032,7 @@ static int ast_parse_default_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
 static int ast_parse_switch_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* switch_statement = ast_node_new(ast, SWITCH_STATEMENT);
-    ast_node_append_child(parent, switch_statement);
+    ast_node_append_child(ast, parent, switch_statement);
 
     assert(ast->cur_token == TK_SWITCH);
     ast_step(ast);
@@ -1100,7 +1073,7 @@ static int ast_parse_switch_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
 static int ast_parse_try_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* try_statement = ast_node_new(ast, TRY_STATEMENT);
-    ast_node_append_child(parent, try_statement);
+    ast_node_append_child(ast, parent, try_statement);
 
     assert(ast->cur_token == TK_TRY);
     ast_step(ast);
@@ -1113,7 +1086,7 @@ static int ast_parse_try_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
         ast_step(ast);
 
         lgx_ast_node_t* catch_statement = ast_node_new(ast, CATCH_STATEMENT);
-        ast_node_append_child(try_statement, catch_statement);
+        ast_node_append_child(ast, try_statement, catch_statement);
 
         if (ast_parse_decl_parameter_with_parentheses(ast, catch_statement)) {
             return 1;
@@ -1136,7 +1109,7 @@ static int ast_parse_try_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
 static int ast_parse_throw_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* throw_statement = ast_node_new(ast, THROW_STATEMENT);
-    ast_node_append_child(parent, throw_statement);
+    ast_node_append_child(ast, parent, throw_statement);
 
     assert(ast->cur_token == TK_THROW);
     ast_step(ast);
@@ -1146,7 +1119,7 @@ static int ast_parse_throw_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
 static int ast_parse_return_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* return_statement = ast_node_new(ast, RETURN_STATEMENT);
-    ast_node_append_child(parent, return_statement);
+    ast_node_append_child(ast, parent, return_statement);
 
     assert(ast->cur_token == TK_RETURN);
     ast_step(ast);
@@ -1156,7 +1129,7 @@ static int ast_parse_return_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
 static int ast_parse_echo_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* echo_statement = ast_node_new(ast, ECHO_STATEMENT);
-    ast_node_append_child(parent, echo_statement);
+    ast_node_append_child(ast, parent, echo_statement);
 
     assert(ast->cur_token == TK_ECHO);
     ast_step(ast);
@@ -1166,7 +1139,7 @@ static int ast_parse_echo_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
 static int ast_parse_co_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* co_statement = ast_node_new(ast, CO_STATEMENT);
-    ast_node_append_child(parent, co_statement);
+    ast_node_append_child(ast, parent, co_statement);
 
     assert(ast->cur_token == TK_CO);
     ast_step(ast);
@@ -1176,14 +1149,14 @@ static int ast_parse_co_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
 static int ast_parse_expression_statement(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* expression_statement = ast_node_new(ast, EXPRESSION_STATEMENT);
-    ast_node_append_child(parent, expression_statement);
+    ast_node_append_child(ast, parent, expression_statement);
     
     return ast_parse_expression(ast, expression_statement);
 }
 
 static int ast_parse_import_declaration(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* import_declaration = ast_node_new(ast, IMPORT_DECLARATION);
-    ast_node_append_child(parent, import_declaration);
+    ast_node_append_child(ast, parent, import_declaration);
 
     assert(ast->cur_token == TK_IMPORT);
     ast_step(ast);
@@ -1199,7 +1172,7 @@ static int ast_parse_import_declaration(lgx_ast_t* ast, lgx_ast_node_t* parent)
 
 static int ast_parse_export_declaration(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* export_declaration = ast_node_new(ast, EXPORT_DECLARATION);
-    ast_node_append_child(parent, export_declaration);
+    ast_node_append_child(ast, parent, export_declaration);
 
     assert(ast->cur_token == TK_EXPORT);
     ast_step(ast);
@@ -1211,7 +1184,7 @@ static int ast_parse_export_declaration(lgx_ast_t* ast, lgx_ast_node_t* parent)
 
 static int ast_parse_variable_declaration(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* variable_declaration = ast_node_new(ast, VARIABLE_DECLARATION);
-    ast_node_append_child(parent, variable_declaration);
+    ast_node_append_child(ast, parent, variable_declaration);
 
     assert(ast->cur_token == TK_VAR);
     ast_step(ast);
@@ -1219,7 +1192,7 @@ static int ast_parse_variable_declaration(lgx_ast_t* ast, lgx_ast_node_t* parent
     while (1) {
         if (!variable_declaration) {
             variable_declaration = ast_node_new(ast, VARIABLE_DECLARATION);
-            ast_node_append_child(parent, variable_declaration);
+            ast_node_append_child(ast, parent, variable_declaration);
         }
 
         if (ast_parse_identifier_token(ast, variable_declaration)) {
@@ -1254,7 +1227,7 @@ static int ast_parse_variable_declaration(lgx_ast_t* ast, lgx_ast_node_t* parent
 
 static int ast_parse_constant_declaration(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* constant_declaration = ast_node_new(ast, CONSTANT_DECLARATION);
-    ast_node_append_child(parent, constant_declaration);
+    ast_node_append_child(ast, parent, constant_declaration);
 
     assert(ast->cur_token == TK_CONST);
     ast_step(ast);
@@ -1262,7 +1235,7 @@ static int ast_parse_constant_declaration(lgx_ast_t* ast, lgx_ast_node_t* parent
     while (1) {
         if (!constant_declaration) {
             constant_declaration = ast_node_new(ast, CONSTANT_DECLARATION);
-            ast_node_append_child(parent, constant_declaration);
+            ast_node_append_child(ast, parent, constant_declaration);
         }
 
         if (ast_parse_identifier_token(ast, constant_declaration)) {
@@ -1299,7 +1272,7 @@ static int ast_parse_constant_declaration(lgx_ast_t* ast, lgx_ast_node_t* parent
 
 static int ast_parse_function_receiver(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* function_receiver = ast_node_new(ast, FUNCTION_RECEIVER);
-    ast_node_append_child(parent, function_receiver);\
+    ast_node_append_child(ast, parent, function_receiver);\
 
     if (ast->cur_token != TK_LEFT_PAREN) {
         return 0;
@@ -1310,7 +1283,7 @@ static int ast_parse_function_receiver(lgx_ast_t* ast, lgx_ast_node_t* parent) {
 
 static int ast_parse_function_declaration(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* function_declaration = ast_node_new(ast, FUNCTION_DECLARATION);
-    ast_node_append_child(parent, function_declaration);
+    ast_node_append_child(ast, parent, function_declaration);
 
     assert(ast->cur_token == TK_FUNCTION);
     ast_step(ast);
@@ -1345,7 +1318,7 @@ static int ast_parse_function_declaration(lgx_ast_t* ast, lgx_ast_node_t* parent
 
 static int ast_parse_type_declaration(lgx_ast_t* ast, lgx_ast_node_t* parent) {
     lgx_ast_node_t* type_declaration = ast_node_new(ast, TYPE_DECLARATION);
-    ast_node_append_child(parent, type_declaration);
+    ast_node_append_child(ast, parent, type_declaration);
 
     assert(ast->cur_token == TK_TYPE);
     ast_step(ast);
@@ -1549,6 +1522,7 @@ int lgx_ast_init(lgx_ast_t* ast, char* file) {
     // 初始化
     memset(ast, 0, sizeof(lgx_ast_t));
     lgx_list_init(&ast->errors);
+    lgx_arena_init(&ast->arena);
 
     if (lgx_lex_init(&ast->lex, file) != 0) {
         ast_error(ast, "can't open input file: %s\n", file);
@@ -1576,18 +1550,11 @@ int lgx_ast_cleanup(lgx_ast_t* ast) {
 
     lgx_symbol_cleanup(ast);
 
-    if (ast->root) {
-        ast_node_del(ast->root);
-        ast->root = NULL;
-    }
-
-    // 释放错误信息链表
-    while (!lgx_list_empty(&ast->errors)) {
-        lgx_ast_error_list_t *n = lgx_list_first_entry(&ast->errors, lgx_ast_error_list_t, head);
-        lgx_list_del(&n->head);
-        lgx_str_cleanup(&n->err_msg);
-        xfree(n);
-    }
+    // 语法树节点与错误信息都在 arena 中，一次性释放
+    ast->root = NULL;
+    ast->symbols = NULL;
+    lgx_list_init(&ast->errors);
+    lgx_arena_cleanup(&ast->arena);
 
     return 0;
 }
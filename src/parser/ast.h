@@ -3,6 +3,7 @@
 
 #include "../common/list.h"
 #include "../common/ht.h"
+#include "../common/arena.h"
 #include "../tokenizer/lex.h"
 #include "../compiler/register.h"
 #include "type.h"
@@ -105,6 +106,14 @@ typedef struct lgx_ast_node_s {
     } u;
 } lgx_ast_node_t;
 
+// 块语句的符号表，同一语法树中的符号表串成链表，释放时不需要遍历语法树
+typedef struct lgx_ast_symbols_s {
+    // 必须是第一个成员，节点中保存的是指向它的指针
+    lgx_ht_t table;
+
+    struct lgx_ast_symbols_s* next;
+} lgx_ast_symbols_t;
+
 typedef struct lgx_ast_error_list_s {
     lgx_list_t head;
 
@@ -117,6 +126,9 @@ typedef struct lgx_ast {
     // 源文件
     lgx_lex_t lex;
 
+    // 语法树节点、符号、错误信息等在一次编译期间使用的内存，在 lgx_ast_cleanup 时一次性释放
+    lgx_arena_t arena;
+
     // 词法分析相关数据
     lgx_token_t prev_token;
     lgx_token_t cur_token;
@@ -126,6 +138,9 @@ typedef struct lgx_ast {
     // 抽象语法树
     lgx_ast_node_t *root;
 
+    // 所有块语句的符号表
+    lgx_ast_symbols_t *symbols;
+
     // 包名
     lgx_str_t package;
 
@@ -137,6 +152,9 @@ typedef struct lgx_ast {
 int lgx_ast_init(lgx_ast_t* ast, char* file);
 int lgx_ast_cleanup(lgx_ast_t* ast);
 
+// 在 arena 中分配一条错误信息，err_msg 的缓冲区长度为 256 字节
+lgx_ast_error_list_t* lgx_ast_error_new(lgx_ast_t* ast);
+
 void lgx_ast_print(lgx_ast_t* ast);
 void lgx_ast_print_error(lgx_ast_t* ast);
 
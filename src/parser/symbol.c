@@ -1,23 +1,16 @@
 #include "../interpreter/value.h"
+#include "../runtime/buildin.h"
 #include "symbol.h"
 
 // 追加一条错误信息
 static void symbol_error(lgx_ast_t* ast, lgx_ast_node_t* node, const char *fmt, ...) {
     va_list   args;
 
-    lgx_ast_error_list_t* err = xcalloc(1, sizeof(lgx_ast_error_list_t));
+    lgx_ast_error_list_t* err = lgx_ast_error_new(ast);
     if (!err) {
         return;
     }
 
-    lgx_list_init(&err->head);
-    err->err_no = 1;
-
-    if (lgx_str_init(&err->err_msg, 256)) {
-        xfree(err);
-        return;
-    }
-
     if (ast->lex.source.path) {
         err->err_msg.length = snprintf(err->err_msg.buffer, err->err_msg.size,
             "[SYMBOL ERROR] [%s:%d:%d] ", ast->lex.source.path, node->line + 1, node->row);
@@ -34,14 +27,17 @@ static void symbol_error(lgx_ast_t* ast, lgx_ast_node_t* node, const char *fmt,
     lgx_list_add_tail(&err->head, &ast->errors);
 }
 
-static lgx_symbol_t* symbol_new() {
-    return (lgx_symbol_t*)xcalloc(1, sizeof(lgx_symbol_t));
+static lgx_symbol_t* symbol_new(lgx_ast_t* ast) {
+    return (lgx_symbol_t*)lgx_arena_alloc(&ast->arena, sizeof(lgx_symbol_t));
 }
 
-static void symbol_del(lgx_symbol_t* symbol) {
-    lgx_value_cleanup(&symbol->v);
+// 符号本身在 arena 中，只需要释放它的值与类型
+static void symbol_release(lgx_symbol_t* symbol) {
+    // 函数常量的值同时保存在常量表中，由常量表负责释放
+    if (symbol->s_type != S_CONSTANT || symbol->type.type != T_FUNCTION) {
+        lgx_value_cleanup(&symbol->v);
+    }
     lgx_type_cleanup(&symbol->type);
-    xfree(symbol);
 }
 
 static lgx_symbol_t* symbol_add(lgx_ast_t* ast, lgx_ast_node_t* node,
@@ -55,7 +51,7 @@ static lgx_symbol_t* symbol_add(lgx_ast_t* ast, lgx_ast_node_t* node,
         return NULL;
     }
 
-    lgx_symbol_t* symbol = symbol_new();
+    lgx_symbol_t* symbol = symbol_new(ast);
     if (!symbol) {
         return NULL;
     }
@@ -64,7 +60,7 @@ static lgx_symbol_t* symbol_add(lgx_ast_t* ast, lgx_ast_node_t* node,
     symbol->is_global = is_global;
 
     if (lgx_ht_set(symbols, name, symbol)) {
-        symbol_del(symbol);
+        symbol_release(symbol);
         symbol_error(ast, node, "symbol `%.*s` unkonwn error\n", name->length, name->buffer);
         return NULL;
     }
@@ -95,6 +91,12 @@ static int symbol_parse_type_map(lgx_ast_t* ast, lgx_ast_node_t* node, lgx_type_
         return 1;
     }
 
+    // 整数键直接以二进制比较，不会转换为字符串
+    if (map->key.type != T_LONG && map->key.type != T_STRING) {
+        symbol_error(ast, node, "key of map should be int or string\n");
+        return 1;
+    }
+
     if (symbol_parse_type(ast, node->child[1], &map->value)) {
         return 1;
     }
@@ -530,33 +532,66 @@ static int symbol_generate(lgx_ast_t* ast, lgx_ast_node_t* node) {
     return ret;
 }
 
-// 初始化符号信息
-int lgx_symbol_init(lgx_ast_t* ast) {
-    // TODO 导入内建函数
+// 把内建函数添加为全局函数常量，脚本中同名的全局符号优先
+static int symbol_add_buildin(lgx_ast_t* ast) {
+    lgx_ht_t* symbols = ast->root->u.symbols;
 
+    const lgx_buildin_t* b;
+    for (b = lgx_buildin_list; b->name; ++b) {
+        lgx_str_t name;
+        name.buffer = (char *)b->name;
+        name.length = strlen(b->name);
+        name.size = 0;
 
-    // 遍历语法树生成符号信息
-    return symbol_generate(ast, ast->root);
-}
+        if (lgx_ht_get(symbols, &name)) {
+            continue;
+        }
 
-static void symbol_cleanup(lgx_ast_node_t* node) {
-    if (node->type == BLOCK_STATEMENT) {
-        lgx_ht_node_t* n;
-        for (n = lgx_ht_first(node->u.symbols); n; n = lgx_ht_next(n)) {
-            symbol_del(n->v);
-            n->v = NULL;
+        lgx_function_t* fun = lgx_buildin_new(b);
+        if (!fun) {
+            symbol_error(ast, ast->root, "out of memory\n");
+            return 1;
+        }
+
+        lgx_symbol_t* symbol = symbol_add(ast, ast->root, symbols, S_CONSTANT, &name, 1);
+        if (!symbol) {
+            lgx_function_cleanup(fun);
+            xfree(fun);
+            return 1;
+        }
+
+        // 函数值在编译时转交给常量表
+        lgx_value_set_fun(&symbol->v, fun);
+        if (lgx_type_dup(&fun->gc.type, &symbol->type)) {
+            symbol_error(ast, ast->root, "out of memory\n");
+            return 1;
         }
     }
 
-    int i;
-    for (i = 0; i < node->children; ++i) {
-        symbol_cleanup(node->child[i]);
+    return 0;
+}
+
+// 初始化符号信息
+int lgx_symbol_init(lgx_ast_t* ast) {
+    // 遍历语法树生成符号信息
+    if (symbol_generate(ast, ast->root)) {
+        return 1;
     }
+
+    // 导入内建函数
+    return symbol_add_buildin(ast);
 }
 
+// 释放所有符号的值与类型以及符号表，符号本身随语法树的 arena 一起释放
 void lgx_symbol_cleanup(lgx_ast_t* ast) {
-    if (ast->root) {
-        symbol_cleanup(ast->root);
+    lgx_ast_symbols_t* symbols;
+    for (symbols = ast->symbols; symbols; symbols = symbols->next) {
+        lgx_ht_node_t* n;
+        for (n = lgx_ht_first(&symbols->table); n; n = lgx_ht_next(n)) {
+            symbol_release(n->v);
+            n->v = NULL;
+        }
+        lgx_ht_cleanup(&symbols->table);
     }
 }
 
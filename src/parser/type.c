@@ -372,7 +372,8 @@ void lgx_type_array_cleanup(lgx_type_array_t* arr) {
 }
 
 void lgx_type_map_cleanup(lgx_type_map_t* map) {
-    // TODO
+    lgx_type_cleanup(&map->key);
+    lgx_type_cleanup(&map->value);
     memset(map, 0, sizeof(lgx_type_map_t));
 }
 
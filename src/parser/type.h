@@ -3,6 +3,7 @@
 
 #include "../common/list.h"
 #include "../common/ht.h"
+#include "../common/rb.h"
 #include "../common/str.h"
 
 typedef enum lgx_val_type_e {
@@ -41,6 +42,93 @@ typedef union {
     lgx_gc_t        *gc;
 } lgx_v_t;
 
+// 值的表示方式
+// 默认把 8 字节的值与类型分开保存，每个值占用 16 字节。
+// 定义 LGX_VALUE_NAN_BOXING 时使用 NaN-boxing，每个值只占用 8 字节：
+// double 按原样保存（NaN 统一为 0x7FF8000000000000），其它类型保存在 0xFFF8 开头的
+// quiet NaN 空间中，bit 47~50 为类型，bit 0~46 为有效载荷。
+// 为了让全 0 的内存表示 T_UNKNOWN，实际保存的是与 LGX_NAN_MASK 异或后的结果。
+// 有效载荷只有 47 位，所以该模式下 T_LONG 的范围为 [-2^46, 2^46)，
+// 指针同样必须位于低 128T 地址空间内（x86-64 与 AArch64 的用户态地址满足该条件）。
+// 整数运算仍然按 64 位进行，结果超出 T_LONG 的范围时抛出 integer overflow 异常，
+// 超出范围的整数常量在编译时报错。因此结果要么与默认表示相同，要么抛出异常，不会被截断。
+//
+// 解释器、协程、运行时与编译器只应该通过下面的 lgx_value_* 函数读写值，
+// 整个值的复制直接使用结构体赋值。
+#ifdef LGX_VALUE_NAN_BOXING
+
+typedef struct lgx_value_s {
+    unsigned long long bits;
+} lgx_value_t;
+
+#define LGX_NAN_MASK    0xFFF8000000000000ULL
+#define LGX_NAN_PAYLOAD 0x00007FFFFFFFFFFFULL
+#define LGX_NAN_SHIFT   47
+
+typedef union {
+    unsigned long long bits;
+    double d;
+} lgx_nan_t;
+
+// T_LONG 能够保存的范围
+#define LGX_LONG_MIN    (-(1LL << (LGX_NAN_SHIFT - 1)))
+#define LGX_LONG_MAX    ((1LL << (LGX_NAN_SHIFT - 1)) - 1)
+
+// l 能否保存为 T_LONG，超出范围的值不能交给 lgx_value_set_long
+static lgx_inline int lgx_long_fits(long long l) {
+    return l >= LGX_LONG_MIN && l <= LGX_LONG_MAX;
+}
+
+static lgx_inline lgx_val_type_t lgx_value_type(const lgx_value_t *v) {
+    return (v->bits >> 51) ? T_DOUBLE : (lgx_val_type_t)(v->bits >> LGX_NAN_SHIFT);
+}
+
+static lgx_inline void lgx_value_box(lgx_value_t *v, lgx_val_type_t type, unsigned long long payload) {
+    v->bits = ((unsigned long long)type << LGX_NAN_SHIFT) | (payload & LGX_NAN_PAYLOAD);
+}
+
+static lgx_inline void *lgx_value_ptr(const lgx_value_t *v) {
+    return (void *)(size_t)(v->bits & LGX_NAN_PAYLOAD);
+}
+
+static lgx_inline long long lgx_value_long(const lgx_value_t *v) {
+    // 符号扩展
+    return (long long)(v->bits << (64 - LGX_NAN_SHIFT)) >> (64 - LGX_NAN_SHIFT);
+}
+
+static lgx_inline double lgx_value_double(const lgx_value_t *v) {
+    lgx_nan_t n;
+    n.bits = v->bits ^ LGX_NAN_MASK;
+    return n.d;
+}
+
+static lgx_inline void lgx_value_set_long(lgx_value_t *v, long long l) {
+    lgx_value_box(v, T_LONG, (unsigned long long)l);
+}
+
+static lgx_inline void lgx_value_set_double(lgx_value_t *v, double d) {
+    lgx_nan_t n;
+    n.d = d;
+    if (UNEXPECTED(d != d)) {
+        n.bits = 0x7FF8000000000000ULL;
+    }
+    v->bits = n.bits ^ LGX_NAN_MASK;
+}
+
+#define lgx_value_bool(val) ((int)((val)->bits & 1))
+#define lgx_value_str(val)  ((lgx_string_t *)lgx_value_ptr(val))
+#define lgx_value_arr(val)  ((lgx_array_t *)lgx_value_ptr(val))
+#define lgx_value_map(val)  ((lgx_map_t *)lgx_value_ptr(val))
+#define lgx_value_fun(val)  ((lgx_function_t *)lgx_value_ptr(val))
+#define lgx_value_gc(val)   ((lgx_gc_t *)lgx_value_ptr(val))
+
+#define lgx_value_set_bool(val, b)      lgx_value_box(val, T_BOOL, (b) ? 1 : 0)
+#define lgx_value_set_null(val)         lgx_value_box(val, T_NULL, 0)
+#define lgx_value_set_unknown(val)      ((val)->bits = 0)
+#define lgx_value_set_gc(val, t, p)     lgx_value_box(val, t, (unsigned long long)(size_t)(p))
+
+#else
+
 typedef struct lgx_value_s {
     // 8 字节
     lgx_v_t v;
@@ -48,6 +136,49 @@ typedef struct lgx_value_s {
     lgx_val_type_t type;
 } lgx_value_t;
 
+// 默认表示可以保存任意 64 位整数
+#define lgx_long_fits(l)        1
+
+#define lgx_value_type(val)     ((val)->type)
+#define lgx_value_long(val)     ((val)->v.l)
+#define lgx_value_double(val)   ((val)->v.d)
+#define lgx_value_bool(val)     ((int)((val)->v.l != 0))
+#define lgx_value_str(val)      ((val)->v.str)
+#define lgx_value_arr(val)      ((val)->v.arr)
+#define lgx_value_map(val)      ((val)->v.map)
+#define lgx_value_fun(val)      ((val)->v.fun)
+#define lgx_value_gc(val)       ((val)->v.gc)
+
+static lgx_inline void lgx_value_set_long(lgx_value_t *v, long long l) {
+    v->type = T_LONG;
+    v->v.l = l;
+}
+
+static lgx_inline void lgx_value_set_double(lgx_value_t *v, double d) {
+    v->type = T_DOUBLE;
+    v->v.d = d;
+}
+
+static lgx_inline void lgx_value_set_gc(lgx_value_t *v, lgx_val_type_t type, void *p) {
+    v->type = type;
+    v->v.gc = (lgx_gc_t *)p;
+}
+
+static lgx_inline void lgx_value_set_bool(lgx_value_t *v, int b) {
+    v->type = T_BOOL;
+    v->v.l = b ? 1 : 0;
+}
+
+#define lgx_value_set_null(val)         ((val)->type = T_NULL)
+#define lgx_value_set_unknown(val)      ((val)->type = T_UNKNOWN)
+
+#endif
+
+#define lgx_value_set_str(val, p)   lgx_value_set_gc(val, T_STRING, p)
+#define lgx_value_set_arr(val, p)   lgx_value_set_gc(val, T_ARRAY, p)
+#define lgx_value_set_map(val, p)   lgx_value_set_gc(val, T_MAP, p)
+#define lgx_value_set_fun(val, p)   lgx_value_set_gc(val, T_FUNCTION, p)
+
 typedef struct lgx_val_list_s {
     lgx_list_t head;
     lgx_value_t v;
@@ -75,8 +206,9 @@ struct lgx_gc_s {
     // 类型
     lgx_type_t type;
 
-    // 引用计数
-    //unsigned ref_cnt;
+    // 引用计数：除第一个持有者外，共享该对象的持有者个数
+    // 目前只有不可变的字符串会被共享，数组通过共享元素存储实现写时复制
+    unsigned ref_cnt;
 
     // GC 标记
     unsigned char color;
@@ -119,28 +251,87 @@ typedef struct lgx_type_function_s {
     lgx_type_t* args;
 } lgx_type_function_t;
 
+// 字符串拼接使用的缓冲区，可以被多个字符串共享。
+// 每个字符串只引用缓冲区的一个前缀，因此只有内容恰好到达已写入末尾的字符串可以在原地继续追加，
+// 追加不会改变其它字符串看到的内容
+typedef struct lgx_string_buffer_s {
+    // 除第一个持有者之外，共享该缓冲区的字符串数量
+    unsigned ref_cnt;
+
+    // 缓冲区长度
+    unsigned size;
+
+    // 已写入的长度
+    unsigned length;
+
+    char buffer[];
+} lgx_string_buffer_t;
+
 struct lgx_string_s {
     // GC 信息
     lgx_gc_t gc;
 
+    // 哈希值，为 0 时表示尚未计算。字符串创建后内容不会再改变，所以只需要计算一次
+    unsigned hash;
+
+    // 驻留字符串由驻留表持有，相同内容只保存一份，不参与 GC，也不会被单独释放
+    unsigned interned;
+
+    // 拼接产生的字符串引用共享的缓冲区，此时 string.size 为 0
+    lgx_string_buffer_t* builder;
+
     // 字符串信息
     lgx_str_t string;
+
+    // 短字符串的内容直接保存在字符串对象之后，此时 string.buffer 指向这里并且 string.size 为 0
+    char data[];
 };
 
 struct lgx_array_s {
     // GC 信息
     lgx_gc_t gc;
 
-    // 哈希表
+    // 下标为 0 到 length - 1 的连续整数时，元素直接保存在 values 中
+    unsigned size;
+    unsigned length;
+
+    // 连续存储的元素类型。所有元素都是 int 或 float 时为 T_LONG 或 T_DOUBLE，
+    // 元素保存为不带类型标记的原始值；否则为 T_UNKNOWN，元素保存为 lgx_value_t
+    unsigned kind;
+
+    union {
+        lgx_value_t* values;
+        long long* longs;
+        double* doubles;
+    };
+
+    // 出现了字符串下标或者数组变得稀疏后，转为使用哈希表保存，values 不再使用
     lgx_ht_t table;
+
+    // 写时复制：复制数组时只共享 values 或 table，shared 指向共享计数，
+    // 计数值为共享该存储的其它数组的个数。修改前必须先获得独立的存储
+    unsigned* shared;
 };
 
 struct lgx_map_s {
     // GC 信息
     lgx_gc_t gc;
 
-    // 哈希表
+    // 键的类型，T_LONG 或 T_STRING。整数键以 8 字节的二进制保存，不会被转换为字符串
+    unsigned key;
+
+    // 为 1 时元素按键的顺序保存在红黑树中，支持范围查询；否则保存在哈希表中
+    unsigned ordered;
+
+    // 哈希表，ordered 为 0 时使用
     lgx_ht_t table;
+
+    // 红黑树，ordered 为 1 时使用
+    lgx_rb_t tree;
+
+    // 写时复制：与 lgx_array_t 相同，复制 map 时只共享 table 或 tree，
+    // shared 指向共享计数。修改前必须先获得独立的存储
+    unsigned* shared;
 };
 
 struct lgx_struct_s {
@@ -163,6 +354,7 @@ struct lgx_interface_s {
 };
 
 struct lgx_vm_s;
+struct lgx_jit_function_s;
 
 struct lgx_function_s {
     // GC 信息
@@ -182,6 +374,9 @@ struct lgx_function_s {
 
     // 内建函数指针
     int (*buildin)(struct lgx_vm_s *vm);
+
+    // 调用计数与 JIT 编译结果，函数的各个副本共享同一份
+    struct lgx_jit_function_s *jit;
 };
 
 int lgx_type_to_string(lgx_type_t* type, lgx_str_t* str);
@@ -1,6 +1,711 @@
 #include "../interpreter/vm.h"
+#include "../interpreter/coroutine.h"
+#include "../interpreter/value.h"
+#include "../interpreter/gc.h"
+#include "kernel.h"
 #include "buildin.h"
 
 int lgx_buildin_echo(lgx_vm_t* vm) {
 
-}
\ No newline at end of file
+}
+
+// 当前调用的内建函数的第 i 个参数
+static lgx_value_t* buildin_arg(lgx_co_t* co, unsigned i) {
+    unsigned base = co->stack.base + lgx_value_fun(&co->stack.buf[co->stack.base])->stack_size;
+
+    return &co->stack.buf[base + 4 + i];
+}
+
+// 数值数组的连续视图。元素没有以原始值连续保存时，复制到临时缓冲区中
+typedef struct {
+    unsigned length;
+    union {
+        long long* longs;
+        double* doubles;
+    };
+    void* tmp;
+} buildin_view_t;
+
+// kind 为 T_LONG 或 T_DOUBLE。失败时抛出异常并返回 1
+static int buildin_view(lgx_co_t* co, lgx_value_t* v, unsigned kind, buildin_view_t* view) {
+    memset(view, 0, sizeof(buildin_view_t));
+
+    if (lgx_value_type(v) != T_ARRAY) {
+        lgx_co_throw_s(co, "runtime error");
+        return 1;
+    }
+
+    lgx_array_t* arr = lgx_value_arr(v);
+    if (!lgx_array_is_packed(arr)) {
+        // 稀疏数组的元素没有确定的位置
+        lgx_co_throw_s(co, "array with contiguous integer keys expected");
+        return 1;
+    }
+
+    view->length = arr->length;
+    if (!arr->length) {
+        return 0;
+    }
+
+    if (arr->kind == kind) {
+        view->longs = arr->longs;
+        return 0;
+    }
+
+    // 数组中存在其它类型的元素（例如 null）时，元素以 lgx_value_t 保存
+    view->tmp = xmalloc(arr->length * sizeof(long long));
+    if (!view->tmp) {
+        lgx_co_throw_s(co, "out of memory");
+        return 1;
+    }
+    view->longs = (long long*)view->tmp;
+
+    unsigned i;
+    for (i = 0; i < arr->length; i ++) {
+        lgx_value_t e;
+        lgx_array_packed_get(arr, i, &e);
+        if (lgx_value_type(&e) != kind) {
+            xfree(view->tmp);
+            view->tmp = NULL;
+            lgx_co_throw_s(co, "array element is not %s", kind == T_LONG ? "int" : "float");
+            return 1;
+        }
+        if (kind == T_LONG) {
+            view->longs[i] = lgx_value_long(&e);
+        } else {
+            view->doubles[i] = lgx_value_double(&e);
+        }
+    }
+
+    return 0;
+}
+
+static void buildin_view_cleanup(buildin_view_t* view) {
+    if (view->tmp) {
+        xfree(view->tmp);
+        view->tmp = NULL;
+    }
+}
+
+// 创建包含 length 个尚未赋值元素的数值数组，并加入 GC 跟踪
+static lgx_array_t* buildin_array_new(lgx_co_t* co, unsigned kind, unsigned length, lgx_value_t* v) {
+    lgx_array_t* arr = lgx_array_new();
+    if (!arr) {
+        lgx_co_throw_s(co, "out of memory");
+        return NULL;
+    }
+    if (lgx_type_init(&arr->gc.type, T_ARRAY) || lgx_type_init(&arr->gc.type.u.arr->value, kind)) {
+        lgx_type_cleanup(&arr->gc.type);
+        xfree(arr);
+        lgx_co_throw_s(co, "out of memory");
+        return NULL;
+    }
+    if (lgx_array_init_kind(arr, kind, length)) {
+        lgx_array_cleanup(arr);
+        xfree(arr);
+        lgx_co_throw_s(co, "out of memory");
+        return NULL;
+    }
+
+    lgx_value_set_arr(v, arr);
+    lgx_gc_trace(co->vm, v);
+
+    return arr;
+}
+
+// 返回 buildin_array_new 创建的数组
+static int buildin_return_array(lgx_co_t* co, lgx_array_t* arr, lgx_value_t* v) {
+#ifdef LGX_VALUE_NAN_BOXING
+    // 整数元素超出 T_LONG 的范围时抛出异常，而不是截断
+    if (arr->kind == T_LONG) {
+        unsigned i;
+        for (i = 0; i < arr->length; i ++) {
+            if (UNEXPECTED(!lgx_long_fits(arr->longs[i]))) {
+                lgx_co_throw_s(co, "integer overflow");
+                return 1;
+            }
+        }
+    }
+#endif
+    return lgx_co_return(co, v);
+}
+
+static int buildin_sum_int(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    buildin_view_t a;
+    if (buildin_view(co, buildin_arg(co, 0), T_LONG, &a)) {
+        return 1;
+    }
+    long long r = lgx_kernel.sum_long(a.longs, a.length);
+    buildin_view_cleanup(&a);
+    return lgx_co_return_long(co, r);
+}
+
+static int buildin_sum_float(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    buildin_view_t a;
+    if (buildin_view(co, buildin_arg(co, 0), T_DOUBLE, &a)) {
+        return 1;
+    }
+    double r = lgx_kernel.sum_double(a.doubles, a.length);
+    buildin_view_cleanup(&a);
+    return lgx_co_return_double(co, r);
+}
+
+// 生成 min 与 max 的实现，空数组没有最值，抛出异常
+#define BUILDIN_EXTREMUM(name, kind, field, kernel, ret)                    \
+static int buildin_##name(lgx_vm_t* vm) {                                   \
+    lgx_co_t* co = vm->co_running;                                          \
+    buildin_view_t a;                                                       \
+    if (buildin_view(co, buildin_arg(co, 0), kind, &a)) {                   \
+        return 1;                                                           \
+    }                                                                       \
+    if (!a.length) {                                                        \
+        lgx_co_throw_s(co, #name "() of empty array");                      \
+        return 1;                                                           \
+    }                                                                       \
+    ret(co, lgx_kernel.kernel(a.field, a.length));                          \
+    buildin_view_cleanup(&a);                                               \
+    return 0;                                                               \
+}
+
+BUILDIN_EXTREMUM(min_int, T_LONG, longs, min_long, lgx_co_return_long)
+BUILDIN_EXTREMUM(max_int, T_LONG, longs, max_long, lgx_co_return_long)
+BUILDIN_EXTREMUM(min_float, T_DOUBLE, doubles, min_double, lgx_co_return_double)
+BUILDIN_EXTREMUM(max_float, T_DOUBLE, doubles, max_double, lgx_co_return_double)
+
+// 读取两个长度相同的数组参数
+static int buildin_view2(lgx_co_t* co, unsigned kind, buildin_view_t* a, buildin_view_t* b) {
+    if (buildin_view(co, buildin_arg(co, 0), kind, a)) {
+        return 1;
+    }
+    if (buildin_view(co, buildin_arg(co, 1), kind, b)) {
+        buildin_view_cleanup(a);
+        return 1;
+    }
+    if (a->length != b->length) {
+        buildin_view_cleanup(a);
+        buildin_view_cleanup(b);
+        lgx_co_throw_s(co, "array length mismatch");
+        return 1;
+    }
+    return 0;
+}
+
+static int buildin_dot_int(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    buildin_view_t a, b;
+    if (buildin_view2(co, T_LONG, &a, &b)) {
+        return 1;
+    }
+    long long r = lgx_kernel.dot_long(a.longs, b.longs, a.length);
+    buildin_view_cleanup(&a);
+    buildin_view_cleanup(&b);
+    return lgx_co_return_long(co, r);
+}
+
+static int buildin_dot_float(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    buildin_view_t a, b;
+    if (buildin_view2(co, T_DOUBLE, &a, &b)) {
+        return 1;
+    }
+    double r = lgx_kernel.dot_double(a.doubles, b.doubles, a.length);
+    buildin_view_cleanup(&a);
+    buildin_view_cleanup(&b);
+    return lgx_co_return_double(co, r);
+}
+
+// 元素级运算返回新的数组，参数不会被修改
+static int buildin_scale_int(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    buildin_view_t a;
+    if (buildin_view(co, buildin_arg(co, 0), T_LONG, &a)) {
+        return 1;
+    }
+    long long k = lgx_value_long(buildin_arg(co, 1));
+    lgx_value_t ret;
+    lgx_array_t* arr = buildin_array_new(co, T_LONG, a.length, &ret);
+    if (arr) {
+        lgx_kernel.scale_long(arr->longs, a.longs, k, a.length);
+    }
+    buildin_view_cleanup(&a);
+    return arr ? buildin_return_array(co, arr, &ret) : 1;
+}
+
+static int buildin_scale_float(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    buildin_view_t a;
+    if (buildin_view(co, buildin_arg(co, 0), T_DOUBLE, &a)) {
+        return 1;
+    }
+    double k = lgx_value_double(buildin_arg(co, 1));
+    lgx_value_t ret;
+    lgx_array_t* arr = buildin_array_new(co, T_DOUBLE, a.length, &ret);
+    if (arr) {
+        lgx_kernel.scale_double(arr->doubles, a.doubles, k, a.length);
+    }
+    buildin_view_cleanup(&a);
+    return arr ? buildin_return_array(co, arr, &ret) : 1;
+}
+
+#define BUILDIN_ELEMENTWISE(name, kind, field, kernel)                      \
+static int buildin_##name(lgx_vm_t* vm) {                                   \
+    lgx_co_t* co = vm->co_running;                                          \
+    buildin_view_t a, b;                                                    \
+    if (buildin_view2(co, kind, &a, &b)) {                                  \
+        return 1;                                                           \
+    }                                                                       \
+    lgx_value_t ret;                                                        \
+    lgx_array_t* arr = buildin_array_new(co, kind, a.length, &ret);         \
+    if (arr) {                                                              \
+        lgx_kernel.kernel(arr->field, a.field, b.field, a.length);          \
+    }                                                                       \
+    buildin_view_cleanup(&a);                                               \
+    buildin_view_cleanup(&b);                                               \
+    return arr ? buildin_return_array(co, arr, &ret) : 1;                               \
+}
+
+BUILDIN_ELEMENTWISE(add_int, T_LONG, longs, add_long)
+BUILDIN_ELEMENTWISE(add_float, T_DOUBLE, doubles, add_double)
+BUILDIN_ELEMENTWISE(mul_int, T_LONG, longs, mul_long)
+BUILDIN_ELEMENTWISE(mul_float, T_DOUBLE, doubles, mul_double)
+
+static int buildin_find_int(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    buildin_view_t a;
+    if (buildin_view(co, buildin_arg(co, 0), T_LONG, &a)) {
+        return 1;
+    }
+    long long r = lgx_kernel.find_long(a.longs, a.length, lgx_value_long(buildin_arg(co, 1)));
+    buildin_view_cleanup(&a);
+    return lgx_co_return_long(co, r);
+}
+
+static int buildin_find_float(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    buildin_view_t a;
+    if (buildin_view(co, buildin_arg(co, 0), T_DOUBLE, &a)) {
+        return 1;
+    }
+    long long r = lgx_kernel.find_double(a.doubles, a.length, lgx_value_double(buildin_arg(co, 1)));
+    buildin_view_cleanup(&a);
+    return lgx_co_return_long(co, r);
+}
+
+static int buildin_count_int(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    buildin_view_t a;
+    if (buildin_view(co, buildin_arg(co, 0), T_LONG, &a)) {
+        return 1;
+    }
+    unsigned r = lgx_kernel.count_long(a.longs, a.length, lgx_value_long(buildin_arg(co, 1)));
+    buildin_view_cleanup(&a);
+    return lgx_co_return_long(co, r);
+}
+
+static int buildin_count_float(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    buildin_view_t a;
+    if (buildin_view(co, buildin_arg(co, 0), T_DOUBLE, &a)) {
+        return 1;
+    }
+    unsigned r = lgx_kernel.count_double(a.doubles, a.length, lgx_value_double(buildin_arg(co, 1)));
+    buildin_view_cleanup(&a);
+    return lgx_co_return_long(co, r);
+}
+
+// 返回排序后的新数组
+static int buildin_sort_int(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    buildin_view_t a;
+    if (buildin_view(co, buildin_arg(co, 0), T_LONG, &a)) {
+        return 1;
+    }
+    lgx_value_t ret;
+    lgx_array_t* arr = buildin_array_new(co, T_LONG, a.length, &ret);
+    int failed = !arr;
+    if (arr) {
+        if (a.length) {
+            memcpy(arr->longs, a.longs, a.length * sizeof(long long));
+        }
+        if (lgx_kernel_sort_long(arr->longs, arr->length)) {
+            lgx_co_throw_s(co, "out of memory");
+            failed = 1;
+        }
+    }
+    buildin_view_cleanup(&a);
+    return failed ? 1 : lgx_co_return(co, &ret);
+}
+
+static int buildin_sort_float(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    buildin_view_t a;
+    if (buildin_view(co, buildin_arg(co, 0), T_DOUBLE, &a)) {
+        return 1;
+    }
+    lgx_value_t ret;
+    lgx_array_t* arr = buildin_array_new(co, T_DOUBLE, a.length, &ret);
+    int failed = !arr;
+    if (arr) {
+        if (a.length) {
+            memcpy(arr->doubles, a.doubles, a.length * sizeof(double));
+        }
+        if (lgx_kernel_sort_double(arr->doubles, arr->length)) {
+            lgx_co_throw_s(co, "out of memory");
+            failed = 1;
+        }
+    }
+    buildin_view_cleanup(&a);
+    return failed ? 1 : lgx_co_return(co, &ret);
+}
+
+// 参数不是 map 时抛出异常并返回 NULL
+static lgx_map_t* buildin_map(lgx_co_t* co) {
+    lgx_value_t* v = buildin_arg(co, 0);
+    if (lgx_value_type(v) != T_MAP) {
+        lgx_co_throw_s(co, "runtime error");
+        return NULL;
+    }
+    return lgx_value_map(v);
+}
+
+// 第 i 个参数作为 map 的键，类型不一致时抛出异常并返回 NULL
+static lgx_value_t* buildin_map_key(lgx_co_t* co, lgx_map_t* map, unsigned i) {
+    lgx_value_t* k = buildin_arg(co, i);
+    if (lgx_value_type(k) != map->key) {
+        lgx_co_throw_s(co, "runtime error");
+        return NULL;
+    }
+    return k;
+}
+
+// 按键排序的查询需要红黑树，第一次查询时把 map 转为有序保存
+static lgx_map_t* buildin_ordered_map(lgx_co_t* co) {
+    lgx_map_t* map = buildin_map(co);
+    if (!map) {
+        return NULL;
+    }
+    if (lgx_map_order(map)) {
+        lgx_co_throw_s(co, "out of memory");
+        return NULL;
+    }
+    return map;
+}
+
+// 返回 map 中保存的键
+static int buildin_return_key(lgx_co_t* co, lgx_map_t* map, lgx_str_t* key) {
+    lgx_value_t v;
+    if (lgx_map_key_value(map, key, &v)) {
+        lgx_co_throw_s(co, "out of memory");
+        return 1;
+    }
+    lgx_gc_trace(co->vm, &v);
+    return lgx_co_return(co, &v);
+}
+
+static int buildin_map_len(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    lgx_map_t* map = buildin_map(co);
+    if (!map) {
+        return 1;
+    }
+    return lgx_co_return_long(co, lgx_map_length(map));
+}
+
+static int buildin_map_has(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    lgx_map_t* map = buildin_map(co);
+    lgx_value_t* k = map ? buildin_map_key(co, map, 1) : NULL;
+    if (!k) {
+        return 1;
+    }
+    return lgx_map_get(map, k) ? lgx_co_return_true(co) : lgx_co_return_false(co);
+}
+
+static int buildin_map_del(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    lgx_map_t* map = buildin_map(co);
+    lgx_value_t* k = map ? buildin_map_key(co, map, 1) : NULL;
+    if (!k) {
+        return 1;
+    }
+    lgx_value_t* v = lgx_map_get(map, k);
+    if (v) {
+        lgx_gc_barrier(vm, v);
+        if (!map->shared || !*map->shared) {
+            lgx_gc_retain(vm, v);
+        }
+    }
+    return lgx_map_del(map, k) ? lgx_co_return_false(co) : lgx_co_return_true(co);
+}
+
+// 返回全部键组成的数组。有序的 map 按键的升序，否则按插入顺序
+static int buildin_map_keys(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    lgx_map_t* map = buildin_map(co);
+    if (!map) {
+        return 1;
+    }
+
+    lgx_value_t ret;
+    lgx_array_t* arr;
+    lgx_map_iter_t it;
+    memset(&it, 0, sizeof(it));
+
+    if (map->key == T_LONG) {
+        arr = buildin_array_new(co, T_LONG, lgx_map_length(map), &ret);
+        if (!arr) {
+            return 1;
+        }
+        unsigned i = 0;
+        while (!lgx_map_next(map, &it)) {
+            memcpy(&arr->longs[i ++], it.k->buffer, sizeof(long long));
+        }
+        return lgx_co_return(co, &ret);
+    }
+
+    arr = lgx_array_new();
+    if (!arr) {
+        lgx_co_throw_s(co, "out of memory");
+        return 1;
+    }
+    if (lgx_type_init(&arr->gc.type, T_ARRAY) || lgx_type_init(&arr->gc.type.u.arr->value, T_STRING) ||
+        lgx_array_init(arr, lgx_map_length(map))) {
+        lgx_array_cleanup(arr);
+        xfree(arr);
+        lgx_co_throw_s(co, "out of memory");
+        return 1;
+    }
+    lgx_value_set_arr(&ret, arr);
+    lgx_gc_trace(vm, &ret);
+
+    while (!lgx_map_next(map, &it)) {
+        lgx_value_t k;
+        if (lgx_map_key_value(map, it.k, &k)) {
+            lgx_co_throw_s(co, "out of memory");
+            return 1;
+        }
+        if (lgx_array_append(arr, &k)) {
+            lgx_value_cleanup(&k);
+            lgx_co_throw_s(co, "out of memory");
+            return 1;
+        }
+    }
+
+    return lgx_co_return(co, &ret);
+}
+
+static int buildin_map_min(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    lgx_map_t* map = buildin_ordered_map(co);
+    if (!map) {
+        return 1;
+    }
+    lgx_rb_node_t* n = lgx_rb_get_min(&map->tree);
+    if (!n) {
+        lgx_co_throw_s(co, "map_min() of empty map");
+        return 1;
+    }
+    return buildin_return_key(co, map, &n->key);
+}
+
+static int buildin_map_max(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    lgx_map_t* map = buildin_ordered_map(co);
+    if (!map) {
+        return 1;
+    }
+    lgx_rb_node_t* n = lgx_rb_get_max(&map->tree);
+    if (!n) {
+        lgx_co_throw_s(co, "map_max() of empty map");
+        return 1;
+    }
+    return buildin_return_key(co, map, &n->key);
+}
+
+// 生成按键查找相邻元素的实现，不存在满足条件的键时抛出异常
+#define BUILDIN_MAP_SEEK(name, seek)                                        \
+static int buildin_##name(lgx_vm_t* vm) {                                   \
+    lgx_co_t* co = vm->co_running;                                          \
+    lgx_map_t* map = buildin_ordered_map(co);                               \
+    lgx_value_t* k = map ? buildin_map_key(co, map, 1) : NULL;              \
+    if (!k) {                                                               \
+        return 1;                                                           \
+    }                                                                       \
+    long long num;                                                          \
+    lgx_str_t key;                                                          \
+    lgx_map_key(k, &num, &key);                                             \
+    lgx_rb_node_t* n = seek(&map->tree, &key);                              \
+    if (!n) {                                                               \
+        lgx_co_throw_s(co, #name "(): key not found");                      \
+        return 1;                                                           \
+    }                                                                       \
+    return buildin_return_key(co, map, &n->key);                            \
+}
+
+BUILDIN_MAP_SEEK(map_floor, lgx_rb_get_lesser_or_equal)
+BUILDIN_MAP_SEEK(map_ceil, lgx_rb_get_greater_or_equal)
+BUILDIN_MAP_SEEK(map_lower, lgx_rb_get_lesser)
+BUILDIN_MAP_SEEK(map_higher, lgx_rb_get_greater)
+
+// 返回键在 [lo, hi) 范围内的元素组成的新 map
+static int buildin_map_range(lgx_vm_t* vm) {
+    lgx_co_t* co = vm->co_running;
+    lgx_map_t* map = buildin_ordered_map(co);
+    lgx_value_t* lo = map ? buildin_map_key(co, map, 1) : NULL;
+    lgx_value_t* hi = lo ? buildin_map_key(co, map, 2) : NULL;
+    if (!hi) {
+        return 1;
+    }
+
+    lgx_map_t* dst = lgx_map_new();
+    if (!dst) {
+        lgx_co_throw_s(co, "out of memory");
+        return 1;
+    }
+    if (lgx_type_dup(&map->gc.type, &dst->gc.type) || lgx_map_range(map, lo, hi, dst)) {
+        lgx_map_cleanup(dst);
+        xfree(dst);
+        lgx_co_throw_s(co, "out of memory");
+        return 1;
+    }
+
+    lgx_value_t ret;
+    lgx_value_set_map(&ret, dst);
+    lgx_gc_trace(vm, &ret);
+
+    return lgx_co_return(co, &ret);
+}
+
+const lgx_buildin_t lgx_buildin_list[] = {
+    {"sum_int", "iI", buildin_sum_int},
+    {"sum_float", "fF", buildin_sum_float},
+    {"min_int", "iI", buildin_min_int},
+    {"min_float", "fF", buildin_min_float},
+    {"max_int", "iI", buildin_max_int},
+    {"max_float", "fF", buildin_max_float},
+    {"dot_int", "iII", buildin_dot_int},
+    {"dot_float", "fFF", buildin_dot_float},
+    {"scale_int", "IIi", buildin_scale_int},
+    {"scale_float", "FFf", buildin_scale_float},
+    {"add_int", "III", buildin_add_int},
+    {"add_float", "FFF", buildin_add_float},
+    {"mul_int", "III", buildin_mul_int},
+    {"mul_float", "FFF", buildin_mul_float},
+    {"find_int", "iIi", buildin_find_int},
+    {"find_float", "iFf", buildin_find_float},
+    {"count_int", "iIi", buildin_count_int},
+    {"count_float", "iFf", buildin_count_float},
+    {"sort_int", "II", buildin_sort_int},
+    {"sort_float", "FF", buildin_sort_float},
+    {"map_len", "iM", buildin_map_len},
+    {"map_has", "bMK", buildin_map_has},
+    {"map_del", "bMK", buildin_map_del},
+    {"map_keys", "kM", buildin_map_keys},
+    {"map_min", "KM", buildin_map_min},
+    {"map_max", "KM", buildin_map_max},
+    {"map_floor", "KMK", buildin_map_floor},
+    {"map_ceil", "KMK", buildin_map_ceil},
+    {"map_lower", "KMK", buildin_map_lower},
+    {"map_higher", "KMK", buildin_map_higher},
+    {"map_range", "MMKK", buildin_map_range},
+    {NULL, NULL, NULL}
+};
+
+// map 为 map 参数的类型，为 NULL 时 M、K、V 的具体类型未知
+static int buildin_type(char c, lgx_type_t* map, lgx_type_t* type) {
+    switch (c) {
+        case 'i':
+            return lgx_type_init(type, T_LONG);
+        case 'f':
+            return lgx_type_init(type, T_DOUBLE);
+        case 'b':
+            return lgx_type_init(type, T_BOOL);
+        case 'I':
+        case 'F':
+            if (lgx_type_init(type, T_ARRAY)) {
+                return 1;
+            }
+            return lgx_type_init(&type->u.arr->value, c == 'I' ? T_LONG : T_DOUBLE);
+        case 'M':
+            return map ? lgx_type_dup(map, type) : lgx_type_init(type, T_MAP);
+        case 'K':
+            return map ? lgx_type_dup(&map->u.map->key, type) : lgx_type_init(type, T_UNKNOWN);
+        case 'V':
+            return map ? lgx_type_dup(&map->u.map->value, type) : lgx_type_init(type, T_UNKNOWN);
+        case 'k':
+            if (lgx_type_init(type, T_ARRAY)) {
+                return 1;
+            }
+            return buildin_type('K', map, &type->u.arr->value);
+        default:
+            return 1;
+    }
+}
+
+int lgx_buildin_type(const lgx_buildin_t* b, lgx_type_t* map, lgx_type_t* type) {
+    if (lgx_type_init(type, T_FUNCTION)) {
+        return 1;
+    }
+
+    lgx_type_function_t* fun = type->u.fun;
+    if (buildin_type(b->type[0], map, &fun->ret)) {
+        return 1;
+    }
+
+    fun->arg_len = strlen(b->type) - 1;
+    fun->args = xcalloc(fun->arg_len, sizeof(lgx_type_t));
+    if (!fun->args) {
+        fun->arg_len = 0;
+        return 1;
+    }
+
+    unsigned i;
+    for (i = 0; i < fun->arg_len; i ++) {
+        if (buildin_type(b->type[i + 1], map, &fun->args[i])) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+const lgx_buildin_t* lgx_buildin_find(int (*fun)(struct lgx_vm_s *vm)) {
+    const lgx_buildin_t* b;
+    for (b = lgx_buildin_list; b->name; ++b) {
+        if (b->fun == fun) {
+            return b;
+        }
+    }
+    return NULL;
+}
+
+lgx_function_t* lgx_buildin_new(const lgx_buildin_t* b) {
+    lgx_function_t* fun = lgx_fucntion_new();
+    if (!fun) {
+        return NULL;
+    }
+
+    int ret = 0;
+    unsigned length = strlen(b->name);
+    if (lgx_str_init(&fun->name, length) || lgx_buildin_type(b, NULL, &fun->gc.type)) {
+        ret = 1;
+    } else {
+        memcpy(fun->name.buffer, b->name, length);
+        fun->name.length = length;
+
+        // 参数之前保留 4 个寄存器，与 xscript 函数相同
+        fun->stack_size = 4 + fun->gc.type.u.fun->arg_len;
+    }
+
+    if (ret) {
+        lgx_function_cleanup(fun);
+        xfree(fun);
+        return NULL;
+    }
+
+    fun->buildin = b->fun;
+
+    return fun;
+}
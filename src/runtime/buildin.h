@@ -1,4 +1,33 @@
 #ifndef LGX_BUILDIN_H
 #define LGX_BUILDIN_H
 
-#endif // LGX_BUILDIN_H
\ No newline at end of file
+#include "../parser/type.h"
+
+struct lgx_vm_s;
+
+typedef struct {
+    // 函数名称
+    const char* name;
+
+    // 函数类型，第一个字符为返回值类型，其余依次为参数类型
+    // i: int, f: float, b: bool, I: []int, F: []float
+    // M: 任意 map，K 与 V 为第一个参数的键与值的类型，k: []K。调用时根据实参确定具体类型
+    const char* type;
+
+    // 实现。通过 lgx_co_return 写入返回值，或者通过 lgx_co_throw 抛出异常
+    int (*fun)(struct lgx_vm_s *vm);
+} lgx_buildin_t;
+
+// 内建函数列表，以 name 为 NULL 的元素结尾
+extern const lgx_buildin_t lgx_buildin_list[];
+
+// 创建内建函数对应的函数对象
+lgx_function_t* lgx_buildin_new(const lgx_buildin_t* b);
+
+// 生成内建函数的函数类型。map 为第一个参数的类型，为 NULL 时 M、K、V 保持未知
+int lgx_buildin_type(const lgx_buildin_t* b, lgx_type_t* map, lgx_type_t* type);
+
+// 查找实现为 fun 的内建函数，不存在时返回 NULL
+const lgx_buildin_t* lgx_buildin_find(int (*fun)(struct lgx_vm_s *vm));
+
+#endif // LGX_BUILDIN_H
@@ -33,6 +33,8 @@ lgx_exception_block_t* lgx_exception_block_new() {
     block->start = 0;
     block->end = 0;
 
+    memset(&block->e, 0, sizeof(lgx_type_t));
+
     return block;
 }
 
@@ -0,0 +1,713 @@
+#include "../common/common.h"
+#include "kernel.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define LGX_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+/* 标量实现，同时用于处理向量实现剩余的尾部元素 */
+
+static long long scalar_sum_long(const long long* a, unsigned n) {
+    unsigned long long s = 0;
+    unsigned i;
+    for (i = 0; i < n; i ++) {
+        s += (unsigned long long)a[i];
+    }
+    return (long long)s;
+}
+
+static double scalar_sum_double(const double* a, unsigned n) {
+    double s = 0;
+    unsigned i;
+    for (i = 0; i < n; i ++) {
+        s += a[i];
+    }
+    return s;
+}
+
+static long long scalar_min_long(const long long* a, unsigned n) {
+    long long m = a[0];
+    unsigned i;
+    for (i = 1; i < n; i ++) {
+        m = a[i] < m ? a[i] : m;
+    }
+    return m;
+}
+
+static double scalar_min_double(const double* a, unsigned n) {
+    double m = a[0];
+    unsigned i;
+    for (i = 1; i < n; i ++) {
+        m = a[i] < m ? a[i] : m;
+    }
+    return m;
+}
+
+static long long scalar_max_long(const long long* a, unsigned n) {
+    long long m = a[0];
+    unsigned i;
+    for (i = 1; i < n; i ++) {
+        m = a[i] > m ? a[i] : m;
+    }
+    return m;
+}
+
+static double scalar_max_double(const double* a, unsigned n) {
+    double m = a[0];
+    unsigned i;
+    for (i = 1; i < n; i ++) {
+        m = a[i] > m ? a[i] : m;
+    }
+    return m;
+}
+
+static long long scalar_dot_long(const long long* a, const long long* b, unsigned n) {
+    unsigned long long s = 0;
+    unsigned i;
+    for (i = 0; i < n; i ++) {
+        s += (unsigned long long)a[i] * (unsigned long long)b[i];
+    }
+    return (long long)s;
+}
+
+static double scalar_dot_double(const double* a, const double* b, unsigned n) {
+    double s = 0;
+    unsigned i;
+    for (i = 0; i < n; i ++) {
+        s += a[i] * b[i];
+    }
+    return s;
+}
+
+static void scalar_scale_long(long long* dst, const long long* a, long long k, unsigned n) {
+    unsigned i;
+    for (i = 0; i < n; i ++) {
+        dst[i] = (long long)((unsigned long long)a[i] * (unsigned long long)k);
+    }
+}
+
+static void scalar_scale_double(double* dst, const double* a, double k, unsigned n) {
+    unsigned i;
+    for (i = 0; i < n; i ++) {
+        dst[i] = a[i] * k;
+    }
+}
+
+static void scalar_add_long(long long* dst, const long long* a, const long long* b, unsigned n) {
+    unsigned i;
+    for (i = 0; i < n; i ++) {
+        dst[i] = (long long)((unsigned long long)a[i] + (unsigned long long)b[i]);
+    }
+}
+
+static void scalar_add_double(double* dst, const double* a, const double* b, unsigned n) {
+    unsigned i;
+    for (i = 0; i < n; i ++) {
+        dst[i] = a[i] + b[i];
+    }
+}
+
+static void scalar_mul_long(long long* dst, const long long* a, const long long* b, unsigned n) {
+    unsigned i;
+    for (i = 0; i < n; i ++) {
+        dst[i] = (long long)((unsigned long long)a[i] * (unsigned long long)b[i]);
+    }
+}
+
+static void scalar_mul_double(double* dst, const double* a, const double* b, unsigned n) {
+    unsigned i;
+    for (i = 0; i < n; i ++) {
+        dst[i] = a[i] * b[i];
+    }
+}
+
+static long long scalar_find_long(const long long* a, unsigned n, long long x) {
+    unsigned i;
+    for (i = 0; i < n; i ++) {
+        if (a[i] == x) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static long long scalar_find_double(const double* a, unsigned n, double x) {
+    unsigned i;
+    for (i = 0; i < n; i ++) {
+        if (a[i] == x) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static unsigned scalar_count_long(const long long* a, unsigned n, long long x) {
+    unsigned c = 0;
+    unsigned i;
+    for (i = 0; i < n; i ++) {
+        c += a[i] == x;
+    }
+    return c;
+}
+
+static unsigned scalar_count_double(const double* a, unsigned n, double x) {
+    unsigned c = 0;
+    unsigned i;
+    for (i = 0; i < n; i ++) {
+        c += a[i] == x;
+    }
+    return c;
+}
+
+#ifdef LGX_KERNEL_X86
+
+/* SSE2 实现，x86-64 总是支持 SSE2
+ * SSE2 没有 64 位整数的乘法与比较大小的指令，这些运算仍然使用标量实现
+ */
+
+static long long sse2_sum_long(const long long* a, unsigned n) {
+    __m128i s = _mm_setzero_si128();
+    unsigned i;
+    for (i = 0; i + 2 <= n; i += 2) {
+        s = _mm_add_epi64(s, _mm_loadu_si128((const __m128i*)(a + i)));
+    }
+    long long r[2];
+    _mm_storeu_si128((__m128i*)r, s);
+    return (long long)((unsigned long long)r[0] + (unsigned long long)r[1] +
+        (unsigned long long)scalar_sum_long(a + i, n - i));
+}
+
+static double sse2_sum_double(const double* a, unsigned n) {
+    __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+    unsigned i;
+    for (i = 0; i + 4 <= n; i += 4) {
+        s0 = _mm_add_pd(s0, _mm_loadu_pd(a + i));
+        s1 = _mm_add_pd(s1, _mm_loadu_pd(a + i + 2));
+    }
+    double r[2];
+    _mm_storeu_pd(r, _mm_add_pd(s0, s1));
+    return r[0] + r[1] + scalar_sum_double(a + i, n - i);
+}
+
+static double sse2_min_double(const double* a, unsigned n) {
+    if (n < 2) {
+        return scalar_min_double(a, n);
+    }
+    __m128d m = _mm_loadu_pd(a);
+    unsigned i;
+    for (i = 2; i + 2 <= n; i += 2) {
+        m = _mm_min_pd(_mm_loadu_pd(a + i), m);
+    }
+    double r[2];
+    _mm_storeu_pd(r, m);
+    double x = r[1] < r[0] ? r[1] : r[0];
+    for (; i < n; i ++) {
+        x = a[i] < x ? a[i] : x;
+    }
+    return x;
+}
+
+static double sse2_max_double(const double* a, unsigned n) {
+    if (n < 2) {
+        return scalar_max_double(a, n);
+    }
+    __m128d m = _mm_loadu_pd(a);
+    unsigned i;
+    for (i = 2; i + 2 <= n; i += 2) {
+        m = _mm_max_pd(_mm_loadu_pd(a + i), m);
+    }
+    double r[2];
+    _mm_storeu_pd(r, m);
+    double x = r[1] > r[0] ? r[1] : r[0];
+    for (; i < n; i ++) {
+        x = a[i] > x ? a[i] : x;
+    }
+    return x;
+}
+
+static double sse2_dot_double(const double* a, const double* b, unsigned n) {
+    __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+    unsigned i;
+    for (i = 0; i + 4 <= n; i += 4) {
+        s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    double r[2];
+    _mm_storeu_pd(r, _mm_add_pd(s0, s1));
+    return r[0] + r[1] + scalar_dot_double(a + i, b + i, n - i);
+}
+
+static void sse2_scale_double(double* dst, const double* a, double k, unsigned n) {
+    __m128d vk = _mm_set1_pd(k);
+    unsigned i;
+    for (i = 0; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(dst + i, _mm_mul_pd(_mm_loadu_pd(a + i), vk));
+    }
+    scalar_scale_double(dst + i, a + i, k, n - i);
+}
+
+static void sse2_add_long(long long* dst, const long long* a, const long long* b, unsigned n) {
+    unsigned i;
+    for (i = 0; i + 2 <= n; i += 2) {
+        __m128i v = _mm_add_epi64(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)));
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+    scalar_add_long(dst + i, a + i, b + i, n - i);
+}
+
+static void sse2_add_double(double* dst, const double* a, const double* b, unsigned n) {
+    unsigned i;
+    for (i = 0; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(dst + i, _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    }
+    scalar_add_double(dst + i, a + i, b + i, n - i);
+}
+
+static void sse2_mul_double(double* dst, const double* a, const double* b, unsigned n) {
+    unsigned i;
+    for (i = 0; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(dst + i, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    }
+    scalar_mul_double(dst + i, a + i, b + i, n - i);
+}
+
+// SSE2 只能按 32 位比较相等，高低两半都相等时 64 位才相等。返回 2 位的掩码
+static lgx_inline int sse2_eq_long(const long long* a, __m128i x) {
+    __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)a), x);
+    eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_movemask_pd(_mm_castsi128_pd(eq));
+}
+
+static long long sse2_find_long(const long long* a, unsigned n, long long x) {
+    __m128i vx = _mm_set1_epi64x(x);
+    unsigned i;
+    for (i = 0; i + 2 <= n; i += 2) {
+        int mask = sse2_eq_long(a + i, vx);
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    long long r = scalar_find_long(a + i, n - i, x);
+    return r < 0 ? r : i + r;
+}
+
+static long long sse2_find_double(const double* a, unsigned n, double x) {
+    __m128d vx = _mm_set1_pd(x);
+    unsigned i;
+    for (i = 0; i + 2 <= n; i += 2) {
+        int mask = _mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(a + i), vx));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    long long r = scalar_find_double(a + i, n - i, x);
+    return r < 0 ? r : i + r;
+}
+
+static unsigned sse2_count_long(const long long* a, unsigned n, long long x) {
+    __m128i vx = _mm_set1_epi64x(x);
+    unsigned c = 0;
+    unsigned i;
+    for (i = 0; i + 2 <= n; i += 2) {
+        c += __builtin_popcount(sse2_eq_long(a + i, vx));
+    }
+    return c + scalar_count_long(a + i, n - i, x);
+}
+
+static unsigned sse2_count_double(const double* a, unsigned n, double x) {
+    __m128d vx = _mm_set1_pd(x);
+    unsigned c = 0;
+    unsigned i;
+    for (i = 0; i + 2 <= n; i += 2) {
+        c += __builtin_popcount(_mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(a + i), vx)));
+    }
+    return c + scalar_count_double(a + i, n - i, x);
+}
+
+/* AVX2 实现
+ * AVX2 没有 64 位整数的乘法，整数的点积、缩放与乘法仍然使用标量实现
+ */
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static long long avx2_sum_long(const long long* a, unsigned n) {
+    __m256i s0 = _mm256_setzero_si256(), s1 = _mm256_setzero_si256();
+    unsigned i;
+    for (i = 0; i + 8 <= n; i += 8) {
+        s0 = _mm256_add_epi64(s0, _mm256_loadu_si256((const __m256i*)(a + i)));
+        s1 = _mm256_add_epi64(s1, _mm256_loadu_si256((const __m256i*)(a + i + 4)));
+    }
+    long long r[4];
+    _mm256_storeu_si256((__m256i*)r, _mm256_add_epi64(s0, s1));
+    return (long long)((unsigned long long)r[0] + (unsigned long long)r[1] +
+        (unsigned long long)r[2] + (unsigned long long)r[3] +
+        (unsigned long long)scalar_sum_long(a + i, n - i));
+}
+
+AVX2 static double avx2_sum_double(const double* a, unsigned n) {
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    unsigned i;
+    for (i = 0; i + 8 <= n; i += 8) {
+        s0 = _mm256_add_pd(s0, _mm256_loadu_pd(a + i));
+        s1 = _mm256_add_pd(s1, _mm256_loadu_pd(a + i + 4));
+    }
+    double r[4];
+    _mm256_storeu_pd(r, _mm256_add_pd(s0, s1));
+    return (r[0] + r[1]) + (r[2] + r[3]) + scalar_sum_double(a + i, n - i);
+}
+
+AVX2 static long long avx2_min_long(const long long* a, unsigned n) {
+    if (n < 4) {
+        return scalar_min_long(a, n);
+    }
+    __m256i m = _mm256_loadu_si256((const __m256i*)a);
+    unsigned i;
+    for (i = 4; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(a + i));
+        m = _mm256_blendv_epi8(m, v, _mm256_cmpgt_epi64(m, v));
+    }
+    long long r[4];
+    _mm256_storeu_si256((__m256i*)r, m);
+    long long x = scalar_min_long(r, 4);
+    for (; i < n; i ++) {
+        x = a[i] < x ? a[i] : x;
+    }
+    return x;
+}
+
+AVX2 static long long avx2_max_long(const long long* a, unsigned n) {
+    if (n < 4) {
+        return scalar_max_long(a, n);
+    }
+    __m256i m = _mm256_loadu_si256((const __m256i*)a);
+    unsigned i;
+    for (i = 4; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(a + i));
+        m = _mm256_blendv_epi8(m, v, _mm256_cmpgt_epi64(v, m));
+    }
+    long long r[4];
+    _mm256_storeu_si256((__m256i*)r, m);
+    long long x = scalar_max_long(r, 4);
+    for (; i < n; i ++) {
+        x = a[i] > x ? a[i] : x;
+    }
+    return x;
+}
+
+AVX2 static double avx2_min_double(const double* a, unsigned n) {
+    if (n < 4) {
+        return scalar_min_double(a, n);
+    }
+    __m256d m = _mm256_loadu_pd(a);
+    unsigned i;
+    for (i = 4; i + 4 <= n; i += 4) {
+        m = _mm256_min_pd(_mm256_loadu_pd(a + i), m);
+    }
+    double r[4];
+    _mm256_storeu_pd(r, m);
+    double x = scalar_min_double(r, 4);
+    for (; i < n; i ++) {
+        x = a[i] < x ? a[i] : x;
+    }
+    return x;
+}
+
+AVX2 static double avx2_max_double(const double* a, unsigned n) {
+    if (n < 4) {
+        return scalar_max_double(a, n);
+    }
+    __m256d m = _mm256_loadu_pd(a);
+    unsigned i;
+    for (i = 4; i + 4 <= n; i += 4) {
+        m = _mm256_max_pd(_mm256_loadu_pd(a + i), m);
+    }
+    double r[4];
+    _mm256_storeu_pd(r, m);
+    double x = scalar_max_double(r, 4);
+    for (; i < n; i ++) {
+        x = a[i] > x ? a[i] : x;
+    }
+    return x;
+}
+
+AVX2 static double avx2_dot_double(const double* a, const double* b, unsigned n) {
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    unsigned i;
+    for (i = 0; i + 8 <= n; i += 8) {
+        s0 = _mm256_add_pd(s0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        s1 = _mm256_add_pd(s1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+    }
+    double r[4];
+    _mm256_storeu_pd(r, _mm256_add_pd(s0, s1));
+    return (r[0] + r[1]) + (r[2] + r[3]) + scalar_dot_double(a + i, b + i, n - i);
+}
+
+AVX2 static void avx2_scale_double(double* dst, const double* a, double k, unsigned n) {
+    __m256d vk = _mm256_set1_pd(k);
+    unsigned i;
+    for (i = 0; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), vk));
+    }
+    scalar_scale_double(dst + i, a + i, k, n - i);
+}
+
+AVX2 static void avx2_add_long(long long* dst, const long long* a, const long long* b, unsigned n) {
+    unsigned i;
+    for (i = 0; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_add_epi64(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i)));
+        _mm256_storeu_si256((__m256i*)(dst + i), v);
+    }
+    scalar_add_long(dst + i, a + i, b + i, n - i);
+}
+
+AVX2 static void avx2_add_double(double* dst, const double* a, const double* b, unsigned n) {
+    unsigned i;
+    for (i = 0; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(dst + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+    scalar_add_double(dst + i, a + i, b + i, n - i);
+}
+
+AVX2 static void avx2_mul_double(double* dst, const double* a, const double* b, unsigned n) {
+    unsigned i;
+    for (i = 0; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+    scalar_mul_double(dst + i, a + i, b + i, n - i);
+}
+
+AVX2 static long long avx2_find_long(const long long* a, unsigned n, long long x) {
+    __m256i vx = _mm256_set1_epi64x(x);
+    unsigned i;
+    for (i = 0; i + 4 <= n; i += 4) {
+        __m256i eq = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)(a + i)), vx);
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    long long r = scalar_find_long(a + i, n - i, x);
+    return r < 0 ? r : i + r;
+}
+
+AVX2 static long long avx2_find_double(const double* a, unsigned n, double x) {
+    __m256d vx = _mm256_set1_pd(x);
+    unsigned i;
+    for (i = 0; i + 4 <= n; i += 4) {
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(a + i), vx, _CMP_EQ_OQ));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    long long r = scalar_find_double(a + i, n - i, x);
+    return r < 0 ? r : i + r;
+}
+
+AVX2 static unsigned avx2_count_long(const long long* a, unsigned n, long long x) {
+    __m256i vx = _mm256_set1_epi64x(x);
+    unsigned c = 0;
+    unsigned i;
+    for (i = 0; i + 4 <= n; i += 4) {
+        __m256i eq = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)(a + i)), vx);
+        c += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(eq)));
+    }
+    return c + scalar_count_long(a + i, n - i, x);
+}
+
+AVX2 static unsigned avx2_count_double(const double* a, unsigned n, double x) {
+    __m256d vx = _mm256_set1_pd(x);
+    unsigned c = 0;
+    unsigned i;
+    for (i = 0; i + 4 <= n; i += 4) {
+        c += __builtin_popcount(_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(a + i), vx, _CMP_EQ_OQ)));
+    }
+    return c + scalar_count_double(a + i, n - i, x);
+}
+
+#endif // LGX_KERNEL_X86
+
+lgx_kernel_t lgx_kernel = {
+    LGX_KERNEL_SCALAR,
+    scalar_sum_long, scalar_sum_double,
+    scalar_min_long, scalar_min_double,
+    scalar_max_long, scalar_max_double,
+    scalar_dot_long, scalar_dot_double,
+    scalar_scale_long, scalar_scale_double,
+    scalar_add_long, scalar_add_double,
+    scalar_mul_long, scalar_mul_double,
+    scalar_find_long, scalar_find_double,
+    scalar_count_long, scalar_count_double
+};
+
+void lgx_kernel_init(lgx_kernel_level_t max) {
+#ifdef LGX_KERNEL_X86
+    // __builtin_cpu_supports 通过 CPUID 检测，并且会确认操作系统保存了 AVX 寄存器
+    __builtin_cpu_init();
+
+    if (max >= LGX_KERNEL_SSE2 && __builtin_cpu_supports("sse2")) {
+        lgx_kernel.level = LGX_KERNEL_SSE2;
+        lgx_kernel.sum_long = sse2_sum_long;
+        lgx_kernel.sum_double = sse2_sum_double;
+        lgx_kernel.min_double = sse2_min_double;
+        lgx_kernel.max_double = sse2_max_double;
+        lgx_kernel.dot_double = sse2_dot_double;
+        lgx_kernel.scale_double = sse2_scale_double;
+        lgx_kernel.add_long = sse2_add_long;
+        lgx_kernel.add_double = sse2_add_double;
+        lgx_kernel.mul_double = sse2_mul_double;
+        lgx_kernel.find_long = sse2_find_long;
+        lgx_kernel.find_double = sse2_find_double;
+        lgx_kernel.count_long = sse2_count_long;
+        lgx_kernel.count_double = sse2_count_double;
+    }
+
+    if (max >= LGX_KERNEL_AVX2 && __builtin_cpu_supports("avx2")) {
+        lgx_kernel.level = LGX_KERNEL_AVX2;
+        lgx_kernel.sum_long = avx2_sum_long;
+        lgx_kernel.sum_double = avx2_sum_double;
+        lgx_kernel.min_long = avx2_min_long;
+        lgx_kernel.min_double = avx2_min_double;
+        lgx_kernel.max_long = avx2_max_long;
+        lgx_kernel.max_double = avx2_max_double;
+        lgx_kernel.dot_double = avx2_dot_double;
+        lgx_kernel.scale_double = avx2_scale_double;
+        lgx_kernel.add_long = avx2_add_long;
+        lgx_kernel.add_double = avx2_add_double;
+        lgx_kernel.mul_double = avx2_mul_double;
+        lgx_kernel.find_long = avx2_find_long;
+        lgx_kernel.find_double = avx2_find_double;
+        lgx_kernel.count_long = avx2_count_long;
+        lgx_kernel.count_double = avx2_count_double;
+    }
+#endif
+}
+
+/* 排序
+ * 元素较少时使用插入排序，否则把元素转换为可以按无符号整数比较的键，再按字节进行基数排序
+ */
+
+// 元素个数不超过该值时使用插入排序
+#define SORT_INSERTION_LIMIT 64
+
+// 有符号整数翻转符号位后，按无符号整数比较的结果与原来相同
+static lgx_inline unsigned long long sort_key_long(long long x) {
+    return (unsigned long long)x ^ (1ULL << 63);
+}
+
+static lgx_inline long long sort_value_long(unsigned long long k) {
+    return (long long)(k ^ (1ULL << 63));
+}
+
+// 负数翻转所有位，正数只翻转符号位
+static lgx_inline unsigned long long sort_key_double(double x) {
+    unsigned long long k;
+    memcpy(&k, &x, sizeof(k));
+    return (k >> 63) ? ~k : k | (1ULL << 63);
+}
+
+static lgx_inline double sort_value_double(unsigned long long k) {
+    k = (k >> 63) ? k & ~(1ULL << 63) : ~k;
+    double x;
+    memcpy(&x, &k, sizeof(x));
+    return x;
+}
+
+static void sort_insertion(unsigned long long* a, unsigned n) {
+    unsigned i;
+    for (i = 1; i < n; i ++) {
+        unsigned long long k = a[i];
+        unsigned j = i;
+        while (j > 0 && a[j - 1] > k) {
+            a[j] = a[j - 1];
+            j --;
+        }
+        a[j] = k;
+    }
+}
+
+// 所有元素在某个字节上都相同时跳过这一轮
+static int sort_radix(unsigned long long* a, unsigned n) {
+    if (n <= SORT_INSERTION_LIMIT) {
+        sort_insertion(a, n);
+        return 0;
+    }
+
+    unsigned long long* tmp = (unsigned long long*)xmalloc(n * sizeof(unsigned long long));
+    if (UNEXPECTED(!tmp)) {
+        return 1;
+    }
+
+    unsigned (*count)[256] = (unsigned (*)[256])xcalloc(8, sizeof(*count));
+    if (UNEXPECTED(!count)) {
+        xfree(tmp);
+        return 1;
+    }
+
+    unsigned i, b;
+    for (i = 0; i < n; i ++) {
+        for (b = 0; b < 8; b ++) {
+            count[b][(a[i] >> (b * 8)) & 0xff] ++;
+        }
+    }
+
+    unsigned long long* src = a;
+    unsigned long long* dst = tmp;
+    for (b = 0; b < 8; b ++) {
+        unsigned shift = b * 8;
+        if (count[b][(src[0] >> shift) & 0xff] == n) {
+            continue;
+        }
+
+        unsigned offset = 0;
+        for (i = 0; i < 256; i ++) {
+            unsigned c = count[b][i];
+            count[b][i] = offset;
+            offset += c;
+        }
+
+        for (i = 0; i < n; i ++) {
+            dst[count[b][(src[i] >> shift) & 0xff] ++] = src[i];
+        }
+
+        unsigned long long* t = src;
+        src = dst;
+        dst = t;
+    }
+
+    if (src != a) {
+        memcpy(a, src, n * sizeof(unsigned long long));
+    }
+
+    xfree(count);
+    xfree(tmp);
+
+    return 0;
+}
+
+// 键与元素的大小相同，直接在原数组上转换
+int lgx_kernel_sort_long(long long* a, unsigned n) {
+    unsigned long long* k = (unsigned long long*)a;
+    unsigned i;
+    for (i = 0; i < n; i ++) {
+        k[i] = sort_key_long(a[i]);
+    }
+    int ret = sort_radix(k, n);
+    for (i = 0; i < n; i ++) {
+        a[i] = sort_value_long(k[i]);
+    }
+    return ret;
+}
+
+int lgx_kernel_sort_double(double* a, unsigned n) {
+    unsigned long long* k = (unsigned long long*)a;
+    unsigned i;
+    for (i = 0; i < n; i ++) {
+        k[i] = sort_key_double(a[i]);
+    }
+    int ret = sort_radix(k, n);
+    for (i = 0; i < n; i ++) {
+        a[i] = sort_value_double(k[i]);
+    }
+    return ret;
+}
@@ -0,0 +1,54 @@
+#ifndef LGX_KERNEL_H
+#define LGX_KERNEL_H
+
+// 数值数组的批量运算内核
+// 启动时根据 CPUID 选择 AVX2、SSE2 或者标量实现。整数运算在各个实现之间的结果完全相同；
+// 浮点数的求和与点积使用多路累加，累加顺序不同，结果可能存在舍入误差
+
+typedef enum {
+    LGX_KERNEL_SCALAR = 0,
+    LGX_KERNEL_SSE2,
+    LGX_KERNEL_AVX2
+} lgx_kernel_level_t;
+
+typedef struct {
+    lgx_kernel_level_t level;
+
+    // 整数运算按照补码回绕，不会因为溢出而出错
+    long long (*sum_long)(const long long* a, unsigned n);
+    double (*sum_double)(const double* a, unsigned n);
+
+    // n 必须大于 0
+    long long (*min_long)(const long long* a, unsigned n);
+    double (*min_double)(const double* a, unsigned n);
+    long long (*max_long)(const long long* a, unsigned n);
+    double (*max_double)(const double* a, unsigned n);
+
+    long long (*dot_long)(const long long* a, const long long* b, unsigned n);
+    double (*dot_double)(const double* a, const double* b, unsigned n);
+
+    // dst 可以与 a 或 b 相同
+    void (*scale_long)(long long* dst, const long long* a, long long k, unsigned n);
+    void (*scale_double)(double* dst, const double* a, double k, unsigned n);
+    void (*add_long)(long long* dst, const long long* a, const long long* b, unsigned n);
+    void (*add_double)(double* dst, const double* a, const double* b, unsigned n);
+    void (*mul_long)(long long* dst, const long long* a, const long long* b, unsigned n);
+    void (*mul_double)(double* dst, const double* a, const double* b, unsigned n);
+
+    // 返回第一个等于 x 的元素的下标，不存在时返回 -1
+    long long (*find_long)(const long long* a, unsigned n, long long x);
+    long long (*find_double)(const double* a, unsigned n, double x);
+    unsigned (*count_long)(const long long* a, unsigned n, long long x);
+    unsigned (*count_double)(const double* a, unsigned n, double x);
+} lgx_kernel_t;
+
+extern lgx_kernel_t lgx_kernel;
+
+// 根据 CPU 支持的指令集选择内核，最多使用到 max 级别
+void lgx_kernel_init(lgx_kernel_level_t max);
+
+// 原地升序排序，成功返回 0，内存不足时返回 1
+int lgx_kernel_sort_long(long long* a, unsigned n);
+int lgx_kernel_sort_double(double* a, unsigned n);
+
+#endif // LGX_KERNEL_H
@@ -15,11 +15,14 @@ int lgx_source_init(lgx_source_t* source, char *path) {
         goto error;
     }
 
-    source->path = strdup(path);
+    // 路径会通过 xfree 释放，不能使用 strdup
+    size_t len = strlen(path) + 1;
+    source->path = (char*)xmalloc(len);
     if (!source->path) {
         err_no = 2;
         goto error;
     }
+    memcpy(source->path, path, len);
 
     // 定位到文件末尾
     if (fseek(fp, 0L, SEEK_END) != 0) {
@@ -1,11 +1,19 @@
-/*
+#include <chrono>
+
+extern "C" {
 #include "./tokenizer/lex.h"
 #include "./parser/ast.h"
+#include "./parser/symbol.h"
 #include "./compiler/compiler.h"
 #include "./compiler/bytecode.h"
 #include "./compiler/constant.h"
+#include "./optimizer/optimizer.h"
 #include "./interpreter/vm.h"
-*/
+#include "./interpreter/gc.h"
+#include "./jit/jit.h"
+#include "./common/hash.h"
+#include "./runtime/kernel.h"
+}
 
 #include "xscript.hpp"
 #include "framework/command.hpp"
@@ -15,68 +23,129 @@ using xscript::tokenizer::scanner;
 using xscript::parser::syntax;
 using xscript::parser::ast;
 
-int main(int argc, char* argv[]) {
-
-    command::instance().init(argc, argv);
+// 使用字节码解释器执行源文件
+static int execute(std::string path) {
+    int ret = 0;
 
-    /*
-    lgx_token_init();
+    auto compile_start = std::chrono::steady_clock::now();
 
     lgx_ast_t ast;
-    int ast_ok = lgx_ast_init(&ast, argv[1]);
-    lgx_ast_print(&ast);
-    lgx_ast_print_error(&ast);
+    if (lgx_ast_init(&ast, (char*)path.c_str()) != 0) {
+        lgx_ast_print_error(&ast);
+        lgx_ast_cleanup(&ast);
+        return 1;
+    }
 
-    if (ast_ok == 0) {
-        lgx_compiler_t c;
-        lgx_compiler_init(&c);
-        int c_ok = lgx_compiler_generate(&c, &ast);
+    auto parse_end = std::chrono::steady_clock::now();
 
-        lgx_bc_print(c.bc.buffer, c.bc.length);
+    lgx_compiler_t c;
+    lgx_compiler_init(&c);
+
+    int level = command::instance().get_optimize_level();
+
+    if (lgx_compiler_generate(&c, &ast) != 0) {
         lgx_ast_print_error(&ast);
-        lgx_const_print(&c.constant);
-        printf("\n\n");
-
-        if (c_ok == 0) {
-            lgx_vm_t vm;
-            lgx_vm_init(&vm, &c);
-
-            // 寻找 main 函数
-            lgx_str_t mainfunc = lgx_str("main");
-            lgx_symbol_t* symbol = lgx_symbol_get(ast.root, &mainfunc, -1);
-
-            if (symbol) {
-                lgx_function_t* fun  = symbol->v.v.fun;
-                lgx_vm_call(&vm, fun);
-            } else {
-                // TODO
-                // can't find main func
-            }
+        ret = 1;
+    } else if (lgx_optimizer_run(&c, level) != 0) {
+        fprintf(stderr, "%s: optimizer failed\n", path.c_str());
+        ret = 1;
+    } else {
+        auto compile_end = std::chrono::steady_clock::now();
+
+        if (command::instance().is_stat()) {
+            double parse_us = std::chrono::duration<double, std::micro>(parse_end - compile_start).count();
+            double us = std::chrono::duration<double, std::micro>(compile_end - parse_end).count();
+            fprintf(stderr, "[stat] %s: parsed in %.3f ms, compiled in %.3f ms (-O%d), %u instructions\n",
+                path.c_str(), parse_us / 1000, us / 1000, level, c.bc.length);
+        }
 
-            lgx_vm_cleanup(&vm);
+        lgx_vm_t vm;
+        lgx_vm_init(&vm, &c);
+        vm.heap.pause = command::instance().get_gc_pause();
+#ifdef LGX_JIT
+        // -j 0 同时关闭 trace
+        vm.jit.threshold = command::instance().get_jit_threshold();
+        vm.jit.trace_threshold = vm.jit.threshold ? command::instance().get_trace_threshold() : 0;
+#endif
+
+        // 寻找 main 函数
+        lgx_str_t mainfunc;
+        lgx_str_set(mainfunc, "main");
+        lgx_symbol_t* symbol = lgx_symbol_get(ast.root, &mainfunc, -1);
+
+        if (symbol) {
+            auto start = std::chrono::steady_clock::now();
+
+            ret = lgx_vm_call(&vm, lgx_value_fun(&symbol->v));
+
+            auto end = std::chrono::steady_clock::now();
+
+            if (command::instance().is_stat()) {
+                double us = std::chrono::duration<double, std::micro>(end - start).count();
+                fprintf(stderr, "[stat] %s: %llu instructions, %.3f ms, %.2f MIPS, %u functions jitted, %u traces\n",
+                    path.c_str(), vm.instructions, us / 1000, us > 0 ? vm.instructions / us : 0, vm.jit.compiled, vm.jit.traces);
+                fprintf(stderr, "[stat] %s: %u minor gc, %u full gc, max gc pause %.3f ms (max root scan %.3f ms)\n",
+                    path.c_str(), vm.heap.minor_count, vm.heap.full_count, vm.heap.max_pause / 1000.0, vm.heap.max_scan / 1000.0);
+#ifndef LGX_SYSTEM_MALLOC
+                // 等待后台线程释放积压的对象，统计才不包含已经不再使用的内存
+                lgx_gc_stop(&vm);
+                lgx_mem_stat_t mem;
+                lgx_mem_stat(&mem);
+                size_t busy = mem.pages - mem.empty_pages;
+                fprintf(stderr, "[stat] %s: %zu pages (%zu peak, %zu empty), %zu blocks filling %.1f%% of used pages, %zu large blocks\n",
+                    path.c_str(), mem.pages, mem.peak_pages, mem.empty_pages, mem.blocks,
+                    busy ? 100.0 * mem.used / (busy * LGX_MEM_PAGE_SIZE) : 0.0, mem.large);
+#endif
+            }
+        } else {
+            fprintf(stderr, "%s: can't find function `main`\n", path.c_str());
+            ret = 1;
         }
 
-        lgx_compiler_cleanup(&c);
+        lgx_vm_cleanup(&vm);
     }
 
+    lgx_compiler_cleanup(&c);
     lgx_ast_cleanup(&ast);
 
-    lgx_token_cleanup();
-    */
+    return ret;
+}
+
+int main(int argc, char* argv[]) {
+
+    lgx_hash_init();
+    lgx_kernel_init(LGX_KERNEL_AVX2);
+
+    command::instance().init(argc, argv);
 
     int ret = 0;
     syntax s;
-    
+
     if (command::instance().get_source_files().size() == 0) {
         // TODO 交互式终端模式
     }
 
-    // 
+    if (command::instance().is_run()) {
+        lgx_token_init();
+
+        for (auto source : command::instance().get_source_files()) {
+            if (execute(source) != 0) {
+                ret = 1;
+            }
+        }
+
+        lgx_token_cleanup();
+        lgx_string_intern_cleanup();
+
+        return ret;
+    }
+
+    //
     for (auto source : command::instance().get_source_files()) {
         if (!s.load(source)) {
             ret = 1;
         }
     }
-    
+
     return ret;
-}
\ No newline at end of file
+}
@@ -0,0 +1,99 @@
+// INT64: 用例中的常量超出 NaN-boxing 时整数的范围
+
+/* EXPECT
+-9223372036854775808
+-9223372036854775808
+-9223372036854775808
+-9223372036854775808
+-9223372036854775808
+9223372036854775807
+-4611686018427387904
+-3
+-3
+3
+-1
+-3
+"ok"
+"division by zero
+"
+"division by zero
+"
+"division by zero
+"
+*/
+
+package main;
+
+// 整数除法的边界：INT64_MIN / -1 按补码回绕，结果仍为 INT64_MIN
+// 解释器、JIT、trace 与编译期常量折叠的结果必须一致
+func idiv(var a int, var b int) int {
+    return a / b;
+}
+
+func main() {
+    var min = -9223372036854775807 - 1;
+    var max = 9223372036854775807;
+
+    // 类型确定的整数除法
+    echo(idiv(min, -1));
+
+    // 通用除法指令
+    var arr = [min, -1, 0, 2, -7];
+    var zero = [0.0];
+    echo(arr[0] / arr[1]);
+
+    // 编译期常量折叠
+    echo((-9223372036854775807 - 1) / -1);
+
+    // 常量传播后折叠
+    var m = min;
+    var n = -1;
+    echo(m / n);
+
+    // 立即数除数
+    echo(min / 1);
+    echo(max / 1);
+    echo(min / 2);
+
+    // 向 0 取整
+    echo(idiv(-7, 2));
+    echo(idiv(7, -2));
+    echo(idiv(-7, -2));
+    echo(min / max);
+    echo(arr[4] / arr[3]);
+
+    // 循环中的除法会被 trace 编译
+    var i int;
+    var ok = true;
+    var d = -1;
+    for (i = 0; i < 200; i = i + 1) {
+        if (min / d != min || arr[0] / arr[1] != min) {
+            ok = false;
+        }
+    }
+    for (i = 0; i < 200; i = i + 1) {
+        if (idiv(min, n) != min) {
+            ok = false;
+        }
+    }
+    if (ok) {
+        echo("ok");
+    }
+
+    // 除数为 0 时抛出可以捕获的异常
+    try {
+        echo(idiv(1, 0));
+    } catch (var e string) {
+        echo(e);
+    }
+    try {
+        echo(arr[0] / arr[2]);
+    } catch (var e string) {
+        echo(e);
+    }
+    try {
+        echo(1.0 / zero[0]);
+    } catch (var e string) {
+        echo(e);
+    }
+}
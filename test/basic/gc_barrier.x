@@ -0,0 +1,71 @@
+// NOPARSE: 语法分析器尚未支持 []T 类型声明
+
+/* EXPECT
+72024
+*/
+
+package main;
+
+// Full GC 分多次执行期间，容器中的字符串先被读入寄存器，再从容器中移除。
+// 寄存器不在快照中，写屏障必须保证这些字符串在本轮 Full GC 中存活
+
+func valid_key(d int) string {
+    return "ab";
+}
+
+// 递归中的每一层都持有对象，使老年代不断增长并触发 Full GC
+func rec(d int, var base []int, var box []string, var m [int]string, var valid [string]int) int {
+    var k = d - d / 1024 * 1024;
+    var s = valid_key(d) + "c";
+    var a = scale_int(base, d);
+
+    // 取出上一轮放入的字符串，并用新的字符串覆盖
+    var t = box[k];
+    box[k] = s;
+    var u = m[k];
+    map_del(m, k);
+    m[k] = s;
+
+    var n = 0;
+    if (d > 0) {
+        n = rec(d - 1, base, box, m, valid) + a[0] - d;
+    }
+    if (map_has(valid, t) && map_has(valid, u)) {
+        n = n + 1;
+    }
+    return n;
+}
+
+func main() {
+    var box []string = [];
+    var m [int]string = [];
+    var i int;
+    for (i = 0; i < 1024; i = i + 1) {
+        box[] = "";
+        m[i] = "";
+    }
+    var valid [string]int = [];
+    valid[""] = 1;
+    valid["abc"] = 1;
+
+    var base []int = [];
+    for (i = 0; i < 256; i = i + 1) {
+        base[] = 1;
+    }
+
+    var n = 0;
+    var j int;
+    for (i = 0; i < 24; i = i + 1) {
+        // 每一轮使用新的容器，使它在老年代中位于较后的位置，标记时较晚被扫描
+        var nb []string = [];
+        var nm [int]string = [];
+        for (j = 0; j < 1024; j = j + 1) {
+            nb[] = box[j];
+            nm[j] = m[j];
+        }
+        box = nb;
+        m = nm;
+        n = n + rec(3000, base, box, m, valid);
+    }
+    echo(n);
+}
@@ -0,0 +1,26 @@
+// NOPARSE: 语法分析器尚未支持 []T 类型声明
+
+/* EXPECT
+15000550000
+*/
+
+package main;
+
+// GC 只扫描有效的栈帧与参数区。循环中反复触发 Minor GC，
+// 已经写入参数区、但寄存器已经被复用的参数，以及内建函数的参数都必须存活
+
+func f(var a []int, var s string, var b []int) int {
+    var t = [1, 2, 3, 4, 5, 6, 7, 8];
+    return a[0] + b[1] + t[2];
+}
+
+func main() {
+    var i int;
+    var sum = 0;
+    for (i = 0; i < 100000; i = i + 1) {
+        sum = sum + f([i, 1], "abc" + "d", [3, 4, 5]);
+        var x = scale_int([i, i, i, i], 2);
+        sum = sum + x[3];
+    }
+    echo(sum);
+}
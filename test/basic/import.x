@@ -1,3 +1,5 @@
+// NORUN: 字节码编译器尚未支持 import
+
 package main;
 
 import std.io;
@@ -0,0 +1,238 @@
+// NOPARSE: 语法分析器尚未支持 []T 类型声明
+
+/* EXPECT
+"ok"
+"ok"
+"min_int() of empty array"
+"max_float() of empty array"
+*/
+
+package main;
+
+var seed = 12345;
+
+// 生成可重复的伪随机数，包含负数
+func rand() int {
+    seed = seed * 75;
+    seed = seed - seed / 65537 * 65537;
+    return seed * 61 - 2000000;
+}
+
+// 语言没有 int 到 float 的转换，按二进制位累加
+func float_of(var v int) float {
+    var f = 0.0;
+    var p = 1.0;
+    var neg = v < 0;
+    if (neg) {
+        v = -v;
+    }
+    while (v > 0) {
+        if (v - v / 2 * 2 == 1) {
+            f = f + p;
+        }
+        p = p * 2.0;
+        v = v / 2;
+    }
+    if (neg) {
+        f = -f;
+    }
+    return f;
+}
+
+// 用脚本逐个元素计算的结果与内建函数比较
+// 覆盖空数组以及不是向量宽度整数倍的长度
+func check_int(var n int) bool {
+    var a []int = [];
+    var b []int = [];
+    var i int;
+    for (i = 0; i < n; i = i + 1) {
+        a[i] = rand();
+        b[i] = rand() >> 12;
+    }
+    var key = 7;
+    if (n > 2) {
+        key = a[1];
+        b[n - 1] = key;
+    }
+
+    var sum = 0;
+    var dot = 0;
+    var count = 0;
+    var find = -1;
+    for (i = 0; i < n; i = i + 1) {
+        sum = sum + a[i];
+        dot = dot + a[i] * b[i];
+        if (b[i] == key) {
+            count = count + 1;
+            if (find < 0) {
+                find = i;
+            }
+        }
+    }
+    if (sum_int(a) != sum || dot_int(a, b) != dot) {
+        return false;
+    }
+    if (count_int(b, key) != count || find_int(b, key) != find) {
+        return false;
+    }
+
+    var min = 0;
+    var max = 0;
+    if (n > 0) {
+        min = a[0];
+        max = a[0];
+        for (i = 1; i < n; i = i + 1) {
+            if (a[i] < min) {
+                min = a[i];
+            }
+            if (a[i] > max) {
+                max = a[i];
+            }
+        }
+        if (min_int(a) != min || max_int(a) != max) {
+            return false;
+        }
+    }
+
+    var s = scale_int(a, -3);
+    var add = add_int(a, b);
+    var mul = mul_int(a, b);
+    var sorted = sort_int(a);
+    for (i = 0; i < n; i = i + 1) {
+        if (s[i] != a[i] * -3 || add[i] != a[i] + b[i] || mul[i] != a[i] * b[i]) {
+            return false;
+        }
+        if (i > 0 && sorted[i - 1] > sorted[i]) {
+            return false;
+        }
+    }
+    if (n > 0 && (sorted[0] != min || sorted[n - 1] != max || sum_int(sorted) != sum)) {
+        return false;
+    }
+
+    return true;
+}
+
+func check_float(var n int) bool {
+    var a []float = [];
+    var b []float = [];
+    var i int;
+    for (i = 0; i < n; i = i + 1) {
+        // 乘以 2 的幂，保证求和与点积的结果与累加顺序无关
+        a[i] = float_of(rand() >> 10);
+        b[i] = 0.25 * float_of(rand() >> 16);
+    }
+    var key = 0.5;
+    if (n > 2) {
+        key = a[1];
+        b[n - 1] = key;
+    }
+
+    var sum = 0.0;
+    var dot = 0.0;
+    var count = 0;
+    var find = -1;
+    for (i = 0; i < n; i = i + 1) {
+        sum = sum + a[i];
+        dot = dot + a[i] * b[i];
+        if (b[i] == key) {
+            count = count + 1;
+            if (find < 0) {
+                find = i;
+            }
+        }
+    }
+    if (sum_float(a) != sum || dot_float(a, b) != dot) {
+        return false;
+    }
+    if (count_float(b, key) != count || find_float(b, key) != find) {
+        return false;
+    }
+
+    var min = 0.0;
+    var max = 0.0;
+    if (n > 0) {
+        min = a[0];
+        max = a[0];
+        for (i = 1; i < n; i = i + 1) {
+            if (a[i] < min) {
+                min = a[i];
+            }
+            if (a[i] > max) {
+                max = a[i];
+            }
+        }
+        if (min_float(a) != min || max_float(a) != max) {
+            return false;
+        }
+    }
+
+    var s = scale_float(a, -0.5);
+    var add = add_float(a, b);
+    var mul = mul_float(a, b);
+    var sorted = sort_float(a);
+    for (i = 0; i < n; i = i + 1) {
+        if (s[i] != a[i] * -0.5 || add[i] != a[i] + b[i] || mul[i] != a[i] * b[i]) {
+            return false;
+        }
+        if (i > 0 && sorted[i - 1] > sorted[i]) {
+            return false;
+        }
+    }
+    if (n > 0 && (sorted[0] != min || sorted[n - 1] != max || sum_float(sorted) != sum)) {
+        return false;
+    }
+
+    return true;
+}
+
+func main() {
+    var n int;
+    var ok = true;
+    for (n = 0; n <= 40; n = n + 1) {
+        if (!check_int(n)) {
+            echo(n);
+            ok = false;
+        }
+    }
+    for (n = 67; n <= 69; n = n + 1) {
+        if (!check_int(n)) {
+            echo(n);
+            ok = false;
+        }
+    }
+    if (ok) {
+        echo("ok");
+    }
+
+    ok = true;
+    for (n = 0; n <= 40; n = n + 1) {
+        if (!check_float(n)) {
+            echo(n);
+            ok = false;
+        }
+    }
+    for (n = 67; n <= 69; n = n + 1) {
+        if (!check_float(n)) {
+            echo(n);
+            ok = false;
+        }
+    }
+    if (ok) {
+        echo("ok");
+    }
+
+    var empty []int = [];
+    try {
+        echo(min_int(empty));
+    } catch (var e string) {
+        echo(e);
+    }
+
+    var fempty []float = [];
+    try {
+        echo(max_float(fempty));
+    } catch (var e string) {
+        echo(e);
+    }
+}
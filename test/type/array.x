@@ -1,3 +1,5 @@
+// NORUN: 字节码编译器尚未支持 array<T> 类型声明
+
 
 package main;
 
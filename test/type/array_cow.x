@@ -0,0 +1,104 @@
+// NOPARSE: 语法分析器尚未支持 []T 类型声明
+
+/* EXPECT
+11
+3
+1
+99
+5
+1
+7
+1
+8
+2
+1
+2
+3
+0
+"ok"
+*/
+
+package main;
+
+// 数组的复制共享存储（写时复制），嵌套的数组与 map 也必须保持值语义：
+// 通过 a[i][j] = v 修改其中一方，另一方不受影响
+
+func main() {
+    // 嵌套数组
+    var outer = [[1, 2], [3, 4]];
+    var nested [][][]int = [];
+    nested[] = outer;
+    outer[1][0] = 11;
+    echo(outer[1][0]);
+    echo(nested[0][1][0]);
+    nested[0][0][0] = 99;
+    echo(outer[0][0]);
+    echo(nested[0][0][0]);
+
+    // 字符串下标
+    var t [][]int = [];
+    t["k"] = [1, 2];
+    var u [][][]int = [];
+    u[] = t;
+    t["k"][0] = 5;
+    echo(t["k"][0]);
+    echo(u[0]["k"][0]);
+
+    // 数组中的 map
+    var m [string]int = [];
+    m["a"] = 1;
+    var ms [][string]int = [];
+    ms[] = m;
+    var mc [][][string]int = [];
+    mc[] = ms;
+    ms[0]["a"] = 7;
+    echo(ms[0]["a"]);
+    echo(mc[0][0]["a"]);
+
+    // map 中的数组
+    var am [string][]int = [];
+    am["a"] = [1, 2];
+    var amc [][string][]int = [];
+    amc[] = am;
+    am["a"][1] = 8;
+    echo(am["a"][1]);
+    echo(amc[0]["a"][1]);
+
+    // 多个数组共享同一个存储，逐个修改
+    var deep [][][]int = [];
+    deep[] = [[0]];
+    var c1 [][][][]int = [];
+    var c2 [][][][]int = [];
+    var c3 [][][][]int = [];
+    c1[] = deep;
+    c2[] = deep;
+    c3[] = deep;
+    c1[0][0][0][0] = 1;
+    c2[0][0][0][0] = 2;
+    c3[0][0][0][0] = 3;
+    echo(c1[0][0][0][0]);
+    echo(c2[0][0][0][0]);
+    echo(c3[0][0][0][0]);
+    echo(deep[0][0][0]);
+
+    // 循环中的嵌套写入（会被 JIT 编译）
+    var grid [][]int = [];
+    var i int;
+    for (i = 0; i < 8; i = i + 1) {
+        grid[] = [0, 0];
+    }
+    var copy [][][]int = [];
+    copy[] = grid;
+    for (i = 0; i < 200; i = i + 1) {
+        grid[i / 25][1] = i;
+    }
+    var ok = true;
+    for (i = 0; i < 8; i = i + 1) {
+        if (copy[0][i][1] != 0 || grid[i][1] != i * 25 + 24) {
+            ok = false;
+        }
+    }
+    if (ok) {
+        echo("ok");
+    }
+}
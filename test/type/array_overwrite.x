@@ -0,0 +1,95 @@
+// NOPARSE: 语法分析器尚未支持 [K]V 类型声明
+
+/* EXPECT
+[1,2,]
+1
+[5,]
+[7,8,]
+"xyz"
+"xyw"
+3
+"ok"
+*/
+
+package main;
+
+// 读取容器中的元素只复制指针，覆盖或删除该元素后，寄存器中的值必须仍然有效
+
+func make_str(i int) string {
+    return "xy";
+}
+
+// 分配足够多的对象，触发多次 GC
+func churn() int {
+    var i int;
+    var junk []int = [];
+    for (i = 0; i < 300000; i = i + 1) {
+        junk = [i, i, i, i];
+    }
+    return 0;
+}
+
+func main() {
+    var b = [[1, 2], [3]];
+    var v = b[0];
+    b[0] = [9];
+    echo(v);
+
+    // 字符串下标
+    var s [][]int = [];
+    s["k"] = [1];
+    var w = s["k"];
+    s["k"] = [2];
+    echo(w[0]);
+
+    // map 中的元素被覆盖或删除
+    var m [int][]int = [];
+    m[1] = [5];
+    m[2] = [7, 8];
+    var x = m[1];
+    var y = m[2];
+    m[1] = [6];
+    map_del(m, 2);
+    echo(x);
+    echo(y);
+
+    // 只被容器持有的字符串
+    var t []string = [];
+    t[] = make_str(0) + "z";
+    var u = t[0];
+    t[0] = "";
+    echo(u);
+
+    // 共享存储的其它数组释放之后，存储只属于该数组
+    var st []string = [];
+    st[] = make_str(0) + "w";
+    var sc [][]string = [];
+    sc[] = st;
+    sc[0] = [];
+    churn();
+    var r = st[0];
+    st[0] = "";
+    churn();
+    echo(r);
+
+    // 持有期间多次触发 GC
+    var keep = b[1];
+    b[1] = [0];
+    churn();
+    echo(keep[0]);
+
+    // 循环中反复覆盖（会被 JIT 编译）
+    var grid [][]int = [[0]];
+    var ok = true;
+    var i int;
+    for (i = 0; i < 1000; i = i + 1) {
+        var cur = grid[0];
+        grid[0] = [i + 1];
+        if (cur[0] != i) {
+            ok = false;
+        }
+    }
+    if (ok) {
+        echo("ok");
+    }
+}
@@ -1,3 +1,5 @@
+// PENDING: 尚未支持匿名函数
+
 package main;
 
 func add(var x int, var y int) int {
@@ -0,0 +1,152 @@
+/* EXPECT
+70368744177663
+-70368744177664
+-70368744177664
+35184372088832
+70368744177662
+"ok"
+"ok"
+"ok"
+"ok"
+"ok"
+"ok"
+"ok"
+"ok"
+*/
+
+package main;
+
+// 整数的边界：默认表示下整数为 64 位；NaN-boxing 时 T_LONG 的范围为 [-2^46, 2^46)，
+// 超出范围的结果抛出异常。两种构建的结果要么一致，要么抛出异常，不会被截断
+
+func add(var a int, var b int) int {
+    return a + b;
+}
+
+func sub(var a int, var b int) int {
+    return a - b;
+}
+
+func mul(var a int, var b int) int {
+    return a * b;
+}
+
+func neg(var a int) int {
+    return -a;
+}
+
+func shl(var a int, var b int) int {
+    return a << b;
+}
+
+// 越过边界的运算：64 位时结果为 expect，否则必须抛出异常
+func check(var wide bool, var r int, var expect int) bool {
+    return wide && r == expect;
+}
+
+func main() {
+    var max = 70368744177663;
+    var min = -70368744177664;
+
+    // 边界上的值保持不变
+    echo(max);
+    echo(min);
+    echo(neg(max) - 1);
+    echo(shl(1, 45));
+    echo(add(max, -1));
+
+    // 通过运行时的结果判断整数的宽度
+    var wide = true;
+    try {
+        shl(1, 46);
+    } catch (var e string) {
+        wide = false;
+    }
+
+    var ok = true;
+    try {
+        ok = check(wide, add(max, 1), shl(1, 23) * shl(1, 23));
+    } catch (var e string) {
+        ok = !wide;
+    }
+    if (ok) {
+        echo("ok");
+    }
+
+    try {
+        ok = check(wide, sub(min, 1), neg(max) - 2);
+    } catch (var e string) {
+        ok = !wide;
+    }
+    if (ok) {
+        echo("ok");
+    }
+
+    try {
+        ok = check(wide, mul(max, 2), shl(1, 23) * shl(1, 24) - 2);
+    } catch (var e string) {
+        ok = !wide;
+    }
+    if (ok) {
+        echo("ok");
+    }
+
+    try {
+        ok = check(wide, neg(min), add(max, 1));
+    } catch (var e string) {
+        ok = !wide;
+    }
+    if (ok) {
+        echo("ok");
+    }
+
+    // 类型不确定的运算
+    var arr = [max, min, 1];
+    try {
+        ok = check(wide, arr[0] + arr[2], add(max, 1));
+    } catch (var e string) {
+        ok = !wide;
+    }
+    if (ok) {
+        echo("ok");
+    }
+
+    // 循环变量越过边界
+    var i int;
+    var n = 0;
+    try {
+        for (i = max - 3; i != min; i = i + 1) {
+            n = n + 1;
+            if (n > 5) {
+                break;
+            }
+        }
+        ok = wide && n == 6;
+    } catch (var e string) {
+        ok = !wide && n == 4;
+    }
+    if (ok) {
+        echo("ok");
+    }
+
+    // 内建函数的结果
+    var a = [max, 1];
+    try {
+        ok = check(wide, sum_int(a), add(max, 1));
+    } catch (var e string) {
+        ok = !wide;
+    }
+    if (ok) {
+        echo("ok");
+    }
+
+    try {
+        var s = scale_int(a, 2);
+        ok = check(wide, s[0], mul(max, 2));
+    } catch (var e string) {
+        ok = !wide;
+    }
+    if (ok) {
+        echo("ok");
+    }
+}
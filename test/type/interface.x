@@ -1,3 +1,5 @@
+// PENDING: 尚未支持 interface
+
 package main;
 
 type A interface {
@@ -1,12 +1,25 @@
+// NOPARSE: 语法分析器尚未支持 [K]V 类型声明
+
+/* EXPECT
+[3:"1",]
+["123":"456",]
+"1"
+"456"
+1
+*/
+
 package main;
 
 func main() {
     var a [int]string = [];
     var b [string]string = [];
 
-    a[3] = 1;
+    a[3] = "1";
     b["123"] = "456";
 
     echo(a);
     echo(b);
-}
\ No newline at end of file
+    echo(a[3]);
+    echo(b["123"]);
+    echo(map_len(a));
+}
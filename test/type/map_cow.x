@@ -0,0 +1,80 @@
+// NOPARSE: 语法分析器尚未支持 [K]V 类型声明
+
+/* EXPECT
+2
+1
+1
+3
+5
+1
+2
+0
+1
+1
+"ok"
+*/
+
+package main;
+
+// map 的复制共享存储（写时复制）：修改、删除或排序其中一方，另一方不受影响
+
+func main() {
+    // 修改与新增
+    var m [string]int = [];
+    m["a"] = 1;
+    var c [][string]int = [];
+    c[] = m;
+    m["a"] = 2;
+    m["b"] = 3;
+    echo(m["a"]);
+    echo(c[0]["a"]);
+    echo(map_len(c[0]));
+    echo(m["b"]);
+
+    // 删除
+    var d [int]int = [];
+    d[1] = 5;
+    d[2] = 6;
+    var dc [][int]int = [];
+    dc[] = d;
+    map_del(d, 2);
+    echo(d[1]);
+    echo(map_len(d));
+    echo(map_len(dc[0]));
+
+    // map 中嵌套的数组
+    var am [string][]int = [];
+    am["x"] = [0];
+    var amc [][string][]int = [];
+    amc[] = am;
+    am["x"][0] = 1;
+    echo(amc[0]["x"][0]);
+    echo(am["x"][0]);
+
+    // 排序后范围查询，共享的一方仍然保持原来的内容
+    var o [int]int = [];
+    o[3] = 3;
+    o[1] = 1;
+    var oc [][int]int = [];
+    oc[] = o;
+    echo(map_min(o));
+
+    // 循环中复制与修改（会被 JIT 编译）
+    var base [string]int = [];
+    base["k"] = 0;
+    var copies [][string]int = [];
+    var i int;
+    for (i = 0; i < 200; i = i + 1) {
+        copies[] = base;
+        base["k"] = i + 1;
+    }
+    var ok = true;
+    for (i = 0; i < 200; i = i + 1) {
+        if (copies[i]["k"] != i) {
+            ok = false;
+        }
+    }
+    if (ok && map_len(oc[0]) == 2) {
+        echo("ok");
+    }
+}
@@ -0,0 +1,153 @@
+// NOPARSE: 语法分析器尚未支持 [K]V 类型声明
+
+/* EXPECT
+500
+false
+true
+false
+"ok"
+1000
+"ok"
+[3,5,1,]
+3
+"xx"
+5
+"x"
+"xxxxx"
+[14,21,28,7,]
+7
+28
+21
+false
+[7,14,21,28,35,]
+*/
+
+package main;
+
+func main() {
+    // 删除一半的键后重新插入，被删除的位置必须能够被复用且不影响查找
+    var m [int]int = [];
+    var i int;
+    for (i = 0; i < 1000; i = i + 1) {
+        m[i * 7] = i;
+    }
+    for (i = 0; i < 1000; i = i + 2) {
+        map_del(m, i * 7);
+    }
+    echo(map_len(m));
+    echo(map_has(m, 0));
+    echo(map_has(m, 7));
+    echo(map_del(m, 0));
+
+    var ok = true;
+    var round int;
+    for (round = 0; round < 20; round = round + 1) {
+        for (i = 0; i < 1000; i = i + 2) {
+            m[i * 7] = i + round;
+        }
+        for (i = 0; i < 1000; i = i + 1) {
+            if (!map_has(m, i * 7)) {
+                ok = false;
+            } else if (i - i / 2 * 2 == 0 && m[i * 7] != i + round) {
+                ok = false;
+            } else if (i - i / 2 * 2 == 1 && m[i * 7] != i) {
+                ok = false;
+            }
+        }
+        for (i = 0; i < 1000; i = i + 2) {
+            if (!map_del(m, i * 7)) {
+                ok = false;
+            }
+        }
+        if (map_len(m) != 500) {
+            ok = false;
+        }
+    }
+    if (ok) {
+        echo("ok");
+    }
+
+    for (i = 0; i < 1000; i = i + 2) {
+        m[i * 7] = i;
+    }
+    echo(map_len(m));
+
+    // 删除全部元素后，map 仍然可以正常使用
+    var s [string]int = [];
+    var key = "";
+    for (i = 0; i < 50; i = i + 1) {
+        key = key + "x";
+        s[key] = i;
+    }
+    ok = true;
+    for (round = 0; round < 5; round = round + 1) {
+        key = "";
+        for (i = 0; i < 50; i = i + 1) {
+            key = key + "x";
+            if (!map_del(s, key)) {
+                ok = false;
+            }
+        }
+        if (map_len(s) != 0) {
+            ok = false;
+        }
+        key = "";
+        for (i = 0; i < 50; i = i + 1) {
+            key = key + "x";
+            s[key] = i + round;
+        }
+    }
+    key = "";
+    for (i = 0; i < 50; i = i + 1) {
+        key = key + "x";
+        if (s[key] != i + 4) {
+            ok = false;
+        }
+    }
+    if (ok) {
+        echo("ok");
+    }
+
+    // 重新插入的键排在最后
+    var t [int]int = [];
+    t[1] = 1;
+    t[3] = 3;
+    t[5] = 5;
+    map_del(t, 1);
+    t[1] = 10;
+    echo(map_keys(t));
+    echo(map_len(t));
+
+    // 转为有序保存之后删除并重新插入
+    var o [string]int = [];
+    key = "";
+    for (i = 0; i < 5; i = i + 1) {
+        key = key + "x";
+        o[key] = i;
+    }
+    map_del(o, "x");
+    map_del(o, "xxx");
+    echo(map_min(o));
+    o["x"] = 1;
+    o["xxx"] = 3;
+    echo(map_len(o));
+    echo(map_min(o));
+    echo(map_max(o));
+
+    var r [int]int = [];
+    for (i = 1; i <= 4; i = i + 1) {
+        r[i * 7] = i;
+    }
+    map_del(r, 7);
+    r[7] = 1;
+    echo(map_keys(r));
+    echo(map_min(r));
+    map_del(r, 7);
+    map_del(r, 35);
+    echo(map_max(r));
+    echo(map_floor(r, 27));
+    echo(map_has(r, 7));
+    r[7] = 1;
+    r[35] = 5;
+    echo(map_keys(r));
+}
@@ -1,3 +1,5 @@
+// PENDING: 尚未支持 struct
+
 package main;
 
 func main() {
@@ -1,3 +1,5 @@
+// PENDING: 尚未支持 type 声明
+
 package main;
 
 func main() {